@@ -0,0 +1,202 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+//====== GENERATOR SETTINGS ======
+#define DEFAULT_SEED 42
+#define BORROWED_PERCENT 4 // Share of books that are out
+#define LOAN_DAYS 90       // Borrow dates are spread over this many days before the last one
+#define LAST_LOAN_DAY 1    // Last borrow date: 01-06-2025
+#define LAST_LOAN_MONTH 6
+#define LAST_LOAN_YEAR 2025
+
+static const char *words[] = {
+    "the", "of", "and", "a", "in", "to", "night", "house", "river", "war", "peace", "garden", "shadow",
+    "king", "queen", "secret", "history", "winter", "summer", "city", "stone", "fire", "glass", "little",
+    "last", "lost", "silent", "golden", "dark", "old", "new", "road", "sea", "island", "dragon", "code",
+    "mind", "heart", "letters", "journey", "empire", "forest", "light", "time", "memory", "children",
+    "storm", "mountain", "north", "south", "daughter", "brother", "wolf", "library", "machine", "song",
+    "introduction", "principles", "programming", "algorithms", "philosophy", "economics", "modern"};
+
+static const char *firstNames[] = {"Anna", "John", "Maria", "David", "Elena", "Peter", "Sofia", "James", "Olga",
+                                   "Thomas", "Laura", "Ivan", "Grace", "Mark", "Nadia", "Robert", "Chen", "Amir",
+                                   "Hannah", "Luis", "Yuki", "Kwame", "Ingrid", "Pablo"};
+
+static const char *lastNames[] = {"Smith", "Kowalski", "Garcia", "Novak", "Tanaka", "Okafor", "Schmidt", "Rossi",
+                                  "Johansson", "Petrov", "Dubois", "Nguyen", "Brown", "Silva", "Fischer", "Haddad",
+                                  "Murphy", "Kim", "Andersen", "Moreau", "Santos", "Ivanova", "Clarke", "Weber"};
+
+static const char *genres[] = {"Fiction", "Classic", "Mystery", "Thriller", "Fantasy", "Science Fiction",
+                               "Romance", "History", "Biography", "Poetry", "Programming", "Philosophy",
+                               "Children", "Horror", "Travel", "Economics", "Dystopian", "Drama"};
+
+static const char *syllables[] = {"ka", "lo", "mi", "ren", "tho", "vax", "qui", "zer", "bel", "dun", "fay", "gor"};
+
+#define COUNT(array) ((int)(sizeof(array) / sizeof(array[0])))
+
+//====== NEXT RANDOM FUNCTION ======
+/*
+    nextRandom function:
+    - Small deterministic generator so the same seed always writes the same catalog.
+*/
+static unsigned int nextRandom(unsigned int *state)
+{
+   *state = *state * 1103515245u + 12345u;
+   return *state >> 8;
+}
+
+//====== SKEWED PICK FUNCTION ======
+/*
+    skewedPick function:
+    - Picks an index below count, favouring the first entries, so common words repeat like in real titles.
+*/
+static int skewedPick(unsigned int *state, int count)
+{
+   unsigned int a = nextRandom(state) % count;
+   unsigned int b = nextRandom(state) % count;
+   return (int)(a < b ? a : b);
+}
+
+//====== DAYS FROM CIVIL FUNCTION ======
+/*
+    daysFromCivil and civilFromDays functions:
+    - Convert between a calendar date and days since 01-01-1970, to spread the borrow dates.
+*/
+static long daysFromCivil(int year, int month, int day)
+{
+   year -= month <= 2;
+   long era = (year >= 0 ? year : year - 399) / 400;
+   long yearOfEra = year - era * 400;
+   long dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+   long dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+   return era * 146097 + dayOfEra - 719468;
+}
+
+static void civilFromDays(long days, int *year, int *month, int *day)
+{
+   days += 719468;
+   long era = (days >= 0 ? days : days - 146096) / 146097;
+   long dayOfEra = days - era * 146097;
+   long yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+   long dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+   long monthIndex = (5 * dayOfYear + 2) / 153;
+   *day = (int)(dayOfYear - (153 * monthIndex + 2) / 5 + 1);
+   *month = (int)(monthIndex < 10 ? monthIndex + 3 : monthIndex - 9);
+   *year = (int)(yearOfEra + era * 400 + (*month <= 2));
+}
+
+//====== WRITE TITLE FUNCTION ======
+/*
+    writeTitle function:
+    - One to eight common words and sometimes a made-up word, capitalized, at most 50 characters.
+*/
+static void writeTitle(unsigned int *state, char *title, int size)
+{
+   int length = 0;
+   int parts = 1 + nextRandom(state) % 8;
+   for (int p = 0; p < parts; p++)
+   {
+      const char *word = words[skewedPick(state, COUNT(words))];
+      if (length + (p ? 1 : 0) + (int)strlen(word) >= size)
+      {
+         break;
+      }
+      length += snprintf(title + length, size - length, "%s%s", p ? " " : "", word);
+   }
+   if (nextRandom(state) % 3 == 0 && length + 10 < size)
+   {
+      length += snprintf(title + length, size - length, " %s%s%s", syllables[nextRandom(state) % COUNT(syllables)],
+                         syllables[nextRandom(state) % COUNT(syllables)],
+                         syllables[nextRandom(state) % COUNT(syllables)]);
+   }
+   title[0] = (char)toupper((unsigned char)title[0]);
+}
+
+//====== WRITE AUTHORS FUNCTION ======
+/*
+    writeAuthors function:
+    - One author most of the time, up to four, as "First Last" separated by ", ".
+*/
+static void writeAuthors(unsigned int *state, char *authors, int size)
+{
+   int length = 0;
+   int count = 1;
+   while (count < 4 && nextRandom(state) % 4 == 0)
+   {
+      count++;
+   }
+   for (int a = 0; a < count; a++)
+   {
+      length += snprintf(authors + length, size - length, "%s%s %s", a ? ", " : "",
+                         firstNames[nextRandom(state) % COUNT(firstNames)],
+                         lastNames[nextRandom(state) % COUNT(lastNames)]);
+   }
+}
+
+//====== MAIN FUNCTION ======
+/*
+    main function:
+    - Usage: catalog_gen books [seed] > books.db
+    - Writes books lines in the "books.db" format: unique ISBNs in shuffled order, titles and author
+      lists of varied length, a few genres, years leaning to recent ones and some borrowed books.
+*/
+int main(int argc, char **argv)
+{
+   long books = argc > 1 ? atol(argv[1]) : 0;
+   unsigned int seed = argc > 2 ? (unsigned int)atol(argv[2]) : DEFAULT_SEED;
+   unsigned int state = seed;
+   if (books <= 0 || books > 10000000000L)
+   {
+      fprintf(stderr, "Usage: %s books [seed] > books.db\n", argv[0]);
+      return 1;
+   }
+
+   static char buffer[1 << 20];
+   setvbuf(stdout, buffer, _IOFBF, sizeof(buffer));
+   long lastLoan = daysFromCivil(LAST_LOAN_YEAR, LAST_LOAN_MONTH, LAST_LOAN_DAY);
+
+   for (long i = 0; i < books; i++)
+   {
+      char title[51], authors[201], genre[101], date[16] = "-";
+
+      // An odd multiplier not divisible by 5 is a permutation of the 10-digit numbers
+      unsigned long long number = ((unsigned long long)i * 2654435761ull + seed) % 10000000000ull;
+
+      writeTitle(&state, title, sizeof(title));
+      writeAuthors(&state, authors, sizeof(authors));
+      int first = nextRandom(&state) % COUNT(genres);
+      int second = nextRandom(&state) % COUNT(genres);
+      if (first != second && nextRandom(&state) % 2)
+      {
+         snprintf(genre, sizeof(genre), "%s, %s", genres[first], genres[second]);
+      }
+      else
+      {
+         snprintf(genre, sizeof(genre), "%s", genres[first]);
+      }
+
+      // The later of two years, so recent books are more common
+      int yearA = 1800 + nextRandom(&state) % 226;
+      int yearB = 1800 + nextRandom(&state) % 226;
+      int year = yearA > yearB ? yearA : yearB;
+
+      int borrowed = (int)(nextRandom(&state) % 100) < BORROWED_PERCENT;
+      if (borrowed)
+      {
+         int y, m, d;
+         civilFromDays(lastLoan - nextRandom(&state) % LOAN_DAYS, &y, &m, &d);
+         snprintf(date, sizeof(date), "%02d-%02d-%04d", d, m, y);
+      }
+
+      printf("978%010llu|%s|%s|%d|%s|%s|%s\n", number, title, authors, year, genre, borrowed ? "true" : "false",
+             date);
+   }
+
+   if (fflush(stdout) != 0)
+   {
+      fprintf(stderr, "Error: Could not write the catalog.\n");
+      return 1;
+   }
+   return 0;
+}
@@ -0,0 +1,260 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "catalog.h"
+
+//====== BENCHMARK SETTINGS ======
+#define DEFAULT_BOOKS 1000000
+#define DEFAULT_ROUNDS 20
+
+static const char *genres[] = {"Fiction", "Mystery", "Thriller", "Fantasy", "Science Fiction", "Romance", "History",
+                               "Biography", "Poetry", "Children", "Horror", "Drama", "Philosophy", "Travel",
+                               "Programming", "Cooking", "Art", "Music", "Sports", "Religion"};
+
+#define GENRE_COUNT ((int)(sizeof(genres) / sizeof(genres[0])))
+
+//====== FILTER STRUCTURE DEFINITION ======
+typedef struct
+{
+   const char *name;     // Shown in the results
+   const char *genre[2]; // Genres a book must all have, NULL if unused
+   int firstYear;
+   int lastYear;
+   int borrowed; // FACET_ANY, FACET_ON_SHELF or FACET_BORROWED
+} Filter;
+
+static const Filter filters[] = {
+    {"all books", {NULL, NULL}, INT32_MIN, INT32_MAX, FACET_ANY},
+    {"borrowed", {NULL, NULL}, INT32_MIN, INT32_MAX, FACET_BORROWED},
+    {"mystery", {"Mystery", NULL}, INT32_MIN, INT32_MAX, FACET_ANY},
+    {"mystery + thriller", {"Mystery", "Thriller"}, INT32_MIN, INT32_MAX, FACET_ANY},
+    {"1990-1999", {NULL, NULL}, 1990, 1999, FACET_ANY},
+    {"fantasy, 1950-2000, shelf", {"Fantasy", NULL}, 1950, 2000, FACET_ON_SHELF},
+};
+
+#define FILTER_COUNT ((int)(sizeof(filters) / sizeof(filters[0])))
+
+//====== NEXT RANDOM FUNCTION ======
+/*
+    nextRandom function:
+    - Small deterministic generator so every run builds the same catalog.
+*/
+static unsigned int nextRandom(unsigned int *state)
+{
+   *state = *state * 1103515245u + 12345u;
+   return *state >> 8;
+}
+
+//====== NOW FUNCTION ======
+/*
+    now function:
+    - Returns a monotonic time in microseconds.
+*/
+static double now(void)
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+//====== FILL CATALOG FUNCTION ======
+/*
+    fillCatalog function:
+    - Adds count generated books with one to three genres, a year from 1800 to 2025, a third of them borrowed.
+*/
+static int fillCatalog(Catalog *catalog, int count)
+{
+   unsigned int state = 42;
+   for (int i = 0; i < count; i++)
+   {
+      Database book = {0};
+      snprintf(book.isbn, sizeof(book.isbn), "978%010d", i);
+      snprintf(book.nameBook, sizeof(book.nameBook), "Book %d", i);
+      snprintf(book.authors, sizeof(book.authors), "Author %d", i % 1000);
+      book.year = 1800 + nextRandom(&state) % 226;
+      int genreCount = 1 + nextRandom(&state) % 3;
+      int length = 0;
+      for (int g = 0; g < genreCount; g++)
+      {
+         length += snprintf(book.genre + length, sizeof(book.genre) - length, "%s%s", g > 0 ? ", " : "",
+                            genres[nextRandom(&state) % GENRE_COUNT]);
+      }
+      int borrowed = nextRandom(&state) % 3 == 0;
+      strcpy(book.borrowed, borrowed ? "true" : "false");
+      strcpy(book.date, borrowed ? "01-02-2025" : "-");
+      if (!insertBook(catalog, &book))
+      {
+         return 0;
+      }
+   }
+   return 1;
+}
+
+//====== SCAN COUNT FUNCTION ======
+/*
+    scanCount function:
+    - The report the facet index replaces: split the genre field of every live book at its commas and
+      compare each name, then count the books left by the filter per genre and per decade.
+    - Stores the books per genre of the genres array and per decade from 1800 in the given arrays.
+    - Returns the number of matching books.
+*/
+static int scanCount(const Catalog *catalog, const Filter *filter, int *perGenre, int *perDecade)
+{
+   memset(perGenre, 0, GENRE_COUNT * sizeof(int));
+   memset(perDecade, 0, 23 * sizeof(int));
+   int books = 0;
+   for (int i = 0; i < catalog->count; i++)
+   {
+      if (isBookDeleted(catalog, i))
+      {
+         continue;
+      }
+      int year = bookYear(catalog, i);
+      int borrowed = isBookBorrowed(catalog, i);
+      if (year < filter->firstYear || year > filter->lastYear ||
+          (filter->borrowed != FACET_ANY && borrowed != filter->borrowed))
+      {
+         continue;
+      }
+
+      char field[101];
+      StringView genre = bookGenre(catalog, i);
+      snprintf(field, sizeof(field), "%.*s", genre.length, genre.data);
+      int has[GENRE_COUNT] = {0};
+      for (char *name = strtok(field, ","); name; name = strtok(NULL, ","))
+      {
+         while (isspace((unsigned char)*name))
+         {
+            name++;
+         }
+         for (int g = 0; g < GENRE_COUNT; g++)
+         {
+            if (strcasecmp(name, genres[g]) == 0)
+            {
+               has[g] = 1;
+            }
+         }
+      }
+      int matches = 1;
+      for (int f = 0; f < 2 && filter->genre[f]; f++)
+      {
+         for (int g = 0; g < GENRE_COUNT; g++)
+         {
+            matches = matches && (strcmp(genres[g], filter->genre[f]) != 0 || has[g]);
+         }
+      }
+      if (!matches)
+      {
+         continue;
+      }
+      books++;
+      perDecade[(year - 1800) / 10]++;
+      for (int g = 0; g < GENRE_COUNT; g++)
+      {
+         perGenre[g] += has[g];
+      }
+   }
+   return books;
+}
+
+//====== MAIN FUNCTION ======
+/*
+    main function:
+    - Usage: facet_counts [books] [rounds]
+    - Builds a generated catalog, then for each filter times the report of the facet index against the
+      scan of every genre field, checks that both give the same counts per genre and per decade, and
+      prints the mean time of each.
+*/
+int main(int argc, char **argv)
+{
+   int books = argc > 1 ? atoi(argv[1]) : DEFAULT_BOOKS;
+   int rounds = argc > 2 ? atoi(argv[2]) : DEFAULT_ROUNDS;
+   if (books <= 0 || rounds <= 0)
+   {
+      fprintf(stderr, "Usage: %s [books] [rounds]\n", argv[0]);
+      return 1;
+   }
+
+   Catalog catalog = {0};
+   double start = now();
+   if (!fillCatalog(&catalog, books))
+   {
+      freeCatalog(&catalog);
+      return 1;
+   }
+
+   // Rebuild the facet index in one go, as loading books.db does
+   facetIndexFree(&catalog.facets);
+   start = now();
+   if (!facetIndexBuild(&catalog.facets, &catalog))
+   {
+      freeCatalog(&catalog);
+      return 1;
+   }
+   printf("Catalog: %d books, %d genres, facet index built in %.1f ms\n", catalog.count, catalog.facets.genreCount,
+          (now() - start) / 1e3);
+   printf("%-26s %10s %12s %12s %9s\n", "filter", "books", "scan (us)", "index (us)", "speedup");
+
+   static DecadeCount decades[FACET_MAX_DECADES];
+   int failed = 0;
+   for (int f = 0; f < FILTER_COUNT; f++)
+   {
+      const Filter *filter = &filters[f];
+      FacetFilter facetFilter = {0, filter->firstYear, filter->lastYear, filter->borrowed};
+      for (int g = 0; g < 2 && filter->genre[g]; g++)
+      {
+         facetFilter.genres |= (uint64_t)1 << facetIndexGenre(&catalog.facets, filter->genre[g], (int)strlen(filter->genre[g]));
+      }
+
+      FacetCounts counts;
+      start = now();
+      for (int r = 0; r < rounds; r++)
+      {
+         facetIndexCount(&catalog.facets, &catalog, &facetFilter, &counts, decades, FACET_MAX_DECADES);
+      }
+      double indexTime = (now() - start) / rounds;
+
+      int perGenre[GENRE_COUNT], perDecade[23];
+      int scanBooks = 0;
+      start = now();
+      for (int r = 0; r < rounds; r++)
+      {
+         scanBooks = scanCount(&catalog, filter, perGenre, perDecade);
+      }
+      double scanTime = (now() - start) / rounds;
+
+      // Same totals, same books per genre and per decade
+      int same = scanBooks == counts.books;
+      for (int g = 0; g < GENRE_COUNT; g++)
+      {
+         int id = facetIndexGenre(&catalog.facets, genres[g], (int)strlen(genres[g]));
+         same = same && perGenre[g] == (id < 0 ? 0 : counts.genreBooks[id]);
+      }
+      int listed = 0;
+      for (int d = 0; d < 23; d++)
+      {
+         if (perDecade[d] > 0)
+         {
+            same = same && listed < counts.decadeCount && counts.decades[listed].decade == 1800 + d * 10 &&
+                   counts.decades[listed].books == perDecade[d];
+            listed++;
+         }
+      }
+      same = same && listed == counts.decadeCount;
+      if (!same)
+      {
+         printf("Error: Counts differ for \"%s\" (scan %d, index %d)\n", filter->name, scanBooks, counts.books);
+         failed = 1;
+      }
+      printf("%-26s %10d %12.1f %12.1f %8.0fx\n", filter->name, counts.books, scanTime, indexTime,
+             indexTime > 0 ? scanTime / indexTime : 0.0);
+   }
+
+   freeCatalog(&catalog);
+   return failed;
+}
@@ -0,0 +1,377 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+
+#include "catalog.h"
+
+//====== BENCHMARK SETTINGS ======
+#define DEFAULT_BOOKS 1000000
+#define DEFAULT_QUERIES 200
+#define CHECKED_QUERIES 5
+#define MAX_FOUND 100
+
+static const char *words[] = {
+    "the", "of", "and", "a", "in", "night", "house", "river", "war", "peace", "garden", "shadow",
+    "king", "queen", "secret", "history", "winter", "summer", "city", "stone", "fire", "glass",
+    "little", "last", "lost", "silent", "golden", "dark", "old", "new", "road", "sea", "island",
+    "dragon", "code", "mind", "heart", "letters", "journey", "empire", "forest", "light", "time"};
+
+static const char *syllables[] = {"ka", "lo", "mi", "ren", "tho", "vax", "qui", "zer", "bel", "dun", "fay", "gor",
+                                  "an", "sil", "mor", "eth", "dra", "nus", "pel", "wyn", "ost", "ri", "cal", "bo"};
+
+static const char *firstNames[] = {"Anna", "Mark", "Sofia", "James", "Maria", "David", "Hannah", "Peter", "Elena", "Tom"};
+
+//====== NEXT RANDOM FUNCTION ======
+/*
+    nextRandom function:
+    - Small deterministic generator so every run builds the same catalog and queries.
+*/
+static unsigned int nextRandom(unsigned int *state)
+{
+   *state = *state * 1103515245u + 12345u;
+   return *state >> 8;
+}
+
+//====== NOW FUNCTION ======
+/*
+    now function:
+    - Returns a monotonic time in microseconds.
+*/
+static double now(void)
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+//====== MADE UP WORD FUNCTION ======
+/*
+    madeUpWord function:
+    - Writes a word of 2 to 4 random syllables, so the vocabulary runs to hundreds of thousands of words.
+*/
+static int madeUpWord(unsigned int *state, char *word, size_t size)
+{
+   int syllableCount = sizeof(syllables) / sizeof(syllables[0]);
+   int parts = 2 + nextRandom(state) % 3;
+   int length = 0;
+   for (int p = 0; p < parts; p++)
+   {
+      length += snprintf(word + length, size - length, "%s", syllables[nextRandom(state) % syllableCount]);
+   }
+   return length;
+}
+
+//====== FILL CATALOG FUNCTION ======
+/*
+    fillCatalog function:
+    - Adds count generated books: a few common words and two made-up words per title, a first name and a
+      made-up surname as the author.
+*/
+static int fillCatalog(Catalog *catalog, int count)
+{
+   unsigned int state = 42;
+   int wordCount = sizeof(words) / sizeof(words[0]);
+   int nameCount = sizeof(firstNames) / sizeof(firstNames[0]);
+   for (int i = 0; i < count; i++)
+   {
+      Database book = {0};
+      snprintf(book.isbn, sizeof(book.isbn), "978%010d", i);
+      char madeUp[2][16];
+      madeUpWord(&state, madeUp[0], sizeof(madeUp[0]));
+      madeUpWord(&state, madeUp[1], sizeof(madeUp[1]));
+      snprintf(book.nameBook, sizeof(book.nameBook), "%s %s %s %s", words[nextRandom(&state) % wordCount], madeUp[0],
+               words[nextRandom(&state) % wordCount], madeUp[1]);
+      book.nameBook[0] = (char)toupper((unsigned char)book.nameBook[0]);
+      char surname[16];
+      madeUpWord(&state, surname, sizeof(surname));
+      surname[0] = (char)toupper((unsigned char)surname[0]);
+      snprintf(book.authors, sizeof(book.authors), "%s %s", firstNames[nextRandom(&state) % nameCount], surname);
+      book.year = 1900 + nextRandom(&state) % 120;
+      strcpy(book.genre, "Fiction");
+      strcpy(book.borrowed, "false");
+      strcpy(book.date, "-");
+      if (!insertBook(catalog, &book))
+      {
+         return 0;
+      }
+   }
+   return 1;
+}
+
+//====== MISSPELL FUNCTION ======
+/*
+    misspell function:
+    - Applies the given number of random edits (substitution, deletion or insertion of a letter) to a word.
+*/
+static void misspell(unsigned int *state, char *word, int edits)
+{
+   for (int e = 0; e < edits; e++)
+   {
+      int length = (int)strlen(word);
+      int at = nextRandom(state) % length;
+      char letter = (char)('a' + nextRandom(state) % 26);
+      switch (nextRandom(state) % 3)
+      {
+      case 0:
+         word[at] = letter;
+         break;
+      case 1:
+         memmove(word + at, word + at + 1, length - at);
+         break;
+      default:
+         memmove(word + at + 1, word + at, length - at + 1);
+         word[at] = letter;
+         break;
+      }
+   }
+}
+
+//====== MAKE QUERY FUNCTION ======
+/*
+    makeQuery function:
+    - Builds a query from a random book: its two made-up title words (or one of them and the author's
+      surname), each misspelled by the given number of edits, so it has a known book to find.
+*/
+static void makeQuery(const Catalog *catalog, unsigned int *state, int edits, char *query, size_t size)
+{
+   int row = nextRandom(state) % catalog->count;
+   StringView title = bookTitle(catalog, row);
+   StringView authors = bookAuthors(catalog, row);
+   char text[160];
+   snprintf(text, sizeof(text), "%.*s %.*s", title.length, title.data, authors.length, authors.data);
+
+   // Title words 2 and 4 are made up, word 6 is the surname
+   char *picked[6];
+   int count = 0;
+   for (char *word = strtok(text, " "); word && count < 6; word = strtok(NULL, " "))
+   {
+      picked[count++] = word;
+   }
+   char first[40], second[40];
+   snprintf(first, sizeof(first), "%s", picked[1]);
+   snprintf(second, sizeof(second), "%s", nextRandom(state) % 2 ? picked[3] : picked[5]);
+   for (int i = 0; second[i]; i++)
+   {
+      second[i] = (char)tolower((unsigned char)second[i]);
+   }
+   misspell(state, first, edits);
+   misspell(state, second, edits);
+   snprintf(query, size, "%s %s", first, second);
+}
+
+//====== EDIT DISTANCE FUNCTION ======
+/*
+    editDistance function:
+    - Plain Levenshtein distance by dynamic programming, for the scan.
+*/
+static int editDistance(const char *a, int lengthA, const char *b, int lengthB)
+{
+   int row[64];
+   for (int j = 0; j <= lengthB; j++)
+   {
+      row[j] = j;
+   }
+   for (int i = 1; i <= lengthA; i++)
+   {
+      int diagonal = row[0];
+      row[0] = i;
+      for (int j = 1; j <= lengthB; j++)
+      {
+         int above = row[j];
+         int best = diagonal + (a[i - 1] != b[j - 1]);
+         if (above + 1 < best)
+         {
+            best = above + 1;
+         }
+         if (row[j - 1] + 1 < best)
+         {
+            best = row[j - 1] + 1;
+         }
+         row[j] = best;
+         diagonal = above;
+      }
+   }
+   return row[lengthB];
+}
+
+//====== SCAN MATCH STRUCTURE DEFINITION ======
+typedef struct
+{
+   int distance;
+   int row;
+} ScanMatch;
+
+static int compareScanMatches(const void *a, const void *b)
+{
+   const ScanMatch *x = a, *y = b;
+   return x->distance != y->distance ? x->distance - y->distance : x->row - y->row;
+}
+
+//====== SCAN SEARCH FUNCTION ======
+/*
+    scanSearch function:
+    - The search the BK tree replaces: measure every query word against every title and author word of
+      every book, with the same allowance per word as the index (none up to 2 letters, one up to 5).
+    - Returns the number of matches; stores up to maxRows rows, fewest edits first.
+*/
+static int scanSearch(const Catalog *catalog, const char *query, int maxDistance, int *rows, int maxRows)
+{
+   char terms[TOKEN_MAX_TERMS][TOKEN_MAX_LENGTH + 1];
+   int allowed[TOKEN_MAX_TERMS];
+   int termCount = 0;
+   char copy[100];
+   snprintf(copy, sizeof(copy), "%s", query);
+   for (char *term = strtok(copy, " "); term && termCount < TOKEN_MAX_TERMS; term = strtok(NULL, " "))
+   {
+      snprintf(terms[termCount], sizeof(terms[termCount]), "%s", term);
+      int length = (int)strlen(terms[termCount]);
+      allowed[termCount] = length <= 2 ? 0 : length <= 5 ? 1 : 2;
+      if (allowed[termCount] > maxDistance)
+      {
+         allowed[termCount] = maxDistance;
+      }
+      termCount++;
+   }
+
+   ScanMatch *matches = malloc(catalog->count * sizeof(ScanMatch));
+   int found = 0;
+   for (int i = 0; i < catalog->count; i++)
+   {
+      StringView title = bookTitle(catalog, i);
+      StringView authors = bookAuthors(catalog, i);
+      char text[160];
+      int length = snprintf(text, sizeof(text), "%.*s %.*s", title.length, title.data, authors.length, authors.data);
+      for (int j = 0; j < length; j++)
+      {
+         text[j] = (char)tolower((unsigned char)text[j]);
+      }
+
+      int total = 0;
+      for (int t = 0; t < termCount && total >= 0; t++)
+      {
+         int termLength = (int)strlen(terms[t]);
+         int best = -1;
+         for (int start = 0; start < length;)
+         {
+            int end = start;
+            while (end < length && isalnum((unsigned char)text[end]))
+            {
+               end++;
+            }
+            int gap = end - start - termLength;
+            if (end > start && gap <= allowed[t] && gap >= -allowed[t])
+            {
+               int distance = editDistance(terms[t], termLength, text + start, end - start);
+               if (distance <= allowed[t] && (best < 0 || distance < best))
+               {
+                  best = distance;
+               }
+            }
+            start = end + 1;
+         }
+         total = best < 0 ? -1 : total + best;
+      }
+      if (total >= 0)
+      {
+         matches[found++] = (ScanMatch){total, i};
+      }
+   }
+
+   qsort(matches, found, sizeof(ScanMatch), compareScanMatches);
+   for (int i = 0; i < found && i < maxRows; i++)
+   {
+      rows[i] = matches[i].row;
+   }
+   free(matches);
+   return found;
+}
+
+//====== COMPARE TIMES FUNCTION ======
+static int compareTimes(const void *a, const void *b)
+{
+   double x = *(const double *)a, y = *(const double *)b;
+   return (x > y) - (x < y);
+}
+
+//====== MAIN FUNCTION ======
+/*
+    main function:
+    - Usage: fuzzy_search [books] [queries]
+    - Builds a generated catalog, then for distance 1 and 2 runs queries of two words misspelled by as many
+      edits, checks the first few against a full scan of every word of every book, and prints the mean,
+      median and 99th percentile time of the index.
+*/
+int main(int argc, char **argv)
+{
+   int books = argc > 1 ? atoi(argv[1]) : DEFAULT_BOOKS;
+   int queryCount = argc > 2 ? atoi(argv[2]) : DEFAULT_QUERIES;
+   if (books <= 0 || queryCount < CHECKED_QUERIES)
+   {
+      fprintf(stderr, "Usage: %s [books] [queries, at least %d]\n", argv[0], CHECKED_QUERIES);
+      return 1;
+   }
+
+   Catalog catalog = {0};
+   double start = now();
+   if (!fillCatalog(&catalog, books))
+   {
+      freeCatalog(&catalog);
+      return 1;
+   }
+
+   // Rebuild the token index in one go, as loading books.db does, which also lays out the BK tree
+   tokenIndexFree(&catalog.tokenIndex);
+   if (!tokenIndexBuild(&catalog.tokenIndex, &catalog))
+   {
+      freeCatalog(&catalog);
+      return 1;
+   }
+   printf("Catalog: %d books, %u distinct words, built in %.1f ms\n", catalog.count, catalog.tokenIndex.count,
+          (now() - start) / 1e3);
+   printf("%-9s %8s %10s %12s %12s %12s %12s\n", "distance", "queries", "matches", "scan (us)", "mean (us)", "p50 (us)",
+          "p99 (us)");
+
+   double *times = malloc(queryCount * sizeof(double));
+   int failed = 0;
+   for (int distance = 1; distance <= TOKEN_FUZZY_MAX_DISTANCE; distance++)
+   {
+      unsigned int state = 7 + distance;
+      double total = 0, scanTotal = 0;
+      long matches = 0;
+      for (int q = 0; q < queryCount; q++)
+      {
+         char query[100];
+         makeQuery(&catalog, &state, distance, query, sizeof(query));
+
+         int indexRows[MAX_FOUND];
+         start = now();
+         int indexFound = tokenIndexFuzzySearch(&catalog.tokenIndex, &catalog, query, distance, indexRows, MAX_FOUND);
+         times[q] = now() - start;
+         total += times[q];
+         matches += indexFound;
+
+         if (q < CHECKED_QUERIES)
+         {
+            int scanRows[MAX_FOUND];
+            start = now();
+            int scanFound = scanSearch(&catalog, query, distance, scanRows, MAX_FOUND);
+            scanTotal += now() - start;
+            int shown = scanFound < MAX_FOUND ? scanFound : MAX_FOUND;
+            if (scanFound != indexFound || memcmp(scanRows, indexRows, shown * sizeof(int)) != 0)
+            {
+               printf("Error: Results differ for \"%s\" (scan %d, index %d)\n", query, scanFound, indexFound);
+               failed = 1;
+            }
+         }
+      }
+      qsort(times, queryCount, sizeof(double), compareTimes);
+      printf("%-9d %8d %10.1f %12.1f %12.1f %12.1f %12.1f\n", distance, queryCount, (double)matches / queryCount,
+             scanTotal / CHECKED_QUERIES, total / queryCount, times[queryCount / 2], times[queryCount * 99 / 100]);
+   }
+
+   free(times);
+   freeCatalog(&catalog);
+   return failed;
+}
@@ -0,0 +1,444 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "catalog.h"
+#include "storage.h"
+
+//====== BENCHMARK SETTINGS ======
+#define DEFAULT_ROUNDS 5
+#define LOOKUPS 100000 // ISBN lookups per round, one in eight of them misses
+#define LOANS 200      // Borrow and return pairs per round
+#define MAX_FOUND 100  // Rows asked of a title search, as in the search menu
+#define PAGE_ROWS 256  // Rows read per borrow index page, as in showBorrowedBooks
+#define SCHEMA 1       // Bumped whenever names or meaning of the JSON fields change
+
+static const char *queries[] = {"the", "night", "garden of", "silent sea", "dragon", "history of the",
+                                "kalomi", "introduction to", "zzz", "e"};
+
+// Temporary directory holding the copy of the catalog the benchmarks run on
+static char copyDirectory[4096];
+
+//====== BENCHMARK RESULT STRUCTURE DEFINITION ======
+/*
+    BenchResult structure:
+    - Time of every round of one benchmark, in milliseconds, and how many operations a round does.
+*/
+typedef struct
+{
+   const char *name; // Stable name used to track the benchmark across releases
+   int ops;          // Operations per round
+   double *rounds;   // Time of each round
+} BenchResult;
+
+//====== NEXT RANDOM FUNCTION ======
+/*
+    nextRandom function:
+    - Small deterministic generator so every run picks the same books.
+*/
+static unsigned int nextRandom(unsigned int *state)
+{
+   *state = *state * 1103515245u + 12345u;
+   return *state >> 8;
+}
+
+//====== NOW FUNCTION ======
+/*
+    now function:
+    - Returns a monotonic time in milliseconds.
+*/
+static double now(void)
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+//====== COMPARE TIMES FUNCTION ======
+/*
+    compareTimes function:
+    - qsort order of round times, fastest first.
+*/
+static int compareTimes(const void *a, const void *b)
+{
+   double x = *(const double *)a;
+   double y = *(const double *)b;
+   return (x > y) - (x < y);
+}
+
+//====== COPY FILE FUNCTION ======
+/*
+    copyFile function:
+    - Copies the file from into to, replacing it.
+    - Returns 1 on success, 0 if from is missing or either file could not be read or written.
+*/
+static int copyFile(const char *from, const char *to)
+{
+   FILE *input = fopen(from, "rb");
+   if (!input)
+   {
+      return 0;
+   }
+   FILE *output = fopen(to, "wb");
+   if (!output)
+   {
+      fclose(input);
+      return 0;
+   }
+   char buffer[1 << 16];
+   size_t length;
+   int ok = 1;
+   while ((length = fread(buffer, 1, sizeof(buffer), input)) > 0)
+   {
+      ok = ok && fwrite(buffer, 1, length, output) == length;
+   }
+   ok = ok && !ferror(input);
+   fclose(input);
+   return fclose(output) == 0 && ok;
+}
+
+//====== REMOVE COPY FUNCTION ======
+/*
+    removeCopy function:
+    - atexit handler: deletes the temporary directory the catalog was copied to, and everything in it.
+*/
+static void removeCopy(void)
+{
+   char command[sizeof(copyDirectory) + 16];
+   snprintf(command, sizeof(command), "rm -rf '%s'", copyDirectory);
+   if (system(command) != 0)
+   {
+      fprintf(stderr, "Warning: Unable to remove %s.\n", copyDirectory);
+   }
+}
+
+//====== MAKE COPY FUNCTION ======
+/*
+    makeCopy function:
+    - Copies "books.db" of directory into a new directory under $TMPDIR (or /tmp) and makes that the
+      current directory, so the benchmarks never write to directory.
+    - The journal is left behind: it names the file it belongs to, which the copy is not.
+    - Returns 1 on success, 0 otherwise.
+*/
+static int makeCopy(const char *directory)
+{
+   const char *base = getenv("TMPDIR") && getenv("TMPDIR")[0] ? getenv("TMPDIR") : "/tmp";
+   char from[4096];
+   char to[sizeof(copyDirectory) + 32];
+   snprintf(copyDirectory, sizeof(copyDirectory), "%s/library-bench-XXXXXX", base);
+   if (!mkdtemp(copyDirectory))
+   {
+      fprintf(stderr, "Error: Unable to create a temporary directory in %s.\n", base);
+      return 0;
+   }
+   atexit(removeCopy);
+
+   snprintf(from, sizeof(from), "%s/books.db", directory);
+   snprintf(to, sizeof(to), "%s/books.db", copyDirectory);
+   if (!copyFile(from, to))
+   {
+      fprintf(stderr, "Error: Unable to copy books.db of %s to %s.\n", directory, copyDirectory);
+      return 0;
+   }
+   return chdir(copyDirectory) == 0;
+}
+
+//====== OPEN CATALOG FUNCTION ======
+/*
+    openCatalog function:
+    - Loads "books.db" of the current directory like the program does, with the image used or not.
+    - Returns the time it took in milliseconds, or -1 if the load failed.
+*/
+static double openCatalog(Catalog *catalog, int useImage)
+{
+   setenv("LIBRARY_IMAGE", useImage ? "1" : "0", 1);
+   memset(catalog, 0, sizeof(*catalog));
+   double start = now();
+   if (!loadDatabase(catalog))
+   {
+      journalClose(&catalog->journal);
+      freeCatalog(catalog);
+      return -1;
+   }
+   return now() - start;
+}
+
+//====== CLOSE CATALOG FUNCTION ======
+/*
+    closeCatalog function:
+    - Closes the journal and frees the catalog, as the program does on exit.
+*/
+static void closeCatalog(Catalog *catalog)
+{
+   journalClose(&catalog->journal);
+   freeCatalog(catalog);
+}
+
+//====== BENCH ISBN LOOKUP FUNCTION ======
+/*
+    benchIsbnLookup function:
+    - Looks up LOOKUPS ISBNs of random books, and some ISBNs that are not in the catalog, in the ISBN index.
+    - Returns the number found, so the lookups cannot be optimized away.
+*/
+static int benchIsbnLookup(const Catalog *catalog, char (*isbns)[14])
+{
+   int found = 0;
+   for (int i = 0; i < LOOKUPS; i++)
+   {
+      found += isbnIndexFind(&catalog->isbnIndex, catalog, isbns[i]) != -1;
+   }
+   return found;
+}
+
+//====== BENCH TITLE SEARCH FUNCTION ======
+/*
+    benchTitleSearch function:
+    - Runs every query through the title trigram index, as the search menu does.
+    - Returns the number of books found.
+*/
+static int benchTitleSearch(const Catalog *catalog)
+{
+   int rows[MAX_FOUND];
+   int found = 0;
+   for (size_t q = 0; q < sizeof(queries) / sizeof(queries[0]); q++)
+   {
+      found += trigramIndexSearch(&catalog->trigramIndex, catalog, queries[q], rows, MAX_FOUND);
+   }
+   return found;
+}
+
+//====== BENCH BORROW RETURN FUNCTION ======
+/*
+    benchBorrowReturn function:
+    - Lends and returns a copy of LOANS books that have one on the shelf, to patrons 1 to 1000 in turn, each
+      change journaled and checkpointed exactly like borrowBook and returnBook do, so every copy ends on the shelf again.
+    - Returns 1 on success, 0 if the journal could not be written.
+*/
+static int benchBorrowReturn(Catalog *catalog, unsigned int *state)
+{
+   char date[11];
+   int32_t day = currentDay();
+   formatDate(day, date, sizeof(date));
+   for (int i = 0; i < LOANS; i++)
+   {
+      int row;
+      do
+      {
+         row = nextRandom(state) % catalog->count;
+      } while (isBookDeleted(catalog, row) || availableCopy(catalog, row) == 0);
+
+      Database book;
+      readBook(catalog, row, &book);
+      int copy = availableCopy(catalog, row);
+      int32_t patron = i % 1000 + 1;
+      if (!journalAppendBorrow(&catalog->journal, row, book.isbn, date, copy, patron))
+      {
+         return 0;
+      }
+      lendCopy(catalog, row, copy, patron, day);
+      journalCheckpoint(&catalog->journal, catalog);
+
+      if (!journalAppendReturn(&catalog->journal, row, book.isbn, copy))
+      {
+         return 0;
+      }
+      returnCopy(catalog, row, copy);
+      journalCheckpoint(&catalog->journal, catalog);
+   }
+   return 1;
+}
+
+//====== BENCH LIST BORROWED FUNCTION ======
+/*
+    benchListBorrowed function:
+    - Does what showBorrowedBooks does, page by page from the borrow index, but prints to output.
+    - Returns the number of books listed.
+*/
+static int benchListBorrowed(const Catalog *catalog, FILE *output)
+{
+   int rows[PAGE_ROWS];
+   int shown = 0;
+   int total;
+   do
+   {
+      total = borrowIndexBetween(&catalog->borrowIndex, INT32_MIN, INT32_MAX, shown, rows, PAGE_ROWS);
+      int count = total - shown < PAGE_ROWS ? total - shown : PAGE_ROWS;
+      for (int j = 0; j < count; j++)
+      {
+         int i = rows[j];
+         StringView isbn = bookIsbn(catalog, i);
+         StringView title = bookTitle(catalog, i);
+         StringView authors = bookAuthors(catalog, i);
+         char date[11];
+         formatDate(bookBorrowDay(catalog, i), date, sizeof(date));
+         fprintf(output, "ISBN: %.*s\nTitle: %.*s\nAuthor(s): %.*s\nBorrowed on: %s\n\n", isbn.length, isbn.data,
+                 title.length, title.data, authors.length, authors.data, date);
+      }
+      shown += count;
+   } while (shown < total);
+   return shown;
+}
+
+//====== PRINT RESULTS FUNCTION ======
+/*
+    printResults function:
+    - Writes the results as JSON with fixed field order and precision, one benchmark per line, so two
+      runs can be compared with diff or any JSON tool.
+    - Each benchmark reports the median and fastest round and the median time per operation.
+*/
+static void printResults(const Catalog *catalog, int rounds, BenchResult *results, int count)
+{
+   printf("{\"suite\":\"library\",\"schema\":%d,\"books\":%d,\"borrowed\":%d,\"rounds\":%d,\"results\":[\n", SCHEMA,
+          catalog->count - catalog->deleted, catalog->borrowIndex.count, rounds);
+   for (int r = 0; r < count; r++)
+   {
+      qsort(results[r].rounds, rounds, sizeof(double), compareTimes);
+      double median = rounds % 2 ? results[r].rounds[rounds / 2]
+                                 : (results[r].rounds[rounds / 2 - 1] + results[r].rounds[rounds / 2]) / 2;
+      double perOp = results[r].ops > 0 ? median * 1e3 / results[r].ops : 0;
+      printf("  {\"name\":\"%s\",\"ops\":%d,\"median_ms\":%.3f,\"min_ms\":%.3f,\"per_op_us\":%.3f}%s\n",
+             results[r].name, results[r].ops, median, results[r].rounds[0], perOp, r + 1 < count ? "," : "");
+   }
+   printf("]}\n");
+}
+
+//====== MAIN FUNCTION ======
+/*
+    main function:
+    - Usage: library_bench directory [rounds]
+    - Times the library on the "books.db" in directory (made with catalog_gen): loading it by parsing and
+      from the image, ISBN lookups, title searches, borrowing and returning with the journal, saving the
+      whole catalog and listing the borrowed books.
+    - Works on a copy of the catalog in a temporary directory, which it removes at the end; nothing in
+      directory is written.
+    - Prints the results as JSON on stdout.
+*/
+int main(int argc, char **argv)
+{
+   int rounds = argc > 2 ? atoi(argv[2]) : DEFAULT_ROUNDS;
+   if (argc < 2 || rounds <= 0)
+   {
+      fprintf(stderr, "Usage: %s directory [rounds]\n", argv[0]);
+      return 1;
+   }
+   char source[4096];
+   snprintf(source, sizeof(source), "%s/books.db", argv[1]);
+   if (access(source, R_OK) != 0)
+   {
+      fprintf(stderr, "Error: No books.db in %s.\n", argv[1]);
+      return 1;
+   }
+   if (!makeCopy(argv[1]))
+   {
+      return 1;
+   }
+
+   BenchResult results[] = {{"load_parse", 1, NULL}, {"load_image", 1, NULL}, {"isbn_lookup", LOOKUPS, NULL},
+                            {"title_search", (int)(sizeof(queries) / sizeof(queries[0])), NULL},
+                            {"borrow_return", LOANS, NULL}, {"save", 1, NULL}, {"list_borrowed", 0, NULL}};
+   int resultCount = sizeof(results) / sizeof(results[0]);
+   for (int r = 0; r < resultCount; r++)
+   {
+      results[r].rounds = calloc(rounds, sizeof(double));
+      if (!results[r].rounds)
+      {
+         fprintf(stderr, "Error: Memory allocation failed.\n");
+         return 1;
+      }
+   }
+
+   // Loading, by parsing the text and then from the image the first load leaves behind
+   Catalog catalog;
+   for (int pass = 0; pass < 2; pass++)
+   {
+      unlink("books.db.image");
+      for (int r = 0; r < rounds + pass; r++)
+      {
+         double time = openCatalog(&catalog, pass);
+         if (time < 0)
+         {
+            fprintf(stderr, "Error: Could not load books.db.\n");
+            return 1;
+         }
+         closeCatalog(&catalog);
+         // The first load with the image enabled only writes it
+         if (pass == 0 || r > 0)
+         {
+            results[pass].rounds[r - pass] = time;
+         }
+      }
+   }
+   if (openCatalog(&catalog, 1) < 0 || catalog.count - catalog.deleted == 0)
+   {
+      fprintf(stderr, "Error: books.db has no books.\n");
+      return 1;
+   }
+
+   // Lookups of existing books, and one in eight of an ISBN with a prefix the catalog does not use
+   char (*isbns)[14] = malloc(LOOKUPS * sizeof(*isbns));
+   FILE *devNull = fopen("/dev/null", "w");
+   if (!isbns || !devNull)
+   {
+      fprintf(stderr, "Error: Could not prepare the benchmarks.\n");
+      return 1;
+   }
+   unsigned int state = 42;
+   for (int i = 0; i < LOOKUPS; i++)
+   {
+      int row;
+      do
+      {
+         row = nextRandom(&state) % catalog.count;
+      } while (isBookDeleted(&catalog, row));
+      StringView isbn = bookIsbn(&catalog, row);
+      snprintf(isbns[i], sizeof(isbns[i]), "%.*s", isbn.length, isbn.data);
+      if (i % 8 == 7)
+      {
+         memcpy(isbns[i], "000", 3);
+      }
+   }
+
+   int failed = 0;
+   volatile int sink = 0;
+   for (int r = 0; r < rounds && !failed; r++)
+   {
+      double start = now();
+      sink += benchIsbnLookup(&catalog, isbns);
+      results[2].rounds[r] = now() - start;
+
+      start = now();
+      sink += benchTitleSearch(&catalog);
+      results[3].rounds[r] = now() - start;
+
+      start = now();
+      failed = !benchBorrowReturn(&catalog, &state);
+      results[4].rounds[r] = now() - start;
+
+      start = now();
+      failed = failed || !saveDatabase("bench.db", &catalog, NULL);
+      results[5].rounds[r] = now() - start;
+
+      start = now();
+      results[6].ops = benchListBorrowed(&catalog, devNull);
+      results[6].rounds[r] = now() - start;
+   }
+   if (failed)
+   {
+      fprintf(stderr, "Error: Could not write the journal or the saved catalog.\n");
+   }
+   else
+   {
+      printResults(&catalog, rounds, results, resultCount);
+   }
+
+   fclose(devNull);
+   free(isbns);
+   for (int r = 0; r < resultCount; r++)
+   {
+      free(results[r].rounds);
+   }
+   closeCatalog(&catalog);
+   return failed;
+}
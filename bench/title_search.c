@@ -0,0 +1,180 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+
+#include "catalog.h"
+
+//====== BENCHMARK SETTINGS ======
+#define DEFAULT_BOOKS 200000
+#define DEFAULT_ROUNDS 20
+#define MAX_FOUND 100
+
+static const char *words[] = {
+    "the", "of", "and", "a", "in", "night", "house", "river", "war", "peace", "garden", "shadow",
+    "king", "queen", "secret", "history", "winter", "summer", "city", "stone", "fire", "glass",
+    "little", "last", "lost", "silent", "golden", "dark", "old", "new", "road", "sea", "island",
+    "dragon", "code", "mind", "heart", "letters", "journey", "empire", "forest", "light", "time"};
+
+static const char *syllables[] = {"ka", "lo", "mi", "ren", "tho", "vax", "qui", "zer", "bel", "dun", "fay", "gor"};
+
+static const char *queries[] = {"the", "e", "ar", "night", "the last", "Dragon", "garden of", "kalomi",
+                                "vaxqui", "silent sea", "zzz", "history of the golden empire"};
+
+//====== NEXT RANDOM FUNCTION ======
+/*
+    nextRandom function:
+    - Small deterministic generator so every run builds the same catalog.
+*/
+static unsigned int nextRandom(unsigned int *state)
+{
+   *state = *state * 1103515245u + 12345u;
+   return *state >> 8;
+}
+
+//====== NOW FUNCTION ======
+/*
+    now function:
+    - Returns a monotonic time in microseconds.
+*/
+static double now(void)
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+//====== FILL CATALOG FUNCTION ======
+/*
+    fillCatalog function:
+    - Adds count generated books: a few common words plus one made-up word per title.
+*/
+static int fillCatalog(Catalog *catalog, int count)
+{
+   unsigned int state = 42;
+   int wordCount = sizeof(words) / sizeof(words[0]);
+   int syllableCount = sizeof(syllables) / sizeof(syllables[0]);
+   for (int i = 0; i < count; i++)
+   {
+      Database book = {0};
+      snprintf(book.isbn, sizeof(book.isbn), "978%010d", i);
+      int length = 0;
+      int parts = 2 + nextRandom(&state) % 4;
+      for (int p = 0; p < parts; p++)
+      {
+         const char *word = words[nextRandom(&state) % wordCount];
+         length += snprintf(book.nameBook + length, sizeof(book.nameBook) - length, "%s%s", p ? " " : "", word);
+         if (p == 0)
+         {
+            book.nameBook[0] = (char)toupper((unsigned char)book.nameBook[0]);
+         }
+      }
+      length += snprintf(book.nameBook + length, sizeof(book.nameBook) - length, " %s%s%s",
+                         syllables[nextRandom(&state) % syllableCount], syllables[nextRandom(&state) % syllableCount],
+                         syllables[nextRandom(&state) % syllableCount]);
+      strcpy(book.authors, "Generated Author");
+      book.year = 1900 + nextRandom(&state) % 120;
+      strcpy(book.genre, "Fiction");
+      strcpy(book.borrowed, "false");
+      strcpy(book.date, "-");
+      if (!insertBook(catalog, &book))
+      {
+         return 0;
+      }
+   }
+   return 1;
+}
+
+//====== SCAN SEARCH FUNCTION ======
+/*
+    scanSearch function:
+    - The search the title index replaces: lowercase every title and strstr it, stopping at maxRows.
+*/
+static int scanSearch(const Catalog *catalog, const char *title, int *rows, int maxRows)
+{
+   char lowerQuery[50];
+   snprintf(lowerQuery, sizeof(lowerQuery), "%s", title);
+   for (int i = 0; lowerQuery[i]; i++)
+   {
+      lowerQuery[i] = (char)tolower((unsigned char)lowerQuery[i]);
+   }
+
+   int found = 0;
+   for (int i = 0; i < catalog->count && found < maxRows; i++)
+   {
+      StringView name = bookTitle(catalog, i);
+      char lowerName[sizeof(((Database *)0)->nameBook)];
+      snprintf(lowerName, sizeof(lowerName), "%.*s", name.length, name.data);
+      for (int j = 0; lowerName[j]; j++)
+      {
+         lowerName[j] = (char)tolower((unsigned char)lowerName[j]);
+      }
+      if (strstr(lowerName, lowerQuery) != NULL)
+      {
+         rows[found++] = i;
+      }
+   }
+   return found;
+}
+
+//====== MAIN FUNCTION ======
+/*
+    main function:
+    - Usage: title_search [books] [rounds]
+    - Builds a generated catalog, checks that the trigram index returns exactly the rows of the
+      scan for every query, and prints the average time of both.
+*/
+int main(int argc, char **argv)
+{
+   int books = argc > 1 ? atoi(argv[1]) : DEFAULT_BOOKS;
+   int rounds = argc > 2 ? atoi(argv[2]) : DEFAULT_ROUNDS;
+   if (books <= 0 || rounds <= 0)
+   {
+      fprintf(stderr, "Usage: %s [books] [rounds]\n", argv[0]);
+      return 1;
+   }
+
+   Catalog catalog = {0};
+   double start = now();
+   if (!fillCatalog(&catalog, books))
+   {
+      freeCatalog(&catalog);
+      return 1;
+   }
+   printf("Catalog: %d books, %u trigram keys, built in %.1f ms\n", catalog.count, catalog.trigramIndex.count,
+          (now() - start) / 1e3);
+   printf("%-30s %8s %12s %12s %9s\n", "query", "matches", "scan (us)", "index (us)", "speedup");
+
+   int failed = 0;
+   for (size_t q = 0; q < sizeof(queries) / sizeof(queries[0]); q++)
+   {
+      int scanRows[MAX_FOUND], indexRows[MAX_FOUND];
+      int scanFound = 0, indexFound = 0;
+
+      start = now();
+      for (int r = 0; r < rounds; r++)
+      {
+         scanFound = scanSearch(&catalog, queries[q], scanRows, MAX_FOUND);
+      }
+      double scanTime = (now() - start) / rounds;
+
+      start = now();
+      for (int r = 0; r < rounds; r++)
+      {
+         indexFound = trigramIndexSearch(&catalog.trigramIndex, &catalog, queries[q], indexRows, MAX_FOUND);
+      }
+      double indexTime = (now() - start) / rounds;
+
+      if (scanFound != indexFound || memcmp(scanRows, indexRows, scanFound * sizeof(int)) != 0)
+      {
+         printf("Error: Results differ for \"%s\" (scan %d, index %d)\n", queries[q], scanFound, indexFound);
+         failed = 1;
+      }
+      printf("%-30s %8d %12.1f %12.1f %8.1fx\n", queries[q], indexFound, scanTime, indexTime,
+             indexTime > 0 ? scanTime / indexTime : 0);
+   }
+
+   freeCatalog(&catalog);
+   return failed;
+}
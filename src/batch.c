@@ -0,0 +1,873 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "batch.h"
+#include "ranked_search.h"
+#include "stats.h"
+
+// Most '|'-separated fields a command line may have
+#define BATCH_MAX_FIELDS 8
+
+//====== SPLIT COMMAND FUNCTION ======
+/*
+    splitCommand function:
+    - Splits a command line on '|' in place, keeping empty fields.
+    - Returns the number of fields found (at most maxFields).
+*/
+static int splitCommand(char *line, char **fields, int maxFields)
+{
+   int count = 0;
+   char *start = line;
+   while (count < maxFields)
+   {
+      fields[count++] = start;
+      char *bar = strchr(start, '|');
+      if (!bar)
+      {
+         break;
+      }
+      *bar = '\0';
+      start = bar + 1;
+   }
+   return count;
+}
+
+//====== WRITE JSON STRING FUNCTION ======
+/*
+    writeJsonString function:
+    - Writes length bytes of text as a quoted JSON string, escaping quotes, backslashes and control characters.
+*/
+void writeJsonString(FILE *output, const char *text, int length)
+{
+   fputc('"', output);
+   for (int i = 0; i < length; i++)
+   {
+      unsigned char ch = (unsigned char)text[i];
+      if (ch == '"' || ch == '\\')
+      {
+         fprintf(output, "\\%c", ch);
+      }
+      else if (ch < 0x20)
+      {
+         fprintf(output, "\\u%04x", ch);
+      }
+      else
+      {
+         fputc(ch, output);
+      }
+   }
+   fputc('"', output);
+}
+
+//====== BEGIN RESULT FUNCTION ======
+/*
+    beginResult function:
+    - Starts the JSON object reporting one command; the caller adds fields and closes it with "}\n".
+*/
+static void beginResult(FILE *output, int lineNumber, const char *command, const char *status)
+{
+   fprintf(output, "{\"line\":%d,\"command\":", lineNumber);
+   writeJsonString(output, command, (int)strlen(command));
+   fprintf(output, ",\"status\":\"%s\"", status);
+}
+
+//====== REPORT COMMAND ERROR FUNCTION ======
+/*
+    reportCommandError function:
+    - Reports a command that was not applied, with the reason.
+    - Returns 0 so command handlers can return its result.
+*/
+int reportCommandError(FILE *output, int lineNumber, const char *command, const char *message)
+{
+   beginResult(output, lineNumber, command, "error");
+   fprintf(output, ",\"error\":");
+   writeJsonString(output, message, (int)strlen(message));
+   fprintf(output, "}\n");
+   return 0;
+}
+
+//====== WRITE BOOK FUNCTION ======
+/*
+    writeBook function:
+    - Writes the book at the given row as a JSON object.
+*/
+static void writeBook(FILE *output, const Catalog *catalog, int row)
+{
+   StringView isbn = bookIsbn(catalog, row);
+   StringView title = bookTitle(catalog, row);
+   StringView authors = bookAuthors(catalog, row);
+   StringView genre = bookGenre(catalog, row);
+   char date[11];
+   formatDate(bookBorrowDay(catalog, row), date, sizeof(date));
+
+   fprintf(output, "{\"isbn\":");
+   writeJsonString(output, isbn.data, isbn.length);
+   fprintf(output, ",\"title\":");
+   writeJsonString(output, title.data, title.length);
+   fprintf(output, ",\"authors\":");
+   writeJsonString(output, authors.data, authors.length);
+   fprintf(output, ",\"year\":%d,\"genre\":", bookYear(catalog, row));
+   writeJsonString(output, genre.data, genre.length);
+   fprintf(output, ",\"copies\":%d,\"available\":%d,\"borrowed\":%s,\"date\":\"%s\"}", bookCopies(catalog, row),
+           bookCopies(catalog, row) - lentCopies(catalog, row), isBookBorrowed(catalog, row) ? "true" : "false", date);
+}
+
+//====== REPORT BOOK FUNCTION ======
+/*
+    reportBook function:
+    - Reports a command that was applied to one book, including the book as it is now.
+    - Returns 1 so command handlers can return its result.
+*/
+static int reportBook(FILE *output, int lineNumber, const char *command, const Catalog *catalog, int row)
+{
+   beginResult(output, lineNumber, command, "ok");
+   fprintf(output, ",\"book\":");
+   writeBook(output, catalog, row);
+   fprintf(output, "}\n");
+   return 1;
+}
+
+//====== REPORT LOAN FUNCTION ======
+/*
+    reportLoan function:
+    - Reports a command that lent or returned one copy of a book, with the copy, its patron and the book as it is now.
+    - Returns 1 so command handlers can return its result.
+*/
+static int reportLoan(FILE *output, int lineNumber, const char *command, const Catalog *catalog, int row, int copy,
+                      int32_t patron)
+{
+   beginResult(output, lineNumber, command, "ok");
+   fprintf(output, ",\"copy\":%d,\"patron\":%d,\"book\":", copy, patron);
+   writeBook(output, catalog, row);
+   fprintf(output, "}\n");
+   return 1;
+}
+
+//====== PARSE NUMBER FUNCTION ======
+/*
+    parseNumber function:
+    - Converts a whole field to a number from min to max.
+    - Returns 1 on success, 0 if the field is not such a number.
+*/
+static int parseNumber(const char *text, long min, long max, int *value)
+{
+   char *end;
+   long number = strtol(text, &end, 10);
+   if (*text == '\0' || *end != '\0' || number < min || number > max)
+   {
+      return 0;
+   }
+   *value = (int)number;
+   return 1;
+}
+
+//====== BATCH ADD FUNCTION ======
+/*
+    batchAdd function:
+    - add|ISBN|Title|Authors|Year|Genre or add|ISBN|Title|Authors|Year|Genre|copies (one copy if not given)
+    - Validates the book with checkBook (the rules of addBook, plus no empty or overlong fields, which
+      books.db could not store).
+    - Returns 1 if the book was added, 0 otherwise.
+*/
+static int batchAdd(Catalog *catalog, char **fields, int count, int lineNumber, FILE *output)
+{
+   if (count != 6 && count != 7)
+   {
+      return reportCommandError(output, lineNumber, "add", "expected add|ISBN|Title|Authors|Year|Genre[|copies]");
+   }
+   int year;
+   const char *problem = checkBook(fields[1], fields[2], fields[3], fields[4], fields[5], &year);
+   if (problem)
+   {
+      return reportCommandError(output, lineNumber, "add", problem);
+   }
+   int copies = 1;
+   if (count == 7 && !parseNumber(fields[6], 1, LOAN_MAX_COPIES, &copies))
+   {
+      char message[64];
+      snprintf(message, sizeof(message), "copies must be a number from 1 to %d", LOAN_MAX_COPIES);
+      return reportCommandError(output, lineNumber, "add", message);
+   }
+
+   Database book;
+   snprintf(book.isbn, sizeof(book.isbn), "%s", fields[1]);
+   snprintf(book.nameBook, sizeof(book.nameBook), "%s", fields[2]);
+   snprintf(book.authors, sizeof(book.authors), "%s", fields[3]);
+   book.year = year;
+   snprintf(book.genre, sizeof(book.genre), "%s", fields[5]);
+   strcpy(book.borrowed, "false");
+   strcpy(book.date, "-");
+   book.copies = copies;
+
+   // Log the change before applying it, and take the record back if the book could not be added
+   if (!journalAppendAdd(&catalog->journal, &book))
+   {
+      return reportCommandError(output, lineNumber, "add", "the book could not be added");
+   }
+   if (!insertBook(catalog, &book))
+   {
+      journalRetract(&catalog->journal);
+      return reportCommandError(output, lineNumber, "add", "the book could not be added");
+   }
+   return reportBook(output, lineNumber, "add", catalog, catalog->count - 1);
+}
+
+//====== BATCH BORROW FUNCTION ======
+/*
+    batchBorrow function:
+    - borrow|ISBN[|DD-MM-YYYY[|patron[|copy]]]: lends a copy of the book on the date (today if it is not
+      given or empty) to the patron (0 or none for an unknown one); the first copy on the shelf unless
+      one is named.
+    - Returns 1 if a copy was lent, 0 otherwise.
+*/
+static int batchBorrow(Catalog *catalog, char **fields, int count, int lineNumber, FILE *output)
+{
+   if (count < 2 || count > 5)
+   {
+      return reportCommandError(output, lineNumber, "borrow", "expected borrow|ISBN[|DD-MM-YYYY[|patron[|copy]]]");
+   }
+   int32_t day = currentDay();
+   if (count >= 3 && fields[2][0] != '\0' && !parseDate(fields[2], (int)strlen(fields[2]), &day))
+   {
+      return reportCommandError(output, lineNumber, "borrow", "date must be DD-MM-YYYY");
+   }
+   int patron = LOAN_UNKNOWN_PATRON;
+   if (count >= 4 && !parseNumber(fields[3], 0, 999999999, &patron))
+   {
+      return reportCommandError(output, lineNumber, "borrow", "patron must be a number from 0 to 999999999");
+   }
+   int row = isbnIndexFind(&catalog->isbnIndex, catalog, fields[1]);
+   if (row == -1)
+   {
+      return reportCommandError(output, lineNumber, "borrow", "book not found");
+   }
+
+   int copy = availableCopy(catalog, row);
+   if (count == 5)
+   {
+      int32_t holder, since;
+      if (!parseNumber(fields[4], 1, bookCopies(catalog, row), &copy))
+      {
+         return reportCommandError(output, lineNumber, "borrow", "no such copy of the book");
+      }
+      if (copyLoan(catalog, row, copy, &holder, &since))
+      {
+         return reportCommandError(output, lineNumber, "borrow", "copy is already borrowed");
+      }
+   }
+   else if (copy == 0)
+   {
+      return reportCommandError(output, lineNumber, "borrow", bookCopies(catalog, row) > 1 ? "all copies are borrowed" : "book is already borrowed");
+   }
+
+   char date[11];
+   formatDate(day, date, sizeof(date));
+   Database book;
+   readBook(catalog, row, &book);
+   if (!journalAppendBorrow(&catalog->journal, row, book.isbn, date, copy, patron))
+   {
+      return reportCommandError(output, lineNumber, "borrow", "the book could not be borrowed");
+   }
+   lendCopy(catalog, row, copy, patron, day);
+   return reportLoan(output, lineNumber, "borrow", catalog, row, copy, patron);
+}
+
+//====== BATCH RETURN FUNCTION ======
+/*
+    batchReturn function:
+    - return|ISBN or return|ISBN|copy; the copy may only be left out if a single copy of the book is lent.
+    - Returns 1 if the copy was returned, 0 otherwise.
+*/
+static int batchReturn(Catalog *catalog, char **fields, int count, int lineNumber, FILE *output)
+{
+   if (count != 2 && count != 3)
+   {
+      return reportCommandError(output, lineNumber, "return", "expected return|ISBN or return|ISBN|copy");
+   }
+   int row = isbnIndexFind(&catalog->isbnIndex, catalog, fields[1]);
+   if (row == -1)
+   {
+      return reportCommandError(output, lineNumber, "return", "book not found");
+   }
+
+   int copy = 0;
+   int32_t patron, day;
+   if (count == 3)
+   {
+      if (!parseNumber(fields[2], 1, bookCopies(catalog, row), &copy))
+      {
+         return reportCommandError(output, lineNumber, "return", "no such copy of the book");
+      }
+      if (!copyLoan(catalog, row, copy, &patron, &day))
+      {
+         return reportCommandError(output, lineNumber, "return", "copy was not borrowed");
+      }
+   }
+   else
+   {
+      if (lentCopies(catalog, row) == 0)
+      {
+         return reportCommandError(output, lineNumber, "return", "book was not borrowed");
+      }
+      if (lentCopies(catalog, row) > 1)
+      {
+         return reportCommandError(output, lineNumber, "return", "several copies are borrowed, expected return|ISBN|copy");
+      }
+      int copies = bookCopies(catalog, row);
+      do
+      {
+         copy++;
+      } while (copy <= copies && !copyLoan(catalog, row, copy, &patron, &day));
+      if (copy > copies)
+      {
+         return reportCommandError(output, lineNumber, "return", "no loan is recorded for any copy of the book");
+      }
+   }
+
+   Database book;
+   readBook(catalog, row, &book);
+   if (!journalAppendReturn(&catalog->journal, row, book.isbn, copy))
+   {
+      return reportCommandError(output, lineNumber, "return", "the book could not be returned");
+   }
+   returnCopy(catalog, row, copy);
+   return reportLoan(output, lineNumber, "return", catalog, row, copy, patron);
+}
+
+//====== BATCH DELETE FUNCTION ======
+/*
+    batchDelete function:
+    - delete|ISBN
+    - Reports the book as it was before it was removed.
+    - Returns 1 if the book was deleted, 0 otherwise.
+*/
+static int batchDelete(Catalog *catalog, char **fields, int count, int lineNumber, FILE *output)
+{
+   if (count != 2)
+   {
+      return reportCommandError(output, lineNumber, "delete", "expected delete|ISBN");
+   }
+   int row = isbnIndexFind(&catalog->isbnIndex, catalog, fields[1]);
+   if (row == -1)
+   {
+      return reportCommandError(output, lineNumber, "delete", "book not found");
+   }
+
+   Database book;
+   readBook(catalog, row, &book);
+   if (!journalAppendDelete(&catalog->journal, row, book.isbn))
+   {
+      return reportCommandError(output, lineNumber, "delete", "the book could not be deleted");
+   }
+   reportBook(output, lineNumber, "delete", catalog, row);
+   removeBook(catalog, row);
+   return 1;
+}
+
+//====== BATCH TITLE PAGE FUNCTION ======
+/*
+    batchTitlePage function:
+    - find|title|text|count or find|title|text|count|cursor
+    - Lists the next count books (at most BATCH_MAX_RESULTS) whose title contains text, best matches first,
+      as titleSearchPage ranks them, starting after the cursor of an earlier page ("rank:row").
+    - Reports the cursor of the following page as "next", or null after the last page.
+    - Returns 1 if the query was valid (even with no matches), 0 otherwise.
+*/
+static int batchTitlePage(Catalog *catalog, char **fields, int count, int lineNumber, FILE *output)
+{
+   int pageSize;
+   if (!parseNumber(fields[3], 1, BATCH_MAX_RESULTS, &pageSize))
+   {
+      return reportCommandError(output, lineNumber, "find", "page size must be a number from 1 to 1000");
+   }
+   TitleCursor cursor;
+   titleCursorStart(&cursor);
+   if (count == 5)
+   {
+      char *row = strchr(fields[4], ':');
+      if (row)
+      {
+         *row++ = '\0';
+      }
+      if (!row || !parseNumber(fields[4], TITLE_RANK_EXACT, TITLE_RANK_INFIX, &cursor.last.rank) ||
+          !parseNumber(row, 0, catalog->count, &cursor.last.row))
+      {
+         return reportCommandError(output, lineNumber, "find", "cursor must be the \"next\" value of the previous page");
+      }
+   }
+
+   TitleMatch matches[BATCH_MAX_RESULTS];
+   int found = titleSearchPage(catalog, fields[2], &cursor, matches, pageSize);
+   beginResult(output, lineNumber, "find", "ok");
+   fprintf(output, ",\"count\":%d,", found);
+   if (cursor.done)
+   {
+      fprintf(output, "\"next\":null");
+   }
+   else
+   {
+      fprintf(output, "\"next\":\"%d:%d\"", cursor.last.rank, cursor.last.row);
+   }
+   fprintf(output, ",\"books\":[");
+   for (int i = 0; i < found; i++)
+   {
+      if (i > 0)
+      {
+         fputc(',', output);
+      }
+      writeBook(output, catalog, matches[i].row);
+   }
+   fprintf(output, "]}\n");
+   return 1;
+}
+
+//====== BATCH FIND FUNCTION ======
+/*
+    batchFind function:
+    - find|isbn|ISBN, find|title|text (in row order; with a page size, ranked pages, see batchTitlePage),
+      find|keywords|words, find|fuzzy|words[|distance] (title and author words allowing typos, up to
+      TOKEN_FUZZY_MAX_DISTANCE edits per word, closest first), find|year|first|last (oldest first), find|borrowed[|DD-MM-YYYY[|DD-MM-YYYY]] (books
+      borrowed before the date, or from the first date to the second, oldest loan first) or find|overdue|days
+      (borrowed more than days ago)
+    - Uses the same indexes and scans as the search menu; sees the changes of earlier commands in the batch.
+    - Lists up to BATCH_MAX_RESULTS books and sets "truncated" if there were more.
+    - Returns 1 if the query was valid (even with no matches), 0 otherwise.
+*/
+static int batchFind(Catalog *catalog, char **fields, int count, int lineNumber, FILE *output)
+{
+   int rows[BATCH_MAX_RESULTS + 1];
+   int found;
+   int total = -1;
+
+   if (count == 3 && strcmp(fields[1], "isbn") == 0)
+   {
+      STATS_START(statStart);
+      int row = isbnIndexFind(&catalog->isbnIndex, catalog, fields[2]);
+      STATS_STOP(STAT_FIND_ISBN, statStart);
+      found = row == -1 ? 0 : 1;
+      rows[0] = row;
+   }
+   else if (count == 3 && strcmp(fields[1], "title") == 0)
+   {
+      found = trigramIndexSearch(&catalog->trigramIndex, catalog, fields[2], rows, BATCH_MAX_RESULTS + 1);
+   }
+   else if ((count == 4 || count == 5) && strcmp(fields[1], "title") == 0)
+   {
+      return batchTitlePage(catalog, fields, count, lineNumber, output);
+   }
+   else if (count == 3 && strcmp(fields[1], "keywords") == 0)
+   {
+      total = tokenIndexSearch(&catalog->tokenIndex, catalog, fields[2], rows, BATCH_MAX_RESULTS);
+      if (total < 0)
+      {
+         return reportCommandError(output, lineNumber, "find", "no words to search for");
+      }
+      found = total;
+   }
+   else if ((count == 3 || count == 4) && strcmp(fields[1], "fuzzy") == 0)
+   {
+      int distance = TOKEN_FUZZY_MAX_DISTANCE;
+      if (count == 4 && !parseNumber(fields[3], 0, TOKEN_FUZZY_MAX_DISTANCE, &distance))
+      {
+         return reportCommandError(output, lineNumber, "find", "distance must be a number from 0 to 2");
+      }
+      total = tokenIndexFuzzySearch(&catalog->tokenIndex, catalog, fields[2], distance, rows, BATCH_MAX_RESULTS);
+      if (total < 0)
+      {
+         return reportCommandError(output, lineNumber, "find", "no words to search for");
+      }
+      found = total;
+   }
+   else if (count == 4 && strcmp(fields[1], "year") == 0)
+   {
+      int first, last;
+      if (!parseNumber(fields[2], -9999, 2025, &first) || !parseNumber(fields[3], -9999, 2025, &last))
+      {
+         return reportCommandError(output, lineNumber, "find", "years must be numbers from -9999 to 2025");
+      }
+      found = yearIndexRange(&catalog->yearIndex, catalog, first, last, rows, BATCH_MAX_RESULTS + 1);
+   }
+   else if (count >= 2 && count <= 4 && strcmp(fields[1], "borrowed") == 0)
+   {
+      // One date lists the books borrowed before it, two list those borrowed from the first to the last
+      int32_t first = INT32_MIN, last = INT32_MAX;
+      int32_t day;
+      if (count >= 3 && !parseDate(fields[2], (int)strlen(fields[2]), &day))
+      {
+         return reportCommandError(output, lineNumber, "find", "date must be DD-MM-YYYY");
+      }
+      if (count == 3)
+      {
+         last = day - 1;
+      }
+      else if (count == 4)
+      {
+         first = day;
+         if (!parseDate(fields[3], (int)strlen(fields[3]), &last))
+         {
+            return reportCommandError(output, lineNumber, "find", "date must be DD-MM-YYYY");
+         }
+      }
+      total = borrowIndexBetween(&catalog->borrowIndex, first, last, 0, rows, BATCH_MAX_RESULTS + 1);
+      found = total;
+   }
+   else if (count == 3 && strcmp(fields[1], "overdue") == 0)
+   {
+      char *end;
+      long days = strtol(fields[2], &end, 10);
+      if (*fields[2] == '\0' || *end != '\0' || days < 0 || days > 100000)
+      {
+         return reportCommandError(output, lineNumber, "find", "days must be a number from 0 to 100000");
+      }
+      total = borrowIndexBetween(&catalog->borrowIndex, INT32_MIN, currentDay() - (int32_t)days - 1, 0, rows, BATCH_MAX_RESULTS + 1);
+      found = total;
+   }
+   else
+   {
+      return reportCommandError(output, lineNumber, "find", "expected find|isbn|..., find|title|...[|count[|cursor]], find|keywords|..., find|fuzzy|...[|distance], find|year|first|last, find|borrowed[|date[|date]] or find|overdue|days");
+   }
+
+   int truncated = found > BATCH_MAX_RESULTS;
+   if (truncated)
+   {
+      found = BATCH_MAX_RESULTS;
+   }
+   beginResult(output, lineNumber, "find", "ok");
+   if (total >= 0)
+   {
+      fprintf(output, ",\"total\":%d", total);
+   }
+   fprintf(output, ",\"count\":%d,\"truncated\":%s,\"books\":[", found, truncated ? "true" : "false");
+   for (int i = 0; i < found; i++)
+   {
+      if (i > 0)
+      {
+         fputc(',', output);
+      }
+      writeBook(output, catalog, rows[i]);
+   }
+   fprintf(output, "]}\n");
+   return 1;
+}
+
+//====== BATCH LOANS FUNCTION ======
+/*
+    batchLoans function:
+    - loans|patron
+    - Lists the copies lent to a known patron, in the order they were lent, through the patron index.
+    - Lists up to BATCH_MAX_RESULTS loans and sets "truncated" if there were more.
+    - Returns 1 if the patron number was valid (even with no loans), 0 otherwise.
+*/
+static int batchLoans(Catalog *catalog, char **fields, int count, int lineNumber, FILE *output)
+{
+   int patron;
+   if (count != 2 || !parseNumber(fields[1], 1, 999999999, &patron))
+   {
+      return reportCommandError(output, lineNumber, "loans", "expected loans|patron with a patron from 1 to 999999999");
+   }
+
+   PatronLoan loans[BATCH_MAX_RESULTS];
+   int total = findPatronLoans(catalog, patron, loans, BATCH_MAX_RESULTS);
+   int found = total > BATCH_MAX_RESULTS ? BATCH_MAX_RESULTS : total;
+   beginResult(output, lineNumber, "loans", "ok");
+   fprintf(output, ",\"patron\":%d,\"total\":%d,\"count\":%d,\"truncated\":%s,\"loans\":[", patron, total, found,
+           total > found ? "true" : "false");
+   for (int i = 0; i < found; i++)
+   {
+      char date[11];
+      formatDate(loans[i].day, date, sizeof(date));
+      fprintf(output, "%s{\"copy\":%d,\"date\":\"%s\",\"book\":", i > 0 ? "," : "", loans[i].copy, date);
+      writeBook(output, catalog, loans[i].row);
+      fputc('}', output);
+   }
+   fprintf(output, "]}\n");
+   return 1;
+}
+
+//====== BATCH SUGGEST FUNCTION ======
+/*
+    batchSuggest function:
+    - suggest|title|prefix[|count] or suggest|author|prefix[|count]
+    - Lists the count (10 if not given, at most COMPLETION_MAX_RESULTS) most common normalized titles or
+      author names starting with prefix, from the completion index, with their number of books.
+    - Returns 1 if the query was valid (even with no completions), 0 otherwise.
+*/
+static int batchSuggest(Catalog *catalog, char **fields, int count, int lineNumber, FILE *output)
+{
+   int field = -1;
+   if (count >= 3 && strcmp(fields[1], "title") == 0)
+   {
+      field = COMPLETE_TITLE;
+   }
+   else if (count >= 3 && strcmp(fields[1], "author") == 0)
+   {
+      field = COMPLETE_AUTHOR;
+   }
+   if (field == -1 || count > 4)
+   {
+      return reportCommandError(output, lineNumber, "suggest", "expected suggest|title|prefix[|count] or suggest|author|prefix[|count]");
+   }
+   int max = 10;
+   if (count == 4 && !parseNumber(fields[3], 1, COMPLETION_MAX_RESULTS, &max))
+   {
+      return reportCommandError(output, lineNumber, "suggest", "count must be a number from 1 to 100");
+   }
+
+   Completion completions[COMPLETION_MAX_RESULTS];
+   int found = completionIndexFind(&catalog->completions, field, fields[2], completions, max);
+   beginResult(output, lineNumber, "suggest", "ok");
+   fprintf(output, ",\"field\":\"%s\",\"count\":%d,\"completions\":[", fields[1], found);
+   for (int i = 0; i < found; i++)
+   {
+      fprintf(output, "%s{\"text\":", i > 0 ? "," : "");
+      writeJsonString(output, completions[i].text, (int)strlen(completions[i].text));
+      fprintf(output, ",\"books\":%d}", completions[i].count);
+   }
+   fprintf(output, "]}\n");
+   return 1;
+}
+
+//====== BATCH FACETS FUNCTION ======
+/*
+    batchFacets function:
+    - facets[|genres[|first|last[|borrowed|shelf]]], where empty fields mean any
+    - Counts the books that have every one of the comma-separated genres, were published from first to last
+      and are borrowed or on the shelf, and how many of them are borrowed, per genre (most books first) and
+      per decade, from the facet index.
+    - A genre no book has matches nothing.
+    - Returns 1 if the filter was valid (even with no books), 0 otherwise.
+*/
+static int batchFacets(Catalog *catalog, char **fields, int count, int lineNumber, FILE *output)
+{
+   FacetFilter filter = {0, INT32_MIN, INT32_MAX, FACET_ANY};
+   if (count == 3 || count > 5)
+   {
+      return reportCommandError(output, lineNumber, "facets", "expected facets[|genres[|first|last[|borrowed|shelf]]]");
+   }
+   if ((count >= 4 && fields[2][0] != '\0' && !parseNumber(fields[2], -9999, 2025, &filter.firstYear)) ||
+       (count >= 4 && fields[3][0] != '\0' && !parseNumber(fields[3], -9999, 2025, &filter.lastYear)))
+   {
+      return reportCommandError(output, lineNumber, "facets", "years must be numbers from -9999 to 2025");
+   }
+   if (count == 5 && strcmp(fields[4], "borrowed") == 0)
+   {
+      filter.borrowed = FACET_BORROWED;
+   }
+   else if (count == 5 && strcmp(fields[4], "shelf") == 0)
+   {
+      filter.borrowed = FACET_ON_SHELF;
+   }
+   else if (count == 5 && fields[4][0] != '\0')
+   {
+      return reportCommandError(output, lineNumber, "facets", "status must be borrowed or shelf");
+   }
+
+   // Every named genre must have an id, or no book can match
+   int unknown = 0;
+   for (const char *name = count >= 2 ? fields[1] : ""; *name != '\0';)
+   {
+      int length = (int)strcspn(name, ",");
+      int id = facetIndexGenre(&catalog->facets, name, length);
+      if (id >= 0)
+      {
+         filter.genres |= (uint64_t)1 << id;
+      }
+      else if (strspn(name, " \t") < (size_t)length)
+      {
+         unknown = 1;
+      }
+      name += name[length] == ',' ? length + 1 : length;
+   }
+
+   DecadeCount decades[FACET_MAX_DECADES];
+   FacetCounts counts;
+   memset(&counts, 0, sizeof(counts));
+   if (!unknown)
+   {
+      facetIndexCount(&catalog->facets, catalog, &filter, &counts, decades, FACET_MAX_DECADES);
+   }
+   int ids[FACET_MAX_GENRES];
+   int genres = facetCountsGenres(&counts, ids);
+
+   beginResult(output, lineNumber, "facets", "ok");
+   fprintf(output, ",\"books\":%d,\"borrowed\":%d,\"genres\":[", counts.books, counts.borrowed);
+   for (int i = 0; i < genres; i++)
+   {
+      const char *name = facetIndexGenreName(&catalog->facets, ids[i]);
+      fprintf(output, "%s{\"genre\":", i > 0 ? "," : "");
+      writeJsonString(output, name, (int)strlen(name));
+      fprintf(output, ",\"books\":%d,\"borrowed\":%d}", counts.genreBooks[ids[i]], counts.genreBorrowed[ids[i]]);
+   }
+   fprintf(output, "],\"decades\":[");
+   for (int i = 0; i < counts.decadeCount; i++)
+   {
+      fprintf(output, "%s{\"decade\":%d,\"books\":%d,\"borrowed\":%d}", i > 0 ? "," : "", counts.decades[i].decade,
+              counts.decades[i].books, counts.decades[i].borrowed);
+   }
+   fprintf(output, "]}\n");
+   return 1;
+}
+
+//====== BATCH STATS FUNCTION ======
+/*
+    batchStats function:
+    - stats
+    - Reports the latency histograms and counters gathered since the program started (see stats.h).
+    - Returns 1.
+*/
+static int batchStats(int count, int lineNumber, FILE *output)
+{
+   if (count != 1)
+   {
+      return reportCommandError(output, lineNumber, "stats", "expected stats");
+   }
+   beginResult(output, lineNumber, "stats", "ok");
+   fprintf(output, ",\"stats\":");
+   statsWrite(output);
+   fprintf(output, "}\n");
+   return 1;
+}
+
+//====== IS UPDATE COMMAND FUNCTION ======
+/*
+    isUpdateCommand function:
+    - Returns 1 if a command line changes the catalog (add, borrow, return, delete), 0 if it only reads it.
+*/
+int isUpdateCommand(const char *line)
+{
+   size_t length = strcspn(line, "|");
+   static const char *updates[] = {"add", "borrow", "return", "delete"};
+   for (size_t i = 0; i < sizeof(updates) / sizeof(updates[0]); i++)
+   {
+      if (length == strlen(updates[i]) && strncmp(line, updates[i], length) == 0)
+      {
+         return 1;
+      }
+   }
+   return 0;
+}
+
+//====== RUN COMMAND FUNCTION ======
+/*
+    runCommand function:
+    - Runs one command line (without its newline) and writes its JSON result to output.
+    - The line is split in place.
+    - Returns 1 if the command succeeded, 0 if it failed, -1 if the line is empty or a '#' comment.
+*/
+int runCommand(Catalog *catalog, char *line, int lineNumber, FILE *output)
+{
+   if (line[0] == '\0' || line[0] == '#')
+   {
+      return -1;
+   }
+
+   char *fields[BATCH_MAX_FIELDS];
+   int count = splitCommand(line, fields, BATCH_MAX_FIELDS);
+   if (strcmp(fields[0], "add") == 0)
+   {
+      return batchAdd(catalog, fields, count, lineNumber, output);
+   }
+   if (strcmp(fields[0], "borrow") == 0)
+   {
+      return batchBorrow(catalog, fields, count, lineNumber, output);
+   }
+   if (strcmp(fields[0], "return") == 0)
+   {
+      return batchReturn(catalog, fields, count, lineNumber, output);
+   }
+   if (strcmp(fields[0], "delete") == 0)
+   {
+      return batchDelete(catalog, fields, count, lineNumber, output);
+   }
+   if (strcmp(fields[0], "find") == 0)
+   {
+      return batchFind(catalog, fields, count, lineNumber, output);
+   }
+   if (strcmp(fields[0], "loans") == 0)
+   {
+      return batchLoans(catalog, fields, count, lineNumber, output);
+   }
+   if (strcmp(fields[0], "suggest") == 0)
+   {
+      return batchSuggest(catalog, fields, count, lineNumber, output);
+   }
+   if (strcmp(fields[0], "facets") == 0)
+   {
+      return batchFacets(catalog, fields, count, lineNumber, output);
+   }
+   if (strcmp(fields[0], "stats") == 0)
+   {
+      return batchStats(count, lineNumber, output);
+   }
+   return reportCommandError(output, lineNumber, fields[0], "unknown command");
+}
+
+//====== READ COMMAND FUNCTION ======
+/*
+    readCommand function:
+    - Reads the next line of input into line, without its line break.
+    - A line longer than the buffer is skipped to its end and reported as too long.
+    - Returns 1 if a line was read, 0 if it was too long, -1 at the end of input.
+*/
+int readCommand(FILE *input, char *line, int size)
+{
+   if (!fgets(line, size, input))
+   {
+      return -1;
+   }
+   size_t length = strlen(line);
+   if (length > 0 && line[length - 1] != '\n' && !feof(input))
+   {
+      int ch;
+      while ((ch = fgetc(input)) != '\n' && ch != EOF)
+         ;
+      return 0;
+   }
+   line[strcspn(line, "\r\n")] = '\0';
+   return 1;
+}
+
+//====== RUN BATCH FUNCTION ======
+/*
+    runBatch function:
+    - Runs the commands of input, one per line (see runCommand and batch.h), and writes one JSON object
+      per command to output, then a summary object.
+    - All changes form one journal transaction, written with a single flush at the end; a command that fails
+      changes nothing and does not stop the others.
+    - Returns 1 if the changes were committed, 0 otherwise.
+*/
+int runBatch(Catalog *catalog, FILE *input, FILE *output)
+{
+   char line[BATCH_LINE_LENGTH];
+   int lineNumber = 0;
+   int commands = 0;
+   int failed = 0;
+   int read;
+
+   journalBegin(&catalog->journal);
+   while ((read = readCommand(input, line, sizeof(line))) >= 0)
+   {
+      lineNumber++;
+      int ok = read ? runCommand(catalog, line, lineNumber, output) : reportCommandError(output, lineNumber, "", "line is too long");
+      if (ok >= 0)
+      {
+         commands++;
+         failed += !ok;
+      }
+      statsPoll(0);
+   }
+
+   // One write for every change of the batch
+   double persisted = catalog->journal.persist.totalMs;
+   int committed = journalCommit(&catalog->journal);
+   fprintf(output, "{\"summary\":true,\"commands\":%d,\"succeeded\":%d,\"failed\":%d,\"committed\":%s,\"persistMs\":%.3f}\n",
+           commands, commands - failed, failed, committed ? "true" : "false",
+           catalog->journal.persist.totalMs - persisted);
+   fflush(output);
+   if (committed)
+   {
+      journalCheckpoint(&catalog->journal, catalog);
+   }
+   return committed;
+}
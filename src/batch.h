@@ -0,0 +1,35 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stdio.h>
+
+#include "catalog.h"
+
+// Most books listed in the result of one find command
+#define BATCH_MAX_RESULTS 1000
+
+// Longest command line, including its line break
+#define BATCH_LINE_LENGTH 1024
+
+/*
+    Commands, one per line, '|'-separated like books.db:
+        add|ISBN|Title|Authors|Year|Genre[|copies]
+        borrow|ISBN[|DD-MM-YYYY[|patron[|copy]]]
+        return|ISBN[|copy]
+        delete|ISBN
+        find|isbn|ISBN, find|title|text[|count[|cursor]], find|keywords|words, find|fuzzy|words[|distance],
+        find|year|first|last, find|borrowed[|DD-MM-YYYY[|DD-MM-YYYY]], find|overdue|days
+        loans|patron
+        suggest|title|prefix[|count], suggest|author|prefix[|count]
+        facets[|genres[|first|last[|borrowed|shelf]]]
+        stats
+    Every command is answered with one JSON object on one line.
+*/
+void writeJsonString(FILE *output, const char *text, int length);
+int isUpdateCommand(const char *line);
+int readCommand(FILE *input, char *line, int size);
+int reportCommandError(FILE *output, int lineNumber, const char *command, const char *message);
+int runCommand(Catalog *catalog, char *line, int lineNumber, FILE *output);
+int runBatch(Catalog *catalog, FILE *input, FILE *output);
+
+#endif
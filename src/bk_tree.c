@@ -0,0 +1,420 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bk_tree.h"
+#include "image.h"
+#include "stats.h"
+
+//====== BK PATTERN STRUCTURE DEFINITION ======
+/*
+    BkPattern structure:
+    - A word prepared for bit-parallel distances: bit i of peq[c] is set where the word has byte c at position i.
+*/
+typedef struct
+{
+   uint64_t peq[256]; // Position mask of every byte value
+   int length;        // Word length, at most BK_MAX_WORD
+} BkPattern;
+
+//====== PREPARE PATTERN FUNCTION ======
+/*
+    preparePattern function:
+    - Builds the position masks of a word.
+*/
+static void preparePattern(BkPattern *pattern, const char *word, int length)
+{
+   memset(pattern->peq, 0, sizeof(pattern->peq));
+   pattern->length = length;
+   for (int i = 0; i < length; i++)
+   {
+      pattern->peq[(unsigned char)word[i]] |= (uint64_t)1 << i;
+   }
+}
+
+//====== PATTERN DISTANCE FUNCTION ======
+/*
+    patternDistance function:
+    - Computes the Levenshtein distance between a prepared word and a text with Myers' bit-parallel
+      algorithm: one column of the distance table is held as bit vectors of +1/-1 vertical deltas,
+      so each byte of the text costs a handful of word operations instead of a row of the table.
+    - Gives up as soon as the distance is sure to exceed bound, each remaining byte lowering it by one at most.
+    - Returns the distance, or a value above bound.
+*/
+static int patternDistance(const BkPattern *pattern, const char *text, int length, int bound)
+{
+   if (pattern->length == 0)
+   {
+      return length;
+   }
+
+   uint64_t pv = ~(uint64_t)0;
+   uint64_t mv = 0;
+   uint64_t last = (uint64_t)1 << (pattern->length - 1);
+   int score = pattern->length;
+   for (int i = 0; i < length; i++)
+   {
+      uint64_t eq = pattern->peq[(unsigned char)text[i]];
+      uint64_t xv = eq | mv;
+      uint64_t xh = (((eq & pv) + pv) ^ pv) | eq;
+      uint64_t ph = mv | ~(xh | pv);
+      uint64_t mh = pv & xh;
+      if (ph & last)
+      {
+         score++;
+      }
+      else if (mh & last)
+      {
+         score--;
+      }
+      // The first row of the table grows by one per byte of text
+      ph = (ph << 1) | 1;
+      mh <<= 1;
+      pv = mh | ~(xv | ph);
+      mv = ph & xv;
+      if (score - (length - 1 - i) > bound)
+      {
+         return bound + 1;
+      }
+   }
+   return score;
+}
+
+//====== ADD TO BK TREE FUNCTION ======
+/*
+    bkTreeAdd function:
+    - Adds a word (cut to BK_MAX_WORD bytes): walks down from the root, following at each node the child
+      at the word's distance from it, and hangs the word under the first node lacking such a child, in
+      distance order among its siblings.
+    - A word already in the tree is not added again.
+    - Returns 1 on success, 0 on memory allocation failure.
+*/
+int bkTreeAdd(BkTree *tree, const char *word, int length)
+{
+   if (length > BK_MAX_WORD)
+   {
+      length = BK_MAX_WORD;
+   }
+
+   // The new node becomes the first child of parent, or the sibling after previous
+   int parent = -1;
+   int previous = -1;
+   int distance = 0;
+   if (tree->count > 0)
+   {
+      BkPattern pattern;
+      preparePattern(&pattern, word, length);
+      int node = 0;
+      while (node >= 0)
+      {
+         const BkNode *current = &tree->nodes[node];
+         distance = patternDistance(&pattern, tree->text + current->text, current->length, BK_MAX_WORD);
+         if (distance == 0)
+         {
+            return 1;
+         }
+         parent = node;
+         previous = -1;
+         node = current->child;
+         while (node >= 0 && tree->nodes[node].distance < distance)
+         {
+            previous = node;
+            node = tree->nodes[node].sibling;
+         }
+         if (node >= 0 && tree->nodes[node].distance != distance)
+         {
+            break;
+         }
+      }
+   }
+
+   if (tree->count >= tree->capacity)
+   {
+      int capacity = tree->capacity ? tree->capacity * 2 : 1024;
+      BkNode *nodes = realloc(tree->nodes, (size_t)capacity * sizeof(BkNode));
+      if (!nodes)
+      {
+         fprintf(stderr, "Error: Memory allocation for fuzzy word index failed.\n");
+         return 0;
+      }
+      tree->nodes = nodes;
+      tree->capacity = capacity;
+      STATS_ADD(STAT_REALLOCS, 1);
+   }
+   if (tree->textSize + length > tree->textCapacity)
+   {
+      size_t capacity = tree->textCapacity ? tree->textCapacity * 2 : 16384;
+      char *text = realloc(tree->text, capacity);
+      if (!text)
+      {
+         fprintf(stderr, "Error: Memory allocation for fuzzy word index failed.\n");
+         return 0;
+      }
+      tree->text = text;
+      tree->textCapacity = capacity;
+      STATS_ADD(STAT_REALLOCS, 1);
+   }
+
+   BkNode *node = &tree->nodes[tree->count];
+   memset(node, 0, sizeof(*node));
+   node->text = (uint32_t)tree->textSize;
+   node->length = (uint8_t)length;
+   node->distance = (uint8_t)distance;
+   node->reach = 0;
+   node->child = -1;
+   node->sibling = -1;
+   if (previous >= 0)
+   {
+      node->sibling = tree->nodes[previous].sibling;
+      tree->nodes[previous].sibling = tree->count;
+   }
+   else if (parent >= 0)
+   {
+      node->sibling = tree->nodes[parent].child;
+      tree->nodes[parent].child = tree->count;
+   }
+   if (parent >= 0 && tree->nodes[parent].reach < distance)
+   {
+      tree->nodes[parent].reach = (uint8_t)distance;
+   }
+   memcpy(tree->text + tree->textSize, word, length);
+   tree->textSize += length;
+   tree->count++;
+   return 1;
+}
+
+//====== LAYOUT BK TREE FUNCTION ======
+/*
+    bkTreeLayout function:
+    - Renumbers the nodes breadth first and rewrites the words in the same order, so the children of every
+      node are consecutive nodes with consecutive words; a search then reads them together instead of
+      chasing each one through memory.
+    - Meant to run once the vocabulary of a whole catalog has been added.
+    - Returns 1 on success, 0 on memory allocation failure (the tree is then left as it was).
+*/
+int bkTreeLayout(BkTree *tree)
+{
+   if (tree->count == 0)
+   {
+      return 1;
+   }
+
+   int *order = malloc((size_t)tree->count * sizeof(int));
+   BkNode *nodes = malloc((size_t)tree->count * sizeof(BkNode));
+   char *text = malloc(tree->textSize ? tree->textSize : 1);
+   if (!order || !nodes || !text)
+   {
+      fprintf(stderr, "Error: Memory allocation for fuzzy word index failed.\n");
+      free(order);
+      free(nodes);
+      free(text);
+      return 0;
+   }
+
+   // Queue the nodes breadth first; siblings are already in distance order
+   int queued = 1;
+   order[0] = 0;
+   for (int i = 0; i < queued; i++)
+   {
+      for (int child = tree->nodes[order[i]].child; child >= 0; child = tree->nodes[child].sibling)
+      {
+         order[queued++] = child;
+      }
+   }
+
+   // Node i of the new layout is order[i]; its children follow the children of the nodes before it
+   size_t textSize = 0;
+   int next = 1;
+   for (int i = 0; i < tree->count; i++)
+   {
+      const BkNode *old = &tree->nodes[order[i]];
+      BkNode *node = &nodes[i];
+      memset(node, 0, sizeof(*node));
+      node->text = (uint32_t)textSize;
+      node->length = old->length;
+      node->distance = old->distance;
+      node->reach = old->reach;
+      node->child = old->child >= 0 ? next : -1;
+      node->sibling = old->sibling >= 0 ? i + 1 : -1;
+      for (int child = old->child; child >= 0; child = tree->nodes[child].sibling)
+      {
+         next++;
+      }
+      memcpy(text + textSize, tree->text + old->text, old->length);
+      textSize += old->length;
+   }
+
+   free(order);
+   free(tree->nodes);
+   free(tree->text);
+   tree->nodes = nodes;
+   tree->capacity = tree->count;
+   tree->text = text;
+   tree->textCapacity = tree->textSize ? tree->textSize : 1;
+   return 1;
+}
+
+//====== FIND IN BK TREE FUNCTION ======
+/*
+    bkTreeFind function:
+    - Finds the words within maxDistance edits (insertions, deletions, substitutions) of the given word.
+    - Measures the word against a node, keeps the node if close enough, and only visits the children
+      whose own distance to the node lies within maxDistance of that measure.
+    - A node whose length alone puts it farther than maxDistance from the word and from every one of
+      its children's rings is not visited, and a measure stops once it passes that reach.
+    - Stores up to maxMatches matches, in no particular order, in matches.
+    - Returns the number of matches stored, or -1 on memory allocation failure.
+*/
+int bkTreeFind(const BkTree *tree, const char *word, int length, int maxDistance, BkMatch *matches, int maxMatches)
+{
+   if (tree->count == 0)
+   {
+      return 0;
+   }
+   if (length > BK_MAX_WORD)
+   {
+      length = BK_MAX_WORD;
+   }
+
+   // Nodes still to visit; searches rarely need more than the local array
+   int local[1024];
+   int *stack = local;
+   int capacity = (int)(sizeof(local) / sizeof(local[0]));
+
+   BkPattern pattern;
+   preparePattern(&pattern, word, length);
+   int found = 0;
+   int top = 0;
+   stack[top++] = 0;
+   while (top > 0)
+   {
+      const BkNode *node = &tree->nodes[stack[--top]];
+      int distance = patternDistance(&pattern, tree->text + node->text, node->length, maxDistance + node->reach);
+      if (distance <= maxDistance && found < maxMatches)
+      {
+         matches[found++] = (BkMatch){tree->text + node->text, node->length, (uint8_t)distance};
+      }
+      for (int child = node->child; child >= 0; child = tree->nodes[child].sibling)
+      {
+         int gap = tree->nodes[child].distance - distance;
+         if (gap < -maxDistance)
+         {
+            continue;
+         }
+         if (gap > maxDistance)
+         {
+            break;
+         }
+         const BkNode *next = &tree->nodes[child];
+         int lengthGap = next->length - length;
+         if (lengthGap > maxDistance + next->reach || lengthGap < -maxDistance - next->reach)
+         {
+            continue;
+         }
+         if (top == capacity)
+         {
+            int *grown = malloc((size_t)capacity * 2 * sizeof(int));
+            if (!grown)
+            {
+               fprintf(stderr, "Error: Memory allocation for fuzzy word search failed.\n");
+               found = -1;
+               top = 0;
+               break;
+            }
+            memcpy(grown, stack, (size_t)top * sizeof(int));
+            if (stack != local)
+            {
+               free(stack);
+            }
+            stack = grown;
+            capacity *= 2;
+         }
+         stack[top++] = child;
+      }
+   }
+   if (stack != local)
+   {
+      free(stack);
+   }
+   return found;
+}
+
+//====== FREE BK TREE FUNCTION ======
+/*
+    bkTreeFree function:
+    - Releases the nodes and the words.
+*/
+void bkTreeFree(BkTree *tree)
+{
+   free(tree->nodes);
+   free(tree->text);
+   memset(tree, 0, sizeof(*tree));
+}
+
+//====== WRITE BK TREE FUNCTION ======
+/*
+    bkTreeWrite function:
+    - Writes the node count and text size, then the nodes and the words, to a binary image section.
+    - Returns 1 on success, 0 on write failure.
+*/
+int bkTreeWrite(const BkTree *tree, FILE *file)
+{
+   uint64_t sizes[2] = {(uint64_t)tree->count, (uint64_t)tree->textSize};
+   return imagePut(file, sizes, sizeof(sizes)) && imagePut(file, tree->nodes, (size_t)tree->count * sizeof(BkNode)) &&
+          imagePut(file, tree->text, tree->textSize);
+}
+
+//====== READ BK TREE FUNCTION ======
+/*
+    bkTreeRead function:
+    - Restores a tree written by bkTreeWrite into fresh allocations.
+    - Checks that every word lies in the text and that no node is the child or sibling of more than one
+      node (nor the root of any), so a damaged image cannot make a search loop.
+    - Returns 1 on success, 0 if the section is malformed or allocation fails (the tree is then empty).
+*/
+int bkTreeRead(BkTree *tree, ImageReader *reader)
+{
+   memset(tree, 0, sizeof(*tree));
+   const uint64_t *sizes = imageTake(reader, 2 * sizeof(uint64_t));
+   if (!sizes || sizes[0] > INT32_MAX || sizes[1] > UINT32_MAX)
+   {
+      return 0;
+   }
+   int count = (int)sizes[0];
+   size_t textSize = (size_t)sizes[1];
+   const BkNode *nodes = imageTake(reader, (size_t)count * sizeof(BkNode));
+   const char *text = imageTake(reader, textSize);
+   uint8_t *linked = calloc(count ? count : 1, 1);
+   int ok = nodes && text && linked;
+   for (int n = 0; ok && n < count; n++)
+   {
+      ok = nodes[n].length <= BK_MAX_WORD && (size_t)nodes[n].text + nodes[n].length <= textSize &&
+           nodes[n].child >= -1 && nodes[n].child < count && nodes[n].sibling >= -1 && nodes[n].sibling < count &&
+           nodes[n].child != 0 && nodes[n].sibling != 0;
+      for (int k = 0; ok && k < 2; k++)
+      {
+         int32_t target = k == 0 ? nodes[n].child : nodes[n].sibling;
+         ok = target < 0 || !linked[target]++;
+      }
+   }
+   free(linked);
+   if (!ok)
+   {
+      return 0;
+   }
+
+   tree->nodes = malloc(count > 0 ? (size_t)count * sizeof(BkNode) : 1);
+   tree->text = malloc(textSize > 0 ? textSize : 1);
+   if (!tree->nodes || !tree->text)
+   {
+      fprintf(stderr, "Error: Memory allocation for fuzzy word index failed.\n");
+      bkTreeFree(tree);
+      return 0;
+   }
+   memcpy(tree->nodes, nodes, (size_t)count * sizeof(BkNode));
+   memcpy(tree->text, text, textSize);
+   tree->count = tree->capacity = count;
+   tree->textSize = textSize;
+   tree->textCapacity = textSize > 0 ? textSize : 1;
+   return 1;
+}
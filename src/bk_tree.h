@@ -0,0 +1,63 @@
+#ifndef BK_TREE_H
+#define BK_TREE_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+struct ImageReader;
+
+// Longest word the tree can hold, the width of the bit-parallel distance
+#define BK_MAX_WORD 64
+
+//====== BK TREE STRUCTURE DEFINITION ======
+/*
+    BkTree structure:
+    - Burkhard-Keller tree over a vocabulary of words.
+    - Every child sits at its edit (Levenshtein) distance from its parent, so by the triangle inequality
+      a search for the words within k of a query only descends into children whose distance is within
+      k of the parent's own distance to the query, and skips the rest of the vocabulary.
+    - Children are kept sorted by distance. bkTreeLayout renumbers the nodes breadth first, so the
+      children of a node and their words lie next to each other in memory; words added later are linked in.
+    - Distances are computed bit-parallel (Myers), one machine word per query.
+    - Words are only ever added.
+*/
+typedef struct
+{
+   uint32_t text;    // Offset of the word in the text pool
+   uint8_t length;   // Word length
+   uint8_t distance; // Edit distance to the parent, 0 for the root
+   uint8_t reach;    // Largest distance of a child, 0 if none
+   int32_t child;    // First (closest) child, -1 if none
+   int32_t sibling;  // Next child of the same parent, farther away, -1 if none
+} BkNode;
+
+typedef struct
+{
+   BkNode *nodes;       // Node 0 is the root
+   int count;           // Number of nodes
+   int capacity;        // Allocated nodes
+   char *text;          // Words, back to back
+   size_t textSize;     // Bytes used in text
+   size_t textCapacity; // Bytes allocated for text
+} BkTree;
+
+//====== BK MATCH STRUCTURE DEFINITION ======
+/*
+    BkMatch structure:
+    - A word of the tree found near a query.
+*/
+typedef struct
+{
+   const char *text; // The word, in the tree's text pool
+   uint8_t length;   // Word length
+   uint8_t distance; // Edit distance to the query
+} BkMatch;
+
+int bkTreeAdd(BkTree *tree, const char *word, int length);
+int bkTreeLayout(BkTree *tree);
+int bkTreeFind(const BkTree *tree, const char *word, int length, int maxDistance, BkMatch *matches, int maxMatches);
+void bkTreeFree(BkTree *tree);
+int bkTreeWrite(const BkTree *tree, FILE *file);
+int bkTreeRead(BkTree *tree, struct ImageReader *reader);
+
+#endif
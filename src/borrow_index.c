@@ -0,0 +1,177 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "borrow_index.h"
+#include "catalog.h"
+#include "stats.h"
+
+//====== FIND ENTRY FUNCTION ======
+/*
+    findEntry function:
+    - Binary search for the first entry that does not sort before (day, row).
+*/
+static int findEntry(const BorrowIndex *index, int32_t day, int row)
+{
+   int lo = 0, hi = index->count;
+   while (lo < hi)
+   {
+      int mid = lo + (hi - lo) / 2;
+      const BorrowEntry *entry = &index->entries[mid];
+      if (entry->day < day || (entry->day == day && entry->row < row))
+      {
+         lo = mid + 1;
+      }
+      else
+      {
+         hi = mid;
+      }
+   }
+   return lo;
+}
+
+//====== COMPARE ENTRIES FUNCTION ======
+/*
+    compareEntries function:
+    - qsort order of the entries: by borrow day, then by row.
+*/
+static int compareEntries(const void *a, const void *b)
+{
+   const BorrowEntry *x = a;
+   const BorrowEntry *y = b;
+   if (x->day != y->day)
+   {
+      return x->day < y->day ? -1 : 1;
+   }
+   return (x->row > y->row) - (x->row < y->row);
+}
+
+//====== GROW ENTRIES FUNCTION ======
+/*
+    growEntries function:
+    - Makes room for one more entry, doubling the array when full.
+    - Returns 1 on success, 0 on memory allocation failure.
+*/
+static int growEntries(BorrowIndex *index)
+{
+   if (index->count < index->capacity)
+   {
+      return 1;
+   }
+   int capacity = index->capacity ? index->capacity * 2 : 64;
+   BorrowEntry *entries = realloc(index->entries, capacity * sizeof(BorrowEntry));
+   if (!entries)
+   {
+      fprintf(stderr, "Error: Memory allocation for the borrow index failed.\n");
+      return 0;
+   }
+   index->entries = entries;
+   index->capacity = capacity;
+   STATS_ADD(STAT_REALLOCS, 1);
+   return 1;
+}
+
+//====== ADD TO BORROW INDEX FUNCTION ======
+/*
+    borrowIndexAdd function:
+    - Adds a book borrowed on the given day, keeping the entries sorted.
+    - Returns 1 on success, 0 on memory allocation failure.
+*/
+int borrowIndexAdd(BorrowIndex *index, int row, int32_t day)
+{
+   if (!growEntries(index))
+   {
+      return 0;
+   }
+
+   int at = findEntry(index, day, row);
+   memmove(index->entries + at + 1, index->entries + at, (index->count - at) * sizeof(BorrowEntry));
+   index->entries[at].day = day;
+   index->entries[at].row = row;
+   index->count++;
+   return 1;
+}
+
+//====== REMOVE FROM BORROW INDEX FUNCTION ======
+/*
+    borrowIndexRemove function:
+    - Drops the entry of a book that was borrowed on the given day, if there is one.
+*/
+void borrowIndexRemove(BorrowIndex *index, int row, int32_t day)
+{
+   int at = findEntry(index, day, row);
+   if (at < index->count && index->entries[at].day == day && index->entries[at].row == row)
+   {
+      memmove(index->entries + at, index->entries + at + 1, (index->count - at - 1) * sizeof(BorrowEntry));
+      index->count--;
+   }
+}
+
+//====== BUILD BORROW INDEX FUNCTION ======
+/*
+    borrowIndexBuild function:
+    - Collects the borrowed books of the catalog and sorts them by borrow day.
+    - Returns 1 on success, 0 on memory allocation failure.
+*/
+int borrowIndexBuild(BorrowIndex *index, const Catalog *catalog)
+{
+   memset(index, 0, sizeof(*index));
+   for (int i = 0; i < catalog->count; i++)
+   {
+      if (!isBookBorrowed(catalog, i))
+      {
+         continue;
+      }
+      if (!growEntries(index))
+      {
+         return 0;
+      }
+      index->entries[index->count].day = bookBorrowDay(catalog, i);
+      index->entries[index->count].row = i;
+      index->count++;
+   }
+
+   // One sort instead of an insertion per book
+   if (index->count > 1)
+   {
+      qsort(index->entries, index->count, sizeof(BorrowEntry), compareEntries);
+   }
+   return 1;
+}
+
+//====== BORROWED BETWEEN FUNCTION ======
+/*
+    borrowIndexBetween function:
+    - Finds the books borrowed from firstDay to lastDay (inclusive), oldest first; INT32_MIN and INT32_MAX
+      leave the range open, and an open start includes books borrowed without a date.
+    - Skips the first skip of them and stores up to maxRows of the rest in rows, so a long list can be
+      read in pages.
+    - Returns the total number of books borrowed in the range.
+*/
+int borrowIndexBetween(const BorrowIndex *index, int32_t firstDay, int32_t lastDay, int skip, int *rows, int maxRows)
+{
+   if (lastDay < firstDay)
+   {
+      return 0;
+   }
+   STATS_START(statStart);
+   int start = firstDay == INT32_MIN ? 0 : findEntry(index, firstDay, INT32_MIN);
+   int end = lastDay == INT32_MAX ? index->count : findEntry(index, lastDay + 1, INT32_MIN);
+   for (int i = start + skip; i < end && i - start - skip < maxRows; i++)
+   {
+      rows[i - start - skip] = index->entries[i].row;
+   }
+   STATS_STOP(STAT_FIND_BORROWED, statStart);
+   return end - start;
+}
+
+//====== FREE BORROW INDEX FUNCTION ======
+/*
+    borrowIndexFree function:
+    - Releases the entries.
+*/
+void borrowIndexFree(BorrowIndex *index)
+{
+   free(index->entries);
+   memset(index, 0, sizeof(*index));
+}
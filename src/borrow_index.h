@@ -0,0 +1,38 @@
+#ifndef BORROW_INDEX_H
+#define BORROW_INDEX_H
+
+#include <stdint.h>
+
+struct Catalog;
+
+//====== BORROW INDEX STRUCTURE DEFINITION ======
+/*
+    BorrowIndex structure:
+    - The borrowed books only, as (borrow day, row) pairs sorted by day and then row.
+    - Books borrowed in a range of days are a slice of the array, found by binary search, so listing
+      borrowed or overdue books costs time in the number of books listed, not in the catalog size.
+    - Books are mostly borrowed today, so a borrow usually appends; a return moves only the
+      entries borrowed after it.
+    - Books borrowed without a recorded date (NO_DATE) sort first.
+    - Kept in step with the catalog by insertBook, removeBook, lendCopy and returnCopy.
+*/
+typedef struct
+{
+   int32_t day; // Borrow day, as in BookRecord
+   int row;     // Row of the book in the catalog
+} BorrowEntry;
+
+typedef struct
+{
+   BorrowEntry *entries; // Borrowed books, oldest first
+   int count;            // Number of borrowed books
+   int capacity;         // Allocated entries
+} BorrowIndex;
+
+int borrowIndexBuild(BorrowIndex *index, const struct Catalog *catalog);
+int borrowIndexAdd(BorrowIndex *index, int row, int32_t day);
+void borrowIndexRemove(BorrowIndex *index, int row, int32_t day);
+int borrowIndexBetween(const BorrowIndex *index, int32_t firstDay, int32_t lastDay, int skip, int *rows, int maxRows);
+void borrowIndexFree(BorrowIndex *index);
+
+#endif
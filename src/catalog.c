@@ -0,0 +1,607 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "catalog.h"
+#include "stats.h"
+
+_Static_assert(sizeof(BookRecord) == 32, "BookRecord should stay a compact 32-byte header");
+
+//====== ROW TEXT FUNCTION ======
+/*
+    rowText function:
+    - Returns the start of a row's text, in the arena or in the loaded file.
+*/
+static const char *rowText(const Catalog *catalog, const BookRecord *book)
+{
+   return ((book->flags & BOOK_IN_ARENA) ? catalog->arena : catalog->data) + book->offset;
+}
+
+//====== BOOK FIELD ACCESSORS ======
+/*
+    bookIsbn, bookTitle, bookAuthors, bookGenre, bookYear, bookBorrowDay functions:
+    - Return one field of the book at the given row.
+*/
+StringView bookIsbn(const Catalog *catalog, int row)
+{
+   const BookRecord *book = &catalog->books[row];
+   StringView view = {rowText(catalog, book), book->isbnLength};
+   return view;
+}
+
+StringView bookTitle(const Catalog *catalog, int row)
+{
+   const BookRecord *book = &catalog->books[row];
+   StringView view = {rowText(catalog, book) + book->titleAt, book->titleLength};
+   return view;
+}
+
+StringView bookAuthors(const Catalog *catalog, int row)
+{
+   const BookRecord *book = &catalog->books[row];
+   StringView view = {rowText(catalog, book) + book->authorsAt, book->authorsLength};
+   return view;
+}
+
+StringView bookGenre(const Catalog *catalog, int row)
+{
+   const BookRecord *book = &catalog->books[row];
+   StringView view = {rowText(catalog, book) + book->genreAt, book->genreLength};
+   return view;
+}
+
+int bookYear(const Catalog *catalog, int row)
+{
+   return catalog->books[row].year;
+}
+
+int32_t bookBorrowDay(const Catalog *catalog, int row)
+{
+   return catalog->books[row].borrowDay;
+}
+
+//====== IS BOOK BORROWED FUNCTION ======
+/*
+    isBookBorrowed function:
+    - Returns 1 if the book at the given row is borrowed, 0 otherwise.
+*/
+int isBookBorrowed(const Catalog *catalog, int row)
+{
+   return (catalog->books[row].flags & BOOK_BORROWED) != 0;
+}
+
+//====== IS BOOK DELETED FUNCTION ======
+/*
+    isBookDeleted function:
+    - Returns 1 if the row is the tombstone of a deleted book, 0 otherwise.
+*/
+int isBookDeleted(const Catalog *catalog, int row)
+{
+   return (catalog->books[row].flags & BOOK_DELETED) != 0;
+}
+
+//====== ISBN EQUALS FUNCTION ======
+/*
+    isbnEquals function:
+    - Returns 1 if the book at the given row has exactly the given ISBN.
+*/
+int isbnEquals(const Catalog *catalog, int row, const char *isbn)
+{
+   StringView view = bookIsbn(catalog, row);
+   return (int)strlen(isbn) == view.length && memcmp(view.data, isbn, view.length) == 0;
+}
+
+//====== READ BOOK FUNCTION ======
+/*
+    readBook function:
+    - Copies all fields of the book at the given row into a Database structure.
+*/
+void readBook(const Catalog *catalog, int row, Database *book)
+{
+   StringView field = bookIsbn(catalog, row);
+   snprintf(book->isbn, sizeof(book->isbn), "%.*s", field.length, field.data);
+   field = bookTitle(catalog, row);
+   snprintf(book->nameBook, sizeof(book->nameBook), "%.*s", field.length, field.data);
+   field = bookAuthors(catalog, row);
+   snprintf(book->authors, sizeof(book->authors), "%.*s", field.length, field.data);
+   book->year = bookYear(catalog, row);
+   field = bookGenre(catalog, row);
+   snprintf(book->genre, sizeof(book->genre), "%.*s", field.length, field.data);
+   formatDate(bookBorrowDay(catalog, row), book->date, sizeof(book->date));
+   strcpy(book->borrowed, isBookBorrowed(catalog, row) ? "true" : "false");
+   book->copies = bookCopies(catalog, row);
+}
+
+//====== SET BORROW STATE FUNCTION ======
+/*
+    setBorrowState function:
+    - Sets the borrow flag and date of the row, moves it to its place in the borrow index and updates the
+      borrowed counters of the facet index.
+*/
+static void setBorrowState(Catalog *catalog, int row, int borrowed, int32_t day)
+{
+   BookRecord *book = &catalog->books[row];
+   if (!borrowed)
+   {
+      day = NO_DATE;
+   }
+   if (((book->flags & BOOK_BORROWED) != 0) == borrowed && book->borrowDay == day)
+   {
+      return;
+   }
+   if (book->flags & BOOK_BORROWED)
+   {
+      borrowIndexRemove(&catalog->borrowIndex, row, book->borrowDay);
+   }
+   if (borrowed && !borrowIndexAdd(&catalog->borrowIndex, row, day))
+   {
+      fprintf(stderr, "Error: Could not add the book to the borrow index.\n");
+   }
+   book->flags = (uint8_t)(borrowed ? book->flags | BOOK_BORROWED : book->flags & ~BOOK_BORROWED);
+   book->borrowDay = day;
+   scanColumnsSetFlags(&catalog->columns, row, book->flags);
+   facetIndexSetBorrowed(&catalog->facets, catalog, row, borrowed);
+}
+
+//====== SYNC BORROW STATE FUNCTION ======
+/*
+    syncBorrowState function:
+    - Sums up the copies of a book with a loan table entry in its row: borrowed if any copy is lent,
+      since the day of the oldest loan.
+*/
+static void syncBorrowState(Catalog *catalog, int row)
+{
+   int entry = catalog->books[row].loans - 1;
+   setBorrowState(catalog, row, catalog->loans.lentCount[entry] > 0, loanTableEarliest(&catalog->loans, entry));
+}
+
+//====== COPY COUNT FUNCTIONS ======
+/*
+    bookCopies, lentCopies, availableCopy functions:
+    - Return the number of copies of the book at the given row, how many of them are lent, and the number
+      (from 1) of a copy on the shelf, 0 if there is none; all in O(1).
+    - A book without a loan table entry is a single copy, lent if the row is borrowed.
+*/
+int bookCopies(const Catalog *catalog, int row)
+{
+   int entry = catalog->books[row].loans - 1;
+   return entry < 0 ? 1 : catalog->loans.copyCount[entry];
+}
+
+int lentCopies(const Catalog *catalog, int row)
+{
+   int entry = catalog->books[row].loans - 1;
+   return entry < 0 ? isBookBorrowed(catalog, row) : catalog->loans.lentCount[entry];
+}
+
+int availableCopy(const Catalog *catalog, int row)
+{
+   int entry = catalog->books[row].loans - 1;
+   return entry < 0 ? !isBookBorrowed(catalog, row) : loanTableFirstFree(&catalog->loans, entry);
+}
+
+//====== COPY LOAN FUNCTION ======
+/*
+    copyLoan function:
+    - Looks up who has copy number copy of the book at the given row, and since when.
+    - Returns 1 and stores the patron (LOAN_UNKNOWN_PATRON if not known) and the day if the copy is lent, 0 otherwise.
+*/
+int copyLoan(const Catalog *catalog, int row, int copy, int32_t *patron, int32_t *day)
+{
+   int entry = catalog->books[row].loans - 1;
+   if (entry < 0)
+   {
+      *patron = LOAN_UNKNOWN_PATRON;
+      *day = bookBorrowDay(catalog, row);
+      return copy == 1 && isBookBorrowed(catalog, row);
+   }
+   if (copy < 1 || copy > catalog->loans.copyCount[entry])
+   {
+      return 0;
+   }
+   int slot = catalog->loans.firstCopy[entry] + copy - 1;
+   *patron = catalog->loans.patron[slot];
+   *day = catalog->loans.day[slot];
+   return *patron != LOAN_SHELF;
+}
+
+//====== LEND COPY FUNCTION ======
+/*
+    lendCopy function:
+    - Lends copy number copy of the book at the given row (0 for the first one on the shelf) to patron on day,
+      and updates the row's borrow flag, date and borrow index entry.
+    - A single-copy book only gets a loan table entry once it is lent to a known patron.
+    - Returns the number of the copy lent, or 0 if it was not on the shelf.
+*/
+int lendCopy(Catalog *catalog, int row, int copy, int32_t patron, int32_t day)
+{
+   STATS_START(statStart);
+   BookRecord *book = &catalog->books[row];
+   if (book->loans == 0 && patron > LOAN_UNKNOWN_PATRON && copy <= 1 && !(book->flags & BOOK_BORROWED))
+   {
+      int entry = loanTableAddBook(&catalog->loans, row, 1);
+      if (entry < 0)
+      {
+         return 0;
+      }
+      book->loans = entry + 1;
+   }
+
+   int lent;
+   if (book->loans == 0)
+   {
+      lent = copy <= 1 && !(book->flags & BOOK_BORROWED);
+      if (lent)
+      {
+         setBorrowState(catalog, row, 1, day);
+      }
+   }
+   else
+   {
+      lent = loanTableLend(&catalog->loans, book->loans - 1, copy, patron, day);
+      if (lent)
+      {
+         syncBorrowState(catalog, row);
+      }
+   }
+   STATS_STOP(STAT_BORROW, statStart);
+   return lent;
+}
+
+//====== RETURN COPY FUNCTION ======
+/*
+    returnCopy function:
+    - Puts copy number copy of the book at the given row back on the shelf (0 for the only copy that is lent),
+      and updates the row's borrow flag, date and borrow index entry.
+    - Returns the number of the copy returned, or 0 if it was not lent.
+*/
+int returnCopy(Catalog *catalog, int row, int copy)
+{
+   STATS_START(statStart);
+   BookRecord *book = &catalog->books[row];
+   int returned;
+   if (book->loans == 0)
+   {
+      returned = copy <= 1 && (book->flags & BOOK_BORROWED);
+      if (returned)
+      {
+         setBorrowState(catalog, row, 0, NO_DATE);
+      }
+   }
+   else
+   {
+      returned = loanTableReturn(&catalog->loans, book->loans - 1, copy);
+      if (returned)
+      {
+         syncBorrowState(catalog, row);
+      }
+   }
+   STATS_STOP(STAT_RETURN, statStart);
+   return returned;
+}
+
+//====== FIND PATRON LOANS FUNCTION ======
+/*
+    findPatronLoans function:
+    - Lists the copies lent to a patron, in the order they were lent, through the patron index.
+    - Fills at most max entries of loans.
+    - Returns the total number of copies the patron has.
+*/
+int findPatronLoans(const Catalog *catalog, int32_t patron, PatronLoan *loans, int max)
+{
+   const PatronLoans *list = patronIndexFind(&catalog->loans.patrons, patron);
+   if (!list)
+   {
+      return 0;
+   }
+   for (int i = 0; i < list->count && i < max; i++)
+   {
+      int slot = list->copies[i];
+      int entry = catalog->loans.copyEntry[slot];
+      loans[i].row = catalog->loans.bookRow[entry];
+      loans[i].copy = slot - catalog->loans.firstCopy[entry] + 1;
+      loans[i].day = catalog->loans.day[slot];
+   }
+   return list->count;
+}
+
+//====== RESERVE BOOKS FUNCTION ======
+/*
+    reserveBooks function:
+    - Makes sure the row array can hold at least rows rows.
+    - Grows it at least twofold, so appending N books one at a time copies O(N) rows in total; a caller that
+      knows the final size (from the file size or an image header) gets exactly that many rows in one allocation.
+    - Returns 1 on success, 0 on memory allocation failure (the rows are left as they were).
+*/
+int reserveBooks(Catalog *catalog, int rows)
+{
+   if (rows <= catalog->capacity)
+   {
+      return 1;
+   }
+
+   int capacity = catalog->capacity ? catalog->capacity * 2 : 16;
+   if (capacity < rows)
+   {
+      capacity = rows;
+   }
+   BookRecord *grown = realloc(catalog->books, (size_t)capacity * sizeof(BookRecord));
+   if (!grown)
+   {
+      fprintf(stderr, "Error! Memory reallocation failed.\n");
+      return 0;
+   }
+   catalog->books = grown;
+   catalog->capacity = capacity;
+   STATS_ADD(STAT_REALLOCS, 1);
+   return 1;
+}
+
+//====== RESERVE ARENA FUNCTION ======
+/*
+    reserveArena function:
+    - Makes sure the string arena can take bytes more bytes of text, growing it at least twofold.
+    - Returns 1 on success, 0 on memory allocation failure (the arena is left as it was).
+*/
+int reserveArena(Catalog *catalog, size_t bytes)
+{
+   if (catalog->arenaSize + bytes <= catalog->arenaCapacity)
+   {
+      return 1;
+   }
+
+   size_t capacity = catalog->arenaCapacity ? catalog->arenaCapacity : 4096;
+   while (catalog->arenaSize + bytes > capacity)
+   {
+      capacity *= 2;
+   }
+   char *grown = realloc(catalog->arena, capacity);
+   if (!grown)
+   {
+      fprintf(stderr, "Error: Memory allocation failed.\n");
+      return 0;
+   }
+   catalog->arena = grown;
+   catalog->arenaCapacity = capacity;
+   STATS_ADD(STAT_REALLOCS, 1);
+   return 1;
+}
+
+//====== ARENA STORE FUNCTION ======
+/*
+    arenaStore function:
+    - Appends text to the string arena (see reserveArena).
+    - Returns the offset of the text in the arena, or -1 on memory allocation failure.
+*/
+static long long arenaStore(Catalog *catalog, const char *text, size_t length)
+{
+   if (!reserveArena(catalog, length))
+   {
+      return -1;
+   }
+
+   size_t offset = catalog->arenaSize;
+   memcpy(catalog->arena + offset, text, length);
+   catalog->arenaSize += length;
+   return (long long)offset;
+}
+
+//====== CHECK BOOK FUNCTION ======
+/*
+    checkBook function:
+    - Applies the rules of addBook to the text fields of a new book: a 13-digit ISBN, a title of 1 to 50
+      characters, 1 to 200 characters of authors, a year not after 2025 and 1 to 100 characters of genre.
+    - Also rejects '|' and line breaks, which books.db could not store.
+    - Returns NULL and stores the year in yearValue if the book is valid, otherwise the reason it is not.
+*/
+const char *checkBook(const char *isbn, const char *title, const char *authors, const char *year, const char *genre,
+                      int *yearValue)
+{
+   if (strlen(isbn) != 13 || strspn(isbn, "0123456789") != 13)
+   {
+      return "ISBN must contain exactly 13 digits";
+   }
+   if (title[0] == '\0' || strlen(title) > (size_t)FIELD_LIMIT(nameBook))
+   {
+      return "title must have 1 to 50 characters";
+   }
+   if (authors[0] == '\0' || strlen(authors) > (size_t)FIELD_LIMIT(authors))
+   {
+      return "authors must have 1 to 200 characters";
+   }
+   char *end;
+   long value = strtol(year, &end, 10);
+   if (year[0] == '\0' || *end != '\0' || value > 2025 || value < -9999)
+   {
+      return "year must be a number not greater than 2025";
+   }
+   if (genre[0] == '\0' || strlen(genre) > (size_t)FIELD_LIMIT(genre))
+   {
+      return "genre must have 1 to 100 characters";
+   }
+   if (strpbrk(title, "|\r\n") || strpbrk(authors, "|\r\n") || strpbrk(genre, "|\r\n"))
+   {
+      return "fields must not contain '|' or line breaks";
+   }
+   *yearValue = (int)value;
+   return NULL;
+}
+
+//====== INSERT BOOK FUNCTION ======
+/*
+    insertBook function:
+    - Appends the given book to the catalog, growing the row array geometrically if needed.
+    - Packs its text fields into the string arena.
+    - Adds the book to the ISBN, token, trigram, year and completion indexes, to the scan columns and, if it is borrowed, to
+      the borrow index.
+    - A book with several copies gets a loan table entry; if it is borrowed, its first copy is the one lent.
+    - Returns 1 on success, 0 on memory allocation failure.
+*/
+int insertBook(Catalog *catalog, const Database *book)
+{
+   STATS_START(statStart);
+   if (!reserveBooks(catalog, catalog->count + 1))
+   {
+      return 0;
+   }
+
+   // Pack ISBN, title, authors and genre back to back
+   size_t isbnLength = strlen(book->isbn);
+   size_t titleLength = strlen(book->nameBook);
+   size_t authorsLength = strlen(book->authors);
+   size_t genreLength = strlen(book->genre);
+   char text[sizeof(book->isbn) + sizeof(book->nameBook) + sizeof(book->authors) + sizeof(book->genre)];
+   memcpy(text, book->isbn, isbnLength);
+   memcpy(text + isbnLength, book->nameBook, titleLength);
+   memcpy(text + isbnLength + titleLength, book->authors, authorsLength);
+   memcpy(text + isbnLength + titleLength + authorsLength, book->genre, genreLength);
+   long long offset = arenaStore(catalog, text, isbnLength + titleLength + authorsLength + genreLength);
+   if (offset < 0)
+   {
+      return 0;
+   }
+
+   BookRecord *record = &catalog->books[catalog->count];
+   memset(record, 0, sizeof(*record));
+   record->offset = (uint64_t)offset;
+   record->isbnLength = (uint8_t)isbnLength;
+   record->titleAt = (uint16_t)isbnLength;
+   record->titleLength = (uint8_t)titleLength;
+   record->authorsAt = (uint16_t)(isbnLength + titleLength);
+   record->authorsLength = (uint8_t)authorsLength;
+   record->genreAt = (uint16_t)(isbnLength + titleLength + authorsLength);
+   record->genreLength = (uint8_t)genreLength;
+   record->flags = BOOK_IN_ARENA;
+   record->year = book->year;
+   if (strcmp(book->borrowed, "true") == 0)
+   {
+      record->flags |= BOOK_BORROWED;
+   }
+   if (!parseDate(book->date, (int)strlen(book->date), &record->borrowDay))
+   {
+      record->borrowDay = NO_DATE;
+   }
+   catalog->count++;
+
+   if (!isbnIndexInsert(&catalog->isbnIndex, catalog, catalog->count - 1))
+   {
+      fprintf(stderr, "Error: Could not add the book to the ISBN index.\n");
+   }
+   if (!tokenIndexAdd(&catalog->tokenIndex, catalog, catalog->count - 1))
+   {
+      fprintf(stderr, "Error: Could not add the book to the token index.\n");
+   }
+   if (!trigramIndexAdd(&catalog->trigramIndex, catalog, catalog->count - 1))
+   {
+      fprintf(stderr, "Error: Could not add the book to the trigram index.\n");
+   }
+   if (!scanColumnsAppend(&catalog->columns, catalog, catalog->count - 1))
+   {
+      fprintf(stderr, "Error: Could not add the book to the scan columns.\n");
+   }
+   if ((record->flags & BOOK_BORROWED) && !borrowIndexAdd(&catalog->borrowIndex, catalog->count - 1, record->borrowDay))
+   {
+      fprintf(stderr, "Error: Could not add the book to the borrow index.\n");
+   }
+   if (!yearIndexAdd(&catalog->yearIndex, catalog->count - 1, record->year))
+   {
+      fprintf(stderr, "Error: Could not add the book to the year index.\n");
+   }
+   if (!completionIndexAdd(&catalog->completions, catalog, catalog->count - 1))
+   {
+      fprintf(stderr, "Error: Could not add the book to the completion index.\n");
+   }
+   if (!facetIndexAdd(&catalog->facets, catalog, catalog->count - 1))
+   {
+      fprintf(stderr, "Error: Could not add the book to the facet index.\n");
+   }
+   if (book->copies > 1)
+   {
+      int entry = loanTableAddBook(&catalog->loans, catalog->count - 1, book->copies);
+      if (entry < 0)
+      {
+         fprintf(stderr, "Error: Could not add the copies of the book to the loan table.\n");
+      }
+      else
+      {
+         record->loans = entry + 1;
+         if (record->flags & BOOK_BORROWED)
+         {
+            loanTableLend(&catalog->loans, entry, 1, LOAN_UNKNOWN_PATRON, record->borrowDay);
+         }
+      }
+   }
+   STATS_STOP(STAT_ADD, statStart);
+   return 1;
+}
+
+//====== REMOVE BOOK FUNCTION ======
+/*
+    removeBook function:
+    - Turns the book at the given row into a tombstone; no other row moves, so row numbers stay valid.
+    - Drops it from the ISBN, borrow and completion indexes, the facet counters and the loan table, and blanks it in
+      the scan columns.
+    - Its token and trigram postings stay behind and are skipped by the searches until compactCatalog rebuilds them.
+*/
+void removeBook(Catalog *catalog, int row)
+{
+   STATS_START(statStart);
+   isbnIndexRemove(&catalog->isbnIndex, catalog, row);
+   completionIndexRemove(&catalog->completions, catalog, row);
+   facetIndexRemove(&catalog->facets, catalog, row);
+   if (isBookBorrowed(catalog, row))
+   {
+      borrowIndexRemove(&catalog->borrowIndex, row, catalog->books[row].borrowDay);
+   }
+   catalog->books[row].flags = (uint8_t)((catalog->books[row].flags & ~BOOK_BORROWED) | BOOK_DELETED);
+   catalog->books[row].borrowDay = NO_DATE;
+   if (catalog->books[row].loans > 0)
+   {
+      loanTableRemoveBook(&catalog->loans, catalog->books[row].loans - 1);
+      catalog->books[row].loans = 0;
+   }
+   scanColumnsRemove(&catalog->columns, row);
+   catalog->deleted++;
+   STATS_STOP(STAT_DELETE, statStart);
+}
+
+//====== FREE CATALOG FUNCTION ======
+/*
+    freeCatalog function:
+    - Releases the rows, the loaded file, the string arena, the indexes, the scan columns and the loan table.
+    - The journal is closed separately with journalClose.
+*/
+void freeCatalog(Catalog *catalog)
+{
+   free(catalog->books);
+   free(catalog->arena);
+
+   if (catalog->mapped)
+   {
+      munmap((void *)catalog->data, catalog->dataSize);
+   }
+   else
+   {
+      free((void *)catalog->data);
+   }
+
+   isbnIndexFree(&catalog->isbnIndex);
+   tokenIndexFree(&catalog->tokenIndex);
+   trigramIndexFree(&catalog->trigramIndex);
+   scanColumnsFree(&catalog->columns);
+   borrowIndexFree(&catalog->borrowIndex);
+   yearIndexFree(&catalog->yearIndex);
+   completionIndexFree(&catalog->completions);
+   facetIndexFree(&catalog->facets);
+   loanTableFree(&catalog->loans);
+   catalog->books = NULL;
+   catalog->count = 0;
+   catalog->deleted = 0;
+   catalog->capacity = 0;
+   catalog->data = NULL;
+   catalog->dataSize = 0;
+   catalog->arena = NULL;
+   catalog->arenaSize = 0;
+   catalog->arenaCapacity = 0;
+}
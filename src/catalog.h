@@ -0,0 +1,105 @@
+#ifndef CATALOG_H
+#define CATALOG_H
+
+#include <pthread.h>
+#include <stddef.h>
+
+#include "borrow_index.h"
+#include "completion_index.h"
+#include "date.h"
+#include "db.h"
+#include "facet_index.h"
+#include "isbn_index.h"
+#include "journal.h"
+#include "loans.h"
+#include "scan.h"
+#include "token_index.h"
+#include "trigram_index.h"
+#include "year_index.h"
+
+// Deleted books are dropped from the rows once they make up more than 1/CATALOG_TOMBSTONE_RATIO of them
+// (and at least CATALOG_TOMBSTONE_MIN), or whenever the journal is compacted anyway
+#ifndef CATALOG_TOMBSTONE_RATIO
+#define CATALOG_TOMBSTONE_RATIO 4
+#endif
+#ifndef CATALOG_TOMBSTONE_MIN
+#define CATALOG_TOMBSTONE_MIN 1024
+#endif
+
+//====== CATALOG STRUCTURE DEFINITION ======
+/*
+    Catalog structure:
+    - Holds every book of the library as a compact BookRecord.
+    - Text fields point into the loaded "books.db" bytes, or into the string arena for books added later.
+    - Keeps the ISBN, token, title trigram, borrow, year, completion and facet indexes, the scan columns and the
+      journal that must follow every change.
+    - Copies and patron loans live in the loan table; lendCopy and returnCopy keep it and the rows in step.
+    - Fields are read through the book* accessors, which hide where a row's text lives.
+    - Deleted books stay as tombstone rows (BOOK_DELETED) so row numbers held by search results remain valid;
+      compactCatalog drops them.
+*/
+typedef struct Catalog
+{
+   BookRecord *books;           // Rows in file order
+   int count;                   // Number of rows, tombstones included
+   int deleted;                 // Number of tombstone rows
+   int capacity;                // Allocated rows
+   const char *data;            // Contents of "books.db" the rows point into
+   size_t dataSize;             // Size of data in bytes
+   int mapped;                  // 1 if data is a memory mapping of the file, 0 if it was read into the heap
+   char *arena;                 // Packed text of books added after loading
+   size_t arenaSize;            // Bytes used in the arena
+   size_t arenaCapacity;        // Bytes allocated for the arena
+   IsbnIndex isbnIndex;         // ISBN -> row
+   TokenIndex tokenIndex;       // Title, author and genre words -> rows
+   TrigramIndex trigramIndex;   // Title trigrams -> rows
+   ScanColumns columns;         // Flags, years and lowercased titles for full scans
+   BorrowIndex borrowIndex;     // Borrowed books by borrow day
+   YearIndex yearIndex;         // Rows by publication year
+   CompletionIndex completions; // Title and author prefixes -> most common completions
+   FacetIndex facets;           // Genre ids per row, live and borrowed bitmaps, counters per genre and decade
+   LoanTable loans;             // Copies and patron loans of the books that need more than their row
+   Journal journal;             // Changes made since "books.db" was written
+   pthread_rwlock_t *readers;   // Held by lookups running beside the writer (server mode), NULL if there are none
+   int frozen;                  // 1 for a copy made by freezeCatalog: rows, text and loans only, no indexes
+} Catalog;
+
+//====== PATRON LOAN STRUCTURE DEFINITION ======
+/*
+    PatronLoan structure:
+    - One copy lent to a patron, as listed by findPatronLoans.
+*/
+typedef struct
+{
+   int row;     // Row of the book
+   int copy;    // Copy number, from 1
+   int32_t day; // Days since 01-01-1970 of the loan, NO_DATE if undated
+} PatronLoan;
+
+StringView bookIsbn(const Catalog *catalog, int row);
+StringView bookTitle(const Catalog *catalog, int row);
+StringView bookAuthors(const Catalog *catalog, int row);
+StringView bookGenre(const Catalog *catalog, int row);
+int bookYear(const Catalog *catalog, int row);
+int32_t bookBorrowDay(const Catalog *catalog, int row);
+int isBookBorrowed(const Catalog *catalog, int row);
+int isBookDeleted(const Catalog *catalog, int row);
+int isbnEquals(const Catalog *catalog, int row, const char *isbn);
+
+void readBook(const Catalog *catalog, int row, Database *book);
+int bookCopies(const Catalog *catalog, int row);
+int lentCopies(const Catalog *catalog, int row);
+int availableCopy(const Catalog *catalog, int row);
+int copyLoan(const Catalog *catalog, int row, int copy, int32_t *patron, int32_t *day);
+int lendCopy(Catalog *catalog, int row, int copy, int32_t patron, int32_t day);
+int returnCopy(Catalog *catalog, int row, int copy);
+int findPatronLoans(const Catalog *catalog, int32_t patron, PatronLoan *loans, int max);
+int reserveBooks(Catalog *catalog, int rows);
+int reserveArena(Catalog *catalog, size_t bytes);
+const char *checkBook(const char *isbn, const char *title, const char *authors, const char *year, const char *genre,
+                      int *yearValue);
+int insertBook(Catalog *catalog, const Database *book);
+void removeBook(Catalog *catalog, int row);
+void freeCatalog(Catalog *catalog);
+
+#endif
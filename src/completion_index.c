@@ -0,0 +1,872 @@
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "catalog.h"
+#include "completion_index.h"
+#include "image.h"
+#include "stats.h"
+
+//====== NORMALIZE KEY FUNCTION ======
+/*
+    normalizeKey function:
+    - Copies text into key lowercased, with runs of spaces folded into one and leading spaces dropped.
+    - A trailing space is kept, so a prefix ending in a space only completes to longer names; keys drop it.
+    - Keeps at most COMPLETION_KEY_LENGTH bytes and NUL-terminates key.
+    - Returns the length of key.
+*/
+static int normalizeKey(const char *text, int length, char *key)
+{
+   int size = 0;
+   for (int i = 0; i < length && size < COMPLETION_KEY_LENGTH; i++)
+   {
+      char c = (char)tolower((unsigned char)text[i]);
+      if (isspace((unsigned char)c))
+      {
+         if (size == 0 || key[size - 1] == ' ')
+         {
+            continue;
+         }
+         c = ' ';
+      }
+      key[size++] = c;
+   }
+   key[size] = '\0';
+   return size;
+}
+
+//====== NEW NODE FUNCTION ======
+/*
+    newNode function:
+    - Appends a node with the given label and no children.
+    - Returns its index, or -1 on memory allocation failure.
+*/
+static int newNode(CompletionTrie *trie, int32_t label, int32_t length)
+{
+   if (trie->count == trie->capacity)
+   {
+      int capacity = trie->capacity ? 2 * trie->capacity : 64;
+      TrieNode *nodes = realloc(trie->nodes, (size_t)capacity * sizeof(TrieNode));
+      if (!nodes)
+      {
+         fprintf(stderr, "Error: Memory allocation for completion index failed.\n");
+         return -1;
+      }
+      trie->nodes = nodes;
+      trie->capacity = capacity;
+      STATS_ADD(STAT_REALLOCS, 1);
+   }
+   TrieNode *node = &trie->nodes[trie->count];
+   node->label = label;
+   node->length = length;
+   node->child = -1;
+   node->sibling = -1;
+   node->count = 0;
+   node->best = 0;
+   return trie->count++;
+}
+
+//====== STORE LABEL FUNCTION ======
+/*
+    storeLabel function:
+    - Appends the bytes of a new edge label to the label pool.
+    - Returns their offset, or -1 on memory allocation failure.
+*/
+static int32_t storeLabel(CompletionTrie *trie, const char *text, int length)
+{
+   if (trie->labelSize + (size_t)length > trie->labelCapacity)
+   {
+      size_t capacity = trie->labelCapacity ? 2 * trie->labelCapacity : 4096;
+      while (capacity < trie->labelSize + (size_t)length)
+      {
+         capacity *= 2;
+      }
+      // Labels are addressed by int32_t offsets
+      char *labels = capacity <= (size_t)INT32_MAX + 1 ? realloc(trie->labels, capacity) : NULL;
+      if (!labels)
+      {
+         fprintf(stderr, "Error: Memory allocation for completion index failed.\n");
+         return -1;
+      }
+      trie->labels = labels;
+      trie->labelCapacity = capacity;
+      STATS_ADD(STAT_REALLOCS, 1);
+   }
+   memcpy(trie->labels + trie->labelSize, text, length);
+   trie->labelSize += length;
+   return (int32_t)(trie->labelSize - length);
+}
+
+//====== FIND CHILD FUNCTION ======
+/*
+    findChild function:
+    - Looks for the child of a node whose label starts with byte c.
+    - Returns it, or -1 if there is none; sets *before to the child it would follow in sorted order
+      (-1 if it would come first).
+*/
+static int findChild(const CompletionTrie *trie, int node, unsigned char c, int *before)
+{
+   *before = -1;
+   for (int child = trie->nodes[node].child; child != -1; child = trie->nodes[child].sibling)
+   {
+      unsigned char first = (unsigned char)trie->labels[trie->nodes[child].label];
+      if (first == c)
+      {
+         return child;
+      }
+      if (first > c)
+      {
+         break;
+      }
+      *before = child;
+   }
+   return -1;
+}
+
+//====== ADD KEY FUNCTION ======
+/*
+    addKey function:
+    - Counts one more book with the given key, adding the nodes it needs: a new leaf for the part of
+      the key no edge matches, after splitting the edge it leaves in the middle, if any.
+    - Raises the best count of every node on the way.
+    - Returns 1 on success, 0 on memory allocation failure.
+*/
+static int addKey(CompletionTrie *trie, const char *key, int length)
+{
+   if (trie->count == 0 && newNode(trie, 0, 0) < 0)
+   {
+      return 0;
+   }
+
+   int path[COMPLETION_KEY_LENGTH + 1];
+   int depth = 0;
+   int node = 0;
+   int pos = 0;
+   path[depth++] = node;
+   while (pos < length)
+   {
+      int before;
+      int child = findChild(trie, node, (unsigned char)key[pos], &before);
+      if (child == -1)
+      {
+         // No edge starts with the next byte: the rest of the key becomes a new leaf
+         int32_t label = storeLabel(trie, key + pos, length - pos);
+         child = label < 0 ? -1 : newNode(trie, label, length - pos);
+         if (child < 0)
+         {
+            return 0;
+         }
+         TrieNode *parent = &trie->nodes[node];
+         if (before == -1)
+         {
+            trie->nodes[child].sibling = parent->child;
+            parent->child = child;
+         }
+         else
+         {
+            trie->nodes[child].sibling = trie->nodes[before].sibling;
+            trie->nodes[before].sibling = child;
+         }
+         node = child;
+         path[depth++] = node;
+         break;
+      }
+
+      int common = 0;
+      const TrieNode *edge = &trie->nodes[child];
+      while (common < edge->length && pos + common < length && trie->labels[edge->label + common] == key[pos + common])
+      {
+         common++;
+      }
+      if (common < edge->length)
+      {
+         // The key leaves the edge in its middle: the lower part of the edge moves to a new node below it
+         int lower = newNode(trie, edge->label + common, edge->length - common);
+         if (lower < 0)
+         {
+            return 0;
+         }
+         TrieNode *upper = &trie->nodes[child];
+         trie->nodes[lower].child = upper->child;
+         trie->nodes[lower].count = upper->count;
+         trie->nodes[lower].best = upper->best;
+         upper->length = common;
+         upper->child = lower;
+         upper->count = 0;
+      }
+      node = child;
+      pos += common;
+      path[depth++] = node;
+   }
+
+   int count = ++trie->nodes[node].count;
+   for (int i = 0; i < depth; i++)
+   {
+      if (trie->nodes[path[i]].best < count)
+      {
+         trie->nodes[path[i]].best = count;
+      }
+   }
+   return 1;
+}
+
+//====== REMOVE KEY FUNCTION ======
+/*
+    removeKey function:
+    - Counts one book less with the given key, then recomputes the best counts on the way back up.
+*/
+static void removeKey(CompletionTrie *trie, const char *key, int length)
+{
+   if (trie->count == 0)
+   {
+      return;
+   }
+
+   int path[COMPLETION_KEY_LENGTH + 1];
+   int depth = 0;
+   int node = 0;
+   int pos = 0;
+   path[depth++] = node;
+   while (pos < length)
+   {
+      int before;
+      node = findChild(trie, node, (unsigned char)key[pos], &before);
+      if (node == -1)
+      {
+         return;
+      }
+      const TrieNode *edge = &trie->nodes[node];
+      if (edge->length > length - pos || memcmp(trie->labels + edge->label, key + pos, edge->length) != 0)
+      {
+         return;
+      }
+      pos += edge->length;
+      path[depth++] = node;
+   }
+   if (trie->nodes[node].count == 0)
+   {
+      return;
+   }
+
+   trie->nodes[node].count--;
+   for (int i = depth - 1; i >= 0; i--)
+   {
+      TrieNode *step = &trie->nodes[path[i]];
+      int best = step->count;
+      for (int child = step->child; child != -1; child = trie->nodes[child].sibling)
+      {
+         if (trie->nodes[child].best > best)
+         {
+            best = trie->nodes[child].best;
+         }
+      }
+      step->best = best;
+   }
+}
+
+//====== FOR EACH KEY FUNCTION ======
+/*
+    forEachKey function:
+    - Normalizes the title of a row and each comma-separated name of its authors, and hands every
+      non-empty one to visit with its field (COMPLETE_TITLE or COMPLETE_AUTHOR).
+    - Returns 1 on success, 0 as soon as visit fails.
+*/
+static int forEachKey(const Catalog *catalog, int row, int (*visit)(void *context, int field, const char *key, int length),
+                      void *context)
+{
+   char key[COMPLETION_KEY_LENGTH + 1];
+   StringView title = bookTitle(catalog, row);
+   int length = normalizeKey(title.data, title.length, key);
+   length -= length > 0 && key[length - 1] == ' ';
+   if (length > 0 && !visit(context, COMPLETE_TITLE, key, length))
+   {
+      return 0;
+   }
+
+   StringView authors = bookAuthors(catalog, row);
+   int start = 0;
+   while (start <= authors.length)
+   {
+      int end = start;
+      while (end < authors.length && authors.data[end] != ',')
+      {
+         end++;
+      }
+      length = normalizeKey(authors.data + start, end - start, key);
+      length -= length > 0 && key[length - 1] == ' ';
+      if (length > 0 && !visit(context, COMPLETE_AUTHOR, key, length))
+      {
+         return 0;
+      }
+      start = end + 1;
+   }
+   return 1;
+}
+
+/*
+    visitAdd, visitRemove functions:
+    - forEachKey visitors that count a key in, or out of, its trie of the CompletionIndex in context.
+*/
+static int visitAdd(void *context, int field, const char *key, int length)
+{
+   return addKey(&((CompletionIndex *)context)->tries[field], key, length);
+}
+
+static int visitRemove(void *context, int field, const char *key, int length)
+{
+   removeKey(&((CompletionIndex *)context)->tries[field], key, length);
+   return 1;
+}
+
+//====== ADD TO COMPLETION INDEX FUNCTION ======
+/*
+    completionIndexAdd function:
+    - Counts the title and every author of the book at the given row.
+    - Returns 1 on success, 0 on memory allocation failure.
+*/
+int completionIndexAdd(CompletionIndex *index, const Catalog *catalog, int row)
+{
+   return forEachKey(catalog, row, visitAdd, index);
+}
+
+//====== REMOVE FROM COMPLETION INDEX FUNCTION ======
+/*
+    completionIndexRemove function:
+    - Uncounts the title and every author of the book at the given row, which must still be counted.
+*/
+void completionIndexRemove(CompletionIndex *index, const Catalog *catalog, int row)
+{
+   forEachKey(catalog, row, visitRemove, index);
+}
+
+//====== KEY LIST STRUCTURE DEFINITION ======
+/*
+    KeyList structure:
+    - Every key of one field, NUL-terminated back to back, gathered to build a trie in one sorted pass.
+*/
+typedef struct
+{
+   char *text;      // Keys, each followed by '\0'
+   size_t size;     // Bytes used in text
+   size_t capacity; // Bytes allocated for text
+   size_t *at;      // Offset of each key in text
+   int count;       // Number of keys
+   int slots;       // Allocated offsets
+} KeyList;
+
+//====== VISIT GATHER FUNCTION ======
+/*
+    visitGather function:
+    - forEachKey visitor that appends a key to its field's KeyList in the array context.
+*/
+static int visitGather(void *context, int field, const char *key, int length)
+{
+   KeyList *list = &((KeyList *)context)[field];
+   if (list->size + (size_t)length + 1 > list->capacity)
+   {
+      size_t capacity = list->capacity ? 2 * list->capacity : 1 << 16;
+      char *text = realloc(list->text, capacity);
+      if (!text)
+      {
+         fprintf(stderr, "Error: Memory allocation for completion index failed.\n");
+         return 0;
+      }
+      list->text = text;
+      list->capacity = capacity;
+   }
+   if (list->count == list->slots)
+   {
+      int slots = list->slots ? 2 * list->slots : 1024;
+      size_t *at = realloc(list->at, (size_t)slots * sizeof(size_t));
+      if (!at)
+      {
+         fprintf(stderr, "Error: Memory allocation for completion index failed.\n");
+         return 0;
+      }
+      list->at = at;
+      list->slots = slots;
+   }
+   list->at[list->count++] = list->size;
+   memcpy(list->text + list->size, key, length);
+   list->text[list->size + length] = '\0';
+   list->size += (size_t)length + 1;
+   return 1;
+}
+
+//====== SORT KEYS FUNCTION ======
+/*
+    sortKeys function:
+    - Sorts key pointers in byte order, all keys sharing their first depth bytes (three-way radix quicksort).
+    - Partitions on one byte at a time, so runs of equal keys, such as a popular author, are settled in
+      one pass per byte instead of by repeated full comparisons.
+*/
+static void sortKeys(const char **keys, int count, int depth)
+{
+   while (count > 16)
+   {
+      unsigned char pivot = (unsigned char)keys[count / 2][depth];
+      int lt = 0, i = 0, gt = count;
+      while (i < gt)
+      {
+         unsigned char c = (unsigned char)keys[i][depth];
+         const char *swap = keys[i];
+         if (c < pivot)
+         {
+            keys[i++] = keys[lt];
+            keys[lt++] = swap;
+         }
+         else if (c > pivot)
+         {
+            keys[i] = keys[--gt];
+            keys[gt] = swap;
+         }
+         else
+         {
+            i++;
+         }
+      }
+      sortKeys(keys, lt, depth);
+      sortKeys(keys + gt, count - gt, depth);
+      if (pivot == '\0')
+      {
+         return;
+      }
+      keys += lt;
+      count = gt - lt;
+      depth++;
+   }
+
+   // Insertion sort for short runs
+   for (int i = 1; i < count; i++)
+   {
+      const char *key = keys[i];
+      int j = i;
+      for (; j > 0 && strcmp(keys[j - 1] + depth, key + depth) > 0; j--)
+      {
+         keys[j] = keys[j - 1];
+      }
+      keys[j] = key;
+   }
+}
+
+//====== SET BEST FUNCTION ======
+/*
+    setBest function:
+    - Computes the best count of a node and its whole subtree from their key counts.
+*/
+static int32_t setBest(CompletionTrie *trie, int node)
+{
+   int32_t best = trie->nodes[node].count;
+   for (int child = trie->nodes[node].child; child != -1; child = trie->nodes[child].sibling)
+   {
+      int32_t below = setBest(trie, child);
+      if (below > best)
+      {
+         best = below;
+      }
+   }
+   trie->nodes[node].best = best;
+   return best;
+}
+
+//====== LOAD SORTED KEYS FUNCTION ======
+/*
+    loadSortedKeys function:
+    - Builds a trie from keys sorted in byte order, without searching it: each key differs from the
+      previous one only after their common prefix, so it hangs off the rightmost path of the trie,
+      splitting the edge the prefix ends in, if any, and always becomes the last child of its parent.
+    - Equal keys are counted on one node. Best counts are set in one pass at the end.
+    - Returns 1 on success, 0 on memory allocation failure.
+*/
+static int loadSortedKeys(CompletionTrie *trie, const char **keys, int count)
+{
+   if (count == 0)
+   {
+      return 1;
+   }
+   if (newNode(trie, 0, 0) < 0)
+   {
+      return 0;
+   }
+
+   // Rightmost path: node, key length at its end and its last child
+   int path[COMPLETION_KEY_LENGTH + 1];
+   int pathEnd[COMPLETION_KEY_LENGTH + 1];
+   int lastChild[COMPLETION_KEY_LENGTH + 1];
+   int depth = 1;
+   path[0] = 0;
+   pathEnd[0] = 0;
+   lastChild[0] = -1;
+   const char *previous = "";
+   for (int k = 0; k < count; k++)
+   {
+      const char *key = keys[k];
+      int common = 0;
+      while (key[common] != '\0' && key[common] == previous[common])
+      {
+         common++;
+      }
+      int length = common + (int)strlen(key + common);
+      if (length == common && previous[common] == '\0')
+      {
+         trie->nodes[path[depth - 1]].count++;
+         continue;
+      }
+
+      // Leave the nodes the key does not go through; split the one the common prefix ends inside
+      while (pathEnd[depth - 1] > common)
+      {
+         depth--;
+      }
+      int parent = path[depth - 1];
+      if (lastChild[depth - 1] != -1 && pathEnd[depth - 1] < common)
+      {
+         int upper = lastChild[depth - 1];
+         int keep = common - pathEnd[depth - 1];
+         int lower = newNode(trie, trie->nodes[upper].label + keep, trie->nodes[upper].length - keep);
+         if (lower < 0)
+         {
+            return 0;
+         }
+         trie->nodes[lower].child = trie->nodes[upper].child;
+         trie->nodes[lower].count = trie->nodes[upper].count;
+         trie->nodes[upper].length = keep;
+         trie->nodes[upper].child = lower;
+         trie->nodes[upper].count = 0;
+         path[depth] = upper;
+         pathEnd[depth] = common;
+         lastChild[depth] = lower;
+         parent = upper;
+         depth++;
+      }
+
+      int32_t label = storeLabel(trie, key + common, length - common);
+      int leaf = label < 0 ? -1 : newNode(trie, label, length - common);
+      if (leaf < 0)
+      {
+         return 0;
+      }
+      trie->nodes[leaf].count = 1;
+      if (lastChild[depth - 1] == -1)
+      {
+         trie->nodes[parent].child = leaf;
+      }
+      else
+      {
+         trie->nodes[lastChild[depth - 1]].sibling = leaf;
+      }
+      lastChild[depth - 1] = leaf;
+      path[depth] = leaf;
+      pathEnd[depth] = length;
+      lastChild[depth] = -1;
+      depth++;
+      previous = key;
+   }
+   setBest(trie, 0);
+   return 1;
+}
+
+//====== BUILD COMPLETION INDEX FUNCTION ======
+/*
+    completionIndexBuild function:
+    - Builds both tries over the books of the catalog that are not deleted.
+    - Gathers and sorts the keys of each field first, then loads them in one pass (see loadSortedKeys),
+      which touches every node a few times instead of searching the trie for every key.
+    - Returns 1 on success, 0 on memory allocation failure.
+*/
+int completionIndexBuild(CompletionIndex *index, const Catalog *catalog)
+{
+   memset(index, 0, sizeof(*index));
+   KeyList lists[2];
+   memset(lists, 0, sizeof(lists));
+   int ok = 1;
+   for (int i = 0; ok && i < catalog->count; i++)
+   {
+      ok = (catalog->books[i].flags & BOOK_DELETED) || forEachKey(catalog, i, visitGather, lists);
+   }
+
+   for (int field = 0; field < 2; field++)
+   {
+      KeyList *list = &lists[field];
+      const char **keys = ok ? malloc((list->count > 0 ? (size_t)list->count : 1) * sizeof(char *)) : NULL;
+      if (ok && !keys)
+      {
+         fprintf(stderr, "Error: Memory allocation for completion index failed.\n");
+      }
+      ok = keys != NULL;
+      for (int k = 0; ok && k < list->count; k++)
+      {
+         keys[k] = list->text + list->at[k];
+      }
+      if (ok)
+      {
+         sortKeys(keys, list->count, 0);
+         ok = loadSortedKeys(&index->tries[field], keys, list->count);
+      }
+      free(keys);
+      free(list->text);
+      free(list->at);
+   }
+   return ok;
+}
+
+//====== COMPLETION BEFORE FUNCTION ======
+/*
+    completionBefore function:
+    - Returns 1 if completion a is listed before completion b: more books, then alphabetical order.
+*/
+static int completionBefore(const Completion *a, const Completion *b)
+{
+   return a->count > b->count || (a->count == b->count && strcmp(a->text, b->text) < 0);
+}
+
+//====== COMPARE COMPLETIONS FUNCTION ======
+/*
+    compareCompletions function:
+    - qsort order of completions, as listed by completionIndexFind.
+*/
+static int compareCompletions(const void *a, const void *b)
+{
+   return completionBefore(a, b) ? -1 : completionBefore(b, a) ? 1 : 0;
+}
+
+//====== OFFER COMPLETION FUNCTION ======
+/*
+    offerCompletion function:
+    - Keeps a key among the best max completions found so far, held in a heap whose top is the one
+      listed last (so it is the one to drop).
+    - Keys arrive in alphabetical order, so a key with as many books as the top loses to it.
+*/
+static void offerCompletion(Completion *heap, int *found, int max, const char *key, int length, int count)
+{
+   int i;
+   if (*found < max)
+   {
+      i = (*found)++;
+   }
+   else if (count > heap[0].count)
+   {
+      // Sift the new key down from the top
+      i = 0;
+      Completion *top = &heap[0];
+      top->count = count;
+      memcpy(top->text, key, length);
+      top->text[length] = '\0';
+      for (;;)
+      {
+         int last = i;
+         int left = 2 * i + 1, right = left + 1;
+         if (left < max && completionBefore(&heap[last], &heap[left]))
+         {
+            last = left;
+         }
+         if (right < max && completionBefore(&heap[last], &heap[right]))
+         {
+            last = right;
+         }
+         if (last == i)
+         {
+            return;
+         }
+         Completion swap = heap[i];
+         heap[i] = heap[last];
+         heap[last] = swap;
+         i = last;
+      }
+   }
+   else
+   {
+      return;
+   }
+
+   // Sift the new key up from the bottom
+   Completion added;
+   added.count = count;
+   memcpy(added.text, key, length);
+   added.text[length] = '\0';
+   while (i > 0 && completionBefore(&heap[(i - 1) / 2], &added))
+   {
+      heap[i] = heap[(i - 1) / 2];
+      i = (i - 1) / 2;
+   }
+   heap[i] = added;
+}
+
+//====== COLLECT COMPLETIONS FUNCTION ======
+/*
+    collectCompletions function:
+    - Offers every key in the subtree of node, whose key so far is the first length bytes of key.
+    - Skips subtrees whose best count cannot beat the completions already kept.
+*/
+static void collectCompletions(const CompletionTrie *trie, int node, char *key, int length, Completion *heap,
+                               int *found, int max)
+{
+   const TrieNode *current = &trie->nodes[node];
+   if (*found == max && current->best <= heap[0].count)
+   {
+      return;
+   }
+   if (current->count > 0)
+   {
+      offerCompletion(heap, found, max, key, length, current->count);
+   }
+   for (int child = current->child; child != -1; child = trie->nodes[child].sibling)
+   {
+      const TrieNode *edge = &trie->nodes[child];
+      if (length + edge->length > COMPLETION_KEY_LENGTH)
+      {
+         continue;
+      }
+      memcpy(key + length, trie->labels + edge->label, edge->length);
+      collectCompletions(trie, child, key, length + edge->length, heap, found, max);
+   }
+}
+
+//====== FIND COMPLETIONS FUNCTION ======
+/*
+    findCompletions function:
+    - The search of completionIndexFind, without the timing.
+*/
+static int findCompletions(const CompletionTrie *trie, const char *prefix, Completion *completions, int max)
+{
+   char query[COMPLETION_KEY_LENGTH + 1];
+   int length = normalizeKey(prefix, (int)strlen(prefix), query);
+   if (trie->count == 0 || max <= 0)
+   {
+      return 0;
+   }
+
+   // Follow the prefix; it may end in the middle of an edge, whose node then heads the completions
+   char key[COMPLETION_KEY_LENGTH + 1];
+   int node = 0;
+   int pos = 0;
+   while (pos < length)
+   {
+      int before;
+      node = findChild(trie, node, (unsigned char)query[pos], &before);
+      if (node == -1)
+      {
+         return 0;
+      }
+      const TrieNode *edge = &trie->nodes[node];
+      int compared = edge->length < length - pos ? edge->length : length - pos;
+      if (pos + edge->length > COMPLETION_KEY_LENGTH || memcmp(trie->labels + edge->label, query + pos, compared) != 0)
+      {
+         return 0;
+      }
+      memcpy(key + pos, trie->labels + edge->label, edge->length);
+      pos += edge->length;
+   }
+
+   int found = 0;
+   collectCompletions(trie, node, key, pos, completions, &found, max);
+   qsort(completions, found, sizeof(Completion), compareCompletions);
+   return found;
+}
+
+//====== FIND IN COMPLETION INDEX FUNCTION ======
+/*
+    completionIndexFind function:
+    - Finds the titles (field COMPLETE_TITLE) or author names (COMPLETE_AUTHOR) that start with the
+      given prefix, after normalizing it like the keys.
+    - Follows the prefix down the trie, then walks the subtree below it in alphabetical order, skipping
+      every subtree whose best count cannot make the list; the time depends on the prefix and max, not
+      on the number of books.
+    - Stores up to max (at most COMPLETION_MAX_RESULTS) completions, most books first, then alphabetical.
+    - Returns the number of completions stored.
+*/
+int completionIndexFind(const CompletionIndex *index, int field, const char *prefix, Completion *completions, int max)
+{
+   STATS_START(statStart);
+   int found = findCompletions(&index->tries[field], prefix, completions,
+                               max < COMPLETION_MAX_RESULTS ? max : COMPLETION_MAX_RESULTS);
+   STATS_STOP(STAT_SUGGEST, statStart);
+   return found;
+}
+
+//====== FREE COMPLETION INDEX FUNCTION ======
+/*
+    completionIndexFree function:
+    - Releases the nodes and labels of both tries.
+*/
+void completionIndexFree(CompletionIndex *index)
+{
+   for (int i = 0; i < 2; i++)
+   {
+      free(index->tries[i].nodes);
+      free(index->tries[i].labels);
+   }
+   memset(index, 0, sizeof(*index));
+}
+
+//====== WRITE COMPLETION INDEX FUNCTION ======
+/*
+    completionIndexWrite function:
+    - Writes the node count and label size of each trie, then its nodes and labels, to a binary image section.
+    - Returns 1 on success, 0 on write failure.
+*/
+int completionIndexWrite(const CompletionIndex *index, FILE *file)
+{
+   int ok = 1;
+   for (int i = 0; ok && i < 2; i++)
+   {
+      const CompletionTrie *trie = &index->tries[i];
+      uint64_t sizes[2] = {(uint64_t)trie->count, (uint64_t)trie->labelSize};
+      ok = imagePut(file, sizes, sizeof(sizes)) && imagePut(file, trie->nodes, (size_t)trie->count * sizeof(TrieNode)) &&
+           imagePut(file, trie->labels, trie->labelSize);
+   }
+   return ok;
+}
+
+//====== READ COMPLETION INDEX FUNCTION ======
+/*
+    completionIndexRead function:
+    - Restores the tries written by completionIndexWrite into fresh allocations.
+    - Checks that every label and node reference stays within its trie.
+    - Returns 1 on success, 0 if the section is malformed or allocation fails (the index is then empty).
+*/
+int completionIndexRead(CompletionIndex *index, ImageReader *reader)
+{
+   memset(index, 0, sizeof(*index));
+   for (int i = 0; i < 2; i++)
+   {
+      CompletionTrie *trie = &index->tries[i];
+      const uint64_t *sizes = imageTake(reader, 2 * sizeof(uint64_t));
+      if (!sizes || sizes[0] > INT32_MAX || sizes[1] > INT32_MAX)
+      {
+         completionIndexFree(index);
+         return 0;
+      }
+      int count = (int)sizes[0];
+      size_t labelSize = (size_t)sizes[1];
+      const TrieNode *nodes = imageTake(reader, (size_t)count * sizeof(TrieNode));
+      const char *labels = imageTake(reader, labelSize);
+      int ok = nodes && labels;
+      for (int n = 0; ok && n < count; n++)
+      {
+         ok = nodes[n].label >= 0 && nodes[n].length >= 0 && (size_t)nodes[n].label + nodes[n].length <= labelSize &&
+              nodes[n].child >= -1 && nodes[n].child < count && nodes[n].sibling >= -1 && nodes[n].sibling < count &&
+              nodes[n].length <= COMPLETION_KEY_LENGTH && (nodes[n].length > 0) == (n > 0);
+      }
+      if (!ok)
+      {
+         completionIndexFree(index);
+         return 0;
+      }
+
+      trie->nodes = malloc(count > 0 ? (size_t)count * sizeof(TrieNode) : 1);
+      trie->labels = malloc(labelSize > 0 ? labelSize : 1);
+      if (!trie->nodes || !trie->labels)
+      {
+         fprintf(stderr, "Error: Memory allocation for completion index failed.\n");
+         completionIndexFree(index);
+         return 0;
+      }
+      memcpy(trie->nodes, nodes, (size_t)count * sizeof(TrieNode));
+      memcpy(trie->labels, labels, labelSize);
+      trie->count = trie->capacity = count;
+      trie->labelSize = trie->labelCapacity = labelSize;
+   }
+   return 1;
+}
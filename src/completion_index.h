@@ -0,0 +1,78 @@
+#ifndef COMPLETION_INDEX_H
+#define COMPLETION_INDEX_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "db.h"
+
+struct Catalog;
+struct ImageReader;
+
+// Fields that can be completed
+#define COMPLETE_TITLE 0
+#define COMPLETE_AUTHOR 1
+
+// Longest key: a title, or one author of an authors field
+#define COMPLETION_KEY_LENGTH FIELD_LIMIT(authors)
+
+// Most completions returned for one prefix
+#define COMPLETION_MAX_RESULTS 100
+
+//====== COMPLETION INDEX STRUCTURE DEFINITION ======
+/*
+    CompletionIndex structure:
+    - Two compressed (radix) tries, one over the normalized titles and one over the normalized author
+      names: lowercased, with runs of spaces folded into one and no space at either end.
+    - Each edge carries a run of bytes kept in a shared label pool; a node where a key ends counts the
+      books with that key, and every node keeps the highest count in its subtree, so the most common
+      completions of a prefix are found without visiting subtrees that cannot make the list.
+    - Nodes live in one array and refer to each other by index, so the tries are stored in the image as they are.
+    - Kept in step by insertBook and removeBook; a key whose last book is gone keeps its (zero-count) node
+      until the index is rebuilt.
+*/
+typedef struct
+{
+   int32_t label;   // Offset of the edge label in the label pool
+   int32_t length;  // Bytes in the edge label, 0 only for the root
+   int32_t child;   // First child, -1 if none; siblings are sorted by the first byte of their label
+   int32_t sibling; // Next sibling, -1 if none
+   int32_t count;   // Books whose key ends at this node
+   int32_t best;    // Highest count of any key in this node's subtree
+} TrieNode;
+
+typedef struct
+{
+   TrieNode *nodes;      // Node 0 is the root
+   int count;            // Number of nodes
+   int capacity;         // Allocated nodes
+   char *labels;         // Edge labels, back to back
+   size_t labelSize;     // Bytes used in labels
+   size_t labelCapacity; // Bytes allocated for labels
+} CompletionTrie;
+
+typedef struct
+{
+   CompletionTrie tries[2]; // Indexed by COMPLETE_TITLE and COMPLETE_AUTHOR
+} CompletionIndex;
+
+//====== COMPLETION STRUCTURE DEFINITION ======
+/*
+    Completion structure:
+    - One completion of a prefix: a whole normalized title or author name, with the books that have it.
+*/
+typedef struct
+{
+   char text[COMPLETION_KEY_LENGTH + 1]; // Normalized title or author name
+   int count;                            // Books with it
+} Completion;
+
+int completionIndexBuild(CompletionIndex *index, const struct Catalog *catalog);
+int completionIndexAdd(CompletionIndex *index, const struct Catalog *catalog, int row);
+void completionIndexRemove(CompletionIndex *index, const struct Catalog *catalog, int row);
+int completionIndexFind(const CompletionIndex *index, int field, const char *prefix, Completion *completions, int max);
+void completionIndexFree(CompletionIndex *index);
+int completionIndexWrite(const CompletionIndex *index, FILE *file);
+int completionIndexRead(CompletionIndex *index, struct ImageReader *reader);
+
+#endif
@@ -0,0 +1,123 @@
+#include <stdio.h>
+#include <time.h>
+
+#include "date.h"
+
+//====== DAY FROM CIVIL FUNCTION ======
+/*
+    dayFromCivil function:
+    - Converts a calendar date (proleptic Gregorian) to the number of days since 01-01-1970.
+*/
+int dayFromCivil(int year, int month, int day)
+{
+   year -= month <= 2;
+   int era = (year >= 0 ? year : year - 399) / 400;
+   int yearOfEra = year - era * 400;
+   int dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+   int dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+   return era * 146097 + dayOfEra - 719468;
+}
+
+//====== CIVIL FROM DAY FUNCTION ======
+/*
+    civilFromDay function:
+    - Converts a number of days since 01-01-1970 back to a calendar date.
+*/
+static void civilFromDay(int32_t days, int *year, int *month, int *day)
+{
+   days += 719468;
+   int era = (days >= 0 ? days : days - 146096) / 146097;
+   int dayOfEra = days - era * 146097;
+   int yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+   int dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+   int monthIndex = (5 * dayOfYear + 2) / 153;
+   *day = dayOfYear - (153 * monthIndex + 2) / 5 + 1;
+   *month = monthIndex + (monthIndex < 10 ? 3 : -9);
+   *year = yearOfEra + era * 400 + (*month <= 2);
+}
+
+//====== PARSE DATE FUNCTION ======
+/*
+    parseDate function:
+    - Parses a "DD-MM-YYYY" borrow date (not NUL-terminated) into a day number.
+    - "-" means not borrowed and gives NO_DATE.
+    - Returns 1 on success, 0 if the text is not a valid date.
+*/
+int parseDate(const char *text, int length, int32_t *day)
+{
+   if (length == 1 && text[0] == '-')
+   {
+      *day = NO_DATE;
+      return 1;
+   }
+
+   int parts[3] = {0, 0, 0};
+   int part = 0;
+   int digits = 0;
+   for (int i = 0; i < length; i++)
+   {
+      if (text[i] >= '0' && text[i] <= '9' && digits < 4)
+      {
+         parts[part] = parts[part] * 10 + (text[i] - '0');
+         digits++;
+      }
+      else if (text[i] == '-' && digits > 0 && part < 2)
+      {
+         part++;
+         digits = 0;
+      }
+      else
+      {
+         return 0;
+      }
+   }
+   if (part != 2 || digits == 0 || parts[0] < 1 || parts[0] > 31 || parts[1] < 1 || parts[1] > 12)
+   {
+      return 0;
+   }
+
+   *day = dayFromCivil(parts[2], parts[1], parts[0]);
+   return 1;
+}
+
+//====== FORMAT DATE FUNCTION ======
+/*
+    formatDate function:
+    - Writes a day number as "DD-MM-YYYY", or "-" for NO_DATE, as stored in "books.db".
+*/
+void formatDate(int32_t day, char *out, int size)
+{
+   if (day == NO_DATE)
+   {
+      snprintf(out, size, "-");
+      return;
+   }
+
+   int year, month, dayOfMonth;
+   civilFromDay(day, &year, &month, &dayOfMonth);
+   snprintf(out, size, "%02d-%02d-%04d", dayOfMonth, month, year);
+}
+
+//====== CURRENT DAY FUNCTION ======
+/*
+    currentDay function:
+    - Returns today's day number in local time.
+*/
+int32_t currentDay(void)
+{
+   time_t t = time(NULL);
+   struct tm tm = *localtime(&t);
+   return dayFromCivil(tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday);
+}
+
+//====== CLOCK MS FUNCTION ======
+/*
+    clockMs function:
+    - Returns milliseconds on a monotonic clock, for timing how long something took.
+*/
+double clockMs(void)
+{
+   struct timespec now;
+   clock_gettime(CLOCK_MONOTONIC, &now);
+   return now.tv_sec * 1000.0 + now.tv_nsec / 1e6;
+}
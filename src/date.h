@@ -0,0 +1,15 @@
+#ifndef DATE_H
+#define DATE_H
+
+#include <stdint.h>
+
+// Day number of a book that is not borrowed (written as "-")
+#define NO_DATE INT32_MIN
+
+int dayFromCivil(int year, int month, int day);
+int parseDate(const char *text, int length, int32_t *day);
+void formatDate(int32_t day, char *out, int size);
+int32_t currentDay(void);
+double clockMs(void);
+
+#endif
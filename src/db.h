@@ -0,0 +1,72 @@
+#ifndef DB_H
+#define DB_H
+
+#include <stdint.h>
+
+//====== DATABASE STRUCTURE DEFINITION ======
+/*
+    Database structure:
+    - Represents a single book with properties like ISBN, title, authors, year, genre, borrowed status, and borrow date.
+    - Used to store book information in a library management system.
+    - The catalog keeps compact BookRecords; this structure carries whole books in and out (input, display, journal).
+*/
+typedef struct
+{
+   char isbn[15];     // ISBN of the book (13 digits)
+   char nameBook[51]; // Title of the book (up to 50 characters)
+   char authors[201]; // Authors of the book (comma-separated, up to 200 characters)
+   int year;          // Publication year
+   char genre[101];   // Genre(s) of the book (comma-separated, up to 100 characters)
+   char date[11];     // Borrow date in DD-MM-YYYY format or "-" if not borrowed
+   char borrowed[6];  // Borrow status ("true" or "false"), true if any copy is lent
+   int copies;        // Number of copies the library holds
+} Database;
+
+// Longest value a Database field can hold, used to clamp fields read from the file
+#define FIELD_LIMIT(field) ((int)sizeof(((Database *)0)->field) - 1)
+
+// BookRecord flags
+#define BOOK_BORROWED 0x01 // The book is borrowed
+#define BOOK_IN_ARENA 0x02 // The row's text lives in the catalog's string arena instead of the loaded file
+#define BOOK_DELETED 0x04  // The book was deleted; the row stays as a tombstone until the catalog is compacted
+#define BOOK_COPIES 0x08   // While loading: the row's line in books.db has copies and loans fields to read
+
+//====== BOOK RECORD STRUCTURE DEFINITION ======
+/*
+    BookRecord structure:
+    - Compact fixed-size header of one book (32 bytes instead of the ~400 of Database).
+    - The text fields are not stored here; they are located by offset/length in the loaded "books.db"
+      bytes or, for books added after loading, in the catalog's string arena.
+    - Borrow status is a flag and the borrow date a day number, so borrowing and returning only
+      touch this header.
+    - A book with several copies, or lent to a known patron, also has an entry in the catalog's loan
+      table; its flag and date then sum up the copies (borrowed if any is lent, since the oldest loan).
+*/
+typedef struct
+{
+   uint64_t offset;       // Start of the row's text (the ISBN) in the loaded file or the arena
+   uint16_t titleAt;      // Offsets of the title, authors and genre from the start of the row
+   uint16_t authorsAt;
+   uint16_t genreAt;
+   uint8_t isbnLength;    // Field lengths, already clamped to the Database field sizes
+   uint8_t titleLength;
+   uint8_t authorsLength;
+   uint8_t genreLength;
+   uint8_t flags;         // BOOK_BORROWED, BOOK_IN_ARENA, BOOK_DELETED, BOOK_COPIES
+   int32_t year;          // Publication year
+   int32_t borrowDay;     // Days since 01-01-1970 of the borrow date, NO_DATE if "-"
+   int32_t loans;         // Entry of the book in the loan table plus one, 0 if it has none
+} BookRecord;
+
+//====== STRING VIEW STRUCTURE DEFINITION ======
+/*
+    StringView structure:
+    - Read-only, not NUL-terminated slice of a field, print with "%.*s".
+*/
+typedef struct
+{
+   const char *data;
+   int length;
+} StringView;
+
+#endif
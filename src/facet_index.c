@@ -0,0 +1,680 @@
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "catalog.h"
+#include "facet_index.h"
+#include "image.h"
+#include "stats.h"
+
+//====== DECADE OF FUNCTION ======
+/*
+    decadeOf function:
+    - Returns the first year of the decade of a year, rounding down for years before 0.
+*/
+static int32_t decadeOf(int32_t year)
+{
+   return year >= 0 ? year / 10 * 10 : -((-(int64_t)year + 9) / 10 * 10);
+}
+
+//====== HASH GENRE FUNCTION ======
+/*
+    hashGenre function:
+    - Computes a 32-bit FNV-1a hash of a genre name, lowercased.
+*/
+static unsigned int hashGenre(const char *name, int length)
+{
+   unsigned int hash = 2166136261u;
+   for (int i = 0; i < length; i++)
+   {
+      hash ^= (unsigned char)tolower((unsigned char)name[i]);
+      hash *= 16777619u;
+   }
+   return hash;
+}
+
+//====== FIND GENRE SLOT FUNCTION ======
+/*
+    findGenreSlot function:
+    - Looks a genre name up in the hash table (linear probing).
+    - Returns its slot, holding the id plus one, or the empty slot where it would go.
+*/
+static int findGenreSlot(const FacetIndex *index, const char *name, int length)
+{
+   int mask = 2 * FACET_MAX_GENRES - 1;
+   int slot = (int)(hashGenre(name, length) & (unsigned int)mask);
+   while (index->slots[slot] != 0)
+   {
+      const char *known = index->names + index->nameAt[index->slots[slot] - 1];
+      if ((int)strlen(known) == length && strncasecmp(known, name, length) == 0)
+      {
+         break;
+      }
+      slot = (slot + 1) & mask;
+   }
+   return slot;
+}
+
+//====== INTERN GENRE FUNCTION ======
+/*
+    internGenre function:
+    - Returns the id of a genre name, giving it the next id if it is new; once FACET_OTHER_GENRE names
+      have ids, every new name gets FACET_OTHER_GENRE.
+    - Returns -1 on memory allocation failure.
+*/
+static int internGenre(FacetIndex *index, const char *name, int length)
+{
+   int slot = findGenreSlot(index, name, length);
+   if (index->slots[slot] != 0)
+   {
+      return index->slots[slot] - 1;
+   }
+   if (index->genreCount >= FACET_OTHER_GENRE)
+   {
+      index->genreCount = FACET_MAX_GENRES;
+      return FACET_OTHER_GENRE;
+   }
+
+   if (index->namesSize + length + 1 > index->namesCapacity)
+   {
+      size_t capacity = index->namesCapacity ? index->namesCapacity * 2 : 1024;
+      while (capacity < index->namesSize + length + 1)
+      {
+         capacity *= 2;
+      }
+      char *names = realloc(index->names, capacity);
+      if (!names)
+      {
+         fprintf(stderr, "Error: Memory allocation for facet index failed.\n");
+         return -1;
+      }
+      index->names = names;
+      index->namesCapacity = capacity;
+      STATS_ADD(STAT_REALLOCS, 1);
+   }
+   int id = index->genreCount++;
+   index->nameAt[id] = (uint32_t)index->namesSize;
+   memcpy(index->names + index->namesSize, name, length);
+   index->names[index->namesSize + length] = '\0';
+   index->namesSize += length + 1;
+   index->slots[slot] = (int8_t)(id + 1);
+   return id;
+}
+
+//====== GENRE MASK FUNCTION ======
+/*
+    genreMask function:
+    - Splits a genre field at its commas and returns the mask of the ids of its names (trimmed, empty
+      names skipped), interning the new ones.
+    - Sets failed on memory allocation failure.
+*/
+static uint64_t genreMask(FacetIndex *index, StringView field, int *failed)
+{
+   uint64_t mask = 0;
+   int start = 0;
+   while (start < field.length)
+   {
+      const char *comma = memchr(field.data + start, ',', field.length - start);
+      int end = comma ? (int)(comma - field.data) : field.length;
+      int first = start, last = end;
+      while (first < last && isspace((unsigned char)field.data[first]))
+      {
+         first++;
+      }
+      while (last > first && isspace((unsigned char)field.data[last - 1]))
+      {
+         last--;
+      }
+      if (last > first)
+      {
+         int id = internGenre(index, field.data + first, last - first);
+         if (id < 0)
+         {
+            *failed = 1;
+            return mask;
+         }
+         mask |= (uint64_t)1 << id;
+      }
+      start = end + 1;
+   }
+   return mask;
+}
+
+//====== FIND DECADE FUNCTION ======
+/*
+    findDecade function:
+    - Binary search for the first counter whose decade is not below the given one.
+*/
+static int findDecade(const FacetIndex *index, int32_t decade)
+{
+   int lo = 0, hi = index->decadeCount;
+   while (lo < hi)
+   {
+      int mid = lo + (hi - lo) / 2;
+      if (index->decades[mid].decade < decade)
+      {
+         lo = mid + 1;
+      }
+      else
+      {
+         hi = mid;
+      }
+   }
+   return lo;
+}
+
+//====== DECADE COUNTER FUNCTION ======
+/*
+    decadeCounter function:
+    - Returns the counters of the decade of a year, adding them (at zero) if the decade is new.
+    - Returns NULL on memory allocation failure.
+*/
+static DecadeCount *decadeCounter(FacetIndex *index, int32_t year)
+{
+   int32_t decade = decadeOf(year);
+   int at = findDecade(index, decade);
+   if (at < index->decadeCount && index->decades[at].decade == decade)
+   {
+      return &index->decades[at];
+   }
+
+   if (index->decadeCount >= index->decadeCapacity)
+   {
+      int capacity = index->decadeCapacity ? index->decadeCapacity * 2 : 32;
+      DecadeCount *decades = realloc(index->decades, capacity * sizeof(DecadeCount));
+      if (!decades)
+      {
+         fprintf(stderr, "Error: Memory allocation for facet index failed.\n");
+         return NULL;
+      }
+      index->decades = decades;
+      index->decadeCapacity = capacity;
+      STATS_ADD(STAT_REALLOCS, 1);
+   }
+   memmove(&index->decades[at + 1], &index->decades[at], (index->decadeCount - at) * sizeof(DecadeCount));
+   index->decades[at] = (DecadeCount){decade, 0, 0};
+   index->decadeCount++;
+   return &index->decades[at];
+}
+
+//====== RESERVE FACET ROWS FUNCTION ======
+/*
+    reserveRows function:
+    - Grows the per-row masks and bitmaps to hold at least rows rows, in whole 64-row words.
+    - Returns 1 on success, 0 on memory allocation failure.
+*/
+static int reserveRows(FacetIndex *index, int rows)
+{
+   if (rows <= index->capacity)
+   {
+      return 1;
+   }
+   int capacity = index->capacity ? index->capacity : 1024;
+   while (capacity < rows)
+   {
+      capacity *= 2;
+   }
+
+   uint64_t *genres = realloc(index->genres, (size_t)capacity * sizeof(uint64_t));
+   if (genres)
+   {
+      index->genres = genres;
+   }
+   uint64_t *live = genres ? realloc(index->live, (size_t)capacity / 8) : NULL;
+   if (live)
+   {
+      index->live = live;
+   }
+   uint64_t *borrowed = live ? realloc(index->borrowed, (size_t)capacity / 8) : NULL;
+   if (!borrowed)
+   {
+      fprintf(stderr, "Error: Memory allocation for facet index failed.\n");
+      return 0;
+   }
+   index->borrowed = borrowed;
+
+   // New words start with no row set
+   memset(index->live + index->capacity / 64, 0, (size_t)(capacity - index->capacity) / 8);
+   memset(index->borrowed + index->capacity / 64, 0, (size_t)(capacity - index->capacity) / 8);
+   index->capacity = capacity;
+   STATS_ADD(STAT_REALLOCS, 1);
+   return 1;
+}
+
+//====== COUNT ROW FUNCTION ======
+/*
+    countRow function:
+    - Adds delta to the counters of a row: the books, or the borrowed books if borrowedOnly is set.
+    - Returns 1 on success, 0 on memory allocation failure.
+*/
+static int countRow(FacetIndex *index, int32_t year, uint64_t genres, int borrowedOnly, int delta)
+{
+   DecadeCount *decade = decadeCounter(index, year);
+   if (!decade)
+   {
+      return 0;
+   }
+   int *perGenre = borrowedOnly ? index->genreBorrowed : index->genreBooks;
+   for (uint64_t bits = genres; bits; bits &= bits - 1)
+   {
+      perGenre[__builtin_ctzll(bits)] += delta;
+   }
+   if (borrowedOnly)
+   {
+      decade->borrowed += delta;
+      index->borrowedBooks += delta;
+   }
+   else
+   {
+      decade->books += delta;
+      index->books += delta;
+   }
+   return 1;
+}
+
+//====== ADD TO FACET INDEX FUNCTION ======
+/*
+    facetIndexAdd function:
+    - Appends the row (the catalog's newest) with its genre ids, sets its bits and counts it.
+    - Returns 1 on success, 0 on memory allocation failure.
+*/
+int facetIndexAdd(FacetIndex *index, const Catalog *catalog, int row)
+{
+   if (!reserveRows(index, row + 1))
+   {
+      return 0;
+   }
+   int failed = 0;
+   uint64_t genres = genreMask(index, bookGenre(catalog, row), &failed);
+   if (failed)
+   {
+      return 0;
+   }
+   while (index->count < row)
+   {
+      index->genres[index->count++] = 0;
+   }
+   index->genres[row] = genres;
+   index->count = row + 1;
+
+   const BookRecord *book = &catalog->books[row];
+   if (book->flags & BOOK_DELETED)
+   {
+      return 1;
+   }
+   uint64_t bit = (uint64_t)1 << (row & 63);
+   index->live[row / 64] |= bit;
+   if (!countRow(index, book->year, genres, 0, 1))
+   {
+      return 0;
+   }
+   if (book->flags & BOOK_BORROWED)
+   {
+      index->borrowed[row / 64] |= bit;
+      return countRow(index, book->year, genres, 1, 1);
+   }
+   return 1;
+}
+
+//====== REMOVE FROM FACET INDEX FUNCTION ======
+/*
+    facetIndexRemove function:
+    - Stops counting a deleted row; its genre ids stay until the catalog is compacted.
+*/
+void facetIndexRemove(FacetIndex *index, const Catalog *catalog, int row)
+{
+   uint64_t bit = (uint64_t)1 << (row & 63);
+   if (row >= index->count || !(index->live[row / 64] & bit))
+   {
+      return;
+   }
+   int32_t year = catalog->books[row].year;
+   if (index->borrowed[row / 64] & bit)
+   {
+      index->borrowed[row / 64] &= ~bit;
+      countRow(index, year, index->genres[row], 1, -1);
+   }
+   index->live[row / 64] &= ~bit;
+   countRow(index, year, index->genres[row], 0, -1);
+}
+
+//====== SET BORROWED IN FACET INDEX FUNCTION ======
+/*
+    facetIndexSetBorrowed function:
+    - Moves a live row in or out of the borrowed bitmap and counters.
+*/
+void facetIndexSetBorrowed(FacetIndex *index, const Catalog *catalog, int row, int borrowed)
+{
+   uint64_t bit = (uint64_t)1 << (row & 63);
+   if (row >= index->count || !(index->live[row / 64] & bit) || ((index->borrowed[row / 64] & bit) != 0) == (borrowed != 0))
+   {
+      return;
+   }
+   index->borrowed[row / 64] ^= bit;
+   countRow(index, catalog->books[row].year, index->genres[row], 1, borrowed ? 1 : -1);
+}
+
+//====== BUILD FACET INDEX FUNCTION ======
+/*
+    facetIndexBuild function:
+    - Interns the genres of all rows of the catalog and counts them.
+    - Returns 1 on success, 0 on memory allocation failure.
+*/
+int facetIndexBuild(FacetIndex *index, const Catalog *catalog)
+{
+   memset(index, 0, sizeof(*index));
+   if (!reserveRows(index, catalog->count))
+   {
+      return 0;
+   }
+   for (int i = 0; i < catalog->count; i++)
+   {
+      if (!facetIndexAdd(index, catalog, i))
+      {
+         return 0;
+      }
+   }
+   return 1;
+}
+
+//====== FACET GENRE FUNCTION ======
+/*
+    facetIndexGenre function:
+    - Returns the id of a genre name (compared without case, surrounding spaces ignored), or -1 if no
+      book has it. Names sharing FACET_OTHER_GENRE cannot be looked up.
+*/
+int facetIndexGenre(const FacetIndex *index, const char *name, int length)
+{
+   while (length > 0 && isspace((unsigned char)*name))
+   {
+      name++;
+      length--;
+   }
+   while (length > 0 && isspace((unsigned char)name[length - 1]))
+   {
+      length--;
+   }
+   int slot = findGenreSlot(index, name, length);
+   return length > 0 ? index->slots[slot] - 1 : -1;
+}
+
+//====== FACET GENRE NAME FUNCTION ======
+/*
+    facetIndexGenreName function:
+    - Returns the name of a genre id as first seen, or "Other genres" for FACET_OTHER_GENRE.
+*/
+const char *facetIndexGenreName(const FacetIndex *index, int id)
+{
+   return id == FACET_OTHER_GENRE ? "Other genres" : index->names + index->nameAt[id];
+}
+
+//====== SELECT COUNTS FUNCTION ======
+/*
+    selectCounts function:
+    - Turns a pair of book and borrowed counters into those of the books with the given borrowed filter:
+      books on the shelf are the books less the borrowed ones.
+*/
+static void selectCounts(int status, int books, int borrowed, int *selectedBooks, int *selectedBorrowed)
+{
+   *selectedBooks = status == FACET_BORROWED ? borrowed : status == FACET_ON_SHELF ? books - borrowed : books;
+   *selectedBorrowed = status == FACET_ON_SHELF ? 0 : borrowed;
+}
+
+//====== COUNT FACETS FUNCTION ======
+/*
+    countFacets function:
+    - The report of facetIndexCount, without the timing.
+*/
+static void countFacets(const FacetIndex *index, const Catalog *catalog, const FacetFilter *filter, FacetCounts *counts,
+                        DecadeCount *decades, int maxDecades)
+{
+   memset(counts, 0, sizeof(*counts));
+   counts->decades = decades;
+
+   // Without a genre or year filter the counters are the report
+   if (filter->genres == 0 && filter->firstYear == INT32_MIN && filter->lastYear == INT32_MAX)
+   {
+      selectCounts(filter->borrowed, index->books, index->borrowedBooks, &counts->books, &counts->borrowed);
+      for (int id = 0; id < FACET_MAX_GENRES; id++)
+      {
+         selectCounts(filter->borrowed, index->genreBooks[id], index->genreBorrowed[id], &counts->genreBooks[id],
+                      &counts->genreBorrowed[id]);
+      }
+      for (int d = 0; d < index->decadeCount && counts->decadeCount < maxDecades; d++)
+      {
+         DecadeCount *decade = &decades[counts->decadeCount];
+         decade->decade = index->decades[d].decade;
+         selectCounts(filter->borrowed, index->decades[d].books, index->decades[d].borrowed, &decade->books,
+                      &decade->borrowed);
+         counts->decadeCount += decade->books > 0;
+      }
+      return;
+   }
+   if (index->decadeCount == 0)
+   {
+      return;
+   }
+
+   // Counters per decade from the first one of the index, indexed directly by year
+   int32_t firstDecade = index->decades[0].decade;
+   int span = (index->decades[index->decadeCount - 1].decade - firstDecade) / 10 + 1;
+   DecadeCount *perDecade = calloc(span, sizeof(DecadeCount));
+   if (!perDecade)
+   {
+      fprintf(stderr, "Error: Memory allocation for facet report failed.\n");
+      return;
+   }
+   int words = (index->count + 63) / 64;
+   long visited = 0;
+   for (int w = 0; w < words; w++)
+   {
+      uint64_t bits = index->live[w];
+      if (filter->borrowed == FACET_BORROWED)
+      {
+         bits &= index->borrowed[w];
+      }
+      else if (filter->borrowed == FACET_ON_SHELF)
+      {
+         bits &= ~index->borrowed[w];
+      }
+
+      for (; bits; bits &= bits - 1)
+      {
+         int row = w * 64 + __builtin_ctzll(bits);
+         uint64_t genres = index->genres[row];
+         visited++;
+         if ((genres & filter->genres) != filter->genres)
+         {
+            continue;
+         }
+         int32_t year = catalog->books[row].year;
+         if (year < filter->firstYear || year > filter->lastYear)
+         {
+            continue;
+         }
+
+         int borrowed = (index->borrowed[w] >> (row & 63)) & 1;
+         DecadeCount *decade = &perDecade[(decadeOf(year) - firstDecade) / 10];
+         decade->books++;
+         decade->borrowed += borrowed;
+         counts->books++;
+         counts->borrowed += borrowed;
+         for (; genres; genres &= genres - 1)
+         {
+            int id = __builtin_ctzll(genres);
+            counts->genreBooks[id]++;
+            counts->genreBorrowed[id] += borrowed;
+         }
+      }
+   }
+   STATS_ADD(STAT_ROWS_SCANNED, visited);
+
+   for (int d = 0; d < span && counts->decadeCount < maxDecades; d++)
+   {
+      if (perDecade[d].books > 0)
+      {
+         perDecade[d].decade = firstDecade + d * 10;
+         decades[counts->decadeCount++] = perDecade[d];
+      }
+   }
+   free(perDecade);
+}
+
+//====== COUNT FACET INDEX FUNCTION ======
+/*
+    facetIndexCount function:
+    - Reports how many live books match a filter, and how many of them are borrowed, per genre id and
+      per decade (up to maxDecades decades with books, ascending, stored in decades).
+    - Without a genre or year filter, reads the counters; otherwise ANDs the live bitmap with the borrowed one
+      (or its complement), then each remaining row's genre mask with the filter's, before reading its year.
+*/
+void facetIndexCount(const FacetIndex *index, const Catalog *catalog, const FacetFilter *filter, FacetCounts *counts,
+                     DecadeCount *decades, int maxDecades)
+{
+   STATS_START(statStart);
+   countFacets(index, catalog, filter, counts, decades, maxDecades);
+   STATS_STOP(STAT_FACETS, statStart);
+}
+
+//====== FACET COUNTS GENRES FUNCTION ======
+/*
+    facetCountsGenres function:
+    - Stores in ids (room for FACET_MAX_GENRES) the genre ids with matching books in a report, most books first
+      and lower ids first among equals.
+    - Returns the number of ids stored.
+*/
+int facetCountsGenres(const FacetCounts *counts, int *ids)
+{
+   int found = 0;
+   for (int id = 0; id < FACET_MAX_GENRES; id++)
+   {
+      if (counts->genreBooks[id] == 0)
+      {
+         continue;
+      }
+      int at = found++;
+      while (at > 0 && counts->genreBooks[ids[at - 1]] < counts->genreBooks[id])
+      {
+         ids[at] = ids[at - 1];
+         at--;
+      }
+      ids[at] = id;
+   }
+   return found;
+}
+
+//====== FREE FACET INDEX FUNCTION ======
+/*
+    facetIndexFree function:
+    - Releases the genre names, the per-row masks and bitmaps and the decade counters.
+*/
+void facetIndexFree(FacetIndex *index)
+{
+   free(index->names);
+   free(index->genres);
+   free(index->live);
+   free(index->borrowed);
+   free(index->decades);
+   memset(index, 0, sizeof(*index));
+}
+
+//====== WRITE FACET INDEX FUNCTION ======
+/*
+    facetIndexWrite function:
+    - Writes the genre names and the genre mask of every row to a binary image section; the bitmaps and
+      counters follow from the rows and are rebuilt by facetIndexRead.
+    - Returns 1 on success, 0 on write failure.
+*/
+int facetIndexWrite(const FacetIndex *index, FILE *file)
+{
+   uint64_t sizes[3] = {(uint64_t)index->genreCount, (uint64_t)index->namesSize, (uint64_t)index->count};
+   return imagePut(file, sizes, sizeof(sizes)) && imagePut(file, index->nameAt, sizeof(index->nameAt)) &&
+          imagePut(file, index->names, index->namesSize) &&
+          imagePut(file, index->genres, (size_t)index->count * sizeof(uint64_t));
+}
+
+//====== READ FACET INDEX FUNCTION ======
+/*
+    facetIndexRead function:
+    - Restores the genre names and masks written by facetIndexWrite for the rows of the catalog, then sets
+      the bitmaps and counters from the rows' flags and years (one pass, no genre text read).
+    - Returns 1 on success, 0 if the section is malformed or allocation fails (the index is then empty).
+*/
+int facetIndexRead(FacetIndex *index, ImageReader *reader, const Catalog *catalog)
+{
+   memset(index, 0, sizeof(*index));
+   const uint64_t *sizes = imageTake(reader, 3 * sizeof(uint64_t));
+   if (!sizes || sizes[0] > FACET_MAX_GENRES || sizes[1] > UINT32_MAX || sizes[2] != (uint64_t)catalog->count)
+   {
+      return 0;
+   }
+   int genreCount = (int)sizes[0];
+   size_t namesSize = (size_t)sizes[1];
+   const uint32_t *nameAt = imageTake(reader, sizeof(index->nameAt));
+   const char *names = imageTake(reader, namesSize);
+   const uint64_t *genres = imageTake(reader, (size_t)catalog->count * sizeof(uint64_t));
+   int named = genreCount < FACET_OTHER_GENRE ? genreCount : FACET_OTHER_GENRE;
+   int ok = nameAt && names && genres && (namesSize == 0 || names[namesSize - 1] == '\0');
+   for (int id = 0; ok && id < named; id++)
+   {
+      ok = nameAt[id] < namesSize;
+   }
+   for (int row = 0; ok && row < catalog->count; row++)
+   {
+      ok = genreCount == 64 || (genres[row] >> genreCount) == 0;
+   }
+   if (!ok)
+   {
+      return 0;
+   }
+
+   index->names = malloc(namesSize ? namesSize : 1);
+   if (!index->names || !reserveRows(index, catalog->count))
+   {
+      fprintf(stderr, "Error: Memory allocation for facet index failed.\n");
+      facetIndexFree(index);
+      return 0;
+   }
+   memcpy(index->names, names, namesSize);
+   memcpy(index->nameAt, nameAt, sizeof(index->nameAt));
+   index->namesSize = index->namesCapacity = namesSize;
+   index->genreCount = genreCount;
+   for (int id = 0; id < named; id++)
+   {
+      const char *name = index->names + index->nameAt[id];
+      int slot = findGenreSlot(index, name, (int)strlen(name));
+      if (index->slots[slot] != 0)
+      {
+         facetIndexFree(index);
+         return 0;
+      }
+      index->slots[slot] = (int8_t)(id + 1);
+   }
+
+   memcpy(index->genres, genres, (size_t)catalog->count * sizeof(uint64_t));
+   index->count = catalog->count;
+   for (int row = 0; row < catalog->count; row++)
+   {
+      const BookRecord *book = &catalog->books[row];
+      if (book->flags & BOOK_DELETED)
+      {
+         continue;
+      }
+      uint64_t bit = (uint64_t)1 << (row & 63);
+      index->live[row / 64] |= bit;
+      int counted = countRow(index, book->year, genres[row], 0, 1);
+      if (counted && (book->flags & BOOK_BORROWED))
+      {
+         index->borrowed[row / 64] |= bit;
+         counted = countRow(index, book->year, genres[row], 1, 1);
+      }
+      if (!counted)
+      {
+         facetIndexFree(index);
+         return 0;
+      }
+   }
+   return 1;
+}
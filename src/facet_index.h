@@ -0,0 +1,106 @@
+#ifndef FACET_INDEX_H
+#define FACET_INDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+struct Catalog;
+struct ImageReader;
+
+// Genres told apart; the genres met after the first FACET_MAX_GENRES - 1 all share the last id
+#define FACET_MAX_GENRES 64
+#define FACET_OTHER_GENRE (FACET_MAX_GENRES - 1)
+
+// Decades a report can list: all those of the years checkBook accepts (-9999 to 2025)
+#define FACET_MAX_DECADES 1204
+
+// Values of FacetFilter.borrowed
+#define FACET_ANY -1
+#define FACET_ON_SHELF 0
+#define FACET_BORROWED 1
+
+//====== FACET INDEX STRUCTURE DEFINITION ======
+/*
+    FacetIndex structure:
+    - Genres interned into small ids: each name of a row's comma-separated genre field (trimmed, compared
+      without case) gets the next id the first time it is seen, and every row keeps the set of its ids as a
+      64-bit mask.
+    - Bitmaps of the live (not deleted) and of the borrowed rows, one bit per row.
+    - Counters of live and borrowed books per genre and per decade, kept in step by insertBook, removeBook,
+      lendCopy and returnCopy, so the totals are read without looking at any row.
+    - A filtered report ANDs the bitmaps 64 rows at a time and the genre masks with the filter, and only
+      visits the rows left.
+*/
+typedef struct
+{
+   int32_t decade; // First year of the decade, such as 1990
+   int books;      // Live books published in it
+   int borrowed;   // Of those, the borrowed ones
+} DecadeCount;
+
+typedef struct
+{
+   char *names;                         // Genre names as first seen, each followed by '\0'
+   uint32_t nameAt[FACET_MAX_GENRES];   // Offset of each genre's name in names
+   size_t namesSize;                    // Bytes used in names
+   size_t namesCapacity;                // Bytes allocated for names
+   int genreCount;                      // Ids given out, at most FACET_MAX_GENRES
+   int8_t slots[2 * FACET_MAX_GENRES];  // Hash table of genre names, id + 1 per slot, 0 if empty
+   uint64_t *genres;                    // Genre ids of each row, one bit per id
+   uint64_t *live;                      // Bit per row, set unless the book was deleted
+   uint64_t *borrowed;                  // Bit per row, set while the book is borrowed
+   int count;                           // Number of rows
+   int capacity;                        // Allocated rows, a multiple of 64
+   int books;                           // Live books
+   int borrowedBooks;                   // Borrowed books
+   int genreBooks[FACET_MAX_GENRES];    // Live books per genre id
+   int genreBorrowed[FACET_MAX_GENRES]; // Borrowed books per genre id
+   DecadeCount *decades;                // Counters per decade, ascending, decades without books included
+   int decadeCount;                     // Number of decades
+   int decadeCapacity;                  // Allocated decades
+} FacetIndex;
+
+//====== FACET FILTER STRUCTURE DEFINITION ======
+/*
+    FacetFilter structure:
+    - Narrows a report to the books that have every genre of a mask, were published in a year range and
+      are borrowed or on the shelf.
+*/
+typedef struct
+{
+   uint64_t genres; // Genre ids a book must all have, 0 for any
+   int firstYear;   // Earliest publication year, INT32_MIN for any
+   int lastYear;    // Latest publication year, INT32_MAX for any
+   int borrowed;    // FACET_ANY, FACET_ON_SHELF or FACET_BORROWED
+} FacetFilter;
+
+//====== FACET COUNTS STRUCTURE DEFINITION ======
+/*
+    FacetCounts structure:
+    - A report: the books matching a filter, split by genre id and by decade.
+*/
+typedef struct
+{
+   int books;                           // Matching books
+   int borrowed;                        // Of those, the borrowed ones
+   int genreBooks[FACET_MAX_GENRES];    // Matching books per genre id
+   int genreBorrowed[FACET_MAX_GENRES]; // Matching borrowed books per genre id
+   DecadeCount *decades;                // Decades with matching books, ascending (caller's buffer)
+   int decadeCount;                     // Number of decades stored in decades
+} FacetCounts;
+
+int facetIndexBuild(FacetIndex *index, const struct Catalog *catalog);
+int facetIndexAdd(FacetIndex *index, const struct Catalog *catalog, int row);
+void facetIndexRemove(FacetIndex *index, const struct Catalog *catalog, int row);
+void facetIndexSetBorrowed(FacetIndex *index, const struct Catalog *catalog, int row, int borrowed);
+int facetIndexGenre(const FacetIndex *index, const char *name, int length);
+const char *facetIndexGenreName(const FacetIndex *index, int id);
+void facetIndexCount(const FacetIndex *index, const struct Catalog *catalog, const FacetFilter *filter,
+                     FacetCounts *counts, DecadeCount *decades, int maxDecades);
+int facetCountsGenres(const FacetCounts *counts, int *ids);
+void facetIndexFree(FacetIndex *index);
+int facetIndexWrite(const FacetIndex *index, FILE *file);
+int facetIndexRead(FacetIndex *index, struct ImageReader *reader, const struct Catalog *catalog);
+
+#endif
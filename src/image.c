@@ -0,0 +1,396 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "catalog.h"
+#include "image.h"
+#include "stats.h"
+
+// Section ids, in file order
+#define SECTION_RECORDS 1
+#define SECTION_ISBN_INDEX 2
+#define SECTION_TOKEN_INDEX 3
+#define SECTION_TRIGRAM_INDEX 4
+#define SECTION_SCAN_COLUMNS 5
+#define SECTION_LOANS 6
+#define SECTION_COMPLETIONS 7
+#define SECTION_FACETS 8
+#define SECTION_COUNT 8
+
+//====== IMAGE HEADER STRUCTURE DEFINITION ======
+/*
+    ImageHeader structure:
+    - Start of "books.db.image", a binary copy of everything loadDatabase computes from "books.db".
+    - Names the exact books.db file it was made from (inode, size and modification time); the
+      record table points into that file's bytes, which act as the string heap.
+    - The checksum covers every byte after the header.
+    - The header is followed by SECTION_COUNT sections, each a SectionHeader and its payload.
+*/
+typedef struct
+{
+   char magic[8];           // "LIBIMAGE"
+   uint32_t version;        // IMAGE_VERSION
+   uint32_t byteOrder;      // 0x01020304 as written by the machine that made the image
+   uint32_t recordSize;     // sizeof(BookRecord)
+   int32_t count;           // Number of rows
+   uint64_t textInode;      // books.db the image belongs to
+   uint64_t textSize;
+   int64_t textModified;    // Seconds
+   int64_t textModifiedNs;  // Nanoseconds
+   uint64_t checksum;       // Checksum of the bytes after the header
+} ImageHeader;
+
+typedef struct
+{
+   uint32_t id;   // SECTION_*
+   uint32_t zero; // Padding
+   uint64_t size; // Payload size in bytes (a multiple of 8)
+} SectionHeader;
+
+//====== CHECKSUM FUNCTION ======
+/*
+    checksum function:
+    - 64-bit FNV-1a style hash taken over 8-byte words, so checking a large image stays cheap.
+*/
+static uint64_t checksum(const char *data, size_t size)
+{
+   uint64_t hash = 14695981039346656037ull;
+   size_t i = 0;
+   for (; i + 8 <= size; i += 8)
+   {
+      uint64_t word;
+      memcpy(&word, data + i, 8);
+      hash = (hash ^ word) * 1099511628211ull;
+   }
+   for (; i < size; i++)
+   {
+      hash = (hash ^ (unsigned char)data[i]) * 1099511628211ull;
+   }
+   return hash;
+}
+
+//====== IMAGE PAD FUNCTION ======
+/*
+    imagePad function:
+    - Pads a value of size bytes that was just written to an image section to a multiple of 8 bytes.
+    - Returns 1 on success, 0 on write failure.
+*/
+int imagePad(FILE *file, size_t size)
+{
+   static const char padding[8] = {0};
+   size_t pad = (8 - size % 8) % 8;
+   return pad == 0 || fwrite(padding, 1, pad, file) == pad;
+}
+
+//====== IMAGE PUT FUNCTION ======
+/*
+    imagePut function:
+    - Writes a value to an image section, padded to a multiple of 8 bytes.
+    - Returns 1 on success, 0 on write failure.
+*/
+int imagePut(FILE *file, const void *data, size_t size)
+{
+   return (size == 0 || fwrite(data, 1, size, file) == size) && imagePad(file, size);
+}
+
+//====== IMAGE TAKE FUNCTION ======
+/*
+    imageTake function:
+    - Returns the next value of size bytes in a section and moves past its padding.
+    - Returns NULL (and marks the reader failed) if the section is too short.
+*/
+const void *imageTake(ImageReader *reader, size_t size)
+{
+   size_t padded = size + (8 - size % 8) % 8;
+   if (reader->failed || padded < size || reader->size - reader->pos < padded)
+   {
+      reader->failed = 1;
+      return NULL;
+   }
+   const void *value = reader->data + reader->pos;
+   reader->pos += padded;
+   return value;
+}
+
+//====== IMAGE ENABLED FUNCTION ======
+/*
+    imageEnabled function:
+    - Images are written and used unless the LIBRARY_IMAGE environment variable is set to 0.
+*/
+int imageEnabled(void)
+{
+   const char *setting = getenv("LIBRARY_IMAGE");
+   return !setting || strcmp(setting, "0") != 0;
+}
+
+//====== WRITE SECTION FUNCTION ======
+/*
+    writeSection function:
+    - Writes a section header, lets the writer fill the payload, then goes back to store its size.
+    - Returns 1 on success, 0 on write failure.
+*/
+static int writeSection(FILE *file, uint32_t id, const Catalog *catalog, const BookRecord *records,
+                        int (*writer)(FILE *, const Catalog *, const BookRecord *))
+{
+   SectionHeader section = {id, 0, 0};
+   long start = ftell(file);
+   if (start < 0 || fwrite(&section, sizeof(section), 1, file) != 1 || !writer(file, catalog, records))
+   {
+      return 0;
+   }
+   long end = ftell(file);
+   section.size = (uint64_t)(end - start) - sizeof(section);
+   return end >= 0 && fseek(file, start, SEEK_SET) == 0 && fwrite(&section, sizeof(section), 1, file) == 1 &&
+          fseek(file, end, SEEK_SET) == 0;
+}
+
+//====== SECTION WRITERS ======
+/*
+    writeRecords, writeIsbn, writeTokens, writeTrigrams, writeColumns, writeLoans, writeCompletions,
+    writeFacets functions:
+    - Write the payload of one section; the indexes serialize themselves.
+*/
+static int writeRecords(FILE *file, const Catalog *catalog, const BookRecord *records)
+{
+   return imagePut(file, records, (size_t)catalog->count * sizeof(BookRecord));
+}
+
+static int writeIsbn(FILE *file, const Catalog *catalog, const BookRecord *records)
+{
+   (void)records;
+   return isbnIndexWrite(&catalog->isbnIndex, file);
+}
+
+static int writeTokens(FILE *file, const Catalog *catalog, const BookRecord *records)
+{
+   (void)records;
+   return tokenIndexWrite(&catalog->tokenIndex, file);
+}
+
+static int writeTrigrams(FILE *file, const Catalog *catalog, const BookRecord *records)
+{
+   (void)records;
+   return trigramIndexWrite(&catalog->trigramIndex, file);
+}
+
+static int writeColumns(FILE *file, const Catalog *catalog, const BookRecord *records)
+{
+   (void)records;
+   return scanColumnsWrite(&catalog->columns, file);
+}
+
+static int writeLoans(FILE *file, const Catalog *catalog, const BookRecord *records)
+{
+   (void)records;
+   return loanTableWrite(&catalog->loans, file);
+}
+
+static int writeCompletions(FILE *file, const Catalog *catalog, const BookRecord *records)
+{
+   (void)records;
+   return completionIndexWrite(&catalog->completions, file);
+}
+
+static int writeFacets(FILE *file, const Catalog *catalog, const BookRecord *records)
+{
+   (void)records;
+   return facetIndexWrite(&catalog->facets, file);
+}
+
+//====== IMAGE WRITE FUNCTION ======
+/*
+    imageWrite function:
+    - Writes the image of a catalog whose rows are stored in the text file described by text.
+    - records are the rows as they point into that file; the indexes are taken from the catalog.
+    - Writes to "<path>.tmp" first and renames it over path once complete.
+    - Returns 1 on success, 0 on failure (no image is left behind).
+*/
+int imageWrite(const char *path, const Catalog *catalog, const BookRecord *records, const struct stat *text)
+{
+   STATS_START(statStart);
+   char temp[300];
+   snprintf(temp, sizeof(temp), "%s.tmp", path);
+   FILE *file = fopen(temp, "w+");
+   if (!file)
+   {
+      fprintf(stderr, "Error: Unable to create %s.\n", temp);
+      return 0;
+   }
+
+   ImageHeader header;
+   memset(&header, 0, sizeof(header));
+   memcpy(header.magic, "LIBIMAGE", 8);
+   header.version = IMAGE_VERSION;
+   header.byteOrder = 0x01020304u;
+   header.recordSize = sizeof(BookRecord);
+   header.count = catalog->count;
+   header.textInode = (uint64_t)text->st_ino;
+   header.textSize = (uint64_t)text->st_size;
+   header.textModified = (int64_t)text->st_mtim.tv_sec;
+   header.textModifiedNs = (int64_t)text->st_mtim.tv_nsec;
+
+   int ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+            writeSection(file, SECTION_RECORDS, catalog, records, writeRecords) &&
+            writeSection(file, SECTION_ISBN_INDEX, catalog, records, writeIsbn) &&
+            writeSection(file, SECTION_TOKEN_INDEX, catalog, records, writeTokens) &&
+            writeSection(file, SECTION_TRIGRAM_INDEX, catalog, records, writeTrigrams) &&
+            writeSection(file, SECTION_SCAN_COLUMNS, catalog, records, writeColumns) &&
+            writeSection(file, SECTION_LOANS, catalog, records, writeLoans) &&
+            writeSection(file, SECTION_COMPLETIONS, catalog, records, writeCompletions) &&
+            writeSection(file, SECTION_FACETS, catalog, records, writeFacets) && fflush(file) == 0;
+
+   // Checksum what was written and store it in the header
+   long size = 0;
+   if (ok)
+   {
+      size = ftell(file);
+      char *body = size > (long)sizeof(header) ? mmap(NULL, (size_t)size, PROT_READ, MAP_SHARED, fileno(file), 0) : MAP_FAILED;
+      ok = body != MAP_FAILED;
+      if (ok)
+      {
+         header.checksum = checksum(body + sizeof(header), (size_t)size - sizeof(header));
+         munmap(body, (size_t)size);
+         ok = fseek(file, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, file) == 1;
+      }
+   }
+
+   if (fclose(file) != 0 || !ok || rename(temp, path) != 0)
+   {
+      fprintf(stderr, "Error: Unable to write %s.\n", path);
+      unlink(temp);
+      return 0;
+   }
+   STATS_STOP(STAT_IMAGE_WRITE, statStart);
+   STATS_ADD(STAT_BYTES_WRITTEN, size);
+   return 1;
+}
+
+//====== IMAGE LOAD FUNCTION ======
+/*
+    imageLoad function:
+    - Loads the rows and prebuilt indexes from the image at path instead of parsing books.db.
+    - The catalog must already hold the mapped books.db described by text; the image is only used if it
+      was made from exactly that file and passes the version and checksum checks.
+    - Returns 1 if the catalog was loaded from the image, 0 if the text has to be parsed instead.
+*/
+int imageLoad(Catalog *catalog, const char *path, const struct stat *text)
+{
+   STATS_START(statStart);
+   int fd = open(path, O_RDONLY);
+   if (fd < 0)
+   {
+      return 0;
+   }
+   struct stat st;
+   if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(ImageHeader))
+   {
+      close(fd);
+      return 0;
+   }
+   size_t size = (size_t)st.st_size;
+   const char *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+   close(fd);
+   if (data == MAP_FAILED)
+   {
+      return 0;
+   }
+
+   // Only an image of this very books.db, written by this build, is usable
+   ImageHeader header;
+   memcpy(&header, data, sizeof(header));
+   int ok = memcmp(header.magic, "LIBIMAGE", 8) == 0 && header.version == IMAGE_VERSION &&
+            header.byteOrder == 0x01020304u && header.recordSize == sizeof(BookRecord) && header.count >= 0 &&
+            header.textInode == (uint64_t)text->st_ino && header.textSize == (uint64_t)text->st_size &&
+            header.textModified == (int64_t)text->st_mtim.tv_sec &&
+            header.textModifiedNs == (int64_t)text->st_mtim.tv_nsec &&
+            header.checksum == checksum(data + sizeof(header), size - sizeof(header));
+
+   // Restore every section
+   size_t pos = sizeof(header);
+   for (uint32_t id = 1; ok && id <= SECTION_COUNT; id++)
+   {
+      SectionHeader section;
+      ok = size - pos >= sizeof(section);
+      if (!ok)
+      {
+         break;
+      }
+      memcpy(&section, data + pos, sizeof(section));
+      pos += sizeof(section);
+      ok = section.id == id && section.size <= size - pos;
+      if (!ok)
+      {
+         break;
+      }
+
+      ImageReader reader = {data + pos, (size_t)section.size, 0, 0};
+      switch (id)
+      {
+      case SECTION_RECORDS:
+      {
+         // The header gives the exact row count, so the rows take a single allocation
+         const BookRecord *records = imageTake(&reader, (size_t)header.count * sizeof(BookRecord));
+         ok = records && reserveBooks(catalog, header.count > 0 ? header.count : 1);
+         if (ok)
+         {
+            memcpy(catalog->books, records, (size_t)header.count * sizeof(BookRecord));
+            catalog->count = header.count;
+         }
+         break;
+      }
+      case SECTION_ISBN_INDEX:
+         ok = isbnIndexRead(&catalog->isbnIndex, &reader);
+         break;
+      case SECTION_TOKEN_INDEX:
+         ok = tokenIndexRead(&catalog->tokenIndex, &reader);
+         break;
+      case SECTION_TRIGRAM_INDEX:
+         ok = trigramIndexRead(&catalog->trigramIndex, &reader);
+         break;
+      case SECTION_SCAN_COLUMNS:
+         ok = scanColumnsRead(&catalog->columns, &reader) && catalog->columns.count == catalog->count;
+         break;
+      case SECTION_LOANS:
+         ok = loanTableRead(&catalog->loans, &reader, catalog->count);
+         for (int row = 0; ok && row < catalog->count; row++)
+         {
+            ok = catalog->books[row].loans >= 0 && catalog->books[row].loans <= catalog->loans.entryCount;
+         }
+         break;
+      case SECTION_COMPLETIONS:
+         ok = completionIndexRead(&catalog->completions, &reader);
+         break;
+      case SECTION_FACETS:
+         ok = facetIndexRead(&catalog->facets, &reader, catalog);
+         break;
+      }
+      pos += (size_t)section.size;
+   }
+   munmap((void *)data, size);
+
+   if (!ok)
+   {
+      // Leave the catalog as it was, ready for parsing
+      free(catalog->books);
+      catalog->books = NULL;
+      catalog->count = 0;
+      catalog->capacity = 0;
+      isbnIndexFree(&catalog->isbnIndex);
+      tokenIndexFree(&catalog->tokenIndex);
+      trigramIndexFree(&catalog->trigramIndex);
+      scanColumnsFree(&catalog->columns);
+      loanTableFree(&catalog->loans);
+      completionIndexFree(&catalog->completions);
+      facetIndexFree(&catalog->facets);
+      fprintf(stderr, "Warning: Ignoring %s, it does not match books.db.\n", path);
+   }
+   else
+   {
+      STATS_STOP(STAT_IMAGE_LOAD, statStart);
+   }
+   return ok;
+}
@@ -0,0 +1,38 @@
+#ifndef IMAGE_H
+#define IMAGE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/stat.h>
+
+#include "db.h"
+
+struct Catalog;
+
+// Bump whenever the layout of the image or of any section changes
+#define IMAGE_VERSION 7
+
+//====== IMAGE READER STRUCTURE DEFINITION ======
+/*
+    ImageReader structure:
+    - Walks through one section of a mapped image; every read is bounds-checked.
+    - Values are stored 8-byte aligned, as written by imagePut.
+*/
+typedef struct ImageReader
+{
+   const char *data; // Start of the section
+   size_t size;      // Size of the section in bytes
+   size_t pos;       // Offset of the next value
+   int failed;       // 1 once a read ran past the end of the section
+} ImageReader;
+
+int imagePad(FILE *file, size_t size);
+int imagePut(FILE *file, const void *data, size_t size);
+const void *imageTake(ImageReader *reader, size_t size);
+
+int imageEnabled(void);
+int imageWrite(const char *path, const struct Catalog *catalog, const BookRecord *records, const struct stat *text);
+int imageLoad(struct Catalog *catalog, const char *path, const struct stat *text);
+
+#endif
@@ -0,0 +1,377 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "catalog.h"
+#include "image.h"
+#include "isbn_index.h"
+#include "stats.h"
+
+//====== HASH ISBN FUNCTION ======
+/*
+    hashIsbn function:
+    - Computes a 32-bit FNV-1a hash of the first length characters of an ISBN.
+*/
+static unsigned int hashIsbn(const char *isbn, int length)
+{
+   unsigned int hash = 2166136261u;
+   for (int i = 0; i < length; i++)
+   {
+      hash ^= (unsigned char)isbn[i];
+      hash *= 16777619u;
+   }
+   return hash;
+}
+
+//====== HASH ROW FUNCTION ======
+/*
+    hashRow function:
+    - Hashes the ISBN of the book at the given row.
+*/
+static unsigned int hashRow(const Catalog *catalog, int row)
+{
+   StringView isbn = bookIsbn(catalog, row);
+   return hashIsbn(isbn.data, isbn.length);
+}
+
+//====== SAME ISBN FUNCTION ======
+/*
+    sameIsbn function:
+    - Returns 1 if the books at both rows have the same ISBN.
+*/
+static int sameIsbn(const Catalog *catalog, int row, int other)
+{
+   StringView a = bookIsbn(catalog, row);
+   StringView b = bookIsbn(catalog, other);
+   return a.length == b.length && memcmp(a.data, b.data, a.length) == 0;
+}
+
+//====== PLACE SLOT FUNCTION ======
+/*
+    placeSlot function:
+    - Puts a hash/row pair into the first free slot of its probe sequence.
+    - Does not check for duplicates, callers make sure the ISBN is not present yet.
+*/
+static void placeSlot(IsbnIndex *index, unsigned int hash, int row)
+{
+   unsigned int mask = index->capacity - 1;
+   unsigned int pos = hash & mask;
+   while (index->slots[pos].row != -1)
+   {
+      pos = (pos + 1) & mask;
+   }
+   index->slots[pos].hash = hash;
+   index->slots[pos].row = row;
+   index->count++;
+}
+
+//====== RESIZE INDEX FUNCTION ======
+/*
+    resizeIndex function:
+    - Allocates a new slot table with the given capacity (a power of two) and rehashes all entries.
+    - Returns 1 on success, 0 on memory allocation failure (the old table is kept).
+*/
+static int resizeIndex(IsbnIndex *index, unsigned int capacity)
+{
+   IsbnSlot *slots = malloc(capacity * sizeof(IsbnSlot));
+   if (!slots)
+   {
+      fprintf(stderr, "Error: Memory allocation for ISBN index failed.\n");
+      return 0;
+   }
+   for (unsigned int i = 0; i < capacity; i++)
+   {
+      slots[i].row = -1;
+   }
+
+   IsbnSlot *oldSlots = index->slots;
+   unsigned int oldCapacity = index->capacity;
+   index->slots = slots;
+   index->capacity = capacity;
+   index->count = 0;
+
+   for (unsigned int i = 0; i < oldCapacity; i++)
+   {
+      if (oldSlots[i].row != -1)
+      {
+         placeSlot(index, oldSlots[i].hash, oldSlots[i].row);
+      }
+   }
+   free(oldSlots);
+   STATS_ADD(STAT_REALLOCS, 1);
+   return 1;
+}
+
+//====== BUILD ISBN INDEX FUNCTION ======
+/*
+    isbnIndexBuild function:
+    - Builds the index over all rows of the catalog, sized to keep the load factor under 1/2.
+    - When an ISBN appears more than once, the first row is indexed.
+    - Returns 1 on success, 0 on memory allocation failure.
+*/
+int isbnIndexBuild(IsbnIndex *index, const Catalog *catalog)
+{
+   unsigned int capacity = 16;
+   while (capacity < 2u * (unsigned int)catalog->count)
+   {
+      capacity *= 2;
+   }
+
+   index->slots = NULL;
+   index->capacity = 0;
+   index->count = 0;
+   index->shadowed = NULL;
+   index->shadowedCount = 0;
+   index->shadowedCapacity = 0;
+   if (!resizeIndex(index, capacity))
+   {
+      return 0;
+   }
+
+   for (int i = 0; i < catalog->count; i++)
+   {
+      if (!isbnIndexInsert(index, catalog, i))
+      {
+         return 0;
+      }
+   }
+   return 1;
+}
+
+//====== FIND BY ISBN FUNCTION ======
+/*
+    isbnIndexFind function:
+    - Looks up an ISBN in the index.
+    - Returns the row number of the first book with that ISBN, or -1 if it is not in the catalog.
+*/
+int isbnIndexFind(const IsbnIndex *index, const Catalog *catalog, const char *isbn)
+{
+   if (index->capacity == 0)
+   {
+      return -1;
+   }
+
+   unsigned int hash = hashIsbn(isbn, (int)strlen(isbn));
+   unsigned int mask = index->capacity - 1;
+   unsigned int pos = hash & mask;
+   while (index->slots[pos].row != -1)
+   {
+      if (index->slots[pos].hash == hash && isbnEquals(catalog, index->slots[pos].row, isbn))
+      {
+         return index->slots[pos].row;
+      }
+      pos = (pos + 1) & mask;
+   }
+   return -1;
+}
+
+//====== INSERT INTO ISBN INDEX FUNCTION ======
+/*
+    isbnIndexInsert function:
+    - Adds the book at the given row to the index, growing the table if needed.
+    - Leaves the slots unchanged if the ISBN is already indexed by another row, and keeps the row in the
+      shadowed list instead.
+    - Returns 1 on success, 0 on memory allocation failure.
+*/
+int isbnIndexInsert(IsbnIndex *index, const Catalog *catalog, int row)
+{
+   unsigned int hash = hashRow(catalog, row);
+   if (index->capacity > 0)
+   {
+      // Keep the earlier row if the ISBN is already indexed
+      unsigned int mask = index->capacity - 1;
+      for (unsigned int pos = hash & mask; index->slots[pos].row != -1; pos = (pos + 1) & mask)
+      {
+         if (index->slots[pos].hash == hash && sameIsbn(catalog, index->slots[pos].row, row))
+         {
+            if (index->shadowedCount == index->shadowedCapacity)
+            {
+               int capacity = index->shadowedCapacity ? index->shadowedCapacity * 2 : 16;
+               int *shadowed = realloc(index->shadowed, capacity * sizeof(int));
+               if (!shadowed)
+               {
+                  fprintf(stderr, "Error: Memory allocation for ISBN index failed.\n");
+                  return 0;
+               }
+               index->shadowed = shadowed;
+               index->shadowedCapacity = capacity;
+               STATS_ADD(STAT_REALLOCS, 1);
+            }
+            index->shadowed[index->shadowedCount++] = row;
+            return 1;
+         }
+      }
+   }
+   if ((unsigned int)(index->count + 1) * 2 > index->capacity)
+   {
+      if (!resizeIndex(index, index->capacity ? index->capacity * 2 : 16))
+      {
+         return 0;
+      }
+   }
+   placeSlot(index, hash, row);
+   return 1;
+}
+
+//====== REMOVE FROM ISBN INDEX FUNCTION ======
+/*
+    isbnIndexRemove function:
+    - Must be called before the row becomes a tombstone.
+    - Drops the row's slot (backward-shift deletion, so no tombstones are left behind in the table).
+    - If a shadowed row has the same ISBN, it becomes the indexed one; only the shadowed list is
+      searched for it, so a delete does not depend on the catalog size.
+*/
+void isbnIndexRemove(IsbnIndex *index, const Catalog *catalog, int row)
+{
+   if (index->capacity == 0)
+   {
+      return;
+   }
+
+   unsigned int hash = hashRow(catalog, row);
+   unsigned int mask = index->capacity - 1;
+   unsigned int pos = hash & mask;
+   int wasIndexed = 0;
+
+   // Find the slot of this row
+   while (index->slots[pos].row != -1)
+   {
+      if (index->slots[pos].row == row)
+      {
+         wasIndexed = 1;
+         break;
+      }
+      pos = (pos + 1) & mask;
+   }
+
+   // Close the gap by moving later entries of the cluster back
+   if (wasIndexed)
+   {
+      unsigned int hole = pos;
+      unsigned int next = pos;
+      while (1)
+      {
+         next = (next + 1) & mask;
+         if (index->slots[next].row == -1)
+         {
+            break;
+         }
+         unsigned int home = index->slots[next].hash & mask;
+         int stays = (hole <= next) ? (hole < home && home <= next) : (hole < home || home <= next);
+         if (!stays)
+         {
+            index->slots[hole] = index->slots[next];
+            hole = next;
+         }
+      }
+      index->slots[hole].row = -1;
+      index->count--;
+   }
+
+   // Promote the first duplicate of the removed ISBN, if any
+   if (wasIndexed)
+   {
+      int first = -1;
+      for (int i = 0; i < index->shadowedCount; i++)
+      {
+         if (sameIsbn(catalog, index->shadowed[i], row) && (first < 0 || index->shadowed[i] < index->shadowed[first]))
+         {
+            first = i;
+         }
+      }
+      if (first >= 0)
+      {
+         placeSlot(index, hash, index->shadowed[first]);
+         index->shadowed[first] = index->shadowed[--index->shadowedCount];
+      }
+   }
+   else
+   {
+      // A shadowed row is simply forgotten
+      for (int i = 0; i < index->shadowedCount; i++)
+      {
+         if (index->shadowed[i] == row)
+         {
+            index->shadowed[i] = index->shadowed[--index->shadowedCount];
+            break;
+         }
+      }
+   }
+}
+
+//====== FREE ISBN INDEX FUNCTION ======
+/*
+    isbnIndexFree function:
+    - Releases the slot table and the shadowed list.
+*/
+void isbnIndexFree(IsbnIndex *index)
+{
+   free(index->slots);
+   free(index->shadowed);
+   index->slots = NULL;
+   index->capacity = 0;
+   index->count = 0;
+   index->shadowed = NULL;
+   index->shadowedCount = 0;
+   index->shadowedCapacity = 0;
+}
+
+//====== WRITE ISBN INDEX FUNCTION ======
+/*
+    isbnIndexWrite function:
+    - Writes the slot table and the shadowed list to a binary image section.
+    - Returns 1 on success, 0 on write failure.
+*/
+int isbnIndexWrite(const IsbnIndex *index, FILE *file)
+{
+   uint32_t sizes[3] = {index->capacity, (uint32_t)index->count, (uint32_t)index->shadowedCount};
+   return imagePut(file, sizes, sizeof(sizes)) && imagePut(file, index->slots, index->capacity * sizeof(IsbnSlot)) &&
+          imagePut(file, index->shadowed, index->shadowedCount * sizeof(int));
+}
+
+//====== READ ISBN INDEX FUNCTION ======
+/*
+    isbnIndexRead function:
+    - Restores a slot table and shadowed list written by isbnIndexWrite into fresh allocations.
+    - Returns 1 on success, 0 if the section is malformed or allocation fails.
+*/
+int isbnIndexRead(IsbnIndex *index, ImageReader *reader)
+{
+   memset(index, 0, sizeof(*index));
+   const uint32_t *sizes = imageTake(reader, 3 * sizeof(uint32_t));
+   if (!sizes || (sizes[0] & (sizes[0] - 1)) != 0 || sizes[1] > sizes[0])
+   {
+      return 0;
+   }
+   const IsbnSlot *slots = imageTake(reader, sizes[0] * sizeof(IsbnSlot));
+   const int *shadowed = imageTake(reader, sizes[2] * sizeof(int));
+   if (!slots || !shadowed)
+   {
+      return 0;
+   }
+   if (sizes[0] > 0)
+   {
+      index->slots = malloc(sizes[0] * sizeof(IsbnSlot));
+      if (!index->slots)
+      {
+         fprintf(stderr, "Error: Memory allocation for ISBN index failed.\n");
+         return 0;
+      }
+      memcpy(index->slots, slots, sizes[0] * sizeof(IsbnSlot));
+   }
+   index->capacity = sizes[0];
+   index->count = (int)sizes[1];
+   if (sizes[2] > 0)
+   {
+      index->shadowed = malloc(sizes[2] * sizeof(int));
+      if (!index->shadowed)
+      {
+         fprintf(stderr, "Error: Memory allocation for ISBN index failed.\n");
+         return 0;
+      }
+      memcpy(index->shadowed, shadowed, sizes[2] * sizeof(int));
+   }
+   index->shadowedCount = (int)sizes[2];
+   index->shadowedCapacity = (int)sizes[2];
+   return 1;
+}
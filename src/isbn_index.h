@@ -0,0 +1,41 @@
+#ifndef ISBN_INDEX_H
+#define ISBN_INDEX_H
+
+#include <stdio.h>
+
+struct Catalog;
+struct ImageReader;
+
+//====== ISBN INDEX STRUCTURE DEFINITION ======
+/*
+    IsbnIndex structure:
+    - Open-addressing (linear probing) hash table from ISBN to row number in the catalog.
+    - Each slot keeps the ISBN hash next to the row so most probes never touch the catalog rows.
+    - Holds the first row for every ISBN; later rows with the same ISBN are kept in a shadowed list and
+      promoted when the indexed one is deleted.
+*/
+typedef struct
+{
+   unsigned int hash; // Hash of the ISBN stored in this slot
+   int row;           // Row number in the catalog, -1 if the slot is empty
+} IsbnSlot;
+
+typedef struct
+{
+   IsbnSlot *slots;       // Slot table, capacity is always a power of two
+   unsigned int capacity; // Number of slots
+   int count;             // Number of occupied slots
+   int *shadowed;         // Rows left out because their ISBN was already indexed
+   int shadowedCount;     // Number of shadowed rows
+   int shadowedCapacity;  // Allocated shadowed rows
+} IsbnIndex;
+
+int isbnIndexBuild(IsbnIndex *index, const struct Catalog *catalog);
+int isbnIndexFind(const IsbnIndex *index, const struct Catalog *catalog, const char *isbn);
+int isbnIndexInsert(IsbnIndex *index, const struct Catalog *catalog, int row);
+void isbnIndexRemove(IsbnIndex *index, const struct Catalog *catalog, int row);
+void isbnIndexFree(IsbnIndex *index);
+int isbnIndexWrite(const IsbnIndex *index, FILE *file);
+int isbnIndexRead(IsbnIndex *index, struct ImageReader *reader);
+
+#endif
@@ -0,0 +1,951 @@
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "catalog.h"
+#include "journal.h"
+#include "stats.h"
+#include "storage.h"
+
+//====== JOURNAL FILE NAME FUNCTION ======
+/*
+    journalFileName function:
+    - Builds the name of a file that lives next to the snapshot, e.g. "books.db.journal".
+*/
+static void journalFileName(char *out, size_t size, const char *path, const char *suffix)
+{
+   snprintf(out, size, "%s%s", path, suffix);
+}
+
+//====== SNAPSHOT ID FUNCTION ======
+/*
+    snapshotId function:
+    - Identifies a snapshot file by its inode number.
+    - Every compaction renames a freshly written file over the snapshot, so the id changes with it.
+    - Returns 0 if the file does not exist.
+*/
+static unsigned long snapshotId(const char *path)
+{
+   struct stat st;
+   if (stat(path, &st) != 0)
+   {
+      return 0;
+   }
+   return (unsigned long)st.st_ino;
+}
+
+//====== SPLIT RECORD FUNCTION ======
+/*
+    splitRecord function:
+    - Splits a journal line on '|' in place, keeping empty fields (unlike strtok).
+    - Returns the number of fields found (at most maxFields).
+*/
+static int splitRecord(char *line, char **fields, int maxFields)
+{
+   int count = 0;
+   char *start = line;
+   while (count < maxFields)
+   {
+      fields[count++] = start;
+      char *bar = strchr(start, '|');
+      if (!bar)
+      {
+         break;
+      }
+      *bar = '\0';
+      start = bar + 1;
+   }
+   return count;
+}
+
+//====== OPEN JOURNAL FILE FUNCTION ======
+/*
+    openJournalFile function:
+    - Opens a journal for reading and parses its header line ("JOURNAL|<snapshot id>").
+    - Returns the file positioned at the first record, or NULL if it is missing or has no valid header.
+*/
+static FILE *openJournalFile(const char *name, unsigned long *base)
+{
+   FILE *file = fopen(name, "r");
+   if (!file)
+   {
+      return NULL;
+   }
+
+   char header[64];
+   if (!fgets(header, sizeof(header), file) || sscanf(header, "JOURNAL|%lu", base) != 1)
+   {
+      fclose(file);
+      return NULL;
+   }
+   return file;
+}
+
+//====== APPLY RECORD FUNCTION ======
+/*
+    applyRecord function:
+    - Applies one journal record to the in-memory catalog.
+    - Delete, borrow and return records carry the row and ISBN they were made on; both must match,
+      and the row must not be a tombstone.
+    - A compaction record drops the tombstones, as the catalog did when it was written.
+    - Borrow and return records name the copy and patron; without them (journals from before copies
+      existed) they lend the first copy on the shelf to an unknown patron and return the only copy lent.
+    - Returns 1 on success, 0 if the record is malformed or does not match the catalog.
+*/
+static int applyRecord(char *line, Catalog *catalog)
+{
+   char *fields[9];
+   int count = splitRecord(line, fields, 9);
+
+   if (strcmp(fields[0], "C") == 0 && count == 1)
+   {
+      return compactCatalog(catalog);
+   }
+
+   if (strcmp(fields[0], "A") == 0 && (count == 8 || count == 9))
+   {
+      Database book;
+      snprintf(book.isbn, sizeof(book.isbn), "%s", fields[1]);
+      snprintf(book.nameBook, sizeof(book.nameBook), "%s", fields[2]);
+      snprintf(book.authors, sizeof(book.authors), "%s", fields[3]);
+      book.year = atoi(fields[4]);
+      snprintf(book.genre, sizeof(book.genre), "%s", fields[5]);
+      snprintf(book.borrowed, sizeof(book.borrowed), "%s", fields[6]);
+      snprintf(book.date, sizeof(book.date), "%s", fields[7]);
+      book.copies = count == 9 ? atoi(fields[8]) : 1;
+      return insertBook(catalog, &book);
+   }
+
+   if (count < 3)
+   {
+      return 0;
+   }
+   int row = atoi(fields[1]);
+   if (row < 0 || row >= catalog->count || isBookDeleted(catalog, row) || !isbnEquals(catalog, row, fields[2]))
+   {
+      return 0;
+   }
+
+   if (strcmp(fields[0], "D") == 0 && count == 3)
+   {
+      removeBook(catalog, row);
+      return 1;
+   }
+
+   int32_t day;
+   if (strcmp(fields[0], "B") == 0 && (count == 4 || count == 6) && parseDate(fields[3], (int)strlen(fields[3]), &day))
+   {
+      int copy = count == 6 ? atoi(fields[4]) : 0;
+      int32_t patron = count == 6 ? atoi(fields[5]) : LOAN_UNKNOWN_PATRON;
+      return lendCopy(catalog, row, copy, patron, day) != 0;
+   }
+   if (strcmp(fields[0], "R") == 0 && (count == 3 || count == 4))
+   {
+      return returnCopy(catalog, row, count == 4 ? atoi(fields[3]) : 0) != 0;
+   }
+   return 0;
+}
+
+//====== READ RECORD FUNCTION ======
+/*
+    readRecord function:
+    - Reads the next line of a journal into line without its newline.
+    - Returns 1 on success, 0 at the end of the file or if the last line has no newline (a write torn by a crash).
+*/
+static int readRecord(FILE *file, char *line, int size)
+{
+   if (!fgets(line, size, file))
+   {
+      return 0;
+   }
+   size_t length = strlen(line);
+   if (length == 0 || line[length - 1] != '\n')
+   {
+      return 0;
+   }
+   line[length - 1] = '\0';
+   return 1;
+}
+
+//====== REPLAY TRANSACTION FUNCTION ======
+/*
+    replayTransaction function:
+    - Applies the count records that follow a "T|count" line, all or none.
+    - The records are read in full before any is applied, so a transaction torn by a crash leaves the catalog untouched.
+    - Returns 1 if all records applied, 0 if one did not match the catalog, -1 if the transaction is incomplete.
+*/
+static int replayTransaction(FILE *file, const char *name, int count, int *lineNumber, Catalog *catalog)
+{
+   char(*lines)[1024] = malloc((count ? count : 1) * sizeof(*lines));
+   if (!lines)
+   {
+      fprintf(stderr, "Error: Memory allocation failed.\n");
+      return 0;
+   }
+
+   int read = 0;
+   while (read < count && readRecord(file, lines[read], sizeof(lines[read])))
+   {
+      read++;
+   }
+   if (read < count)
+   {
+      free(lines);
+      return -1;
+   }
+
+   for (int i = 0; i < count; i++)
+   {
+      (*lineNumber)++;
+      if (!applyRecord(lines[i], catalog))
+      {
+         fprintf(stderr, "Error: Journal record in %s line %d does not match the catalog.\n", name, *lineNumber);
+         free(lines);
+         return 0;
+      }
+   }
+   free(lines);
+   return 1;
+}
+
+//====== REPLAY RECORDS FUNCTION ======
+/*
+    replayRecords function:
+    - Applies every complete record of an open journal, in order.
+    - A last line without a newline is a write torn by a crash and is ignored, as is a transaction missing some of its records.
+    - Stores the length of the valid part of the file in validSize.
+    - Returns 1 if all records applied, 0 if replay stopped at a bad record.
+*/
+static int replayRecords(FILE *file, const char *name, long *validSize, Catalog *catalog)
+{
+   STATS_START(statStart);
+   char line[1024];
+   int lineNumber = 1;
+   *validSize = ftell(file);
+
+   while (!feof(file))
+   {
+      if (!readRecord(file, line, sizeof(line)))
+      {
+         if (ftell(file) != *validSize)
+         {
+            fprintf(stderr, "Warning: Ignoring incomplete record at the end of %s.\n", name);
+         }
+         break;
+      }
+      lineNumber++;
+
+      int count;
+      if (sscanf(line, "T|%d", &count) == 1 && count >= 0)
+      {
+         int applied = replayTransaction(file, name, count, &lineNumber, catalog);
+         if (applied < 0)
+         {
+            fprintf(stderr, "Warning: Ignoring incomplete transaction at the end of %s.\n", name);
+            break;
+         }
+         if (!applied)
+         {
+            return 0;
+         }
+      }
+      else if (!applyRecord(line, catalog))
+      {
+         fprintf(stderr, "Error: Journal record in %s line %d does not match the catalog.\n", name, lineNumber);
+         return 0;
+      }
+      *validSize = ftell(file);
+   }
+   STATS_STOP(STAT_REPLAY, statStart);
+   return 1;
+}
+
+//====== CREATE JOURNAL FUNCTION ======
+/*
+    createJournal function:
+    - Starts an empty journal whose records apply on top of the snapshot with the given id.
+    - Returns 1 on success, 0 if the file could not be created.
+*/
+static int createJournal(Journal *journal, unsigned long base)
+{
+   char name[300];
+   journalFileName(name, sizeof(name), journal->path, ".journal");
+
+   // Appends go to the end of the file whatever the stream's position
+   int fd = open(name, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+   journal->file = fd >= 0 ? fdopen(fd, "a") : NULL;
+   if (!journal->file)
+   {
+      fprintf(stderr, "Error: Unable to create %s.\n", name);
+      if (fd >= 0)
+      {
+         close(fd);
+      }
+      return 0;
+   }
+   fprintf(journal->file, "JOURNAL|%lu\n", base);
+   if (fflush(journal->file) != 0)
+   {
+      fprintf(stderr, "Error: Unable to write %s.\n", name);
+      return 0;
+   }
+   journal->size = ftell(journal->file);
+   return 1;
+}
+
+//====== APPEND RECORDS FUNCTION ======
+/*
+    appendRecords function:
+    - Copies the records (not the header) of one journal to the end of another, behind a "C" record,
+      as the catalog was compacted when the source journal was started.
+    - Used when a failed compaction left records behind that the next one must still cover.
+    - Returns 1 on success, 0 on I/O failure.
+*/
+static int appendRecords(const char *target, const char *source)
+{
+   FILE *in = fopen(source, "r");
+   if (!in)
+   {
+      return 1;
+   }
+   FILE *out = fopen(target, "a");
+   if (!out)
+   {
+      fclose(in);
+      return 0;
+   }
+
+   // The catalog dropped its tombstones when the source journal was started
+   fputs("C\n", out);
+
+   char line[1024];
+   int first = 1;
+   while (fgets(line, sizeof(line), in))
+   {
+      if (!first)
+      {
+         fputs(line, out);
+      }
+      first = 0;
+   }
+   fclose(in);
+   return fclose(out) == 0;
+}
+
+//====== WRITE SNAPSHOT FUNCTION ======
+/*
+    writeSnapshot function:
+    - Writes the catalog over the snapshot with saveDatabase, through the reserved temporary file
+      (written, fsynced, then renamed into place).
+    - Removes the old journal afterwards, as its records are now part of the snapshot.
+    - Reports how long each step took if log is set.
+    - Runs in the background compaction process or thread, or inline if neither could be started.
+    - Returns 1 on success, 0 on failure (the old snapshot and journal stay in place).
+*/
+static int writeSnapshot(const char *path, const Catalog *catalog, int log)
+{
+   char old[300];
+   journalFileName(old, sizeof(old), path, ".journal.old");
+
+   PersistTiming timing;
+   if (!saveDatabase(path, catalog, &timing))
+   {
+      return 0;
+   }
+   if (log)
+   {
+      fprintf(stderr, "Persist: snapshot %s of %d books in %.3f ms (write %.3f, fsync %.3f, rename %.3f)\n", path,
+              catalog->count, timing.writeMs + timing.syncMs + timing.renameMs, timing.writeMs, timing.syncMs, timing.renameMs);
+   }
+   unlink(old);
+   return 1;
+}
+
+//====== SNAPSHOT JOB STRUCTURE DEFINITION ======
+/*
+    SnapshotJob structure:
+    - A snapshot written by a thread of this process from a frozen copy of the catalog (see startSnapshot).
+*/
+struct SnapshotJob
+{
+   pthread_t thread;
+   char path[256]; // Path of the snapshot
+   Catalog frozen; // Copy of the catalog as it was when the journal was rotated
+   int log;        // Report the timings, as LIBRARY_PERSIST_LOG=1 asks
+   int ok;         // Result of writeSnapshot, valid once done is set
+   int done;       // Set by the thread when it has finished, read atomically
+};
+
+//====== SNAPSHOT THREAD FUNCTION ======
+/*
+    snapshotThread function:
+    - Writes the snapshot of a SnapshotJob, then marks it done.
+*/
+static void *snapshotThread(void *arg)
+{
+   struct SnapshotJob *job = arg;
+   job->ok = writeSnapshot(job->path, &job->frozen, job->log);
+   __atomic_store_n(&job->done, 1, __ATOMIC_RELEASE);
+   return NULL;
+}
+
+//====== START SNAPSHOT FUNCTION ======
+/*
+    startSnapshot function:
+    - Starts a thread that writes the snapshot from a frozen copy of the catalog (see freezeCatalog), for a
+      process with other threads running: a forked child would inherit locks that those threads hold, such as
+      the ones of malloc and stdio, and could hang on them.
+    - The copy has no indexes, so no image is written with this snapshot; the next start parses it and writes one.
+    - Returns 1 if the thread was started, 0 otherwise.
+*/
+static int startSnapshot(Journal *journal, const Catalog *catalog)
+{
+   struct SnapshotJob *job = calloc(1, sizeof(*job));
+   if (!job || !freezeCatalog(catalog, &job->frozen))
+   {
+      free(job);
+      return 0;
+   }
+   snprintf(job->path, sizeof(job->path), "%s", journal->path);
+   job->log = journal->logPersist;
+   if (pthread_create(&job->thread, NULL, snapshotThread, job) != 0)
+   {
+      freeFrozenCatalog(&job->frozen);
+      free(job);
+      return 0;
+   }
+   journal->snapshot = job;
+   return 1;
+}
+
+//====== COMPACT JOURNAL FUNCTION ======
+/*
+    compactJournal function:
+    - Folds the journal into a new snapshot of the in-memory catalog.
+    - Reserves the new snapshot file first, so the fresh journal can name it as its base.
+    - Moves the current records to "<snapshot>.journal.old" until the snapshot is in place.
+    - Drops the catalog's tombstones at that point, so its rows match the snapshot that the new records apply to.
+    - With background set, the snapshot is written by a forked child working on a copy-on-write
+      image of the catalog, so the caller can keep serving requests; when other threads read the catalog
+      (catalog->readers is set), by a thread working on a frozen copy instead, as forking is not safe there.
+    - Returns 1 on success, 0 on failure.
+*/
+static int compactJournal(Journal *journal, Catalog *catalog, int background)
+{
+   char name[300], temp[300], old[300];
+   journalFileName(name, sizeof(name), journal->path, ".journal");
+   journalFileName(temp, sizeof(temp), journal->path, ".tmp");
+   journalFileName(old, sizeof(old), journal->path, ".journal.old");
+
+   // Reserve the file that becomes the next snapshot
+   int fd = open(temp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+   struct stat st;
+   if (fd < 0 || fstat(fd, &st) != 0)
+   {
+      fprintf(stderr, "Error: Unable to create %s.\n", temp);
+      if (fd >= 0)
+      {
+         close(fd);
+      }
+      return 0;
+   }
+   close(fd);
+
+   // Set the current records aside, next to any a failed compaction left behind
+   if (journal->file)
+   {
+      fclose(journal->file);
+      journal->file = NULL;
+   }
+   if (access(old, F_OK) == 0)
+   {
+      if (!appendRecords(old, name))
+      {
+         fprintf(stderr, "Error: Unable to merge %s into %s.\n", name, old);
+         return 0;
+      }
+      unlink(name);
+   }
+   else if (access(name, F_OK) == 0 && rename(name, old) != 0)
+   {
+      fprintf(stderr, "Error: Unable to rotate %s.\n", name);
+      return 0;
+   }
+
+   // New records apply on top of the snapshot being written, which has no tombstones
+   if (!createJournal(journal, (unsigned long)st.st_ino) || !compactCatalog(catalog))
+   {
+      return 0;
+   }
+
+   if (background && catalog->readers)
+   {
+      if (startSnapshot(journal, catalog))
+      {
+         return 1;
+      }
+      fprintf(stderr, "Warning: Unable to start background compaction, compacting now.\n");
+   }
+   else if (background)
+   {
+      pid_t pid = fork();
+      if (pid == 0)
+      {
+         _exit(writeSnapshot(journal->path, catalog, journal->logPersist) ? 0 : 1);
+      }
+      if (pid > 0)
+      {
+         journal->compactor = pid;
+         return 1;
+      }
+      fprintf(stderr, "Warning: Unable to start background compaction, compacting now.\n");
+   }
+   return writeSnapshot(journal->path, catalog, journal->logPersist);
+}
+
+//====== REAP COMPACTOR FUNCTION ======
+/*
+    reapCompactor function:
+    - Collects the background compaction process or thread if it has finished (or waits for it if wait is set).
+    - A failed compaction leaves its records in "<snapshot>.journal.old" for the next one.
+*/
+static void reapCompactor(Journal *journal, int wait)
+{
+   struct SnapshotJob *job = journal->snapshot;
+   if (job && (wait || __atomic_load_n(&job->done, __ATOMIC_ACQUIRE)))
+   {
+      pthread_join(job->thread, NULL);
+      if (!job->ok)
+      {
+         fprintf(stderr, "Warning: Background compaction of %s failed, keeping the journal.\n", journal->path);
+      }
+      freeFrozenCatalog(&job->frozen);
+      free(job);
+      journal->snapshot = NULL;
+   }
+   if (journal->compactor == 0)
+   {
+      return;
+   }
+
+   int status;
+   pid_t pid = waitpid(journal->compactor, &status, wait ? 0 : WNOHANG);
+   if (pid == 0)
+   {
+      return;
+   }
+   if (pid < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+   {
+      fprintf(stderr, "Warning: Background compaction of %s failed, keeping the journal.\n", journal->path);
+   }
+   journal->compactor = 0;
+}
+
+//====== JOURNAL LOCK FUNCTION ======
+/*
+    journalLock function:
+    - Takes an exclusive lock on "<snapshot>.lock", so only one process at a time reads a catalog to change
+      it: two would each append to the journal and replace the snapshot without seeing the other's changes.
+    - The lock goes with the returned descriptor; processes forked while it is open hold it as well.
+    - Returns the descriptor, or -1 if another process holds the lock or the file could not be opened.
+*/
+int journalLock(const char *path)
+{
+   char name[300];
+   journalFileName(name, sizeof(name), path, ".lock");
+   int fd = open(name, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+   if (fd < 0)
+   {
+      fprintf(stderr, "Error: Unable to open %s.\n", name);
+      return -1;
+   }
+   if (flock(fd, LOCK_EX | LOCK_NB) != 0)
+   {
+      fprintf(stderr, "Error: %s is in use by another library process (it holds %s).\n", path, name);
+      close(fd);
+      return -1;
+   }
+   return fd;
+}
+
+//====== OPEN JOURNAL FUNCTION ======
+/*
+    journalOpen function:
+    - Replays the journal (and the records of an interrupted compaction) on top of the loaded snapshot.
+    - A journal that belongs to a different snapshot, or stops replaying at a record that does not
+      match, is moved aside to "<snapshot>.journal.stale" for manual recovery.
+    - If replay was not clean, the recovered state is written out as a new snapshot right away.
+    - Leaves the journal open for appending.
+    - Returns 1 on success, 0 on failure.
+*/
+int journalOpen(Journal *journal, const char *path, Catalog *catalog)
+{
+   char name[300], old[300], stale[300], staleOld[300];
+   snprintf(journal->path, sizeof(journal->path), "%s", path);
+   journal->file = NULL;
+   journal->size = 0;
+   journal->compactor = 0;
+   journal->snapshot = NULL;
+   journal->inTransaction = 0;
+   journal->pending = NULL;
+   journal->pendingSize = 0;
+   journal->pendingCapacity = 0;
+   journal->pendingCount = 0;
+   journal->lastLength = 0;
+   journal->syncEach = getenv("LIBRARY_SYNC") && strcmp(getenv("LIBRARY_SYNC"), "1") == 0;
+   journal->logPersist = getenv("LIBRARY_PERSIST_LOG") && strcmp(getenv("LIBRARY_PERSIST_LOG"), "1") == 0;
+   memset(&journal->persist, 0, sizeof(journal->persist));
+   journalFileName(name, sizeof(name), path, ".journal");
+   journalFileName(old, sizeof(old), path, ".journal.old");
+   journalFileName(stale, sizeof(stale), path, ".journal.stale");
+   journalFileName(staleOld, sizeof(staleOld), path, ".journal.old.stale");
+
+   unsigned long id = snapshotId(path);
+   unsigned long base;
+   long validSize;
+   int oldReplayed = 0;
+   int needsCompaction = 0;
+
+   // Records of a compaction that did not finish
+   FILE *file = openJournalFile(old, &base);
+   if (file)
+   {
+      if (base == id)
+      {
+         oldReplayed = 1;
+         needsCompaction = 1;
+         if (!replayRecords(file, old, &validSize, catalog))
+         {
+            // Later records depend on the ones that failed, keep them all for recovery
+            fprintf(stderr, "Warning: Moving %s to %s.\n", old, staleOld);
+            rename(old, staleOld);
+            oldReplayed = 0;
+         }
+         fclose(file);
+      }
+      else
+      {
+         // The compaction renamed its snapshot in place but did not get to remove the records
+         fclose(file);
+         unlink(old);
+      }
+   }
+
+   // Records made since the snapshot (or since the interrupted compaction started)
+   file = openJournalFile(name, &base);
+   if (file)
+   {
+      if ((base == id && !needsCompaction) || oldReplayed)
+      {
+         // The interrupted compaction dropped the tombstones before these records were made
+         if ((oldReplayed && !compactCatalog(catalog)) || !replayRecords(file, name, &validSize, catalog))
+         {
+            fprintf(stderr, "Warning: Moving %s to %s.\n", name, stale);
+            rename(name, stale);
+            needsCompaction = 1;
+         }
+         fclose(file);
+
+         if (!needsCompaction)
+         {
+            // Drop a torn record so new ones start on a fresh line
+            if (truncate(name, validSize) != 0 || !(journal->file = fopen(name, "a")))
+            {
+               fprintf(stderr, "Error: Unable to open %s for appending.\n", name);
+               return 0;
+            }
+            journal->size = validSize;
+            return 1;
+         }
+      }
+      else
+      {
+         fclose(file);
+         fprintf(stderr, "Warning: %s does not belong to %s, moving it to %s.\n", name, path, stale);
+         rename(name, stale);
+      }
+   }
+   else if (access(name, F_OK) == 0)
+   {
+      fprintf(stderr, "Warning: %s has no valid header, moving it to %s.\n", name, stale);
+      rename(name, stale);
+   }
+
+   if (needsCompaction)
+   {
+      return compactJournal(journal, catalog, 0);
+   }
+   return createJournal(journal, id);
+}
+
+//====== RECORD PERSIST FUNCTION ======
+/*
+    recordPersist function:
+    - Adds the latency of a journal write that started at start (clockMs) and was synced to disk to the stats.
+*/
+static void recordPersist(Journal *journal, int records, double start)
+{
+   double ms = clockMs() - start;
+   journal->persist.count++;
+   journal->persist.lastMs = ms;
+   journal->persist.totalMs += ms;
+   if (ms > journal->persist.maxMs)
+   {
+      journal->persist.maxMs = ms;
+   }
+   if (journal->logPersist)
+   {
+      fprintf(stderr, "Persist: %d record(s) to %s.journal in %.3f ms\n", records, journal->path, ms);
+   }
+}
+
+//====== APPEND RECORD FUNCTION ======
+/*
+    appendRecord function:
+    - Writes one record line to the end of the journal and flushes it (and syncs it to disk with LIBRARY_SYNC=1).
+    - Inside a transaction the record is only kept in memory until journalCommit.
+    - Returns 1 on success, 0 if the record could not be written.
+*/
+static int appendRecord(Journal *journal, const char *record)
+{
+   size_t length = strlen(record);
+   if (journal->inTransaction)
+   {
+      if (journal->pendingSize + length > journal->pendingCapacity)
+      {
+         size_t capacity = journal->pendingCapacity ? journal->pendingCapacity : 4096;
+         while (journal->pendingSize + length > capacity)
+         {
+            capacity *= 2;
+         }
+         char *grown = realloc(journal->pending, capacity);
+         if (!grown)
+         {
+            fprintf(stderr, "Error: Memory allocation failed.\n");
+            return 0;
+         }
+         journal->pending = grown;
+         journal->pendingCapacity = capacity;
+         STATS_ADD(STAT_REALLOCS, 1);
+      }
+      memcpy(journal->pending + journal->pendingSize, record, length);
+      journal->pendingSize += length;
+      journal->pendingCount++;
+      journal->lastLength = length;
+      return 1;
+   }
+
+   reapCompactor(journal, 0);
+   if (!journal->file)
+   {
+      fprintf(stderr, "Error: The journal is not open.\n");
+      return 0;
+   }
+   STATS_START(statStart);
+   double start = clockMs();
+   if (fputs(record, journal->file) == EOF || fflush(journal->file) != 0 ||
+       (journal->syncEach && fdatasync(fileno(journal->file)) != 0))
+   {
+      fprintf(stderr, "Error: Unable to write to the journal.\n");
+      return 0;
+   }
+   journal->size += (long)length;
+   journal->lastLength = length;
+   STATS_STOP(STAT_JOURNAL_WRITE, statStart);
+   STATS_ADD(STAT_BYTES_WRITTEN, length);
+   if (journal->syncEach)
+   {
+      recordPersist(journal, 1, start);
+   }
+   return 1;
+}
+
+//====== JOURNAL RETRACT FUNCTION ======
+/*
+    journalRetract function:
+    - Takes back the record appended last, when the change it describes could not be applied in memory,
+      so replay never makes a change the catalog did not.
+    - Inside a transaction it is dropped from the pending records; otherwise the journal is cut back to
+      where the record started.
+    - Returns 1 on success, 0 if there was no record to take back or the journal could not be cut.
+*/
+int journalRetract(Journal *journal)
+{
+   size_t length = journal->lastLength;
+   if (length == 0)
+   {
+      return 0;
+   }
+   journal->lastLength = 0;
+   if (journal->inTransaction)
+   {
+      journal->pendingSize -= length;
+      journal->pendingCount--;
+      return 1;
+   }
+   if (!journal->file || ftruncate(fileno(journal->file), journal->size - (long)length) != 0 ||
+       fseek(journal->file, journal->size - (long)length, SEEK_SET) != 0)
+   {
+      fprintf(stderr, "Error: Unable to take back the last record of the journal.\n");
+      return 0;
+   }
+   journal->size -= (long)length;
+   return 1;
+}
+
+//====== JOURNAL BEGIN FUNCTION ======
+/*
+    journalBegin function:
+    - Starts a transaction: records are collected in memory and written together by journalCommit.
+    - journalCheckpoint must not be called before the transaction is committed.
+*/
+void journalBegin(Journal *journal)
+{
+   journal->inTransaction = 1;
+   journal->pendingSize = 0;
+   journal->pendingCount = 0;
+   journal->lastLength = 0;
+}
+
+//====== JOURNAL COMMIT FUNCTION ======
+/*
+    journalCommit function:
+    - Writes the records of the open transaction behind a "T|count" line with one flush and one fdatasync,
+      so the whole group is on disk when this returns.
+    - Replay applies a transaction only if all of its records made it to the file.
+    - Returns 1 on success (or if there was nothing to write), 0 if the records could not be written.
+*/
+int journalCommit(Journal *journal)
+{
+   journal->inTransaction = 0;
+   if (journal->pendingCount == 0)
+   {
+      return 1;
+   }
+
+   reapCompactor(journal, 0);
+   if (!journal->file)
+   {
+      fprintf(stderr, "Error: The journal is not open.\n");
+      return 0;
+   }
+   STATS_START(statStart);
+   double start = clockMs();
+   int header = fprintf(journal->file, "T|%d\n", journal->pendingCount);
+   if (header < 0 || fwrite(journal->pending, 1, journal->pendingSize, journal->file) != journal->pendingSize ||
+       fflush(journal->file) != 0 || fdatasync(fileno(journal->file)) != 0)
+   {
+      fprintf(stderr, "Error: Unable to write to the journal.\n");
+      return 0;
+   }
+   journal->size += header + (long)journal->pendingSize;
+   STATS_STOP(STAT_JOURNAL_WRITE, statStart);
+   STATS_ADD(STAT_BYTES_WRITTEN, header + journal->pendingSize);
+   recordPersist(journal, journal->pendingCount, start);
+   journal->pendingSize = 0;
+   journal->pendingCount = 0;
+   return 1;
+}
+
+//====== JOURNAL ADD FUNCTION ======
+/*
+    journalAppendAdd function:
+    - Records that a book was added at the end of the catalog; the number of copies is only written if there are several.
+*/
+int journalAppendAdd(Journal *journal, const Database *book)
+{
+   char record[512];
+   int length = snprintf(record, sizeof(record), "A|%s|%s|%s|%d|%s|%s|%s",
+                         book->isbn, book->nameBook, book->authors, book->year,
+                         book->genre, book->borrowed, book->date);
+   if (book->copies > 1)
+   {
+      length += snprintf(record + length, sizeof(record) - length, "|%d", book->copies);
+   }
+   snprintf(record + length, sizeof(record) - length, "\n");
+   return appendRecord(journal, record);
+}
+
+//====== JOURNAL DELETE FUNCTION ======
+/*
+    journalAppendDelete function:
+    - Records that the book at the given row was deleted.
+*/
+int journalAppendDelete(Journal *journal, int row, const char *isbn)
+{
+   char record[64];
+   snprintf(record, sizeof(record), "D|%d|%s\n", row, isbn);
+   return appendRecord(journal, record);
+}
+
+//====== JOURNAL BORROW FUNCTION ======
+/*
+    journalAppendBorrow function:
+    - Records that copy number copy of the book at the given row was lent to patron on the given date.
+*/
+int journalAppendBorrow(Journal *journal, int row, const char *isbn, const char *date, int copy, int32_t patron)
+{
+   char record[96];
+   snprintf(record, sizeof(record), "B|%d|%s|%s|%d|%d\n", row, isbn, date, copy, patron);
+   return appendRecord(journal, record);
+}
+
+//====== JOURNAL RETURN FUNCTION ======
+/*
+    journalAppendReturn function:
+    - Records that copy number copy of the book at the given row was returned.
+*/
+int journalAppendReturn(Journal *journal, int row, const char *isbn, int copy)
+{
+   char record[64];
+   snprintf(record, sizeof(record), "R|%d|%s|%d\n", row, isbn, copy);
+   return appendRecord(journal, record);
+}
+
+//====== JOURNAL CHECKPOINT FUNCTION ======
+/*
+    journalCheckpoint function:
+    - Called after a mutation has been applied in memory.
+    - Starts a background compaction once the journal passes JOURNAL_COMPACT_THRESHOLD, or once
+      deleted books make up more than 1/CATALOG_TOMBSTONE_RATIO of the rows (see CATALOG_TOMBSTONE_MIN).
+    - May renumber the rows; no row number may be held across a call.
+*/
+void journalCheckpoint(Journal *journal, Catalog *catalog)
+{
+   reapCompactor(journal, 0);
+   int tombstones = catalog->deleted >= CATALOG_TOMBSTONE_MIN && catalog->deleted > catalog->count / CATALOG_TOMBSTONE_RATIO;
+   if (journal->compactor == 0 && !journal->snapshot && (journal->size > JOURNAL_COMPACT_THRESHOLD || tombstones))
+   {
+      compactJournal(journal, catalog, 1);
+   }
+}
+
+//====== CLOSE JOURNAL FUNCTION ======
+/*
+    journalClose function:
+    - Closes the journal and waits for a running compaction to finish, then releases the catalog lock.
+    - Records of a transaction that was never committed are dropped.
+*/
+void journalClose(Journal *journal)
+{
+   free(journal->pending);
+   journal->pending = NULL;
+   journal->inTransaction = 0;
+   if (journal->file)
+   {
+      fclose(journal->file);
+      journal->file = NULL;
+   }
+   reapCompactor(journal, 1);
+   if (journal->locked)
+   {
+      close(journal->lockFd);
+      journal->locked = 0;
+   }
+}
@@ -0,0 +1,79 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/types.h>
+
+#include "db.h"
+
+struct Catalog;
+struct SnapshotJob;
+
+// Journal size after which it is folded into a new books.db snapshot
+#ifndef JOURNAL_COMPACT_THRESHOLD
+#define JOURNAL_COMPACT_THRESHOLD (1024L * 1024L)
+#endif
+
+//====== PERSIST STATS STRUCTURE DEFINITION ======
+/*
+    PersistStats structure:
+    - Latency of the journal writes that were synced to disk.
+*/
+typedef struct
+{
+   long count;     // Synced writes so far
+   double lastMs;  // Latency of the latest one
+   double totalMs; // Sum of all latencies
+   double maxMs;   // Slowest one
+} PersistStats;
+
+//====== JOURNAL STRUCTURE DEFINITION ======
+/*
+    Journal structure:
+    - Append-only log of mutations made since books.db was last written.
+    - Lives next to the snapshot as "<snapshot>.journal", one '|'-delimited record per line:
+        A|isbn|title|authors|year|genre|borrowed|date[|copies]   (book added)
+        D|row|isbn                                              (book deleted)
+        B|row|isbn|date|copy|patron                             (copy of a book lent)
+        R|row|isbn|copy                                         (copy of a book returned)
+        T|count                                                 (the next count records form one transaction)
+        C                                                       (deleted books were dropped and the rows renumbered)
+    - The first line names the snapshot the records apply to (its inode), so a journal is never
+      replayed twice on top of a snapshot that already contains it.
+    - While a background compaction runs, the records it covers are kept in "<snapshot>.journal.old".
+    - The process that writes a catalog holds an exclusive lock on "<snapshot>.lock" (see journalLock).
+*/
+typedef struct
+{
+   FILE *file;          // Open journal, appended to after every mutation
+   char path[256];      // Path of the snapshot (books.db)
+   long size;           // Current journal size in bytes
+   pid_t compactor;     // Process writing the new snapshot, 0 if none is running
+   struct SnapshotJob *snapshot; // Thread writing the new snapshot instead (server mode), NULL if none is running
+   int inTransaction;   // 1 between journalBegin and journalCommit
+   char *pending;       // Records of the open transaction, written out by journalCommit
+   size_t pendingSize;  // Bytes used in pending
+   size_t pendingCapacity;
+   int pendingCount;    // Number of records in pending
+   size_t lastLength;   // Length of the record appended last, 0 once it was taken back
+   int lockFd;          // Descriptor holding the lock on "<snapshot>.lock" while locked is set
+   int locked;
+   int syncEach;        // LIBRARY_SYNC=1: every single record is synced to disk, not only transactions
+   int logPersist;      // LIBRARY_PERSIST_LOG=1: report the latency of every durable write on stderr
+   PersistStats persist;
+} Journal;
+
+int journalLock(const char *path);
+int journalOpen(Journal *journal, const char *path, struct Catalog *catalog);
+int journalAppendAdd(Journal *journal, const Database *book);
+int journalAppendDelete(Journal *journal, int row, const char *isbn);
+int journalAppendBorrow(Journal *journal, int row, const char *isbn, const char *date, int copy, int32_t patron);
+int journalAppendReturn(Journal *journal, int row, const char *isbn, int copy);
+int journalRetract(Journal *journal);
+void journalBegin(Journal *journal);
+int journalCommit(Journal *journal);
+void journalCheckpoint(Journal *journal, struct Catalog *catalog);
+void journalClose(Journal *journal);
+
+#endif
@@ -0,0 +1,494 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "date.h"
+#include "loans.h"
+#include "stats.h"
+
+//====== GROW COLUMN FUNCTION ======
+/*
+    growColumn function:
+    - Reallocates one column to capacity values.
+    - Returns 1 on success, 0 on memory allocation failure (the column is left as it was).
+*/
+static int growColumn(int32_t **column, int capacity)
+{
+   int32_t *grown = realloc(*column, (size_t)capacity * sizeof(int32_t));
+   if (!grown)
+   {
+      return 0;
+   }
+   *column = grown;
+   return 1;
+}
+
+//====== RESERVE ENTRIES FUNCTION ======
+/*
+    reserveEntries function:
+    - Makes sure the per-entry columns can take entries more entries and the per-copy columns copies more
+      copies, growing them at least twofold.
+    - Returns 1 on success, 0 on memory allocation failure (the table keeps its contents).
+*/
+static int reserveEntries(LoanTable *table, int entries, int copies)
+{
+   if (table->entryCount + entries > table->entryCapacity)
+   {
+      int capacity = table->entryCapacity ? 2 * table->entryCapacity : 64;
+      while (capacity < table->entryCount + entries)
+      {
+         capacity *= 2;
+      }
+      if (!growColumn(&table->bookRow, capacity) || !growColumn(&table->firstCopy, capacity) ||
+          !growColumn(&table->copyCount, capacity) || !growColumn(&table->lentCount, capacity) ||
+          !growColumn(&table->freeCopy, capacity))
+      {
+         fprintf(stderr, "Error: Memory allocation for the loan table failed.\n");
+         return 0;
+      }
+      table->entryCapacity = capacity;
+      STATS_ADD(STAT_REALLOCS, 1);
+   }
+   if (table->copyTotal + copies > table->copyCapacity)
+   {
+      int capacity = table->copyCapacity ? 2 * table->copyCapacity : 256;
+      while (capacity < table->copyTotal + copies)
+      {
+         capacity *= 2;
+      }
+      if (!growColumn(&table->copyEntry, capacity) || !growColumn(&table->patron, capacity) ||
+          !growColumn(&table->day, capacity) || !growColumn(&table->nextFree, capacity))
+      {
+         fprintf(stderr, "Error: Memory allocation for the loan table failed.\n");
+         return 0;
+      }
+      table->copyCapacity = capacity;
+      STATS_ADD(STAT_REALLOCS, 1);
+   }
+   return 1;
+}
+
+//====== ADD BOOK TO LOAN TABLE FUNCTION ======
+/*
+    loanTableAddBook function:
+    - Adds an entry for the book at the given row with the given number of copies, all on the shelf.
+    - Returns the new entry, or -1 on memory allocation failure.
+*/
+int loanTableAddBook(LoanTable *table, int row, int copies)
+{
+   if (!reserveEntries(table, 1, copies))
+   {
+      return -1;
+   }
+
+   int entry = table->entryCount++;
+   int first = table->copyTotal;
+   table->bookRow[entry] = row;
+   table->firstCopy[entry] = first;
+   table->copyCount[entry] = copies;
+   table->lentCount[entry] = 0;
+   table->freeCopy[entry] = first;
+   for (int i = first; i < first + copies; i++)
+   {
+      table->copyEntry[i] = entry;
+      table->patron[i] = LOAN_SHELF;
+      table->day[i] = NO_DATE;
+      table->nextFree[i] = i + 1 < first + copies ? i + 1 : -1;
+   }
+   table->copyTotal += copies;
+   return entry;
+}
+
+//====== FIRST FREE COPY FUNCTION ======
+/*
+    loanTableFirstFree function:
+    - Returns the number (from 1) of a copy of the entry's book that is on the shelf, or 0 if all are lent.
+*/
+int loanTableFirstFree(const LoanTable *table, int entry)
+{
+   int copy = table->freeCopy[entry];
+   return copy < 0 ? 0 : copy - table->firstCopy[entry] + 1;
+}
+
+//====== LEND COPY FUNCTION ======
+/*
+    loanTableLend function:
+    - Lends copy number copy of the entry's book (0 for the first one on the shelf) to patron on day, and files
+      the loan under the patron if the patron is known.
+    - Returns the number of the copy lent, or 0 if that copy is not on the shelf (or no copy is, for 0).
+*/
+int loanTableLend(LoanTable *table, int entry, int copy, int32_t patron, int32_t day)
+{
+   int first = table->firstCopy[entry];
+   int slot;
+   if (copy == 0)
+   {
+      slot = table->freeCopy[entry];
+      if (slot < 0)
+      {
+         return 0;
+      }
+      table->freeCopy[entry] = table->nextFree[slot];
+   }
+   else
+   {
+      if (copy < 1 || copy > table->copyCount[entry] || table->patron[first + copy - 1] != LOAN_SHELF)
+      {
+         return 0;
+      }
+      // Unlink the copy from the shelf; the list is no longer than the book's copies
+      slot = first + copy - 1;
+      int32_t *link = &table->freeCopy[entry];
+      while (*link != slot)
+      {
+         link = &table->nextFree[*link];
+      }
+      *link = table->nextFree[slot];
+   }
+
+   table->patron[slot] = patron;
+   table->day[slot] = day;
+   table->nextFree[slot] = -1;
+   table->lentCount[entry]++;
+   if (patron > LOAN_UNKNOWN_PATRON && !patronIndexAdd(&table->patrons, patron, slot))
+   {
+      fprintf(stderr, "Error: Could not add the loan to the patron index.\n");
+   }
+   return slot - first + 1;
+}
+
+//====== RETURN COPY FUNCTION ======
+/*
+    loanTableReturn function:
+    - Puts copy number copy of the entry's book back on the shelf; 0 stands for the only copy that is lent.
+    - Returns the number of the copy returned, or 0 if that copy is not lent (or, for 0, not exactly one is).
+*/
+int loanTableReturn(LoanTable *table, int entry, int copy)
+{
+   int first = table->firstCopy[entry];
+   if (copy == 0)
+   {
+      if (table->lentCount[entry] != 1)
+      {
+         return 0;
+      }
+      copy = 1;
+      while (table->patron[first + copy - 1] == LOAN_SHELF)
+      {
+         copy++;
+      }
+   }
+   if (copy < 1 || copy > table->copyCount[entry] || table->patron[first + copy - 1] == LOAN_SHELF)
+   {
+      return 0;
+   }
+
+   int slot = first + copy - 1;
+   if (table->patron[slot] > LOAN_UNKNOWN_PATRON)
+   {
+      patronIndexRemove(&table->patrons, table->patron[slot], slot);
+   }
+   table->patron[slot] = LOAN_SHELF;
+   table->day[slot] = NO_DATE;
+   table->nextFree[slot] = table->freeCopy[entry];
+   table->freeCopy[entry] = slot;
+   table->lentCount[entry]--;
+   return copy;
+}
+
+//====== EARLIEST LOAN FUNCTION ======
+/*
+    loanTableEarliest function:
+    - Returns the day of the oldest loan of the entry's book (NO_DATE if one is undated or none is lent);
+      it is the borrow date the book's row shows.
+*/
+int32_t loanTableEarliest(const LoanTable *table, int entry)
+{
+   int32_t earliest = INT32_MAX;
+   int first = table->firstCopy[entry];
+   for (int i = first; i < first + table->copyCount[entry]; i++)
+   {
+      // NO_DATE is the smallest day, so an undated loan wins
+      if (table->patron[i] != LOAN_SHELF && table->day[i] < earliest)
+      {
+         earliest = table->day[i];
+      }
+   }
+   return earliest == INT32_MAX ? NO_DATE : earliest;
+}
+
+//====== REMOVE BOOK FROM LOAN TABLE FUNCTION ======
+/*
+    loanTableRemoveBook function:
+    - Unlinks the entry of a deleted book and drops its loans from the patron index.
+*/
+void loanTableRemoveBook(LoanTable *table, int entry)
+{
+   int first = table->firstCopy[entry];
+   for (int i = first; i < first + table->copyCount[entry]; i++)
+   {
+      if (table->patron[i] > LOAN_UNKNOWN_PATRON)
+      {
+         patronIndexRemove(&table->patrons, table->patron[i], i);
+      }
+   }
+   table->bookRow[entry] = -1;
+}
+
+//====== REMAP LOAN TABLE FUNCTION ======
+/*
+    loanTableRemap function:
+    - Builds into remapped the table for new row numbers after the catalog dropped its tombstones: newRows
+      gives the new row of every old row, -1 for a dropped one.
+    - Entries of removed books are left out, the others keep their copies and loans in order.
+    - The table itself is only read, so it stays usable until the remapped one replaces it.
+    - Returns 1 on success, 0 on memory allocation failure (remapped is then left empty).
+*/
+int loanTableRemap(const LoanTable *table, const int *newRows, LoanTable *remapped)
+{
+   memset(remapped, 0, sizeof(*remapped));
+   for (int entry = 0; entry < table->entryCount; entry++)
+   {
+      int row = table->bookRow[entry];
+      if (row < 0 || newRows[row] < 0)
+      {
+         continue;
+      }
+      int copied = loanTableAddBook(remapped, newRows[row], table->copyCount[entry]);
+      if (copied < 0)
+      {
+         loanTableFree(remapped);
+         return 0;
+      }
+      int first = table->firstCopy[entry];
+      for (int copy = 1; copy <= table->copyCount[entry]; copy++)
+      {
+         if (table->patron[first + copy - 1] != LOAN_SHELF)
+         {
+            loanTableLend(remapped, copied, copy, table->patron[first + copy - 1], table->day[first + copy - 1]);
+         }
+      }
+   }
+   return 1;
+}
+
+//====== WRITE LOAN FIELDS FUNCTION ======
+/*
+    loanTableWriteFields function:
+    - Writes the copies and loans fields of the entry's book as they follow the borrow date in "books.db":
+      "|copies|copy:patron:DD-MM-YYYY;..." in copy order, or "|copies|-" if no copy is lent.
+    - Returns the number of bytes written, or -1 on write failure.
+*/
+int loanTableWriteFields(const LoanTable *table, int entry, FILE *file)
+{
+   int written = fprintf(file, "|%d|", table->copyCount[entry]);
+   if (written < 0)
+   {
+      return -1;
+   }
+   if (table->lentCount[entry] == 0)
+   {
+      return putc('-', file) == EOF ? -1 : written + 1;
+   }
+
+   int first = table->firstCopy[entry];
+   const char *separator = "";
+   for (int i = first; i < first + table->copyCount[entry]; i++)
+   {
+      if (table->patron[i] == LOAN_SHELF)
+      {
+         continue;
+      }
+      char date[11];
+      formatDate(table->day[i], date, sizeof(date));
+      int length = fprintf(file, "%s%d:%d:%s", separator, i - first + 1, table->patron[i], date);
+      if (length < 0)
+      {
+         return -1;
+      }
+      written += length;
+      separator = ";";
+   }
+   return written;
+}
+
+//====== NEXT LOAN FUNCTION ======
+/*
+    nextLoan function:
+    - Reads the loan at pos in the loans field of a "books.db" line ("copy:patron:DD-MM-YYYY" items
+      separated by ';', or "-" for none) and moves pos past it.
+    - The date may be "-" for a loan made without one.
+    - Returns 1 if a loan was read, 0 at the end of the field, -1 if the item is malformed.
+*/
+int nextLoan(const char *text, int length, int *pos, int *copy, int32_t *patron, int32_t *day)
+{
+   if (*pos >= length || (*pos == 0 && length == 1 && text[0] == '-'))
+   {
+      return 0;
+   }
+
+   long values[2];
+   int at = *pos;
+   for (int i = 0; i < 2; i++)
+   {
+      int start = at;
+      values[i] = 0;
+      while (at < length && text[at] >= '0' && text[at] <= '9' && at - start < 9)
+      {
+         values[i] = values[i] * 10 + (text[at] - '0');
+         at++;
+      }
+      if (at == start || at >= length || text[at] != ':')
+      {
+         return -1;
+      }
+      at++;
+   }
+   int start = at;
+   while (at < length && text[at] != ';')
+   {
+      at++;
+   }
+   if (values[0] < 1 || !parseDate(text + start, at - start, day))
+   {
+      return -1;
+   }
+   if (at < length)
+   {
+      // Skip the separator, which must be followed by another loan
+      at++;
+      if (at == length)
+      {
+         return -1;
+      }
+   }
+   *copy = (int)values[0];
+   *patron = (int32_t)values[1];
+   *pos = at;
+   return 1;
+}
+
+//====== WRITE LOAN TABLE FUNCTION ======
+/*
+    loanTableWrite function:
+    - Writes every column to a binary image section; the patron index is rebuilt when it is read.
+    - Returns 1 on success, 0 on write failure.
+*/
+int loanTableWrite(const LoanTable *table, FILE *file)
+{
+   uint64_t sizes[2] = {(uint64_t)table->entryCount, (uint64_t)table->copyTotal};
+   size_t entryBytes = (size_t)table->entryCount * sizeof(int32_t);
+   size_t copyBytes = (size_t)table->copyTotal * sizeof(int32_t);
+   return imagePut(file, sizes, sizeof(sizes)) && imagePut(file, table->bookRow, entryBytes) &&
+          imagePut(file, table->firstCopy, entryBytes) && imagePut(file, table->copyCount, entryBytes) &&
+          imagePut(file, table->lentCount, entryBytes) && imagePut(file, table->freeCopy, entryBytes) &&
+          imagePut(file, table->copyEntry, copyBytes) && imagePut(file, table->patron, copyBytes) &&
+          imagePut(file, table->day, copyBytes) && imagePut(file, table->nextFree, copyBytes);
+}
+
+//====== READ LOAN TABLE FUNCTION ======
+/*
+    loanTableRead function:
+    - Restores a table written by loanTableWrite for a catalog of rows rows, and rebuilds its patron index.
+    - Returns 1 on success, 0 if the section is malformed or allocation fails (the table is then empty).
+*/
+int loanTableRead(LoanTable *table, ImageReader *reader, int rows)
+{
+   memset(table, 0, sizeof(*table));
+   const uint64_t *sizes = imageTake(reader, 2 * sizeof(uint64_t));
+   if (!sizes || sizes[0] > INT32_MAX / 2 || sizes[1] > INT32_MAX / 2)
+   {
+      return 0;
+   }
+   int entries = (int)sizes[0];
+   int copies = (int)sizes[1];
+   size_t entryBytes = (size_t)entries * sizeof(int32_t);
+   size_t copyBytes = (size_t)copies * sizeof(int32_t);
+   const int32_t *entryColumns[5];
+   const int32_t *copyColumns[4];
+   for (int i = 0; i < 5; i++)
+   {
+      entryColumns[i] = imageTake(reader, entryBytes);
+   }
+   for (int i = 0; i < 4; i++)
+   {
+      copyColumns[i] = imageTake(reader, copyBytes);
+   }
+   if (reader->failed)
+   {
+      return 0;
+   }
+
+   // Every row, entry and copy number must stay in bounds
+   for (int entry = 0; entry < entries; entry++)
+   {
+      int32_t first = entryColumns[1][entry], count = entryColumns[2][entry];
+      if (entryColumns[0][entry] < -1 || entryColumns[0][entry] >= rows || first < 0 || count < 1 ||
+          count > copies - first || entryColumns[4][entry] < -1 || entryColumns[4][entry] >= copies)
+      {
+         return 0;
+      }
+   }
+   for (int copy = 0; copy < copies; copy++)
+   {
+      if (copyColumns[0][copy] < 0 || copyColumns[0][copy] >= entries || copyColumns[3][copy] < -1 ||
+          copyColumns[3][copy] >= copies)
+      {
+         return 0;
+      }
+   }
+
+   if (!reserveEntries(table, entries, copies))
+   {
+      loanTableFree(table);
+      return 0;
+   }
+   if (entries > 0)
+   {
+      memcpy(table->bookRow, entryColumns[0], entryBytes);
+      memcpy(table->firstCopy, entryColumns[1], entryBytes);
+      memcpy(table->copyCount, entryColumns[2], entryBytes);
+      memcpy(table->lentCount, entryColumns[3], entryBytes);
+      memcpy(table->freeCopy, entryColumns[4], entryBytes);
+   }
+   if (copies > 0)
+   {
+      memcpy(table->copyEntry, copyColumns[0], copyBytes);
+      memcpy(table->patron, copyColumns[1], copyBytes);
+      memcpy(table->day, copyColumns[2], copyBytes);
+      memcpy(table->nextFree, copyColumns[3], copyBytes);
+   }
+   table->entryCount = entries;
+   table->copyTotal = copies;
+
+   for (int copy = 0; copy < copies; copy++)
+   {
+      if (table->patron[copy] > LOAN_UNKNOWN_PATRON && table->bookRow[table->copyEntry[copy]] >= 0 &&
+          !patronIndexAdd(&table->patrons, table->patron[copy], copy))
+      {
+         loanTableFree(table);
+         return 0;
+      }
+   }
+   return 1;
+}
+
+//====== FREE LOAN TABLE FUNCTION ======
+/*
+    loanTableFree function:
+    - Releases every column and the patron index.
+*/
+void loanTableFree(LoanTable *table)
+{
+   free(table->bookRow);
+   free(table->firstCopy);
+   free(table->copyCount);
+   free(table->lentCount);
+   free(table->freeCopy);
+   free(table->copyEntry);
+   free(table->patron);
+   free(table->day);
+   free(table->nextFree);
+   patronIndexFree(&table->patrons);
+   memset(table, 0, sizeof(*table));
+}
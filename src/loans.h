@@ -0,0 +1,64 @@
+#ifndef LOANS_H
+#define LOANS_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "image.h"
+#include "patron_index.h"
+
+// Patron of a copy that is on the shelf
+#define LOAN_SHELF -1
+
+// Patron of a loan made without a patron number (the menu's default, and every loan from before copies existed)
+#define LOAN_UNKNOWN_PATRON 0
+
+// Most copies one book can have; with all of them lent, its books.db line stays within the 64 KB a line may take
+#ifndef LOAN_MAX_COPIES
+#define LOAN_MAX_COPIES 999
+#endif
+
+//====== LOAN TABLE STRUCTURE DEFINITION ======
+/*
+    LoanTable structure:
+    - Copies and loans of the books that need more than the single borrowed flag of their row: books with
+      several copies, and books lent to a known patron. Every other book is one copy, described by its row.
+    - Columnar: one set of arrays per book entry and one per copy. The copies of a book are contiguous,
+      copy number n of an entry being copy firstCopy + n - 1.
+    - The copies on the shelf of each book are chained in a free list, so the first available copy is
+      found in O(1); the patron index lists the copies lent to each known patron.
+    - An entry belongs to the row whose BookRecord.loans names it; removing the book only unlinks the
+      entry, which stays behind until loanTableRemap drops it.
+*/
+typedef struct
+{
+   int32_t *bookRow;    // Per entry: catalog row, -1 once the book was removed
+   int32_t *firstCopy;  // Per entry: first of the book's copies
+   int32_t *copyCount;  // Per entry: number of copies
+   int32_t *lentCount;  // Per entry: copies currently lent
+   int32_t *freeCopy;   // Per entry: first copy on the shelf, -1 if all are lent
+   int entryCount;      // Number of entries
+   int entryCapacity;   // Allocated entries
+   int32_t *copyEntry;  // Per copy: entry of the book
+   int32_t *patron;     // Per copy: patron it is lent to, LOAN_SHELF if it is on the shelf
+   int32_t *day;        // Per copy: days since 01-01-1970 of the loan, NO_DATE if on the shelf or undated
+   int32_t *nextFree;   // Per copy on the shelf: next copy on the shelf, -1 at the end
+   int copyTotal;       // Number of copies
+   int copyCapacity;    // Allocated copies
+   PatronIndex patrons; // Patron -> copies lent to them
+} LoanTable;
+
+int loanTableAddBook(LoanTable *table, int row, int copies);
+int loanTableFirstFree(const LoanTable *table, int entry);
+int loanTableLend(LoanTable *table, int entry, int copy, int32_t patron, int32_t day);
+int loanTableReturn(LoanTable *table, int entry, int copy);
+int32_t loanTableEarliest(const LoanTable *table, int entry);
+void loanTableRemoveBook(LoanTable *table, int entry);
+int loanTableRemap(const LoanTable *table, const int *newRows, LoanTable *remapped);
+int loanTableWriteFields(const LoanTable *table, int entry, FILE *file);
+int nextLoan(const char *text, int length, int *pos, int *copy, int32_t *patron, int32_t *day);
+int loanTableWrite(const LoanTable *table, FILE *file);
+int loanTableRead(LoanTable *table, ImageReader *reader, int rows);
+void loanTableFree(LoanTable *table);
+
+#endif
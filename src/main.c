@@ -1,195 +1,30 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <time.h>
-#include <ctype.h>
 
-//====== DATABASE STRUCTURE DEFINITION ======
-/*
-    Database structure:
-    - Represents a single book with properties like ISBN, title, authors, year, genre, borrowed status, and borrow date.
-    - Used to store book information in a library management system.
-*/
-typedef struct
-{
-   char isbn[15];     // ISBN of the book (13 digits)
-   char nameBook[51]; // Title of the book (up to 50 characters)
-   char authors[201]; // Authors of the book (comma-separated, up to 200 characters)
-   int year;          // Publication year
-   char genre[101];   // Genre(s) of the book (comma-separated, up to 100 characters)
-   char date[11];     // Borrow date in DD-MM-YYYY format or "-" if not borrowed
-   char borrowed[6];  // Borrow status ("true" or "false")
-} Database;
-
-//====== LOAD DATABASE FUNCTION ======
-/*
-    loadDatabase function:
-    - Loads book records from "books.db" into a dynamically allocated array.
-    - Dynamically resizes the array if needed.
-    - Returns 1 on success, 0 on failure (file or memory issues).
-*/
-int loadDatabase(Database **database, int *currentSize)
-{
-   // Open file for reading
-   FILE *file = fopen("books.db", "r");
-   if (!file) 
-   {
-      fprintf(stderr, "Missing books.db. Creating a new one...\n");
-      file = fopen("books.db", "w+");
-   }
-
-   // Initialize database array
-   int maxSize = 10;
-   *database = malloc(maxSize * sizeof(Database));
-   if (!*database)
-   {
-      fprintf(stderr, "Error: Memory allocation failed.\n");
-      fclose(file);
-      return 0;
-   }
-
-   char line[256];
-   *currentSize = 0;
-
-   // Read and parse each line
-   while (fgets(line, sizeof(line), file))
-   {
-      line[strcspn(line, "\n")] = '\0';
-
-      // Resize array if needed
-      if (*currentSize >= maxSize)
-      {
-         maxSize += 10;
-         *database = realloc(*database, maxSize * sizeof(Database));
-         if (!*database)
-         {
-            fprintf(stderr, "Error: Memory reallocation failed.\n");
-            fclose(file);
-            return 0;
-         }
-      }
-
-      Database *book = &(*database)[*currentSize];
-      char *token = strtok(line, "|");
-
-      // Parse ISBN
-      if (token)
-      {
-         strncpy(book->isbn, token, sizeof(book->isbn) - 1);
-         book->isbn[sizeof(book->isbn) - 1] = '\0';
-      }
-      else
-      {
-         fprintf(stderr, "Error: Missing ISBN in line: %s\n", line);
-         continue;
-      }
-
-      // Parse title
-      token = strtok(NULL, "|");
-      if (token)
-      {
-         strncpy(book->nameBook, token, sizeof(book->nameBook) - 1);
-         book->nameBook[sizeof(book->nameBook) - 1] = '\0';
-      }
-      else
-      {
-         fprintf(stderr, "Error: Missing book name in line: %s\n", line);
-         continue;
-      }
-
-      // Parse authors
-      token = strtok(NULL, "|");
-      if (token)
-      {
-         strncpy(book->authors, token, sizeof(book->authors) - 1);
-         book->authors[sizeof(book->authors) - 1] = '\0';
-      }
-      else
-      {
-         fprintf(stderr, "Error: Missing authors in line: %s\n", line);
-         continue;
-      }
-
-      // Parse year
-      token = strtok(NULL, "|");
-      if (token)
-      {
-         book->year = atoi(token);
-      }
-      else
-      {
-         fprintf(stderr, "Error: Missing year in line: %s\n", line);
-         continue;
-      }
-
-      // Parse genre
-      token = strtok(NULL, "|");
-      if (token)
-      {
-         strncpy(book->genre, token, sizeof(book->genre) - 1);
-         book->genre[sizeof(book->genre) - 1] = '\0';
-      }
-      else
-      {
-         fprintf(stderr, "Error: Missing genre in line: %s\n", line);
-         continue;
-      }
+#include "batch.h"
+#include "catalog.h"
+#include "ranked_search.h"
+#include "server.h"
+#include "stats.h"
+#include "transfer.h"
+#include "storage.h"
 
-      // Parse borrowed status
-      token = strtok(NULL, "|");
-      if (token)
-      {
-         strncpy(book->borrowed, token, sizeof(book->borrowed) - 1);
-         book->borrowed[sizeof(book->borrowed) - 1] = '\0';
-      }
-      else
-      {
-         fprintf(stderr, "Error: Missing borrowed status in line: %s\n", line);
-         continue;
-      }
-
-      // Parse borrow date
-      token = strtok(NULL, "|");
-      if (token)
-      {
-         strncpy(book->date, token, sizeof(book->date) - 1);
-         book->date[sizeof(book->date) - 1] = '\0';
-      }
-      else
-      {
-         fprintf(stderr, "Error: Missing date in line: %s\n", line);
-         continue;
-      }
-
-      (*currentSize)++;
-   }
-
-   fclose(file);
-   return 1;
-}
+// Books shown per page of title search results
+#define TITLE_PAGE_SIZE 20
 
 //====== ADD BOOK FUNCTION ======
 /*
     addBook function:
     - Adds a new book to the database.
-    - Validates ISBN (13 digits), title (≤50 characters), and year (≤2025).
-    - Saves the updated database to "books.db".
+    - Validates ISBN (13 digits), title (≤50 characters), year (≤2025) and the number of copies as they are entered.
+    - Then checks the whole book with checkBook, as batch and import do, and adds nothing if it fails.
+    - Records the new book in the journal, then adds it to the catalog and the ISBN index.
 */
-void addBook(Database **database, int *currentSize, int *maxSize)
+void addBook(Catalog *catalog)
 {
-   // Resize database if needed
-   if (*currentSize >= *maxSize)
-   {
-      *maxSize += 10;
-      *database = realloc(*database, *maxSize * sizeof(Database));
-      if (!*database)
-      {
-         fprintf(stderr, "Error! Memory reallocation failed.\n");
-         return;
-      }
-   }
-
-   Database *newBook = &(*database)[*currentSize];
+   Database book;
+   Database *newBook = &book;
    getchar();
 
    // Input and validate ISBN
@@ -262,295 +97,368 @@ void addBook(Database **database, int *currentSize, int *maxSize)
    fgets(newBook->genre, sizeof(newBook->genre), stdin);
    newBook->genre[strcspn(newBook->genre, "\n")] = '\0';
 
+   // Input and validate the number of copies
+   while (1)
+   {
+      printf("Enter number of copies (1 to %d): ", LOAN_MAX_COPIES);
+      if (scanf("%d", &newBook->copies) == 1 && newBook->copies >= 1 && newBook->copies <= LOAN_MAX_COPIES)
+      {
+         getchar();
+         break;
+      }
+      printf("Invalid number of copies! Try again.\n");
+      int ch;
+      while ((ch = getchar()) != '\n' && ch != EOF)
+         ;
+   }
+
+   // Apply the same rules as batch and import, which also keep '|' and non-digit ISBNs out of books.db
+   char year[16];
+   snprintf(year, sizeof(year), "%d", newBook->year);
+   const char *problem = checkBook(newBook->isbn, newBook->nameBook, newBook->authors, year, newBook->genre,
+                                   &newBook->year);
+   if (problem)
+   {
+      printf("Error: The book could not be added: %s.\n", problem);
+      return;
+   }
+
    // Set default values for borrowed status and date
    strcpy(newBook->borrowed, "false");
    strcpy(newBook->date, "-");
 
-   (*currentSize)++;
-   printf("Book added successfully!\n");
-
-   // Save database to file
-   FILE *file = fopen("books.db", "w");
-   if (!file)
+   // Log the change before applying it, and take the record back if the book could not be added
+   if (!journalAppendAdd(&catalog->journal, newBook))
    {
-      printf("Not possible to open a file!\n");
+      printf("Error: The book could not be added.\n");
       return;
    }
-
-   for (int i = 0; i < *currentSize; i++)
+   if (!insertBook(catalog, newBook))
    {
-      fprintf(file, "%s|%s|%s|%d|%s|%s|%s\n",
-              (*database)[i].isbn, (*database)[i].nameBook, (*database)[i].authors,
-              (*database)[i].year, (*database)[i].genre, (*database)[i].borrowed,
-              (*database)[i].date);
+      journalRetract(&catalog->journal);
+      printf("Error: The book could not be added.\n");
+      return;
    }
-   fclose(file);
+   printf("Book added successfully!\n");
+   journalCheckpoint(&catalog->journal, catalog);
 }
 
 //====== DELETE BOOK FUNCTION ======
 /*
     deleteBook function:
-    - Removes a book from the database by index.
-    - Shifts remaining books to fill the gap.
-    - Saves the updated database to "books.db".
+    - Removes a book from the catalog by index.
+    - Records the deletion in the journal, then leaves a tombstone in its row, so the indexes of
+      the other books found by the same search stay valid.
 */
-void deleteBook(Database *database, int *currentSize, int index)
+void deleteBook(Catalog *catalog, int index)
 {
    // Validate index
-   if (index < 0 || index >= *currentSize)
+   if (index < 0 || index >= catalog->count || isBookDeleted(catalog, index))
    {
       printf("Invalid book index.\n");
       return;
    }
 
-   // Shift books to remove the selected one
-   for (int i = index; i < *currentSize - 1; i++)
+   // Log the change before applying it
+   Database book;
+   readBook(catalog, index, &book);
+   if (!journalAppendDelete(&catalog->journal, index, book.isbn))
    {
-      database[i] = database[i + 1];
+      printf("Error: The book could not be deleted.\n");
+      return;
    }
-
-   (*currentSize)--;
+   removeBook(catalog, index);
 
    printf("Book deleted successfully!\n");
-
-   // Save updated database to file
-   FILE *file = fopen("books.db", "w");
-   if (!file)
-   {
-      printf("Error: Unable to open 'books.db' for writing.\n");
-      return;
-   }
-   for (int i = 0; i < *currentSize; i++)
-   {
-      fprintf(file, "%s|%s|%s|%d|%s|%s|%s\n",
-              database[i].isbn, database[i].nameBook, database[i].authors,
-              database[i].year, database[i].genre, database[i].borrowed,
-              database[i].date);
-   }
-   fclose(file);
+   journalCheckpoint(&catalog->journal, catalog);
 }
 
 //====== BORROW BOOK FUNCTION ======
 /*
     borrowBook function:
-    - Marks a book as borrowed by ISBN.
+    - Lends the first available copy of a book, found by ISBN in the ISBN index, to a patron.
     - Sets borrow date to the current date.
-    - Checks if the book exists and is not already borrowed.
+    - Checks if the book exists and has a copy on the shelf.
+    - Records the change in the journal.
 */
-void borrowBook(Database *database, int *currentSize, const char *isbn)
+void borrowBook(Catalog *catalog, const char *isbn)
 {
-   for (int i = 0; i < *currentSize; i++)
+   int i = isbnIndexFind(&catalog->isbnIndex, catalog, isbn);
+   if (i == -1)
    {
-      if (strcmp(database[i].isbn, isbn) == 0)
+      printf("Book with ISBN %s not found.\n", isbn);
+      return;
+   }
+
+   int copy = availableCopy(catalog, i);
+   if (copy != 0)
+   {
+      int patron;
+      printf("Enter the patron number (0 if unknown): ");
+      if (scanf("%d", &patron) != 1 || patron < 0)
       {
-         if (strcmp(database[i].borrowed, "false") == 0)
-         {
-            strcpy(database[i].borrowed, "true");
-            time_t t = time(NULL);
-            struct tm tm = *localtime(&t);
-            sprintf(database[i].date, "%02d-%02d-%04d", tm.tm_mday, tm.tm_mon + 1, tm.tm_year + 1900);
-            printf("Book '%s' has been borrowed successfully!\n", database[i].nameBook);
-         }
-         else
-         {
-            printf("This book is already borrowed.\n");
-         }
+         printf("Invalid patron number.\n");
+         int ch;
+         while ((ch = getchar()) != '\n' && ch != EOF)
+            ;
          return;
       }
+      getchar();
+
+      char date[11];
+      int32_t day = currentDay();
+      formatDate(day, date, sizeof(date));
+
+      // Log the change before applying it
+      Database book;
+      readBook(catalog, i, &book);
+      if (!journalAppendBorrow(&catalog->journal, i, book.isbn, date, copy, patron))
+      {
+         printf("Error: The book could not be borrowed.\n");
+         return;
+      }
+      lendCopy(catalog, i, copy, patron, day);
+      if (book.copies > 1)
+      {
+         printf("Copy %d of '%s' has been borrowed successfully!\n", copy, book.nameBook);
+      }
+      else
+      {
+         printf("Book '%s' has been borrowed successfully!\n", book.nameBook);
+      }
+      journalCheckpoint(&catalog->journal, catalog);
+   }
+   else
+   {
+      printf(bookCopies(catalog, i) > 1 ? "All copies of this book are borrowed.\n" : "This book is already borrowed.\n");
    }
-   printf("Book with ISBN %s not found.\n", isbn);
 }
 
-//====== SHOW BORROWED BOOKS FUNCTION ======
+//====== SHOW PATRON LOANS FUNCTION ======
 /*
-    showBorrowedBooks function:
-    - Displays all books currently marked as borrowed.
-    - Shows ISBN, title, authors, and borrow date.
+    showPatronLoans function:
+    - Displays the copies lent to a patron, in the order they were lent, from the patron index.
+    - Shows ISBN, title, copy number and borrow date.
 */
-void showBorrowedBooks(Database *database, int currentSize)
+void showPatronLoans(const Catalog *catalog, int patron)
 {
-   int found = 0;
-   printf("\nBooks currently borrowed:\n");
-
-   for (int i = 0; i < currentSize; i++)
+   PatronLoan loans[256];
+   int total = findPatronLoans(catalog, patron, loans, 256);
+   for (int j = 0; j < total && j < 256; j++)
    {
-      if (strcmp(database[i].borrowed, "true") == 0)
-      {
-         found = 1;
-         printf("ISBN: %s\n", database[i].isbn);
-         printf("Title: %s\n", database[i].nameBook);
-         printf("Author(s): %s\n", database[i].authors);
-         printf("Borrowed on: %s\n\n", database[i].date);
-      }
+      StringView isbn = bookIsbn(catalog, loans[j].row);
+      StringView title = bookTitle(catalog, loans[j].row);
+      char date[11];
+      formatDate(loans[j].day, date, sizeof(date));
+      printf("ISBN: %.*s\n", isbn.length, isbn.data);
+      printf("Title: %.*s\n", title.length, title.data);
+      printf("Copy: %d\n", loans[j].copy);
+      printf("Borrowed on: %s\n\n", date);
    }
-   if (!found)
+   if (total > 256)
    {
-      printf("No books are currently borrowed.\n");
+      printf("... and %d more.\n", total - 256);
+   }
+   if (total == 0)
+   {
+      printf("This patron has no books.\n");
    }
 }
 
-//====== SAVE DATABASE FUNCTION ======
+//====== SHOW COMPLETIONS FUNCTION ======
 /*
-    saveDatabase function:
-    - Saves all books in the database to the specified file.
-    - Overwrites the file with the current state of the database.
+    showCompletions function:
+    - Displays the most common titles or author names (field COMPLETE_TITLE or COMPLETE_AUTHOR) starting
+      with the given text, looked up in the completion index, with their number of books.
 */
-void saveDatabase(const char *filename, Database *database, int currentSize)
+void showCompletions(const Catalog *catalog, int field, const char *prefix)
 {
-   FILE *file = fopen(filename, "w");
-   if (!file)
+   Completion completions[10];
+   int found = completionIndexFind(&catalog->completions, field, prefix, completions, 10);
+   if (found == 0)
    {
-      printf("Error! Unable to open file for writing.\n");
+      printf(field == COMPLETE_TITLE ? "No titles start with: %s\n" : "No author names start with: %s\n", prefix);
       return;
    }
-   for (int i = 0; i < currentSize; i++)
+   printf("\nSuggestions:\n");
+   for (int i = 0; i < found; i++)
    {
-      fprintf(file, "%s|%s|%s|%d|%s|%s|%s\n",
-              database[i].isbn, database[i].nameBook, database[i].authors,
-              database[i].year, database[i].genre, database[i].borrowed,
-              database[i].date);
+      printf("%d. %s (%d book%s)\n", i + 1, completions[i].text, completions[i].count, completions[i].count == 1 ? "" : "s");
    }
-
-   fclose(file);
 }
 
-//====== TO LOWERCASE FUNCTION ======
+//====== SHOW FACETS FUNCTION ======
 /*
-    toLowerCase function:
-    - Converts a string to lowercase for case-insensitive comparisons.
-    - Skips newline and carriage return characters.
+    showFacets function:
+    - Displays how many books there are, and how many are borrowed, per genre and per decade, from the
+      counters of the facet index; with a genre name, only among the books of that genre.
 */
-void toLowerCase(char *str)
+void showFacets(const Catalog *catalog, const char *genre)
 {
-   for (int i = 0; str[i]; i++)
+   FacetFilter filter = {0, INT32_MIN, INT32_MAX, FACET_ANY};
+   if (genre[strspn(genre, " \t")] != '\0')
    {
-      if (str[i] != '\n' && str[i] != '\r')
+      int id = facetIndexGenre(&catalog->facets, genre, (int)strlen(genre));
+      if (id < 0)
       {
-         str[i] = tolower(str[i]);
+         printf("No books have the genre: %s\n", genre);
+         return;
       }
+      filter.genres = (uint64_t)1 << id;
+   }
+
+   static DecadeCount decades[FACET_MAX_DECADES];
+   FacetCounts counts;
+   facetIndexCount(&catalog->facets, catalog, &filter, &counts, decades, FACET_MAX_DECADES);
+   int ids[FACET_MAX_GENRES];
+   int genres = facetCountsGenres(&counts, ids);
+   printf("\n%d book%s, %d borrowed\n", counts.books, counts.books == 1 ? "" : "s", counts.borrowed);
+   printf("\nBy genre:\n");
+   for (int i = 0; i < genres; i++)
+   {
+      printf("%-30s %8d books, %8d borrowed\n", facetIndexGenreName(&catalog->facets, ids[i]),
+             counts.genreBooks[ids[i]], counts.genreBorrowed[ids[i]]);
+   }
+   printf("\nBy decade:\n");
+   for (int i = 0; i < counts.decadeCount; i++)
+   {
+      printf("%5ds %8d books, %8d borrowed\n", counts.decades[i].decade, counts.decades[i].books,
+             counts.decades[i].borrowed);
+   }
+}
+
+//====== SHOW BORROWED BOOKS FUNCTION ======
+/*
+    showBorrowedBooks function:
+    - Displays the books borrowed before the given day (INT32_MAX for all borrowed books), oldest loan first.
+    - Reads them from the borrow index a page at a time, so the work depends only on the number of books shown.
+    - Shows ISBN, title, authors, and borrow date.
+*/
+void showBorrowedBooks(const Catalog *catalog, int32_t before)
+{
+   int rows[256];
+   int shown = 0;
+   int total;
+   do
+   {
+      total = borrowIndexBetween(&catalog->borrowIndex, INT32_MIN, before == INT32_MAX ? INT32_MAX : before - 1, shown, rows, 256);
+      int count = total - shown < 256 ? total - shown : 256;
+      for (int j = 0; j < count; j++)
+      {
+         int i = rows[j];
+         StringView isbn = bookIsbn(catalog, i);
+         StringView title = bookTitle(catalog, i);
+         StringView authors = bookAuthors(catalog, i);
+         char date[11];
+         formatDate(bookBorrowDay(catalog, i), date, sizeof(date));
+         printf("ISBN: %.*s\n", isbn.length, isbn.data);
+         printf("Title: %.*s\n", title.length, title.data);
+         printf("Author(s): %.*s\n", authors.length, authors.data);
+         printf("Borrowed on: %s\n\n", date);
+      }
+      shown += count;
+   } while (shown < total);
+   if (total == 0)
+   {
+      printf(before == INT32_MAX ? "No books are currently borrowed.\n" : "No books are overdue.\n");
    }
 }
 
 //====== FIND BOOK BY ISBN FUNCTION ======
 /*
     findBookByISBN function:
-    - Searches for a book by ISBN and displays its details.
+    - Looks up a book in the ISBN index and displays its details.
     - Offers options to borrow or delete the book, or return to the search/main menu.
     - Sets exitToMain flag to 1 if returning to the main menu.
 */
-void findBookByISBN(Database *database, int currentSize, const char *isbn, int *exitToMain)
+void findBookByISBN(Catalog *catalog, const char *isbn, int *exitToMain)
 {
-   int bookFound = 0;
-   for (int i = 0; i < currentSize; i++)
+   STATS_START(statStart);
+   int i = isbnIndexFind(&catalog->isbnIndex, catalog, isbn);
+   STATS_STOP(STAT_FIND_ISBN, statStart);
+   if (i == -1)
    {
-      if (strcmp(database[i].isbn, isbn) == 0)
-      {
-         Database *selectedBook = &database[i];
-
-         // Display book details
-         printf("\nBook found:\n");
-         printf("ISBN: %s\n", selectedBook->isbn);
-         printf("Title: %s\n", selectedBook->nameBook);
-         printf("Authors: %s\n", selectedBook->authors);
-         printf("Year: %d\n", selectedBook->year);
-         printf("Genre: %s\n", selectedBook->genre);
-         printf("Borrowed: %s\n", selectedBook->borrowed);
-         printf("Date: %s\n", selectedBook->date);
-         printf("-----------------------\n");
-         printf("What would you like to do with this book?\n");
-         printf("1. Borrow the book\n");
-         printf("2. Delete the book\n");
-         printf("3. Back to search menu\n");
-         printf("4. Back to main menu\n");
-
-         int action;
-         scanf("%d", &action);
-         getchar();
+      printf("Book with ISBN %s not found.\n", isbn);
+      return;
+   }
 
-         // Handle user action
-         switch (action)
-         {
-         case 1:
-            borrowBook(database, &currentSize, selectedBook->isbn);
-            saveDatabase("books.db", database, currentSize);
-            break;
-         case 2:
-            deleteBook(database, &currentSize, i);
-            saveDatabase("books.db", database, currentSize);
-            break;
-         case 3:
-            printf("Returning to search menu...\n");
-            return;
-         case 4:
-            printf("Returning to main menu...\n");
-            *exitToMain = 1;
-            return;
-         default:
-            printf("Invalid action. Returning to search menu...\n");
-            return;
-         }
+   Database book;
+   readBook(catalog, i, &book);
+   Database *selectedBook = &book;
+
+   // Display book details
+   printf("\nBook found:\n");
+   printf("ISBN: %s\n", selectedBook->isbn);
+   printf("Title: %s\n", selectedBook->nameBook);
+   printf("Authors: %s\n", selectedBook->authors);
+   printf("Year: %d\n", selectedBook->year);
+   printf("Genre: %s\n", selectedBook->genre);
+   printf("Copies: %d (%d available)\n", selectedBook->copies, selectedBook->copies - lentCopies(catalog, i));
+   printf("Borrowed: %s\n", selectedBook->borrowed);
+   printf("Date: %s\n", selectedBook->date);
+   printf("-----------------------\n");
+   printf("What would you like to do with this book?\n");
+   printf("1. Borrow the book\n");
+   printf("2. Delete the book\n");
+   printf("3. Back to search menu\n");
+   printf("4. Back to main menu\n");
 
-         bookFound = 1;
-         break;
-      }
-   }
-   if (!bookFound)
+   int action;
+   scanf("%d", &action);
+   getchar();
+
+   // Handle user action
+   switch (action)
    {
-      printf("Book with ISBN %s not found.\n", isbn);
+   case 1:
+      borrowBook(catalog, selectedBook->isbn);
+      break;
+   case 2:
+      deleteBook(catalog, i);
+      break;
+   case 3:
+      printf("Returning to search menu...\n");
+      break;
+   case 4:
+      printf("Returning to main menu...\n");
+      *exitToMain = 1;
+      break;
+   default:
+      printf("Invalid action. Returning to search menu...\n");
    }
 }
 
-//====== FIND BOOK BY TITLE FUNCTION ======
+//====== CHOOSE FOUND BOOK FUNCTION ======
 /*
-    findBookByTitle function:
-    - Searches for books by title (case-insensitive, partial match).
-    - Displays matching books and allows the user to select one for actions.
+    chooseFoundBook function:
+    - Lets the user pick one of the books found by a search.
+    - If morePages is set, -1 asks for the next page of results instead.
     - Offers options to borrow, delete, or return to the search/main menu.
     - Sets exitToMain flag to 1 if returning to the main menu.
+    - Returns 1 if the user asked for the next page, 0 otherwise.
 */
-void findBookByTitle(Database *database, int currentSize, const char *title, int *exitToMain)
+int chooseFoundBook(Catalog *catalog, const int *foundIndexes, int foundCount, int morePages, int *exitToMain)
 {
-   int foundIndexes[100];
-   int foundCount = 0;
-   char lowerTitle[50];
-   strcpy(lowerTitle, title);
-   toLowerCase(lowerTitle);
-
-   // Find matching books
-   for (int i = 0; i < currentSize; i++)
-   {
-      char lowerName[50];
-      strcpy(lowerName, database[i].nameBook);
-      toLowerCase(lowerName);
-
-      if (strstr(lowerName, lowerTitle) != NULL)
-      {
-         printf("%d. %s (ISBN: %s)\n", foundCount + 1, database[i].nameBook, database[i].isbn);
-         foundIndexes[foundCount++] = i;
-      }
-   }
-
-   // Handle no matches
-   if (foundCount == 0)
-   {
-      printf("No books found with title containing: %s\n", title);
-      return;
-   }
-
    // Prompt for book selection
-   printf("\nChoose a book by index (0 to cancel): ");
+   printf(morePages ? "\nChoose a book by index (0 to cancel, -1 for the next page): " : "\nChoose a book by index (0 to cancel): ");
    int choice;
    scanf("%d", &choice);
    getchar();
 
+   if (morePages && choice == -1)
+   {
+      return 1;
+   }
    if (choice < 1 || choice > foundCount)
    {
       printf("Returning to search menu...\n");
-      return;
+      return 0;
    }
 
    int selectedBookIndex = foundIndexes[choice - 1];
-   Database *selectedBook = &database[selectedBookIndex];
+   Database book;
+   readBook(catalog, selectedBookIndex, &book);
+   Database *selectedBook = &book;
 
    // Display selected book and options
    printf("\nYou selected: %s (ISBN: %s)\n", selectedBook->nameBook, selectedBook->isbn);
@@ -570,12 +478,10 @@ void findBookByTitle(Database *database, int currentSize, const char *title, int
    switch (action)
    {
    case 1:
-      borrowBook(database, &currentSize, selectedBook->isbn);
-      saveDatabase("books.db", database, currentSize);
+      borrowBook(catalog, selectedBook->isbn);
       break;
    case 2:
-      deleteBook(database, &currentSize, selectedBookIndex);
-      saveDatabase("books.db", database, currentSize);
+      deleteBook(catalog, selectedBookIndex);
       break;
    case 3:
       printf("Returning to search menu...\n");
@@ -587,35 +493,189 @@ void findBookByTitle(Database *database, int currentSize, const char *title, int
    default:
       printf("Invalid action. Returning to search menu...\n");
    }
+   return 0;
+}
+
+//====== FIND BOOK BY TITLE FUNCTION ======
+/*
+    findBookByTitle function:
+    - Searches for books by title (case-insensitive, partial match) through the title trigram index.
+    - Shows the matches a page at a time, best first (exact titles, then titles starting with the text,
+      then titles with a word starting with it), and fetches a page only when the user asks for it.
+    - Allows the user to select one of the books on a page for actions.
+    - Offers options to borrow, delete, or return to the search/main menu.
+    - Sets exitToMain flag to 1 if returning to the main menu.
+*/
+void findBookByTitle(Catalog *catalog, const char *title, int *exitToMain)
+{
+   TitleCursor cursor;
+   titleCursorStart(&cursor);
+   TitleMatch matches[TITLE_PAGE_SIZE];
+   int foundIndexes[TITLE_PAGE_SIZE];
+   int shown = 0;
+   int foundCount;
+   do
+   {
+      foundCount = titleSearchPage(catalog, title, &cursor, matches, TITLE_PAGE_SIZE);
+      for (int i = 0; i < foundCount; i++)
+      {
+         foundIndexes[i] = matches[i].row;
+         StringView name = bookTitle(catalog, foundIndexes[i]);
+         StringView isbn = bookIsbn(catalog, foundIndexes[i]);
+         printf("%d. %.*s (ISBN: %.*s)\n", i + 1, name.length, name.data, isbn.length, isbn.data);
+      }
+      shown += foundCount;
+   } while (foundCount > 0 && chooseFoundBook(catalog, foundIndexes, foundCount, !cursor.done, exitToMain));
+
+   // Handle no matches
+   if (shown == 0)
+   {
+      printf("No books found with title containing: %s\n", title);
+   }
+}
+
+//====== FIND BOOK BY KEYWORDS FUNCTION ======
+/*
+    findBookByKeywords function:
+    - Searches for books whose title, authors or genre contain every given word (looked up in the token index).
+    - A word can be limited to one field with a "title:", "author:" or "genre:" prefix.
+    - If fuzzy is set, searches titles and authors instead, letting every word be off by a few typos
+      (closest books first).
+    - Displays matching books and allows the user to select one for actions.
+    - Sets exitToMain flag to 1 if returning to the main menu.
+*/
+void findBookByKeywords(Catalog *catalog, const char *keywords, int fuzzy, int *exitToMain)
+{
+   int foundIndexes[100];
+   int foundCount = fuzzy ? tokenIndexFuzzySearch(&catalog->tokenIndex, catalog, keywords, TOKEN_FUZZY_MAX_DISTANCE,
+                                                  foundIndexes, 100)
+                          : tokenIndexSearch(&catalog->tokenIndex, catalog, keywords, foundIndexes, 100);
+
+   // Handle empty queries and no matches
+   if (foundCount < 0)
+   {
+      printf("Please enter at least one word to search for.\n");
+      return;
+   }
+   if (foundCount == 0)
+   {
+      printf("No books found matching: %s\n", keywords);
+      return;
+   }
+
+   if (foundCount > 100)
+   {
+      printf("%d books found, showing the first 100.\n", foundCount);
+      foundCount = 100;
+   }
+   for (int i = 0; i < foundCount; i++)
+   {
+      StringView name = bookTitle(catalog, foundIndexes[i]);
+      StringView isbn = bookIsbn(catalog, foundIndexes[i]);
+      printf("%d. %.*s (ISBN: %.*s)\n", i + 1, name.length, name.data, isbn.length, isbn.data);
+   }
+
+   chooseFoundBook(catalog, foundIndexes, foundCount, 0, exitToMain);
+}
+
+//====== FIND BOOK BY YEAR FUNCTION ======
+/*
+    findBookByYear function:
+    - Searches for books published between two years (inclusive) in the year index, oldest first.
+    - Displays the first 100 matching books and allows the user to select one for actions.
+    - Sets exitToMain flag to 1 if returning to the main menu.
+*/
+void findBookByYear(Catalog *catalog, int minYear, int maxYear, int *exitToMain)
+{
+   int foundIndexes[101];
+   int foundCount = yearIndexRange(&catalog->yearIndex, catalog, minYear, maxYear, foundIndexes, 101);
+
+   // Handle no matches
+   if (foundCount == 0)
+   {
+      printf("No books found published between %d and %d\n", minYear, maxYear);
+      return;
+   }
+
+   if (foundCount > 100)
+   {
+      printf("More than 100 books found, showing the first 100.\n");
+      foundCount = 100;
+   }
+   for (int i = 0; i < foundCount; i++)
+   {
+      StringView name = bookTitle(catalog, foundIndexes[i]);
+      StringView isbn = bookIsbn(catalog, foundIndexes[i]);
+      printf("%d. %.*s, %d (ISBN: %.*s)\n", i + 1, name.length, name.data, bookYear(catalog, foundIndexes[i]), isbn.length, isbn.data);
+   }
+
+   chooseFoundBook(catalog, foundIndexes, foundCount, 0, exitToMain);
 }
 
 //====== RETURN BOOK FUNCTION ======
 /*
     returnBook function:
-    - Marks a book as returned by ISBN.
-    - Resets borrow status to "false" and date to "-".
+    - Puts a borrowed copy of a book, found by ISBN in the ISBN index, back on the shelf.
+    - Asks which copy if several copies of the book are borrowed.
     - Checks if the book exists and is borrowed.
+    - Records the change in the journal.
 */
-void returnBook(Database *database, int currentSize, const char *isbn)
+void returnBook(Catalog *catalog, const char *isbn)
 {
-   for (int i = 0; i < currentSize; i++)
+   int i = isbnIndexFind(&catalog->isbnIndex, catalog, isbn);
+   if (i == -1)
+   {
+      printf("Book with ISBN %s not found.\n", isbn);
+      return;
+   }
+
+   int lent = lentCopies(catalog, i);
+   if (lent == 0)
    {
-      if (strcmp(database[i].isbn, isbn) == 0)
+      printf("This book was not borrowed.\n");
+      return;
+   }
+
+   int copy = 0;
+   int32_t patron, day;
+   if (lent > 1)
+   {
+      printf("%d copies of this book are borrowed. Enter the copy number to return (1-%d): ", lent, bookCopies(catalog, i));
+      if (scanf("%d", &copy) != 1 || !copyLoan(catalog, i, copy, &patron, &day))
       {
-         if (strcmp(database[i].borrowed, "true") == 0)
-         {
-            strcpy(database[i].borrowed, "false");
-            strcpy(database[i].date, "-");
-            printf("Book '%s' has been returned successfully!\n", database[i].nameBook);
-         }
-         else
-         {
-            printf("This book was not borrowed.\n");
-         }
+         printf("This copy was not borrowed.\n");
+         int ch;
+         while ((ch = getchar()) != '\n' && ch != EOF)
+            ;
          return;
       }
+      getchar();
    }
-   printf("Book with ISBN %s not found.\n", isbn);
+   else
+   {
+      int copies = bookCopies(catalog, i);
+      do
+      {
+         copy++;
+      } while (copy <= copies && !copyLoan(catalog, i, copy, &patron, &day));
+      if (copy > copies)
+      {
+         printf("Error: No loan is recorded for any copy of this book.\n");
+         return;
+      }
+   }
+
+   // Log the change before applying it
+   Database book;
+   readBook(catalog, i, &book);
+   if (!journalAppendReturn(&catalog->journal, i, book.isbn, copy))
+   {
+      printf("Error: The book could not be returned.\n");
+      return;
+   }
+   returnCopy(catalog, i, copy);
+   printf("Book '%s' has been returned successfully!\n", book.nameBook);
+   journalCheckpoint(&catalog->journal, catalog);
 }
 
 //====== MAIN FUNCTION ======
@@ -624,29 +684,91 @@ void returnBook(Database *database, int currentSize, const char *isbn)
     - Entry point of the program.
     - Loads the database, displays a menu, and handles user interactions.
     - Supports adding, searching, returning books, and exiting the program.
+    - "library --batch [file]" runs the commands of file (or of stdin if it is missing or "-") without any menus,
+      printing one JSON result per command.
+    - "library --serve [socket]" serves the same commands to many clients over a Unix socket (see serveLibrary).
+    - "library --export|--import|--check db|csv|jsonl [file]" converts or checks a catalog one book at a time
+      (see exportCatalog, importCatalog and checkCatalog).
 */
-int main(void)
+int main(int argc, char *argv[])
 {
-   Database *database = NULL;
-   int currentSize = 0;
-   int maxSize = 50;
+   Catalog catalog = {0};
+
+   // Batch mode: commands in, results out, nothing else on stdout
+   if (argc > 1 && strcmp(argv[1], "--batch") == 0)
+   {
+      FILE *input = stdin;
+      if (argc > 2 && strcmp(argv[2], "-") != 0 && !(input = fopen(argv[2], "r")))
+      {
+         fprintf(stderr, "Error: Unable to open %s.\n", argv[2]);
+         return 1;
+      }
+      int ok = loadDatabase(&catalog) && runBatch(&catalog, input, stdout);
+      if (input != stdin)
+      {
+         fclose(input);
+      }
+      journalClose(&catalog.journal);
+      statsPoll(1);
+      freeCatalog(&catalog);
+      return ok ? 0 : 1;
+   }
+
+   // Server mode: one shared catalog for every front desk
+   if (argc > 1 && strcmp(argv[1], "--serve") == 0)
+   {
+      printf("Loading database...\n");
+      int ok = loadDatabase(&catalog) && serveLibrary(&catalog, argc > 2 ? argv[2] : SERVER_DEFAULT_SOCKET);
+      journalClose(&catalog.journal);
+      statsPoll(1);
+      freeCatalog(&catalog);
+      return ok ? 0 : 1;
+   }
+
+   // Streaming export, import and check: one book at a time, the catalog is never loaded
+   if (argc > 2 && (strcmp(argv[1], "--export") == 0 || strcmp(argv[1], "--import") == 0 ||
+                    strcmp(argv[1], "--check") == 0))
+   {
+      BookFormat format;
+      if (!parseFormat(argv[2], &format))
+      {
+         return 1;
+      }
+      const char *path = argc > 3 ? argv[3] : NULL;
+      int ok;
+      if (strcmp(argv[1], "--export") == 0)
+      {
+         ok = exportCatalog(format, path);
+      }
+      else if (strcmp(argv[1], "--import") == 0)
+      {
+         ok = importCatalog(format, path);
+      }
+      else
+      {
+         ok = checkCatalog(format, path);
+      }
+      return ok ? 0 : 1;
+   }
 
    // Load database
    printf("Loading database...\n");
-   if (!loadDatabase(&database, &currentSize))
+   if (!loadDatabase(&catalog))
    {
       printf("Error: Could not load the database. Exiting...\n");
-      free(database);
+      journalClose(&catalog.journal);
+      freeCatalog(&catalog);
       return 1;
    }
 
    int exitToMain = 0;
-   printf("Database loaded successfully. Total books: %d\n", currentSize);
+   printf("Database loaded successfully. Total books: %d\n", catalog.count - catalog.deleted);
    printf("Hello! Please, choose what you want to do: \n");
 
    // Main menu loop
    while (1)
    {
+      statsPoll(0);
       exitToMain = 0;
       printf("----------------------\n");
       printf("Main menu:\n");
@@ -679,7 +801,14 @@ int main(void)
             printf("1. Find the book by its title\n");
             printf("2. Find by the ISBN-13\n");
             printf("3. Show the borrowed books\n");
-            printf("4. Return back to main menu\n");
+            printf("4. Find by keywords (title, author, genre)\n");
+            printf("5. Find by publication year range\n");
+            printf("6. Show the overdue books\n");
+            printf("7. Show the books of a patron\n");
+            printf("8. Complete a title or an author name\n");
+            printf("9. Find by title or author words, allowing typos\n");
+            printf("10. Count the books by genre and decade\n");
+            printf("11. Return back to main menu\n");
             printf("----------------------\n");
             printf("Make your choice: ");
             int subChoice;
@@ -695,7 +824,7 @@ int main(void)
                printf("Books found:\n");
                printf("----------------------\n");
                title[strcspn(title, "\n")] = '\0';
-               findBookByTitle(database, currentSize, title, &exitToMain);
+               findBookByTitle(&catalog, title, &exitToMain);
             }
             else if (subChoice == 2)
             {
@@ -704,15 +833,119 @@ int main(void)
                printf("Enter ISBN to search: ");
                fgets(isbn, sizeof(isbn), stdin);
                isbn[strcspn(isbn, "\n")] = '\0';
-               findBookByISBN(database, currentSize, isbn, &exitToMain);
+               findBookByISBN(&catalog, isbn, &exitToMain);
             }
             else if (subChoice == 3)
             {
                printf("----------------------\n");
                printf("Showing borrowed books...\n");
-               showBorrowedBooks(database, currentSize);
+               printf("\nBooks currently borrowed:\n");
+               showBorrowedBooks(&catalog, INT32_MAX);
             }
             else if (subChoice == 4)
+            {
+               char keywords[100];
+               printf("----------------------\n");
+               printf("Enter keywords (e.g. orwell, title:farm, genre:fantasy): ");
+               fgets(keywords, sizeof(keywords), stdin);
+               printf("Books found:\n");
+               printf("----------------------\n");
+               keywords[strcspn(keywords, "\n")] = '\0';
+               findBookByKeywords(&catalog, keywords, 0, &exitToMain);
+            }
+            else if (subChoice == 5)
+            {
+               int minYear, maxYear;
+               printf("----------------------\n");
+               printf("Enter the first and the last year (e.g. 1900 1950): ");
+               if (scanf("%d %d", &minYear, &maxYear) != 2)
+               {
+                  printf("Invalid years! Try again.\n");
+                  int ch;
+                  while ((ch = getchar()) != '\n' && ch != EOF)
+                     ;
+                  continue;
+               }
+               getchar();
+               printf("Books found:\n");
+               printf("----------------------\n");
+               findBookByYear(&catalog, minYear, maxYear, &exitToMain);
+            }
+            else if (subChoice == 6)
+            {
+               int days;
+               printf("----------------------\n");
+               printf("Enter the loan period in days: ");
+               if (scanf("%d", &days) != 1 || days < 0)
+               {
+                  printf("Invalid number of days! Try again.\n");
+                  int ch;
+                  while ((ch = getchar()) != '\n' && ch != EOF)
+                     ;
+                  continue;
+               }
+               getchar();
+               printf("\nBooks borrowed more than %d days ago:\n", days);
+               showBorrowedBooks(&catalog, currentDay() - days);
+            }
+            else if (subChoice == 7)
+            {
+               int patron;
+               printf("----------------------\n");
+               printf("Enter the patron number: ");
+               if (scanf("%d", &patron) != 1 || patron < 1)
+               {
+                  printf("Invalid patron number! Try again.\n");
+                  int ch;
+                  while ((ch = getchar()) != '\n' && ch != EOF)
+                     ;
+                  continue;
+               }
+               getchar();
+               printf("\nBooks borrowed by patron %d:\n", patron);
+               showPatronLoans(&catalog, patron);
+            }
+            else if (subChoice == 8)
+            {
+               int field;
+               char prefix[100];
+               printf("----------------------\n");
+               printf("Complete 1. a title or 2. an author name: ");
+               if (scanf("%d", &field) != 1 || (field != 1 && field != 2))
+               {
+                  printf("Invalid choice! Try again.\n");
+                  int ch;
+                  while ((ch = getchar()) != '\n' && ch != EOF)
+                     ;
+                  continue;
+               }
+               getchar();
+               printf("Enter the beginning: ");
+               fgets(prefix, sizeof(prefix), stdin);
+               prefix[strcspn(prefix, "\n")] = '\0';
+               showCompletions(&catalog, field == 1 ? COMPLETE_TITLE : COMPLETE_AUTHOR, prefix);
+            }
+            else if (subChoice == 9)
+            {
+               char words[100];
+               printf("----------------------\n");
+               printf("Enter words of the title or author, typos allowed (e.g. tolkein hobit): ");
+               fgets(words, sizeof(words), stdin);
+               printf("Books found:\n");
+               printf("----------------------\n");
+               words[strcspn(words, "\n")] = '\0';
+               findBookByKeywords(&catalog, words, 1, &exitToMain);
+            }
+            else if (subChoice == 10)
+            {
+               char genre[100];
+               printf("----------------------\n");
+               printf("Enter a genre, or nothing for all books: ");
+               fgets(genre, sizeof(genre), stdin);
+               genre[strcspn(genre, "\n")] = '\0';
+               showFacets(&catalog, genre);
+            }
+            else if (subChoice == 11)
             {
                printf("Going back to the main menu...\n");
                break;
@@ -729,8 +962,7 @@ int main(void)
          break;
       }
       case 2:
-         addBook(&database, &currentSize, &maxSize);
-         saveDatabase("books.db", database, currentSize);
+         addBook(&catalog);
          break;
       case 3:
       {
@@ -740,14 +972,15 @@ int main(void)
          getchar();
          fgets(isbn, sizeof(isbn), stdin);
          isbn[strcspn(isbn, "\n")] = '\0';
-         returnBook(database, currentSize, isbn);
-         saveDatabase("books.db", database, currentSize);
+         returnBook(&catalog, isbn);
          break;
       }
       case 4:
          printf("----------------------\n");
          printf("Program was ended. Have a nice day!\n");
-         free(database);
+         journalClose(&catalog.journal);
+         statsPoll(1);
+         freeCatalog(&catalog);
          return 0;
       }
    }
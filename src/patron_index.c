@@ -0,0 +1,168 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "patron_index.h"
+#include "stats.h"
+
+//====== HASH PATRON FUNCTION ======
+/*
+    hashPatron function:
+    - Spreads patron numbers, which are often consecutive, over the slot table (Fibonacci hashing).
+*/
+static unsigned int hashPatron(int32_t patron)
+{
+   return (unsigned int)patron * 2654435761u;
+}
+
+//====== FIND SLOT FUNCTION ======
+/*
+    findSlot function:
+    - Returns the slot holding the patron's list, or the empty slot where it would go.
+*/
+static unsigned int findSlot(const PatronIndex *index, int32_t patron)
+{
+   unsigned int mask = index->slotCapacity - 1;
+   unsigned int pos = hashPatron(patron) & mask;
+   while (index->slots[pos] != -1 && index->lists[index->slots[pos]].patron != patron)
+   {
+      pos = (pos + 1) & mask;
+   }
+   return pos;
+}
+
+//====== RESIZE SLOTS FUNCTION ======
+/*
+    resizeSlots function:
+    - Allocates a slot table of the given capacity (a power of two) and places every list in it.
+    - Returns 1 on success, 0 on memory allocation failure (the old table is kept).
+*/
+static int resizeSlots(PatronIndex *index, unsigned int capacity)
+{
+   int32_t *slots = malloc(capacity * sizeof(int32_t));
+   if (!slots)
+   {
+      fprintf(stderr, "Error: Memory allocation for patron index failed.\n");
+      return 0;
+   }
+   memset(slots, 0xff, capacity * sizeof(int32_t));
+   free(index->slots);
+   index->slots = slots;
+   index->slotCapacity = capacity;
+   for (int i = 0; i < index->count; i++)
+   {
+      index->slots[findSlot(index, index->lists[i].patron)] = i;
+   }
+   STATS_ADD(STAT_REALLOCS, 1);
+   return 1;
+}
+
+//====== ADD TO PATRON INDEX FUNCTION ======
+/*
+    patronIndexAdd function:
+    - Adds a copy to the loans of a patron, creating the patron's list on their first loan.
+    - Keeps the slot table at most half full.
+    - Returns 1 on success, 0 on memory allocation failure.
+*/
+int patronIndexAdd(PatronIndex *index, int32_t patron, int32_t copy)
+{
+   if (2u * (unsigned int)(index->count + 1) > index->slotCapacity &&
+       !resizeSlots(index, index->slotCapacity ? 2 * index->slotCapacity : 16))
+   {
+      return 0;
+   }
+
+   unsigned int slot = findSlot(index, patron);
+   if (index->slots[slot] == -1)
+   {
+      if (index->count == index->capacity)
+      {
+         int capacity = index->capacity ? 2 * index->capacity : 16;
+         PatronLoans *lists = realloc(index->lists, capacity * sizeof(PatronLoans));
+         if (!lists)
+         {
+            fprintf(stderr, "Error: Memory allocation for patron index failed.\n");
+            return 0;
+         }
+         index->lists = lists;
+         index->capacity = capacity;
+         STATS_ADD(STAT_REALLOCS, 1);
+      }
+      PatronLoans *list = &index->lists[index->count];
+      list->patron = patron;
+      list->copies = NULL;
+      list->count = 0;
+      list->capacity = 0;
+      index->slots[slot] = index->count++;
+   }
+
+   PatronLoans *list = &index->lists[index->slots[slot]];
+   if (list->count == list->capacity)
+   {
+      int capacity = list->capacity ? 2 * list->capacity : 4;
+      int32_t *copies = realloc(list->copies, capacity * sizeof(int32_t));
+      if (!copies)
+      {
+         fprintf(stderr, "Error: Memory allocation for patron index failed.\n");
+         return 0;
+      }
+      list->copies = copies;
+      list->capacity = capacity;
+   }
+   list->copies[list->count++] = copy;
+   return 1;
+}
+
+//====== REMOVE FROM PATRON INDEX FUNCTION ======
+/*
+    patronIndexRemove function:
+    - Removes a returned copy from the loans of its patron, keeping the others in lending order.
+*/
+void patronIndexRemove(PatronIndex *index, int32_t patron, int32_t copy)
+{
+   PatronLoans *list = (PatronLoans *)patronIndexFind(index, patron);
+   if (!list)
+   {
+      return;
+   }
+   for (int i = 0; i < list->count; i++)
+   {
+      if (list->copies[i] == copy)
+      {
+         memmove(list->copies + i, list->copies + i + 1, (list->count - i - 1) * sizeof(int32_t));
+         list->count--;
+         return;
+      }
+   }
+}
+
+//====== FIND IN PATRON INDEX FUNCTION ======
+/*
+    patronIndexFind function:
+    - Returns the loans of a patron, or NULL if the patron never borrowed anything.
+*/
+const PatronLoans *patronIndexFind(const PatronIndex *index, int32_t patron)
+{
+   if (index->slotCapacity == 0)
+   {
+      return NULL;
+   }
+   int32_t list = index->slots[findSlot(index, patron)];
+   return list == -1 ? NULL : &index->lists[list];
+}
+
+//====== FREE PATRON INDEX FUNCTION ======
+/*
+    patronIndexFree function:
+    - Releases every list and the slot table.
+*/
+void patronIndexFree(PatronIndex *index)
+{
+   for (int i = 0; i < index->count; i++)
+   {
+      free(index->lists[i].copies);
+   }
+   free(index->lists);
+   free(index->slots);
+   memset(index, 0, sizeof(*index));
+}
@@ -0,0 +1,36 @@
+#ifndef PATRON_INDEX_H
+#define PATRON_INDEX_H
+
+#include <stdint.h>
+
+//====== PATRON INDEX STRUCTURE DEFINITION ======
+/*
+    PatronIndex structure:
+    - Open-addressing (linear probing) hash table from patron number to the copies lent to that patron.
+    - Copies are numbers in the loan table's copy columns; each patron's list is in lending order.
+    - Returning a copy removes it from its patron's list, so a list only ever holds current loans.
+    - Loans of unknown patrons (patron 0) are not indexed.
+*/
+typedef struct
+{
+   int32_t patron;  // Patron number
+   int32_t *copies; // Copies lent to the patron, in lending order
+   int count;       // Number of copies
+   int capacity;    // Allocated copies
+} PatronLoans;
+
+typedef struct
+{
+   PatronLoans *lists;        // One list per patron seen, in order of first loan
+   int count;                 // Number of lists
+   int capacity;              // Allocated lists
+   int32_t *slots;            // List of each slot, -1 if the slot is empty
+   unsigned int slotCapacity; // Number of slots, a power of two
+} PatronIndex;
+
+int patronIndexAdd(PatronIndex *index, int32_t patron, int32_t copy);
+void patronIndexRemove(PatronIndex *index, int32_t patron, int32_t copy);
+const PatronLoans *patronIndexFind(const PatronIndex *index, int32_t patron);
+void patronIndexFree(PatronIndex *index);
+
+#endif
@@ -0,0 +1,132 @@
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "catalog.h"
+#include "ranked_search.h"
+#include "stats.h"
+
+//====== RANK TITLE FUNCTION ======
+/*
+    rankTitle function:
+    - Grades how well a lowercased title matches a lowercased query of the given length (TITLE_RANK_*).
+    - Looks at every place the query appears, so a word start later in the title beats an earlier infix.
+    - Returns -1 if the title does not contain the query.
+*/
+static int rankTitle(const char *title, const char *query, int length)
+{
+   const char *at = strstr(title, query);
+   if (!at)
+   {
+      return -1;
+   }
+   if (at == title)
+   {
+      return title[length] == '\0' ? TITLE_RANK_EXACT : TITLE_RANK_PREFIX;
+   }
+   for (; at; at = strstr(at + 1, query))
+   {
+      if (!isalnum((unsigned char)at[-1]))
+      {
+         return TITLE_RANK_WORD;
+      }
+   }
+   return TITLE_RANK_INFIX;
+}
+
+// Where the query is looked for in the titles of each rank, so every rank is read as its own stream
+static const int rankAnchor[] = {TRIGRAM_WHOLE_TITLE, TRIGRAM_TITLE_START, TRIGRAM_WORD_START, TRIGRAM_INSIDE_WORD};
+
+//====== START TITLE CURSOR FUNCTION ======
+/*
+    titleCursorStart function:
+    - Sets a cursor before the first page of a search.
+*/
+void titleCursorStart(TitleCursor *cursor)
+{
+   cursor->last.rank = -1;
+   cursor->last.row = -1;
+   cursor->done = 0;
+}
+
+//====== TITLE SEARCH PAGE FUNCTION ======
+/*
+    titleSearchPage function:
+    - Finds the next page of books whose title contains the given text (case-insensitive), best matches
+      first: exact titles, then titles starting with the text, then titles with a word starting with it,
+      then the rest; matches of one rank are in row order.
+    - Reads each rank as its own stream in row order, through the anchored keys of the trigram index,
+      from the cursor on: the cursor's rank after its row, then the next ranks from their first row.
+      A stream only holds the few titles of other ranks that share its key, so a page reads about
+      pageSize matches plus one chunk of each rank it reaches, however deep the cursor is.
+    - Queries shorter than three characters have no trigram inside a word: their infix matches come
+      from scanning the titles, which also passes the better ranked titles between them.
+    - Stores up to pageSize matches in matches and moves the cursor past them; sets cursor->done when no
+      match is left after them.
+    - Returns the number of matches stored.
+*/
+int titleSearchPage(const Catalog *catalog, const char *title, TitleCursor *cursor, TitleMatch *matches, int pageSize)
+{
+   if (cursor->done || pageSize <= 0)
+   {
+      return 0;
+   }
+
+   STATS_START(statStart);
+   char query[FIELD_LIMIT(nameBook) + 1];
+   snprintf(query, sizeof(query), "%s", title);
+   int length = 0;
+   for (; query[length]; length++)
+   {
+      query[length] = (char)tolower((unsigned char)query[length]);
+   }
+
+   // Matches up to the cursor were handed out already
+   int rank = cursor->last.rank < 0 ? TITLE_RANK_EXACT : cursor->last.rank;
+   int from = cursor->last.rank < 0 ? 0 : cursor->last.row + 1;
+
+   // One match past the page tells whether another page follows
+   int rows[TITLE_RANK_CHUNK];
+   int chunk = pageSize < TITLE_RANK_CHUNK ? pageSize + 1 : TITLE_RANK_CHUNK;
+   int count = 0;
+   int more = 0;
+   while (rank <= TITLE_RANK_INFIX && !more)
+   {
+      int found = trigramIndexMatches(&catalog->trigramIndex, catalog, title, rankAnchor[rank], from, rows, chunk);
+      for (int i = 0; i < found && !more; i++)
+      {
+         // The stream of a rank also finds some titles of another one (a later word starting like the query, say)
+         const char *text = catalog->columns.titles + catalog->columns.titleAt[rows[i]];
+         if (rankTitle(text, query, length) != rank || isBookDeleted(catalog, rows[i]))
+         {
+            continue;
+         }
+         if (count == pageSize)
+         {
+            more = 1;
+            continue;
+         }
+         matches[count].rank = rank;
+         matches[count].row = rows[i];
+         count++;
+      }
+
+      if (found == chunk)
+      {
+         from = rows[found - 1] + 1;
+      }
+      else
+      {
+         rank++;
+         from = 0;
+      }
+   }
+
+   if (count > 0)
+   {
+      cursor->last = matches[count - 1];
+   }
+   cursor->done = !more;
+   STATS_STOP(STAT_FIND_TITLE, statStart);
+   return count;
+}
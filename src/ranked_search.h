@@ -0,0 +1,44 @@
+#ifndef RANKED_SEARCH_H
+#define RANKED_SEARCH_H
+
+struct Catalog;
+
+// Match quality of a title that contains the query, best first
+#define TITLE_RANK_EXACT 0  // The title is the query
+#define TITLE_RANK_PREFIX 1 // The title starts with the query
+#define TITLE_RANK_WORD 2   // A later word of the title starts with the query
+#define TITLE_RANK_INFIX 3  // The query only appears inside words
+
+// Matches read from the trigram index at a time while ranking
+#ifndef TITLE_RANK_CHUNK
+#define TITLE_RANK_CHUNK 512
+#endif
+
+//====== TITLE MATCH STRUCTURE DEFINITION ======
+/*
+    TitleMatch structure:
+    - One book found by a ranked title search. Matches are ordered by rank, then by row.
+*/
+typedef struct
+{
+   int rank; // TITLE_RANK_* of the title
+   int row;  // Row of the book
+} TitleMatch;
+
+//====== TITLE CURSOR STRUCTURE DEFINITION ======
+/*
+    TitleCursor structure:
+    - Where a paged title search stands: the next page holds the matches ordered after last.
+    - Only two numbers, so a client can hand it back in a later command; rows are stable until the
+      catalog is compacted, which makes a cursor from before that skip or repeat some books.
+*/
+typedef struct
+{
+   TitleMatch last; // Last match handed out, rank -1 before the first page
+   int done;        // 1 once the last page was handed out
+} TitleCursor;
+
+void titleCursorStart(TitleCursor *cursor);
+int titleSearchPage(const struct Catalog *catalog, const char *title, TitleCursor *cursor, TitleMatch *matches, int pageSize);
+
+#endif
@@ -0,0 +1,591 @@
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "catalog.h"
+#include "image.h"
+#include "scan.h"
+#include "stats.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SCAN_X86 1
+#include <immintrin.h>
+#endif
+
+//====== GROW ROWS FUNCTION ======
+/*
+    growRows function:
+    - Makes room for at least one more row in every column, doubling the capacity.
+    - Returns 1 on success, 0 on memory allocation failure.
+*/
+static int growRows(ScanColumns *columns)
+{
+   if (columns->count < columns->capacity)
+   {
+      return 1;
+   }
+
+   int capacity = columns->capacity ? columns->capacity * 2 : 1024;
+   uint8_t *flags = realloc(columns->flags, capacity);
+   if (flags)
+   {
+      columns->flags = flags;
+   }
+   int32_t *years = realloc(columns->years, capacity * sizeof(int32_t));
+   if (years)
+   {
+      columns->years = years;
+   }
+   uint32_t *titleAt = realloc(columns->titleAt, (capacity + 1) * sizeof(uint32_t));
+   if (titleAt)
+   {
+      columns->titleAt = titleAt;
+   }
+   if (!flags || !years || !titleAt)
+   {
+      fprintf(stderr, "Error: Memory allocation for scan columns failed.\n");
+      return 0;
+   }
+   columns->capacity = capacity;
+   STATS_ADD(STAT_REALLOCS, 1);
+   return 1;
+}
+
+//====== APPEND TO SCAN COLUMNS FUNCTION ======
+/*
+    scanColumnsAppend function:
+    - Copies the flags, year and lowercased title of the given row, which must be the last row of the catalog.
+    - Returns 1 on success, 0 on memory allocation failure.
+*/
+int scanColumnsAppend(ScanColumns *columns, const Catalog *catalog, int row)
+{
+   if (!growRows(columns))
+   {
+      return 0;
+   }
+
+   char title[FIELD_LIMIT(nameBook) + 1];
+   StringView view = bookTitle(catalog, row);
+   snprintf(title, sizeof(title), "%.*s", view.length, view.data);
+   size_t length = strlen(title) + 1;
+   if (columns->titlesSize + length > columns->titlesCapacity)
+   {
+      size_t capacity = columns->titlesCapacity ? columns->titlesCapacity * 2 : 32768;
+      char *titles = realloc(columns->titles, capacity);
+      if (!titles)
+      {
+         fprintf(stderr, "Error: Memory allocation for scan columns failed.\n");
+         return 0;
+      }
+      columns->titles = titles;
+      columns->titlesCapacity = capacity;
+      STATS_ADD(STAT_REALLOCS, 1);
+   }
+
+   char *text = columns->titles + columns->titlesSize;
+   for (size_t i = 0; i < length; i++)
+   {
+      text[i] = (char)tolower((unsigned char)title[i]);
+   }
+   columns->titleAt[columns->count] = (uint32_t)columns->titlesSize;
+   columns->titlesSize += length;
+   columns->titleAt[columns->count + 1] = (uint32_t)columns->titlesSize;
+   columns->flags[columns->count] = catalog->books[row].flags;
+   columns->years[columns->count] = bookYear(catalog, row);
+   columns->count++;
+   return 1;
+}
+
+//====== BUILD SCAN COLUMNS FUNCTION ======
+/*
+    scanColumnsBuild function:
+    - Fills the columns from all rows of the catalog.
+    - Returns 1 on success, 0 on memory allocation failure.
+*/
+int scanColumnsBuild(ScanColumns *columns, const Catalog *catalog)
+{
+   memset(columns, 0, sizeof(*columns));
+   for (int i = 0; i < catalog->count; i++)
+   {
+      if (!scanColumnsAppend(columns, catalog, i))
+      {
+         return 0;
+      }
+   }
+   return 1;
+}
+
+//====== REMOVE FROM SCAN COLUMNS FUNCTION ======
+/*
+    scanColumnsRemove function:
+    - Blanks the row of a deleted book in place, so no scan matches it and no other row moves:
+      its flags become BOOK_DELETED, its year SCAN_NO_YEAR and its title all '\0' bytes.
+*/
+void scanColumnsRemove(ScanColumns *columns, int row)
+{
+   columns->flags[row] = BOOK_DELETED;
+   columns->years[row] = SCAN_NO_YEAR;
+   memset(columns->titles + columns->titleAt[row], 0, columns->titleAt[row + 1] - columns->titleAt[row]);
+}
+
+//====== SET FLAGS FUNCTION ======
+/*
+    scanColumnsSetFlags function:
+    - Copies new flags of a row into the flags column.
+*/
+void scanColumnsSetFlags(ScanColumns *columns, int row, uint8_t flags)
+{
+   columns->flags[row] = flags;
+}
+
+//====== FREE SCAN COLUMNS FUNCTION ======
+/*
+    scanColumnsFree function:
+    - Releases all columns.
+*/
+void scanColumnsFree(ScanColumns *columns)
+{
+   free(columns->flags);
+   free(columns->years);
+   free(columns->titles);
+   free(columns->titleAt);
+   memset(columns, 0, sizeof(*columns));
+}
+
+//====== SCALAR KERNELS ======
+/*
+    flagsScalar, yearsScalar, titlesScalar functions:
+    - Plain loops over the columns, used when no vector unit is available and for the
+      rows left over after the last full vector.
+    - Titles are separated by '\0', which a query never contains, so the vector title kernels
+      can search all titles as one string; a match cannot cross two titles.
+    - Continue an output list that already holds found rows, and return the new count.
+*/
+static int flagsScalar(const ScanColumns *columns, int from, uint8_t mask, int *rows, int found, int maxRows)
+{
+   for (int i = from; i < columns->count && found < maxRows; i++)
+   {
+      if (columns->flags[i] & mask)
+      {
+         rows[found++] = i;
+      }
+   }
+   return found;
+}
+
+static int yearsScalar(const ScanColumns *columns, int from, int minYear, int maxYear, int *rows, int found, int maxRows)
+{
+   for (int i = from; i < columns->count && found < maxRows; i++)
+   {
+      if (columns->years[i] >= minYear && columns->years[i] <= maxYear)
+      {
+         rows[found++] = i;
+      }
+   }
+   return found;
+}
+
+static int titlesScalar(const ScanColumns *columns, int from, const char *query, int *rows, int found, int maxRows)
+{
+   for (int i = from; i < columns->count && found < maxRows; i++)
+   {
+      if (!(columns->flags[i] & BOOK_DELETED) && strstr(columns->titles + columns->titleAt[i], query) != NULL)
+      {
+         rows[found++] = i;
+      }
+   }
+   return found;
+}
+
+#ifdef SCAN_X86
+//====== SSE2 KERNELS ======
+/*
+    flagsSse2, yearsSse2, titlesSse2 functions:
+    - Test 16 flag bytes, 4 years or 16 title positions per instruction.
+    - Set bits of each block's lane mask are turned into rows in ascending order.
+    - Hand the rows left over after the last full vector to the scalar loops.
+*/
+__attribute__((target("sse2"))) static int flagsSse2(const ScanColumns *columns, int from, uint8_t mask, int *rows, int found, int maxRows)
+{
+   const __m128i bits = _mm_set1_epi8((char)mask);
+   const __m128i zero = _mm_setzero_si128();
+   int i = from;
+   for (; i + 16 <= columns->count && found < maxRows; i += 16)
+   {
+      __m128i block = _mm_and_si128(_mm_loadu_si128((const __m128i *)(columns->flags + i)), bits);
+      unsigned int lanes = ~(unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(block, zero)) & 0xFFFFu;
+      while (lanes && found < maxRows)
+      {
+         rows[found++] = i + __builtin_ctz(lanes);
+         lanes &= lanes - 1;
+      }
+   }
+   return flagsScalar(columns, i, mask, rows, found, maxRows);
+}
+
+__attribute__((target("sse2"))) static int yearsSse2(const ScanColumns *columns, int from, int minYear, int maxYear, int *rows, int found, int maxRows)
+{
+   const __m128i low = _mm_set1_epi32(minYear);
+   const __m128i high = _mm_set1_epi32(maxYear);
+   int i = from;
+   for (; i + 4 <= columns->count && found < maxRows; i += 4)
+   {
+      __m128i years = _mm_loadu_si128((const __m128i *)(columns->years + i));
+      __m128i outside = _mm_or_si128(_mm_cmpgt_epi32(low, years), _mm_cmpgt_epi32(years, high));
+      unsigned int lanes = ~(unsigned int)_mm_movemask_ps(_mm_castsi128_ps(outside)) & 0xFu;
+      while (lanes && found < maxRows)
+      {
+         rows[found++] = i + __builtin_ctz(lanes);
+         lanes &= lanes - 1;
+      }
+   }
+   return yearsScalar(columns, i, minYear, maxYear, rows, found, maxRows);
+}
+
+__attribute__((target("sse2"))) static int titlesSse2(const ScanColumns *columns, int from, const char *query, int *rows, int found, int maxRows)
+{
+   size_t length = strlen(query);
+   const __m128i first = _mm_set1_epi8(query[0]);
+   const __m128i last = _mm_set1_epi8(query[length - 1]);
+   int row = from;
+   size_t pos = columns->titleAt[from];
+   while (pos + length - 1 + 16 <= columns->titlesSize && found < maxRows)
+   {
+      __m128i starts = _mm_cmpeq_epi8(first, _mm_loadu_si128((const __m128i *)(columns->titles + pos)));
+      __m128i ends = _mm_cmpeq_epi8(last, _mm_loadu_si128((const __m128i *)(columns->titles + pos + length - 1)));
+      unsigned int lanes = (unsigned int)_mm_movemask_epi8(_mm_and_si128(starts, ends));
+      size_t next = pos + 16;
+      while (lanes)
+      {
+         size_t at = pos + __builtin_ctz(lanes);
+         lanes &= lanes - 1;
+         if (length <= 2 || memcmp(columns->titles + at + 1, query + 1, length - 2) == 0)
+         {
+            // Record the title holding the match and go on with the next title
+            while (columns->titleAt[row + 1] <= at)
+            {
+               row++;
+            }
+            rows[found++] = row++;
+            next = columns->titleAt[row];
+            break;
+         }
+      }
+      pos = next;
+   }
+
+   while (row < columns->count && columns->titleAt[row + 1] <= pos)
+   {
+      row++;
+   }
+   return titlesScalar(columns, row, query, rows, found, maxRows);
+}
+
+//====== AVX2 KERNELS ======
+/*
+    flagsAvx2, yearsAvx2, titlesAvx2 functions:
+    - Same as the SSE2 kernels with 32 flag bytes, 8 years or 32 title positions per instruction.
+*/
+__attribute__((target("avx2"))) static int flagsAvx2(const ScanColumns *columns, int from, uint8_t mask, int *rows, int found, int maxRows)
+{
+   const __m256i bits = _mm256_set1_epi8((char)mask);
+   const __m256i zero = _mm256_setzero_si256();
+   int i = from;
+   for (; i + 32 <= columns->count && found < maxRows; i += 32)
+   {
+      __m256i block = _mm256_and_si256(_mm256_loadu_si256((const __m256i *)(columns->flags + i)), bits);
+      unsigned int lanes = ~(unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, zero));
+      while (lanes && found < maxRows)
+      {
+         rows[found++] = i + __builtin_ctz(lanes);
+         lanes &= lanes - 1;
+      }
+   }
+   return flagsScalar(columns, i, mask, rows, found, maxRows);
+}
+
+__attribute__((target("avx2"))) static int yearsAvx2(const ScanColumns *columns, int from, int minYear, int maxYear, int *rows, int found, int maxRows)
+{
+   const __m256i low = _mm256_set1_epi32(minYear);
+   const __m256i high = _mm256_set1_epi32(maxYear);
+   int i = from;
+   for (; i + 8 <= columns->count && found < maxRows; i += 8)
+   {
+      __m256i years = _mm256_loadu_si256((const __m256i *)(columns->years + i));
+      __m256i outside = _mm256_or_si256(_mm256_cmpgt_epi32(low, years), _mm256_cmpgt_epi32(years, high));
+      unsigned int lanes = ~(unsigned int)_mm256_movemask_ps(_mm256_castsi256_ps(outside)) & 0xFFu;
+      while (lanes && found < maxRows)
+      {
+         rows[found++] = i + __builtin_ctz(lanes);
+         lanes &= lanes - 1;
+      }
+   }
+   return yearsScalar(columns, i, minYear, maxYear, rows, found, maxRows);
+}
+
+__attribute__((target("avx2"))) static int titlesAvx2(const ScanColumns *columns, int from, const char *query, int *rows, int found, int maxRows)
+{
+   size_t length = strlen(query);
+   const __m256i first = _mm256_set1_epi8(query[0]);
+   const __m256i last = _mm256_set1_epi8(query[length - 1]);
+   int row = from;
+   size_t pos = columns->titleAt[from];
+   while (pos + length - 1 + 32 <= columns->titlesSize && found < maxRows)
+   {
+      __m256i starts = _mm256_cmpeq_epi8(first, _mm256_loadu_si256((const __m256i *)(columns->titles + pos)));
+      __m256i ends = _mm256_cmpeq_epi8(last, _mm256_loadu_si256((const __m256i *)(columns->titles + pos + length - 1)));
+      unsigned int lanes = (unsigned int)_mm256_movemask_epi8(_mm256_and_si256(starts, ends));
+      size_t next = pos + 32;
+      while (lanes)
+      {
+         size_t at = pos + __builtin_ctz(lanes);
+         lanes &= lanes - 1;
+         if (length <= 2 || memcmp(columns->titles + at + 1, query + 1, length - 2) == 0)
+         {
+            // Record the title holding the match and go on with the next title
+            while (columns->titleAt[row + 1] <= at)
+            {
+               row++;
+            }
+            rows[found++] = row++;
+            next = columns->titleAt[row];
+            break;
+         }
+      }
+      pos = next;
+   }
+
+   while (row < columns->count && columns->titleAt[row + 1] <= pos)
+   {
+      row++;
+   }
+   return titlesScalar(columns, row, query, rows, found, maxRows);
+}
+#endif
+
+//====== SCAN LEVEL ======
+/*
+    scanLevel holds the kernel set in use, -1 until the CPU has been checked.
+*/
+static int scanLevel = -1;
+
+//====== SUPPORTED LEVEL FUNCTION ======
+/*
+    supportedLevel function:
+    - Returns the best kernel set the CPU can run.
+*/
+static int supportedLevel(void)
+{
+#ifdef SCAN_X86
+   __builtin_cpu_init();
+   if (__builtin_cpu_supports("avx2"))
+   {
+      return SCAN_AVX2;
+   }
+   if (__builtin_cpu_supports("sse2"))
+   {
+      return SCAN_SSE2;
+   }
+#endif
+   return SCAN_SCALAR;
+}
+
+//====== SET SCAN LEVEL FUNCTION ======
+/*
+    scanSetLevel function:
+    - Limits the kernels to the given set (SCAN_*), or to the best one the CPU supports if it asks for more.
+    - Meant for benchmarks and for comparing kernels against the scalar loops.
+    - Returns the set now in use.
+*/
+int scanSetLevel(int level)
+{
+   int supported = supportedLevel();
+   scanLevel = level < supported ? level : supported;
+   return scanLevel;
+}
+
+//====== ACTIVE LEVEL FUNCTION ======
+/*
+    activeLevel function:
+    - Returns the kernel set in use, picking the best supported one on first use.
+*/
+static int activeLevel(void)
+{
+   if (scanLevel < 0)
+   {
+      scanLevel = supportedLevel();
+   }
+   return scanLevel;
+}
+
+//====== SCAN FLAGS FUNCTION ======
+/*
+    scanFlags function:
+    - Finds the rows, starting at from, that have any of the given BOOK_* flags.
+    - Stores up to maxRows of them in rows; call again from the row after the last one for more.
+    - Returns the number of rows stored.
+*/
+int scanFlags(const ScanColumns *columns, int from, uint8_t mask, int *rows, int maxRows)
+{
+#ifdef SCAN_X86
+   switch (activeLevel())
+   {
+   case SCAN_AVX2:
+      return flagsAvx2(columns, from, mask, rows, 0, maxRows);
+   case SCAN_SSE2:
+      return flagsSse2(columns, from, mask, rows, 0, maxRows);
+   }
+#endif
+   return flagsScalar(columns, from, mask, rows, 0, maxRows);
+}
+
+//====== SCAN YEARS FUNCTION ======
+/*
+    scanYears function:
+    - Finds the rows, starting at from, published between minYear and maxYear (inclusive).
+    - Stores up to maxRows of them in rows; call again from the row after the last one for more.
+    - Returns the number of rows stored.
+*/
+int scanYears(const ScanColumns *columns, int from, int minYear, int maxYear, int *rows, int maxRows)
+{
+   // Deleted rows hold SCAN_NO_YEAR, which no range may include
+   if (minYear == SCAN_NO_YEAR)
+   {
+      minYear++;
+   }
+#ifdef SCAN_X86
+   switch (activeLevel())
+   {
+   case SCAN_AVX2:
+      return yearsAvx2(columns, from, minYear, maxYear, rows, 0, maxRows);
+   case SCAN_SSE2:
+      return yearsSse2(columns, from, minYear, maxYear, rows, 0, maxRows);
+   }
+#endif
+   return yearsScalar(columns, from, minYear, maxYear, rows, 0, maxRows);
+}
+
+//====== FIND TITLES FUNCTION ======
+/*
+    findTitles function:
+    - Runs the title kernel of the active level (see scanTitles).
+*/
+static int findTitles(const ScanColumns *columns, int from, const char *query, int *rows, int maxRows)
+{
+   if (from >= columns->count)
+   {
+      return 0;
+   }
+#ifdef SCAN_X86
+   if (query[0] != '\0')
+   {
+      switch (activeLevel())
+      {
+      case SCAN_AVX2:
+         return titlesAvx2(columns, from, query, rows, 0, maxRows);
+      case SCAN_SSE2:
+         return titlesSse2(columns, from, query, rows, 0, maxRows);
+      }
+   }
+#endif
+   return titlesScalar(columns, from, query, rows, 0, maxRows);
+}
+
+//====== SCAN TITLES FUNCTION ======
+/*
+    scanTitles function:
+    - Finds the rows, starting at from, whose lowercased title contains query, which must be lowercased too.
+    - Gives the same rows as strstr on every lowercased title.
+    - Stores up to maxRows of them in rows; call again from the row after the last one for more.
+    - Counts the rows it looked at: all the rest, or those up to the last one stored if it stopped at maxRows.
+    - Returns the number of rows stored.
+*/
+int scanTitles(const ScanColumns *columns, int from, const char *query, int *rows, int maxRows)
+{
+   STATS_START(statStart);
+   int found = findTitles(columns, from, query, rows, maxRows);
+   STATS_STOP(STAT_SCAN, statStart);
+   STATS_ADD(STAT_ROWS_SCANNED, found == maxRows && found > 0 ? rows[found - 1] + 1 - from
+                                : from < columns->count ? columns->count - from : 0);
+   return found;
+}
+
+//====== WRITE SCAN COLUMNS FUNCTION ======
+/*
+    scanColumnsWrite function:
+    - Writes every column to a binary image section.
+    - The image's rows all point into the text file, so BOOK_IN_ARENA is left out of the flags.
+    - Returns 1 on success, 0 on write failure.
+*/
+int scanColumnsWrite(const ScanColumns *columns, FILE *file)
+{
+   uint64_t sizes[2] = {(uint64_t)columns->count, columns->titlesSize};
+   uint32_t noTitles = 0;
+   const uint32_t *titleAt = columns->count ? columns->titleAt : &noTitles;
+   uint8_t *flags = malloc(columns->count ? columns->count : 1);
+   if (!flags)
+   {
+      fprintf(stderr, "Error: Memory allocation for scan columns failed.\n");
+      return 0;
+   }
+   for (int i = 0; i < columns->count; i++)
+   {
+      flags[i] = columns->flags[i] & ~BOOK_IN_ARENA;
+   }
+   int ok = imagePut(file, sizes, sizeof(sizes)) && imagePut(file, flags, columns->count) &&
+          imagePut(file, columns->years, columns->count * sizeof(int32_t)) &&
+          imagePut(file, titleAt, (columns->count + 1) * sizeof(uint32_t)) &&
+          imagePut(file, columns->titles, columns->titlesSize);
+   free(flags);
+   return ok;
+}
+
+//====== READ SCAN COLUMNS FUNCTION ======
+/*
+    scanColumnsRead function:
+    - Restores columns written by scanColumnsWrite into fresh allocations.
+    - Returns 1 on success, 0 if the section is malformed or allocation fails (the columns are then empty).
+*/
+int scanColumnsRead(ScanColumns *columns, ImageReader *reader)
+{
+   memset(columns, 0, sizeof(*columns));
+   const uint64_t *sizes = imageTake(reader, 2 * sizeof(uint64_t));
+   if (!sizes || sizes[0] > INT32_MAX / 2 || sizes[1] > UINT32_MAX)
+   {
+      return 0;
+   }
+   int count = (int)sizes[0];
+   size_t titlesSize = (size_t)sizes[1];
+   const uint8_t *flags = imageTake(reader, count);
+   const int32_t *years = imageTake(reader, count * sizeof(int32_t));
+   const uint32_t *titleAt = imageTake(reader, (count + 1) * sizeof(uint32_t));
+   const char *titles = imageTake(reader, titlesSize);
+   if (!flags || !years || !titleAt || !titles || titleAt[0] != 0 || titleAt[count] != titlesSize)
+   {
+      return 0;
+   }
+
+   // Leave room to grow like scanColumnsAppend would
+   int capacity = count > 1024 ? count : 1024;
+   size_t titlesCapacity = titlesSize > 32768 ? titlesSize : 32768;
+   columns->flags = malloc(capacity);
+   columns->years = malloc(capacity * sizeof(int32_t));
+   columns->titleAt = malloc((capacity + 1) * sizeof(uint32_t));
+   columns->titles = malloc(titlesCapacity);
+   if (!columns->flags || !columns->years || !columns->titleAt || !columns->titles)
+   {
+      fprintf(stderr, "Error: Memory allocation for scan columns failed.\n");
+      scanColumnsFree(columns);
+      return 0;
+   }
+   memcpy(columns->flags, flags, count);
+   memcpy(columns->years, years, count * sizeof(int32_t));
+   memcpy(columns->titleAt, titleAt, (count + 1) * sizeof(uint32_t));
+   memcpy(columns->titles, titles, titlesSize);
+   columns->titlesSize = titlesSize;
+   columns->titlesCapacity = titlesCapacity;
+   columns->count = count;
+   columns->capacity = capacity;
+   return 1;
+}
@@ -0,0 +1,53 @@
+#ifndef SCAN_H
+#define SCAN_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+struct Catalog;
+struct ImageReader;
+
+// Year column value of deleted rows
+#define SCAN_NO_YEAR INT32_MIN
+
+// Kernel sets, picked at run time from what the CPU supports
+#define SCAN_SCALAR 0
+#define SCAN_SSE2 1
+#define SCAN_AVX2 2
+
+//====== SCAN COLUMNS STRUCTURE DEFINITION ======
+/*
+    ScanColumns structure:
+    - Columnar copy of the fields that full-table scans filter on, one dense array per field.
+    - A scan streams through a single column instead of striding over whole BookRecords,
+      so the vector kernels read only the bytes they test.
+    - Kept in step with the catalog by insertBook, removeBook, lendCopy and returnCopy; a deleted
+      book keeps its row, blanked so that no scan matches it.
+*/
+typedef struct
+{
+   uint8_t *flags;         // BOOK_* flags per row
+   int32_t *years;         // Publication year per row
+   char *titles;           // Lowercased titles, each followed by '\0'
+   uint32_t *titleAt;      // Offset of each row's title in titles, plus the end offset
+   size_t titlesSize;      // Bytes used in titles
+   size_t titlesCapacity;  // Bytes allocated for titles
+   int count;              // Number of rows
+   int capacity;           // Allocated rows
+} ScanColumns;
+
+int scanColumnsBuild(ScanColumns *columns, const struct Catalog *catalog);
+int scanColumnsAppend(ScanColumns *columns, const struct Catalog *catalog, int row);
+void scanColumnsRemove(ScanColumns *columns, int row);
+void scanColumnsSetFlags(ScanColumns *columns, int row, uint8_t flags);
+void scanColumnsFree(ScanColumns *columns);
+int scanColumnsWrite(const ScanColumns *columns, FILE *file);
+int scanColumnsRead(ScanColumns *columns, struct ImageReader *reader);
+
+int scanSetLevel(int level);
+int scanFlags(const ScanColumns *columns, int from, uint8_t mask, int *rows, int maxRows);
+int scanYears(const ScanColumns *columns, int from, int minYear, int maxYear, int *rows, int maxRows);
+int scanTitles(const ScanColumns *columns, int from, const char *query, int *rows, int maxRows);
+
+#endif
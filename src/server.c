@@ -0,0 +1,644 @@
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "batch.h"
+#include "server.h"
+#include "stats.h"
+
+//====== UPDATE REQUEST STRUCTURE DEFINITION ======
+/*
+    UpdateRequest structure:
+    - One command that changes the catalog, waiting in the writer's queue.
+    - Lives on the stack of the client thread, which sleeps until the writer marks it done.
+*/
+typedef struct UpdateRequest
+{
+   char *line;                 // Command line, split in place by the writer
+   int lineNumber;             // Line of the command in its connection
+   char *result;               // JSON result written by the writer
+   size_t resultSize;          // Length of result
+   int done;                   // 1 once the change is in the journal (or failed)
+   int lost;                   // 1 if the change could not be saved
+   struct UpdateRequest *next; // Next request in the queue
+} UpdateRequest;
+
+//====== SERVER STRUCTURE DEFINITION ======
+/*
+    Server structure:
+    - State shared by the accepting thread, the client threads and the writer thread.
+    - Lookups hold catalogLock for reading and run side by side; only the writer takes it for writing, to apply
+      a group or to swap in the rows of a compaction (catalog->readers points to it while the server runs).
+    - queueLock guards the update queue, the client table and the stopping flag.
+*/
+typedef struct
+{
+   Catalog *catalog;
+   pthread_rwlock_t catalogLock;         // Readers: client lookups; writer: the writer thread
+   pthread_mutex_t queueLock;
+   pthread_cond_t queued;                // Signalled when a request is queued or the server stops
+   pthread_cond_t committed;             // Signalled when a group of requests is done
+   pthread_cond_t clientLeft;            // Signalled when a client thread ends
+   UpdateRequest *head;                  // Oldest queued request
+   UpdateRequest *tail;                  // Newest queued request
+   int queuedCount;                      // Number of queued requests
+   long commitWindow;                    // Microseconds a group is held open for more changes
+   int commitBatch;                      // Most changes in one group
+   long groups;                          // Groups committed so far
+   long changes;                         // Update commands committed so far
+   int clientFds[SERVER_MAX_CLIENTS];    // Sockets of connected clients, -1 if the slot is free
+   int clients;                          // Number of connected clients
+   int stopping;                         // 1 once no more requests will arrive
+   int broken;                           // 1 once a group could not be written: the catalog is ahead of the journal
+   int unanswered;                       // Clients still to be told that their change was not saved
+} Server;
+
+typedef struct
+{
+   Server *server;
+   int slot; // Index in clientFds
+} ClientThread;
+
+// Set by SIGINT and SIGTERM
+static volatile sig_atomic_t stopRequested = 0;
+
+// Set by SIGUSR1
+static volatile sig_atomic_t statsRequested = 0;
+
+//====== STOP HANDLER FUNCTION ======
+/*
+    stopHandler function:
+    - Asks the accepting loop to shut the server down.
+*/
+static void stopHandler(int signal)
+{
+   (void)signal;
+   stopRequested = 1;
+}
+
+//====== STATS HANDLER FUNCTION ======
+/*
+    statsHandler function:
+    - Asks the accepting loop to dump the stats now.
+*/
+static void statsHandler(int signal)
+{
+   (void)signal;
+   statsRequested = 1;
+}
+
+//====== SERVER SETTING FUNCTION ======
+/*
+    serverSetting function:
+    - Reads a non-negative number from the environment variable name, or returns fallback if it is not set.
+*/
+static long serverSetting(const char *name, long fallback)
+{
+   const char *setting = getenv(name);
+   if (setting && *setting && atol(setting) >= 0)
+   {
+      return atol(setting);
+   }
+   return fallback;
+}
+
+//====== SUBMIT UPDATE FUNCTION ======
+/*
+    submitUpdate function:
+    - Queues a command that changes the catalog for the writer and waits until it has been written to the journal.
+    - Sets lost if the change could not be saved; the caller then calls answeredLost once it has told the client.
+    - Returns the JSON result (to be freed by the caller), or NULL if it could not be produced.
+*/
+static char *submitUpdate(Server *server, char *line, int lineNumber, int *lost)
+{
+   UpdateRequest request = {line, lineNumber, NULL, 0, 0, 0, NULL};
+
+   pthread_mutex_lock(&server->queueLock);
+   if (server->tail)
+   {
+      server->tail->next = &request;
+   }
+   else
+   {
+      server->head = &request;
+   }
+   server->tail = &request;
+   server->queuedCount++;
+   pthread_cond_signal(&server->queued);
+   while (!request.done)
+   {
+      pthread_cond_wait(&server->committed, &server->queueLock);
+   }
+   pthread_mutex_unlock(&server->queueLock);
+   *lost = request.lost;
+   return request.result;
+}
+
+//====== ANSWERED LOST FUNCTION ======
+/*
+    answeredLost function:
+    - Notes that a client was told its change was not saved; once all of them were, stops the server (SIGTERM
+      to itself), which disconnects the clients.
+*/
+static void answeredLost(Server *server)
+{
+   pthread_mutex_lock(&server->queueLock);
+   if (--server->unanswered == 0)
+   {
+      kill(getpid(), SIGTERM);
+   }
+   pthread_mutex_unlock(&server->queueLock);
+}
+
+//====== RUN LOOKUP FUNCTION ======
+/*
+    runLookup function:
+    - Runs a command that only reads the catalog under the shared lock, next to other lookups.
+    - The result is collected in memory so the lock is not held while it is sent.
+    - Returns the JSON result (to be freed by the caller), or NULL if it could not be produced.
+*/
+static char *runLookup(Server *server, char *line, int lineNumber)
+{
+   char *result = NULL;
+   size_t resultSize = 0;
+   FILE *output = open_memstream(&result, &resultSize);
+   if (!output)
+   {
+      return NULL;
+   }
+   pthread_rwlock_rdlock(&server->catalogLock);
+   runCommand(server->catalog, line, lineNumber, output);
+   pthread_rwlock_unlock(&server->catalogLock);
+   fclose(output);
+   return result;
+}
+
+//====== SERVE CLIENT FUNCTION ======
+/*
+    serveClient function:
+    - Thread of one connection: reads commands line by line and answers each with one JSON line.
+    - Lookups run on this thread; changes are handed to the writer.
+*/
+static void *serveClient(void *arg)
+{
+   ClientThread *thread = arg;
+   Server *server = thread->server;
+   int slot = thread->slot;
+   free(thread);
+
+   int fd = server->clientFds[slot];
+   int outFd = dup(fd);
+   FILE *input = fdopen(fd, "r");
+   FILE *output = outFd >= 0 ? fdopen(outFd, "w") : NULL;
+   if (input && output)
+   {
+      char line[BATCH_LINE_LENGTH];
+      int lineNumber = 0;
+      int read;
+      while ((read = readCommand(input, line, sizeof(line))) >= 0)
+      {
+         lineNumber++;
+         if (read == 0)
+         {
+            reportCommandError(output, lineNumber, "", "line is too long");
+         }
+         else if (line[0] != '\0' && line[0] != '#')
+         {
+            int lost = 0;
+            char *result = isUpdateCommand(line) ? submitUpdate(server, line, lineNumber, &lost) : runLookup(server, line, lineNumber);
+            if (result)
+            {
+               fputs(result, output);
+               free(result);
+            }
+            else
+            {
+               reportCommandError(output, lineNumber, "", "out of memory");
+            }
+            int flushed = fflush(output) == 0;
+            if (lost)
+            {
+               answeredLost(server);
+            }
+            if (!flushed)
+            {
+               break;
+            }
+         }
+         else if (fflush(output) != 0)
+         {
+            break;
+         }
+      }
+   }
+
+   // Closing the streams closes both descriptors
+   if (output)
+   {
+      fclose(output);
+   }
+   else if (outFd >= 0)
+   {
+      close(outFd);
+   }
+   pthread_mutex_lock(&server->queueLock);
+   server->clientFds[slot] = -1;
+   server->clients--;
+   pthread_cond_signal(&server->clientLeft);
+   pthread_mutex_unlock(&server->queueLock);
+   if (input)
+   {
+      fclose(input);
+   }
+   else
+   {
+      close(fd);
+   }
+   return NULL;
+}
+
+//====== TAKE GROUP FUNCTION ======
+/*
+    takeGroup function:
+    - Waits for a queued change, then keeps the group open until the commit window has passed or a full group is queued.
+    - Detaches up to commitBatch requests from the queue and returns them as a list.
+    - Returns NULL once the server is stopping and the queue is empty.
+*/
+static UpdateRequest *takeGroup(Server *server)
+{
+   pthread_mutex_lock(&server->queueLock);
+   while (!server->head && !server->stopping)
+   {
+      pthread_cond_wait(&server->queued, &server->queueLock);
+   }
+   if (server->head && server->commitWindow > 0)
+   {
+      struct timespec deadline;
+      clock_gettime(CLOCK_MONOTONIC, &deadline);
+      deadline.tv_sec += server->commitWindow / 1000000;
+      deadline.tv_nsec += (server->commitWindow % 1000000) * 1000;
+      if (deadline.tv_nsec >= 1000000000)
+      {
+         deadline.tv_sec++;
+         deadline.tv_nsec -= 1000000000;
+      }
+      while (server->queuedCount < server->commitBatch && !server->stopping &&
+             pthread_cond_timedwait(&server->queued, &server->queueLock, &deadline) != ETIMEDOUT)
+         ;
+   }
+
+   UpdateRequest *group = server->head;
+   if (group)
+   {
+      UpdateRequest *last = group;
+      int taken = 1;
+      for (; last->next && taken < server->commitBatch; taken++)
+      {
+         last = last->next;
+      }
+      server->head = last->next;
+      if (!server->head)
+      {
+         server->tail = NULL;
+      }
+      last->next = NULL;
+      server->queuedCount -= taken;
+   }
+   pthread_mutex_unlock(&server->queueLock);
+   return group;
+}
+
+//====== WRITER FUNCTION ======
+/*
+    writer function:
+    - The only thread that changes the catalog.
+    - Takes a group of queued changes (see takeGroup) and applies them under the exclusive lock as one journal
+      transaction, then releases the lock before writing it (one write and one fdatasync for the whole group)
+      and only then wakes up their clients: lookups may see a change while it is being synced, but its
+      client hears back only once it is on disk.
+    - If the group cannot be written, its clients are told so and the server then stops (see answeredLost): the
+      catalog in memory already holds the group, so later changes would be journaled against rows that a
+      replay never creates. Groups queued meanwhile are refused without being applied.
+    - Ends once the server is stopping and the queue is empty.
+*/
+static void *writer(void *arg)
+{
+   Server *server = arg;
+   while (1)
+   {
+      UpdateRequest *group = takeGroup(server);
+      if (!group)
+      {
+         break;
+      }
+
+      // After a failed commit the catalog holds changes the journal lacks; nothing more may be built on it
+      int saved = 0;
+      if (!server->broken)
+      {
+         pthread_rwlock_wrlock(&server->catalogLock);
+         journalBegin(&server->catalog->journal);
+         for (UpdateRequest *request = group; request; request = request->next)
+         {
+            FILE *output = open_memstream(&request->result, &request->resultSize);
+            if (output)
+            {
+               runCommand(server->catalog, request->line, request->lineNumber, output);
+               fclose(output);
+            }
+         }
+         pthread_rwlock_unlock(&server->catalogLock);
+
+         // Only this thread touches the journal, so lookups go on while the group is synced and any
+         // compaction rebuilds the rows (compactCatalog takes the lock just to swap them in)
+         saved = journalCommit(&server->catalog->journal);
+         if (saved)
+         {
+            journalCheckpoint(&server->catalog->journal, server->catalog);
+         }
+
+         if (!saved)
+         {
+            // Stop the server once the clients know: a restart replays only the groups that reached the journal
+            fprintf(stderr, "Error: A group of changes could not be written to the journal, stopping the server.\n");
+            server->broken = 1;
+         }
+      }
+
+      pthread_mutex_lock(&server->queueLock);
+      server->groups += saved;
+      for (UpdateRequest *request = group; request; request = request->next)
+      {
+         server->changes += saved;
+         if (!saved)
+         {
+            request->lost = 1;
+            server->unanswered++;
+
+            // The client must not believe the change was kept; the command name is the line up to its first '|'
+            free(request->result);
+            request->result = NULL;
+            FILE *output = open_memstream(&request->result, &request->resultSize);
+            if (output)
+            {
+               request->line[strcspn(request->line, "|")] = '\0';
+               reportCommandError(output, request->lineNumber, request->line, "the change could not be saved, the server is stopping");
+               fclose(output);
+            }
+         }
+         request->done = 1;
+      }
+      pthread_cond_broadcast(&server->committed);
+      pthread_mutex_unlock(&server->queueLock);
+   }
+   return NULL;
+}
+
+//====== OPEN SOCKET FUNCTION ======
+/*
+    openSocket function:
+    - Creates the listening Unix socket at path, replacing a socket left behind by a previous run.
+    - Fails if a server still accepts connections on path.
+    - Returns the socket, or -1 on failure.
+*/
+static int openSocket(const char *path)
+{
+   struct sockaddr_un address;
+   memset(&address, 0, sizeof(address));
+   address.sun_family = AF_UNIX;
+   if (strlen(path) >= sizeof(address.sun_path))
+   {
+      fprintf(stderr, "Error: Socket path %s is too long.\n", path);
+      return -1;
+   }
+   strcpy(address.sun_path, path);
+
+   int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+   if (fd < 0)
+   {
+      fprintf(stderr, "Error: Unable to create a socket.\n");
+      return -1;
+   }
+   // A socket that still accepts connections belongs to a running server; only a dead one is replaced
+   int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+   int live = probe >= 0 && connect(probe, (struct sockaddr *)&address, sizeof(address)) == 0;
+   if (probe >= 0)
+   {
+      close(probe);
+   }
+   if (live)
+   {
+      fprintf(stderr, "Error: A server is already listening on %s.\n", path);
+      close(fd);
+      return -1;
+   }
+   unlink(path);
+   if (bind(fd, (struct sockaddr *)&address, sizeof(address)) != 0 || listen(fd, 64) != 0)
+   {
+      fprintf(stderr, "Error: Unable to listen on %s.\n", path);
+      close(fd);
+      return -1;
+   }
+   return fd;
+}
+
+//====== ACCEPT CLIENT FUNCTION ======
+/*
+    acceptClient function:
+    - Accepts one connection and starts its thread, or turns it away if the server is full.
+*/
+static void acceptClient(Server *server, int listenFd)
+{
+   int fd = accept(listenFd, NULL, NULL);
+   if (fd < 0)
+   {
+      return;
+   }
+
+   pthread_mutex_lock(&server->queueLock);
+   int slot = 0;
+   while (slot < SERVER_MAX_CLIENTS && server->clientFds[slot] >= 0)
+   {
+      slot++;
+   }
+   ClientThread *thread = slot < SERVER_MAX_CLIENTS ? malloc(sizeof(ClientThread)) : NULL;
+   pthread_t id;
+   if (thread)
+   {
+      thread->server = server;
+      thread->slot = slot;
+      server->clientFds[slot] = fd;
+      if (pthread_create(&id, NULL, serveClient, thread) == 0)
+      {
+         pthread_detach(id);
+         server->clients++;
+         pthread_mutex_unlock(&server->queueLock);
+         return;
+      }
+      server->clientFds[slot] = -1;
+      free(thread);
+   }
+   pthread_mutex_unlock(&server->queueLock);
+
+   static const char busy[] = "{\"status\":\"error\",\"error\":\"server is busy\"}\n";
+   if (write(fd, busy, sizeof(busy) - 1) < 0)
+   {
+      // Nothing more to tell a client that is gone
+   }
+   close(fd);
+}
+
+//====== SERVE LIBRARY FUNCTION ======
+/*
+    serveLibrary function:
+    - Serves the loaded catalog on a Unix socket until SIGINT or SIGTERM.
+    - Clients send the batch command language (see batch.h), one command per line, and get one JSON line back per command.
+    - Lookups from all clients run concurrently under a shared lock; changes go through a single writer thread that
+      group-commits them: changes arriving within the commit window (up to a full group) share one journal write and
+      fdatasync, and a client gets its answer only after its change is on disk.
+    - SIGUSR1 dumps the stats (see statsDump) right away; with LIBRARY_STATS_FILE set they are also dumped periodically.
+    - On shutdown, disconnects the clients, lets the writer finish and removes the socket.
+    - Returns 1 on a clean shutdown, 0 if the server could not start.
+*/
+int serveLibrary(Catalog *catalog, const char *path)
+{
+   Server server;
+   memset(&server, 0, sizeof(server));
+   server.catalog = catalog;
+   for (int i = 0; i < SERVER_MAX_CLIENTS; i++)
+   {
+      server.clientFds[i] = -1;
+   }
+   server.commitWindow = serverSetting("LIBRARY_COMMIT_WINDOW", SERVER_COMMIT_WINDOW_US);
+   server.commitBatch = (int)serverSetting("LIBRARY_COMMIT_BATCH", SERVER_COMMIT_BATCH);
+   if (server.commitBatch < 1)
+   {
+      server.commitBatch = 1;
+   }
+
+   // Let a queued writer go ahead of new readers so changes are not starved by a stream of lookups
+   pthread_rwlockattr_t attributes;
+   pthread_rwlockattr_init(&attributes);
+   pthread_rwlockattr_setkind_np(&attributes, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+   pthread_rwlock_init(&server.catalogLock, &attributes);
+   pthread_rwlockattr_destroy(&attributes);
+   pthread_mutex_init(&server.queueLock, NULL);
+   pthread_condattr_t clock;
+   pthread_condattr_init(&clock);
+   pthread_condattr_setclock(&clock, CLOCK_MONOTONIC);
+   pthread_cond_init(&server.queued, &clock);
+   pthread_condattr_destroy(&clock);
+   pthread_cond_init(&server.committed, NULL);
+   pthread_cond_init(&server.clientLeft, NULL);
+
+   // Pick the scan kernels now, before lookup threads would all do it at once
+   scanSetLevel(SCAN_AVX2);
+
+   int listenFd = openSocket(path);
+   if (listenFd < 0)
+   {
+      return 0;
+   }
+
+   // Only the accepting loop takes the stop and stats signals; a dead client must not kill the server
+   struct sigaction action;
+   memset(&action, 0, sizeof(action));
+   action.sa_handler = stopHandler;
+   sigaction(SIGINT, &action, NULL);
+   sigaction(SIGTERM, &action, NULL);
+   action.sa_handler = statsHandler;
+   sigaction(SIGUSR1, &action, NULL);
+   signal(SIGPIPE, SIG_IGN);
+   sigset_t handledSignals, waitMask;
+   sigemptyset(&handledSignals);
+   sigaddset(&handledSignals, SIGINT);
+   sigaddset(&handledSignals, SIGTERM);
+   sigaddset(&handledSignals, SIGUSR1);
+   pthread_sigmask(SIG_BLOCK, &handledSignals, &waitMask);
+   sigdelset(&waitMask, SIGINT);
+   sigdelset(&waitMask, SIGTERM);
+   sigdelset(&waitMask, SIGUSR1);
+
+   // A compaction run by the writer swaps in its rows under the lock the lookups hold
+   catalog->readers = &server.catalogLock;
+   pthread_t writerThread;
+   if (pthread_create(&writerThread, NULL, writer, &server) != 0)
+   {
+      fprintf(stderr, "Error: Unable to start the writer thread.\n");
+      catalog->readers = NULL;
+      close(listenFd);
+      unlink(path);
+      return 0;
+   }
+
+   printf("Serving %d books on %s (commit window %ld us, up to %d changes per commit)\n", catalog->count - catalog->deleted, path,
+          server.commitWindow, server.commitBatch);
+   fflush(stdout);
+   while (!stopRequested)
+   {
+      // Also wake up when the next periodic stats dump is due
+      long dueMs = statsPoll(0);
+      struct timespec due = {dueMs / 1000, (dueMs % 1000) * 1000000};
+      struct pollfd waiting = {listenFd, POLLIN, 0};
+      int ready = ppoll(&waiting, 1, dueMs >= 0 ? &due : NULL, &waitMask);
+      if (statsRequested)
+      {
+         statsRequested = 0;
+         statsDump();
+      }
+      if (ready > 0)
+      {
+         acceptClient(&server, listenFd);
+      }
+      else if (ready < 0 && errno != EINTR)
+      {
+         fprintf(stderr, "Error: Unable to wait for clients.\n");
+         break;
+      }
+   }
+
+   // Stop taking connections, disconnect the clients and let the writer drain its queue
+   close(listenFd);
+   unlink(path);
+   pthread_mutex_lock(&server.queueLock);
+   for (int i = 0; i < SERVER_MAX_CLIENTS; i++)
+   {
+      if (server.clientFds[i] >= 0)
+      {
+         shutdown(server.clientFds[i], SHUT_RDWR);
+      }
+   }
+   while (server.clients > 0)
+   {
+      pthread_cond_wait(&server.clientLeft, &server.queueLock);
+   }
+   server.stopping = 1;
+   pthread_cond_signal(&server.queued);
+   pthread_mutex_unlock(&server.queueLock);
+   pthread_join(writerThread, NULL);
+   catalog->readers = NULL;
+
+   pthread_cond_destroy(&server.clientLeft);
+   pthread_cond_destroy(&server.committed);
+   pthread_cond_destroy(&server.queued);
+   pthread_mutex_destroy(&server.queueLock);
+   pthread_rwlock_destroy(&server.catalogLock);
+   printf("Server stopped. %ld update commands committed in %ld journal writes.\n", server.changes, server.groups);
+   const PersistStats *persist = &catalog->journal.persist;
+   if (persist->count > 0)
+   {
+      printf("Journal writes took %.3f ms on average, %.3f ms at worst (write and fdatasync).\n",
+             persist->totalMs / persist->count, persist->maxMs);
+   }
+   return 1;
+}
@@ -0,0 +1,21 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include "catalog.h"
+
+// Socket used when none is given on the command line
+#define SERVER_DEFAULT_SOCKET "library.sock"
+
+// Most clients connected at the same time
+#define SERVER_MAX_CLIENTS 256
+
+// How long the writer keeps a group of changes open for more to arrive, in microseconds
+// (LIBRARY_COMMIT_WINDOW overrides it, 0 commits whatever is queued right away)
+#define SERVER_COMMIT_WINDOW_US 1000
+
+// Most changes committed in one group (LIBRARY_COMMIT_BATCH overrides it)
+#define SERVER_COMMIT_BATCH 256
+
+int serveLibrary(Catalog *catalog, const char *path);
+
+#endif
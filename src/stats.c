@@ -0,0 +1,266 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "stats.h"
+
+#if LIBRARY_STATS
+
+//====== HISTOGRAM STRUCTURE DEFINITION ======
+/*
+    Histogram structure:
+    - Latencies of one operation, in power-of-two buckets of nanoseconds.
+    - Updated with relaxed atomics, so index builders, server lookups and the writer can all record at once.
+*/
+typedef struct
+{
+   uint64_t count;                  // Operations recorded
+   uint64_t totalNs;                // Sum of their latencies
+   uint64_t maxNs;                  // Longest latency
+   uint64_t buckets[STATS_BUCKETS]; // Operations per bucket
+} Histogram;
+
+static Histogram histograms[STAT_TIMERS];
+static uint64_t counters[STAT_COUNTERS];
+static uint64_t startedAt;
+
+//====== STATS START FUNCTION ======
+/*
+    statsStart function:
+    - Notes when the program started, for the uptime of the dumps.
+*/
+__attribute__((constructor)) static void statsStart(void)
+{
+   startedAt = statsClock();
+}
+
+// Names in the JSON output, in the order of StatTimer and StatCounter
+static const char *timerNames[STAT_TIMERS] = {"load", "parse", "indexBuild", "imageLoad", "replay", "findIsbn",
+                                              "findTitle", "findKeywords", "findFuzzy", "findYear", "findBorrowed",
+                                              "suggest", "facets", "scan", "add", "delete", "borrow", "return",
+                                              "compact", "journalWrite", "save", "imageWrite"};
+static const char *counterNames[STAT_COUNTERS] = {"rowsScanned", "bytesWritten", "reallocs"};
+
+//====== STATS CLOCK FUNCTION ======
+/*
+    statsClock function:
+    - Returns nanoseconds on a monotonic clock (a vDSO call, no system call); the start of a timed operation.
+*/
+uint64_t statsClock(void)
+{
+   struct timespec now;
+   clock_gettime(CLOCK_MONOTONIC, &now);
+   return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+}
+
+//====== STATS RECORD FUNCTION ======
+/*
+    statsRecord function:
+    - Adds the time since start (from statsClock) to the histogram of timer.
+*/
+void statsRecord(StatTimer timer, uint64_t start)
+{
+   uint64_t ns = statsClock() - start;
+   int bucket = ns ? 64 - __builtin_clzll(ns) : 0;
+   if (bucket >= STATS_BUCKETS)
+   {
+      bucket = STATS_BUCKETS - 1;
+   }
+
+   Histogram *histogram = &histograms[timer];
+   __atomic_fetch_add(&histogram->count, 1, __ATOMIC_RELAXED);
+   __atomic_fetch_add(&histogram->totalNs, ns, __ATOMIC_RELAXED);
+   __atomic_fetch_add(&histogram->buckets[bucket], 1, __ATOMIC_RELAXED);
+   uint64_t max = __atomic_load_n(&histogram->maxNs, __ATOMIC_RELAXED);
+   while (ns > max && !__atomic_compare_exchange_n(&histogram->maxNs, &max, ns, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+      ;
+}
+
+//====== STATS ADD FUNCTION ======
+/*
+    statsAdd function:
+    - Adds amount to a counter.
+*/
+void statsAdd(StatCounter counter, uint64_t amount)
+{
+   __atomic_fetch_add(&counters[counter], amount, __ATOMIC_RELAXED);
+}
+
+//====== PERCENTILE FUNCTION ======
+/*
+    percentile function:
+    - Upper bound in microseconds of the bucket holding the given share of the operations, capped at the
+      longest latency seen.
+*/
+static double percentile(const uint64_t *buckets, uint64_t count, uint64_t maxNs, double share)
+{
+   uint64_t rank = (uint64_t)(count * share);
+   uint64_t seen = 0;
+   for (int b = 0; b < STATS_BUCKETS; b++)
+   {
+      seen += buckets[b];
+      if (seen > rank)
+      {
+         uint64_t bound = b < 63 ? (uint64_t)1 << b : maxNs;
+         return (bound < maxNs ? bound : maxNs) / 1e3;
+      }
+   }
+   return maxNs / 1e3;
+}
+
+//====== STATS WRITE FUNCTION ======
+/*
+    statsWrite function:
+    - Writes every histogram and counter as one JSON object on one line (no line break).
+    - Per operation: count, total and mean, approximate p50/p90/p99 from the buckets, the maximum, and the
+      non-empty buckets as [upper bound in ns, count] pairs.
+*/
+void statsWrite(FILE *output)
+{
+   fprintf(output, "{\"enabled\":true,\"uptimeMs\":%.3f,\"timers\":{", (statsClock() - startedAt) / 1e6);
+   for (int t = 0; t < STAT_TIMERS; t++)
+   {
+      // Copy first so the figures of one operation agree with each other
+      uint64_t buckets[STATS_BUCKETS];
+      uint64_t count = 0;
+      for (int b = 0; b < STATS_BUCKETS; b++)
+      {
+         buckets[b] = __atomic_load_n(&histograms[t].buckets[b], __ATOMIC_RELAXED);
+         count += buckets[b];
+      }
+      uint64_t totalNs = __atomic_load_n(&histograms[t].totalNs, __ATOMIC_RELAXED);
+      uint64_t maxNs = __atomic_load_n(&histograms[t].maxNs, __ATOMIC_RELAXED);
+
+      fprintf(output, "%s\"%s\":{\"count\":%llu,\"totalMs\":%.3f,\"meanUs\":%.3f,\"p50Us\":%.3f,\"p90Us\":%.3f,"
+                      "\"p99Us\":%.3f,\"maxUs\":%.3f,\"buckets\":[",
+              t ? "," : "", timerNames[t], (unsigned long long)count, totalNs / 1e6,
+              count ? totalNs / 1e3 / count : 0.0, percentile(buckets, count, maxNs, 0.5),
+              percentile(buckets, count, maxNs, 0.9), percentile(buckets, count, maxNs, 0.99), maxNs / 1e3);
+      int listed = 0;
+      for (int b = 0; b < STATS_BUCKETS; b++)
+      {
+         if (buckets[b])
+         {
+            fprintf(output, "%s[%llu,%llu]", listed++ ? "," : "", 1ull << b, (unsigned long long)buckets[b]);
+         }
+      }
+      fputs("]}", output);
+   }
+   fputs("},\"counters\":{", output);
+   for (int c = 0; c < STAT_COUNTERS; c++)
+   {
+      fprintf(output, "%s\"%s\":%llu", c ? "," : "", counterNames[c],
+              (unsigned long long)__atomic_load_n(&counters[c], __ATOMIC_RELAXED));
+   }
+   fputs("}}", output);
+}
+
+//====== STATS FILE FUNCTION ======
+/*
+    statsFile function:
+    - Returns the file named by LIBRARY_STATS_FILE, or NULL if it is not set.
+    - Stores the dump interval from LIBRARY_STATS_INTERVAL (seconds, 60 if not set) in intervalMs.
+*/
+static const char *statsFile(long *intervalMs)
+{
+   const char *path = getenv("LIBRARY_STATS_FILE");
+   const char *interval = getenv("LIBRARY_STATS_INTERVAL");
+   *intervalMs = interval && atol(interval) > 0 ? atol(interval) * 1000 : 60000;
+   return path && *path ? path : NULL;
+}
+
+//====== STATS DUMP FUNCTION ======
+/*
+    statsDump function:
+    - Writes the current stats to LIBRARY_STATS_FILE, replacing it with a rename so readers never see half
+      a dump, or to stderr if no file is set.
+    - Returns 1 on success, 0 if the file could not be written.
+*/
+int statsDump(void)
+{
+   long intervalMs;
+   const char *path = statsFile(&intervalMs);
+   if (!path)
+   {
+      statsWrite(stderr);
+      fputc('\n', stderr);
+      return 1;
+   }
+
+   char temp[300];
+   snprintf(temp, sizeof(temp), "%s.tmp", path);
+   FILE *file = fopen(temp, "w");
+   if (!file)
+   {
+      fprintf(stderr, "Error: Unable to write %s.\n", temp);
+      return 0;
+   }
+   statsWrite(file);
+   fputc('\n', file);
+   if (fclose(file) != 0 || rename(temp, path) != 0)
+   {
+      fprintf(stderr, "Error: Unable to write %s.\n", path);
+      unlink(temp);
+      return 0;
+   }
+   return 1;
+}
+
+//====== STATS POLL FUNCTION ======
+/*
+    statsPoll function:
+    - Called between requests: dumps the stats to LIBRARY_STATS_FILE once every LIBRARY_STATS_INTERVAL
+      seconds, or right away if force is set (at exit).
+    - Returns the milliseconds until the next dump is due, or -1 if no stats file is set.
+*/
+long statsPoll(int force)
+{
+   static uint64_t lastDump;
+   long intervalMs;
+   if (!statsFile(&intervalMs))
+   {
+      return -1;
+   }
+
+   uint64_t now = statsClock();
+   if (!lastDump)
+   {
+      lastDump = startedAt;
+   }
+   long elapsedMs = (long)((now - lastDump) / 1000000);
+   if (force || elapsedMs >= intervalMs)
+   {
+      statsDump();
+      lastDump = now;
+      return intervalMs;
+   }
+   return intervalMs - elapsedMs;
+}
+
+#else
+
+//====== STATS WRITE FUNCTION ======
+/*
+    statsWrite, statsDump and statsPoll functions:
+    - With the probes compiled out there is nothing to report; the stats command still answers.
+*/
+void statsWrite(FILE *output)
+{
+   fputs("{\"enabled\":false}", output);
+}
+
+int statsDump(void)
+{
+   fputs("{\"enabled\":false}\n", stderr);
+   return 1;
+}
+
+long statsPoll(int force)
+{
+   (void)force;
+   return -1;
+}
+
+#endif
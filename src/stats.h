@@ -0,0 +1,71 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+// Build with -DLIBRARY_STATS=0 to compile the probes out; they then expand to nothing
+#ifndef LIBRARY_STATS
+#define LIBRARY_STATS 1
+#endif
+
+// Histogram buckets: bucket b counts latencies of less than 2^b nanoseconds (and at least half that),
+// the last one everything longer
+#define STATS_BUCKETS 40
+
+// Operations whose latency is recorded, one histogram each
+typedef enum
+{
+   STAT_LOAD,          // loadDatabase as a whole
+   STAT_PARSE,         // Parsing the lines of books.db into rows
+   STAT_INDEX_BUILD,   // Building every index over the rows
+   STAT_IMAGE_LOAD,    // Taking the rows and indexes from books.db.image
+   STAT_REPLAY,        // Replaying one journal file
+   STAT_FIND_ISBN,     // ISBN lookup of a find command (isbnIndexFind itself has no probe: it is called in
+                       // tight loops, where the clock read would cost more than the lookup)
+   STAT_FIND_TITLE,    // Title search
+   STAT_FIND_KEYWORDS, // Keyword search
+   STAT_FIND_FUZZY,    // Typo-tolerant title and author search
+   STAT_FIND_YEAR,     // Year range search
+   STAT_FIND_BORROWED, // Borrowed books by date
+   STAT_SUGGEST,       // Title or author completions of a prefix
+   STAT_FACETS,        // Book counts by genre and decade
+   STAT_SCAN,          // Full scan of the title or year column
+   STAT_ADD,           // insertBook
+   STAT_DELETE,        // removeBook
+   STAT_BORROW,        // lendCopy
+   STAT_RETURN,        // returnCopy
+   STAT_COMPACT,       // compactCatalog
+   STAT_JOURNAL_WRITE, // One journal write, or one transaction, reaching the file (and the disk if synced)
+   STAT_SAVE,          // saveDatabase
+   STAT_IMAGE_WRITE,   // Writing books.db.image
+   STAT_TIMERS
+} StatTimer;
+
+// Running totals
+typedef enum
+{
+   STAT_ROWS_SCANNED,  // Rows and postings looked at by searches
+   STAT_BYTES_WRITTEN, // Bytes written to the journal, books.db and the image
+   STAT_REALLOCS,      // Times a row array, arena or index list was grown
+   STAT_COUNTERS
+} StatCounter;
+
+#if LIBRARY_STATS
+uint64_t statsClock(void);
+void statsRecord(StatTimer timer, uint64_t start);
+void statsAdd(StatCounter counter, uint64_t amount);
+#define STATS_START(name) uint64_t name = statsClock()
+#define STATS_STOP(timer, name) statsRecord(timer, name)
+#define STATS_ADD(counter, amount) statsAdd(counter, amount)
+#else
+#define STATS_START(name) ((void)0)
+#define STATS_STOP(timer, name) ((void)0)
+#define STATS_ADD(counter, amount) ((void)0)
+#endif
+
+void statsWrite(FILE *output);
+int statsDump(void);
+long statsPoll(int force);
+
+#endif
@@ -0,0 +1,1057 @@
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "image.h"
+#include "stats.h"
+#include "storage.h"
+
+//====== FIELD VIEW STRUCTURE DEFINITION ======
+/*
+    FieldView structure:
+    - Position of one field while a line is being split, relative to the start of the line.
+*/
+typedef struct
+{
+   int offset; // Offset of the first character from the start of the line
+   int length; // Number of characters (clamped to the Database field size)
+} FieldView;
+
+//====== MAP FILE FUNCTION ======
+/*
+    mapFile function:
+    - Makes the whole contents of an open file available in memory without copying it.
+    - Uses a read-only private mapping; if the file cannot be mapped, reads it into the heap instead.
+    - Returns 1 on success, 0 on failure.
+*/
+static int mapFile(int fd, Catalog *catalog)
+{
+   struct stat st;
+   if (fstat(fd, &st) != 0)
+   {
+      fprintf(stderr, "Error: Unable to read books.db.\n");
+      return 0;
+   }
+
+   catalog->dataSize = (size_t)st.st_size;
+   catalog->data = NULL;
+   catalog->mapped = 0;
+   if (catalog->dataSize == 0)
+   {
+      return 1;
+   }
+
+   void *map = mmap(NULL, catalog->dataSize, PROT_READ, MAP_PRIVATE, fd, 0);
+   if (map != MAP_FAILED)
+   {
+      madvise(map, catalog->dataSize, MADV_SEQUENTIAL);
+      catalog->data = map;
+      catalog->mapped = 1;
+      return 1;
+   }
+
+   // Fall back to one read of the whole file
+   char *buffer = malloc(catalog->dataSize);
+   if (!buffer)
+   {
+      fprintf(stderr, "Error: Memory allocation failed.\n");
+      return 0;
+   }
+   size_t done = 0;
+   while (done < catalog->dataSize)
+   {
+      ssize_t got = read(fd, buffer + done, catalog->dataSize - done);
+      if (got <= 0)
+      {
+         fprintf(stderr, "Error: Unable to read books.db.\n");
+         free(buffer);
+         return 0;
+      }
+      done += (size_t)got;
+   }
+   catalog->data = buffer;
+   return 1;
+}
+
+//====== NEXT FIELD FUNCTION ======
+/*
+    nextField function:
+    - Finds the next '|'-separated field of a line, skipping empty fields like strtok does.
+    - Stores its position relative to the line start, clamped to limit characters.
+    - Returns 1 if a field was found, 0 at the end of the line.
+*/
+static int nextField(const char *line, int length, int *pos, int limit, FieldView *field)
+{
+   while (*pos < length && line[*pos] == '|')
+   {
+      (*pos)++;
+   }
+   if (*pos >= length)
+   {
+      return 0;
+   }
+
+   int start = *pos;
+   while (*pos < length && line[*pos] != '|')
+   {
+      (*pos)++;
+   }
+   field->offset = start;
+   field->length = *pos - start < limit ? *pos - start : limit;
+   return 1;
+}
+
+//====== PARSE YEAR FUNCTION ======
+/*
+    parseYear function:
+    - Converts the leading digits of a field to a number, like atoi on a NUL-terminated copy would.
+*/
+static int parseYear(const char *text, int length)
+{
+   int i = 0;
+   int sign = 1;
+   int value = 0;
+   while (i < length && (text[i] == ' ' || text[i] == '\t'))
+   {
+      i++;
+   }
+   if (i < length && (text[i] == '-' || text[i] == '+'))
+   {
+      sign = text[i] == '-' ? -1 : 1;
+      i++;
+   }
+   while (i < length && text[i] >= '0' && text[i] <= '9')
+   {
+      value = value * 10 + (text[i] - '0');
+      i++;
+   }
+   return sign * value;
+}
+
+//====== PARSE LINE FUNCTION ======
+/*
+    parseLine function:
+    - Splits one line of "books.db" into a compact BookRecord that points into the line, without copying anything.
+    - Converts the borrow status to a flag and the borrow date to a day number.
+    - Flags a line that goes on with copies and loans fields with BOOK_COPIES, for buildLoans to read.
+    - Reports the first missing field to errors and returns 0 if the line is incomplete, 1 otherwise.
+*/
+static int parseLine(const char *line, int length, uint64_t lineOffset, BookRecord *book, FILE *errors)
+{
+   int pos = 0;
+   FieldView isbn, title, authors, year, genre, borrowed, date, copies;
+
+   if (!nextField(line, length, &pos, FIELD_LIMIT(isbn), &isbn))
+   {
+      fprintf(errors, "Error: Missing ISBN in line: %.*s\n", length, line);
+      return 0;
+   }
+   if (!nextField(line, length, &pos, FIELD_LIMIT(nameBook), &title))
+   {
+      fprintf(errors, "Error: Missing book name in line: %.*s\n", length, line);
+      return 0;
+   }
+   if (!nextField(line, length, &pos, FIELD_LIMIT(authors), &authors))
+   {
+      fprintf(errors, "Error: Missing authors in line: %.*s\n", length, line);
+      return 0;
+   }
+   if (!nextField(line, length, &pos, length, &year))
+   {
+      fprintf(errors, "Error: Missing year in line: %.*s\n", length, line);
+      return 0;
+   }
+   if (!nextField(line, length, &pos, FIELD_LIMIT(genre), &genre))
+   {
+      fprintf(errors, "Error: Missing genre in line: %.*s\n", length, line);
+      return 0;
+   }
+   if (!nextField(line, length, &pos, FIELD_LIMIT(borrowed), &borrowed))
+   {
+      fprintf(errors, "Error: Missing borrowed status in line: %.*s\n", length, line);
+      return 0;
+   }
+   if (!nextField(line, length, &pos, FIELD_LIMIT(date), &date))
+   {
+      fprintf(errors, "Error: Missing date in line: %.*s\n", length, line);
+      return 0;
+   }
+
+   // The row's text starts at the ISBN, the other fields are located from there
+   book->offset = lineOffset + (uint64_t)isbn.offset;
+   book->isbnLength = (uint8_t)isbn.length;
+   book->titleAt = (uint16_t)(title.offset - isbn.offset);
+   book->titleLength = (uint8_t)title.length;
+   book->authorsAt = (uint16_t)(authors.offset - isbn.offset);
+   book->authorsLength = (uint8_t)authors.length;
+   book->genreAt = (uint16_t)(genre.offset - isbn.offset);
+   book->genreLength = (uint8_t)genre.length;
+   book->year = parseYear(line + year.offset, year.length);
+   book->flags = 0;
+   if (borrowed.length == 4 && memcmp(line + borrowed.offset, "true", 4) == 0)
+   {
+      book->flags |= BOOK_BORROWED;
+   }
+   if (!parseDate(line + date.offset, date.length, &book->borrowDay))
+   {
+      // Anything that is not a DD-MM-YYYY date is treated like "-"
+      book->borrowDay = NO_DATE;
+   }
+   if (nextField(line, length, &pos, length, &copies))
+   {
+      book->flags |= BOOK_COPIES;
+   }
+   book->loans = 0;
+   return 1;
+}
+
+//====== PARSE CHUNK STRUCTURE DEFINITION ======
+/*
+    ParseChunk structure:
+    - One newline-aligned part of "books.db" and the records parsed from it by one thread.
+    - Error messages are collected in memory and printed after all threads finish, in file order.
+*/
+typedef struct
+{
+   const char *data;   // Start of the whole file
+   size_t start;       // First byte of the chunk
+   size_t end;         // Byte after the chunk
+   BookRecord *books;  // Records parsed from the chunk
+   int count;          // Number of records
+   int capacity;       // Allocated records
+   char *errors;       // Error messages of the chunk
+   size_t errorsSize;  // Length of the error messages
+   int failed;         // 1 if memory ran out
+} ParseChunk;
+
+// Smallest chunk worth a thread of its own
+#define MIN_CHUNK_BYTES (1 << 20)
+
+// Most threads used for parsing
+#define MAX_PARSE_THREADS 64
+
+// Bytes at the start of a chunk sampled to estimate its line count
+#define SAMPLE_BYTES (64 * 1024)
+
+//====== ESTIMATE ROWS FUNCTION ======
+/*
+    estimateRows function:
+    - Guesses how many lines a chunk has from the line lengths of its first SAMPLE_BYTES, with some headroom,
+      so its record buffer is usually allocated once at the right size instead of grown while parsing.
+*/
+static int estimateRows(const ParseChunk *chunk)
+{
+   size_t size = chunk->end - chunk->start;
+   size_t sample = size < SAMPLE_BYTES ? size : SAMPLE_BYTES;
+   size_t lines = 0;
+   const char *at = chunk->data + chunk->start;
+   const char *stop = at + sample;
+   while ((at = memchr(at, '\n', stop - at)) != NULL)
+   {
+      lines++;
+      at++;
+   }
+   if (lines == 0)
+   {
+      return 1024;
+   }
+   double estimate = (double)size / sample * lines * 1.05 + 16;
+   return estimate > INT_MAX / 2 ? INT_MAX / 2 : (int)estimate;
+}
+
+//====== PARSE CHUNK FUNCTION ======
+/*
+    parseChunk function:
+    - Thread body: parses every line of a chunk into the chunk's own record buffer.
+    - The buffer is presized from estimateRows and doubled if the estimate was short.
+*/
+static void *parseChunk(void *arg)
+{
+   ParseChunk *chunk = arg;
+   FILE *errors = open_memstream(&chunk->errors, &chunk->errorsSize);
+   if (!errors)
+   {
+      chunk->failed = 1;
+      return NULL;
+   }
+   if (chunk->end > chunk->start)
+   {
+      chunk->capacity = estimateRows(chunk);
+      chunk->books = malloc((size_t)chunk->capacity * sizeof(BookRecord));
+      if (!chunk->books)
+      {
+         chunk->capacity = 0;
+      }
+   }
+
+   size_t start = chunk->start;
+   while (start < chunk->end)
+   {
+      const char *line = chunk->data + start;
+      const char *newline = memchr(line, '\n', chunk->end - start);
+      size_t length = newline ? (size_t)(newline - line) : chunk->end - start;
+      size_t next = start + length + 1;
+      if (length > 0 && line[length - 1] == '\r')
+      {
+         length--;
+      }
+
+      if (length > UINT16_MAX)
+      {
+         fprintf(errors, "Error: Line too long at byte %zu of books.db.\n", start);
+         start = next;
+         continue;
+      }
+
+      // Resize buffer if needed
+      if (chunk->count >= chunk->capacity)
+      {
+         int capacity = chunk->capacity ? chunk->capacity * 2 : 1024;
+         BookRecord *grown = realloc(chunk->books, capacity * sizeof(BookRecord));
+         if (!grown)
+         {
+            chunk->failed = 1;
+            break;
+         }
+         chunk->books = grown;
+         chunk->capacity = capacity;
+         STATS_ADD(STAT_REALLOCS, 1);
+      }
+
+      if (parseLine(line, (int)length, start, &chunk->books[chunk->count], errors))
+      {
+         chunk->count++;
+      }
+      start = next;
+   }
+
+   fclose(errors);
+   return NULL;
+}
+
+//====== PARSE THREAD COUNT FUNCTION ======
+/*
+    parseThreadCount function:
+    - Uses one thread per online core, or the number set in the LIBRARY_THREADS environment variable,
+      but no more than one per MIN_CHUNK_BYTES of the file.
+*/
+static int parseThreadCount(size_t dataSize)
+{
+   long cores = sysconf(_SC_NPROCESSORS_ONLN);
+   const char *setting = getenv("LIBRARY_THREADS");
+   if (setting && atoi(setting) > 0)
+   {
+      cores = atoi(setting);
+   }
+
+   size_t threads = dataSize / MIN_CHUNK_BYTES + 1;
+   if (cores > 0 && threads > (size_t)cores)
+   {
+      threads = (size_t)cores;
+   }
+   return threads > MAX_PARSE_THREADS ? MAX_PARSE_THREADS : (int)threads;
+}
+
+//====== PARSE FILE FUNCTION ======
+/*
+    parseFile function:
+    - Splits the loaded file into newline-aligned chunks and parses them on parallel threads.
+    - Merges the records of all chunks into the catalog rows in file order and prints
+      the error messages of the chunks in the same order.
+    - Returns 1 on success, 0 on memory or thread issues.
+*/
+static int parseFile(Catalog *catalog)
+{
+   STATS_START(statStart);
+   int threads = parseThreadCount(catalog->dataSize);
+   ParseChunk chunks[MAX_PARSE_THREADS];
+   pthread_t ids[MAX_PARSE_THREADS];
+   int started[MAX_PARSE_THREADS] = {0};
+   memset(chunks, 0, sizeof(chunks));
+
+   // Cut the file at the first newline after each even split point
+   size_t start = 0;
+   for (int t = 0; t < threads; t++)
+   {
+      size_t end = catalog->dataSize * (t + 1) / threads;
+      if (end < start)
+      {
+         end = start;
+      }
+      const char *newline = end < catalog->dataSize ? memchr(catalog->data + end, '\n', catalog->dataSize - end) : NULL;
+      end = newline ? (size_t)(newline - catalog->data) + 1 : catalog->dataSize;
+      chunks[t].data = catalog->data;
+      chunks[t].start = start;
+      chunks[t].end = end;
+      start = end;
+   }
+
+   // The first chunk is parsed on this thread
+   for (int t = 1; t < threads; t++)
+   {
+      started[t] = pthread_create(&ids[t], NULL, parseChunk, &chunks[t]) == 0;
+      if (!started[t])
+      {
+         parseChunk(&chunks[t]);
+      }
+   }
+   parseChunk(&chunks[0]);
+
+   int ok = 1;
+   int total = 0;
+   for (int t = 0; t < threads; t++)
+   {
+      if (started[t])
+      {
+         pthread_join(ids[t], NULL);
+      }
+      if (chunks[t].errors)
+      {
+         fwrite(chunks[t].errors, 1, chunks[t].errorsSize, stderr);
+      }
+      ok = ok && !chunks[t].failed;
+      total += chunks[t].count;
+   }
+
+   // Merge in file order, into rows allocated once at their final size
+   if (ok)
+   {
+      catalog->count = 0;
+      ok = reserveBooks(catalog, total > 0 ? total : 1);
+   }
+   for (int t = 0; t < threads; t++)
+   {
+      if (ok && chunks[t].count > 0)
+      {
+         memcpy(catalog->books + catalog->count, chunks[t].books, chunks[t].count * sizeof(BookRecord));
+         catalog->count += chunks[t].count;
+      }
+      free(chunks[t].books);
+      free(chunks[t].errors);
+   }
+   if (!ok)
+   {
+      fprintf(stderr, "Error: Memory allocation failed.\n");
+   }
+   STATS_STOP(STAT_PARSE, statStart);
+   return ok;
+}
+
+//====== BUILD LOANS FUNCTION ======
+/*
+    buildLoans function:
+    - Reads the copies and loans fields of the rows flagged BOOK_COPIES by parseLine into the loan table,
+      and sums the copies up in the row's borrow flag and date, which the loans take precedence over.
+    - A line with invalid copies or loans is reported and keeps the single copy its borrow fields describe; so
+      does a single copy without loans, which may be borrowed.
+    - Returns 1 on success, 0 on memory allocation failure.
+*/
+static int buildLoans(Catalog *catalog)
+{
+   for (int row = 0; row < catalog->count; row++)
+   {
+      BookRecord *book = &catalog->books[row];
+      if (!(book->flags & BOOK_COPIES))
+      {
+         continue;
+      }
+      book->flags &= ~BOOK_COPIES;
+
+      const char *line = catalog->data + book->offset;
+      const char *newline = memchr(line, '\n', catalog->dataSize - book->offset);
+      int length = newline ? (int)(newline - line) : (int)(catalog->dataSize - book->offset);
+      if (length > 0 && line[length - 1] == '\r')
+      {
+         length--;
+      }
+
+      // Skip the genre, walked to its '|' as its stored length is clamped, then the borrow status and date
+      int pos = book->genreAt;
+      FieldView field, loans;
+      nextField(line, length, &pos, length, &field);
+      nextField(line, length, &pos, length, &field);
+      nextField(line, length, &pos, length, &field);
+      nextField(line, length, &pos, length, &field);
+      int copies = parseYear(line + field.offset, field.length);
+      if (!nextField(line, length, &pos, length, &loans))
+      {
+         loans.offset = pos;
+         loans.length = 0;
+      }
+      if (copies < 1 || copies > LOAN_MAX_COPIES)
+      {
+         fprintf(stderr, "Error: Invalid copies in line: %.*s\n", length, line);
+         continue;
+      }
+
+      // A single copy without loans needs no entry; its borrow fields describe it, as on a line without copies
+      if (copies == 1 && (loans.length == 0 || (loans.length == 1 && line[loans.offset] == '-')))
+      {
+         continue;
+      }
+      int entry = loanTableAddBook(&catalog->loans, row, copies);
+      if (entry < 0)
+      {
+         return 0;
+      }
+      book->loans = entry + 1;
+      int at = 0, copy, read;
+      int32_t patron, day;
+      while ((read = nextLoan(line + loans.offset, loans.length, &at, &copy, &patron, &day)) > 0)
+      {
+         if (!loanTableLend(&catalog->loans, entry, copy, patron, day))
+         {
+            read = -1;
+            break;
+         }
+      }
+      if (read < 0)
+      {
+         fprintf(stderr, "Error: Invalid loans in line: %.*s\n", length, line);
+      }
+      book->flags = (uint8_t)(catalog->loans.lentCount[entry] > 0 ? book->flags | BOOK_BORROWED : book->flags & ~BOOK_BORROWED);
+      book->borrowDay = loanTableEarliest(&catalog->loans, entry);
+   }
+   return 1;
+}
+
+//====== INDEX BUILD THREADS ======
+/*
+    buildIsbnIndex, buildTokenIndex, buildTrigramIndex, buildScanColumns, buildBorrowIndex, buildYearIndex functions:
+    - Thread bodies that build one index over the parsed rows; each only reads the rows and
+      writes its own index, so all of them run at the same time.
+    - Return a non-NULL pointer on success.
+*/
+static void *buildIsbnIndex(void *arg)
+{
+   Catalog *catalog = arg;
+   return isbnIndexBuild(&catalog->isbnIndex, catalog) ? catalog : NULL;
+}
+
+static void *buildTokenIndex(void *arg)
+{
+   Catalog *catalog = arg;
+   return tokenIndexBuild(&catalog->tokenIndex, catalog) ? catalog : NULL;
+}
+
+static void *buildTrigramIndex(void *arg)
+{
+   Catalog *catalog = arg;
+   return trigramIndexBuild(&catalog->trigramIndex, catalog) ? catalog : NULL;
+}
+
+static void *buildScanColumns(void *arg)
+{
+   Catalog *catalog = arg;
+   return scanColumnsBuild(&catalog->columns, catalog) ? catalog : NULL;
+}
+
+static void *buildBorrowIndex(void *arg)
+{
+   Catalog *catalog = arg;
+   return borrowIndexBuild(&catalog->borrowIndex, catalog) ? catalog : NULL;
+}
+
+static void *buildYearIndex(void *arg)
+{
+   Catalog *catalog = arg;
+   return yearIndexBuild(&catalog->yearIndex, catalog) ? catalog : NULL;
+}
+
+static void *buildCompletionIndex(void *arg)
+{
+   Catalog *catalog = arg;
+   return completionIndexBuild(&catalog->completions, catalog) ? catalog : NULL;
+}
+
+static void *buildFacetIndex(void *arg)
+{
+   Catalog *catalog = arg;
+   return facetIndexBuild(&catalog->facets, catalog) ? catalog : NULL;
+}
+
+//====== BUILD INDEXES FUNCTION ======
+/*
+    buildIndexes function:
+    - Builds the ISBN, token, title trigram, borrow, year, completion and facet indexes and the scan columns on
+      parallel threads.
+    - Returns 1 on success, 0 if any of them failed.
+*/
+static int buildIndexes(Catalog *catalog)
+{
+   STATS_START(statStart);
+   void *(*builders[])(void *) = {buildIsbnIndex, buildTokenIndex, buildTrigramIndex, buildScanColumns,
+                                  buildBorrowIndex, buildYearIndex, buildCompletionIndex, buildFacetIndex};
+   int builderCount = sizeof(builders) / sizeof(builders[0]);
+   pthread_t ids[sizeof(builders) / sizeof(builders[0])];
+   int started[sizeof(builders) / sizeof(builders[0])];
+   void *results[sizeof(builders) / sizeof(builders[0])];
+
+   for (int i = 1; i < builderCount; i++)
+   {
+      started[i] = pthread_create(&ids[i], NULL, builders[i], catalog) == 0;
+      if (!started[i])
+      {
+         results[i] = builders[i](catalog);
+      }
+   }
+   results[0] = builders[0](catalog);
+
+   int ok = results[0] != NULL;
+   for (int i = 1; i < builderCount; i++)
+   {
+      if (started[i])
+      {
+         pthread_join(ids[i], &results[i]);
+      }
+      ok = ok && results[i] != NULL;
+   }
+   STATS_STOP(STAT_INDEX_BUILD, statStart);
+   return ok;
+}
+
+//====== FREE INDEXES FUNCTION ======
+/*
+    freeIndexes function:
+    - Frees every index and the scan columns of the catalog, leaving its rows, text and loan table alone.
+*/
+static void freeIndexes(Catalog *catalog)
+{
+   isbnIndexFree(&catalog->isbnIndex);
+   tokenIndexFree(&catalog->tokenIndex);
+   trigramIndexFree(&catalog->trigramIndex);
+   scanColumnsFree(&catalog->columns);
+   borrowIndexFree(&catalog->borrowIndex);
+   yearIndexFree(&catalog->yearIndex);
+   completionIndexFree(&catalog->completions);
+   facetIndexFree(&catalog->facets);
+}
+
+//====== COMPACT CATALOG FUNCTION ======
+/*
+    compactCatalog function:
+    - Drops the tombstones of deleted books: moves the live rows down in order, rebuilds every index
+      over the new row numbers and renumbers the rows of the loan table.
+    - The new rows, loan table and indexes are built beside the current ones, which are only read meanwhile,
+      then swapped in; with catalog->readers set, only that swap waits for the lookups running beside it.
+    - Row numbers held from before are no longer valid afterwards; only call it between requests.
+    - Text of deleted books added in this session stays in the string arena until the next load.
+    - Returns 1 on success, 0 if the rows or an index could not be rebuilt (the catalog is then left as it was).
+*/
+int compactCatalog(Catalog *catalog)
+{
+   if (catalog->deleted == 0)
+   {
+      return 1;
+   }
+
+   STATS_START(statStart);
+   Catalog staged = *catalog;
+   staged.books = malloc((size_t)catalog->capacity * sizeof(BookRecord));
+   int *newRows = malloc((size_t)catalog->count * sizeof(int));
+   if (!staged.books || !newRows)
+   {
+      fprintf(stderr, "Error: Memory allocation failed.\n");
+      free(staged.books);
+      free(newRows);
+      return 0;
+   }
+   int kept = 0;
+   for (int i = 0; i < catalog->count; i++)
+   {
+      newRows[i] = -1;
+      if (!(catalog->books[i].flags & BOOK_DELETED))
+      {
+         newRows[i] = kept;
+         staged.books[kept++] = catalog->books[i];
+      }
+   }
+   staged.count = kept;
+   staged.deleted = 0;
+
+   int remapped = loanTableRemap(&catalog->loans, newRows, &staged.loans);
+   free(newRows);
+   if (!remapped)
+   {
+      fprintf(stderr, "Error: Could not renumber the loan table after dropping deleted books.\n");
+      free(staged.books);
+      return 0;
+   }
+   for (int entry = 0; entry < staged.loans.entryCount; entry++)
+   {
+      staged.books[staged.loans.bookRow[entry]].loans = entry + 1;
+   }
+
+   memset(&staged.isbnIndex, 0, sizeof(staged.isbnIndex));
+   memset(&staged.tokenIndex, 0, sizeof(staged.tokenIndex));
+   memset(&staged.trigramIndex, 0, sizeof(staged.trigramIndex));
+   memset(&staged.columns, 0, sizeof(staged.columns));
+   memset(&staged.borrowIndex, 0, sizeof(staged.borrowIndex));
+   memset(&staged.yearIndex, 0, sizeof(staged.yearIndex));
+   memset(&staged.completions, 0, sizeof(staged.completions));
+   memset(&staged.facets, 0, sizeof(staged.facets));
+   if (!buildIndexes(&staged))
+   {
+      fprintf(stderr, "Error: Could not rebuild the indexes after dropping deleted books.\n");
+      freeIndexes(&staged);
+      loanTableFree(&staged.loans);
+      free(staged.books);
+      return 0;
+   }
+
+   // Swap the rebuilt rows in; lookups only wait for this
+   Catalog retired = *catalog;
+   if (catalog->readers)
+   {
+      pthread_rwlock_wrlock(catalog->readers);
+   }
+   catalog->books = staged.books;
+   catalog->count = staged.count;
+   catalog->deleted = 0;
+   catalog->loans = staged.loans;
+   catalog->isbnIndex = staged.isbnIndex;
+   catalog->tokenIndex = staged.tokenIndex;
+   catalog->trigramIndex = staged.trigramIndex;
+   catalog->columns = staged.columns;
+   catalog->borrowIndex = staged.borrowIndex;
+   catalog->yearIndex = staged.yearIndex;
+   catalog->completions = staged.completions;
+   catalog->facets = staged.facets;
+   if (catalog->readers)
+   {
+      pthread_rwlock_unlock(catalog->readers);
+   }
+
+   free(retired.books);
+   loanTableFree(&retired.loans);
+   freeIndexes(&retired);
+   STATS_STOP(STAT_COMPACT, statStart);
+   return 1;
+}
+
+//====== FREEZE CATALOG FUNCTION ======
+/*
+    freezeCatalog function:
+    - Copies what saveDatabase reads of a catalog without tombstones into frozen: the rows, the text added
+      since loading and the loan table, so a snapshot can be written from it while the catalog keeps changing.
+    - The copy shares the loaded "books.db" bytes, which never change, and has no indexes.
+    - Returns 1 on success, 0 on memory allocation failure; free the copy with freeFrozenCatalog.
+*/
+int freezeCatalog(const Catalog *catalog, Catalog *frozen)
+{
+   memset(frozen, 0, sizeof(*frozen));
+   frozen->frozen = 1;
+   frozen->data = catalog->data;
+   frozen->dataSize = catalog->dataSize;
+   frozen->count = catalog->count;
+   frozen->capacity = catalog->count;
+   frozen->books = malloc((catalog->count ? catalog->count : 1) * sizeof(BookRecord));
+   frozen->arena = malloc(catalog->arenaSize ? catalog->arenaSize : 1);
+   int *rows = malloc((catalog->count ? catalog->count : 1) * sizeof(int));
+   if (!frozen->books || !frozen->arena || !rows)
+   {
+      fprintf(stderr, "Error: Memory allocation failed.\n");
+      free(rows);
+      freeFrozenCatalog(frozen);
+      return 0;
+   }
+   memcpy(frozen->books, catalog->books, (size_t)catalog->count * sizeof(BookRecord));
+   memcpy(frozen->arena, catalog->arena, catalog->arenaSize);
+   frozen->arenaSize = catalog->arenaSize;
+   frozen->arenaCapacity = catalog->arenaSize;
+
+   // Same rows, so the loan table is copied as it is, less the entries of removed books
+   for (int i = 0; i < catalog->count; i++)
+   {
+      rows[i] = i;
+   }
+   int copied = loanTableRemap(&catalog->loans, rows, &frozen->loans);
+   free(rows);
+   if (!copied)
+   {
+      freeFrozenCatalog(frozen);
+      return 0;
+   }
+   for (int entry = 0; entry < frozen->loans.entryCount; entry++)
+   {
+      frozen->books[frozen->loans.bookRow[entry]].loans = entry + 1;
+   }
+   return 1;
+}
+
+//====== FREE FROZEN CATALOG FUNCTION ======
+/*
+    freeFrozenCatalog function:
+    - Frees a copy made by freezeCatalog, leaving the "books.db" bytes it shares alone.
+*/
+void freeFrozenCatalog(Catalog *frozen)
+{
+   free(frozen->books);
+   free(frozen->arena);
+   loanTableFree(&frozen->loans);
+   memset(frozen, 0, sizeof(*frozen));
+}
+
+//====== LOAD DATABASE FUNCTION ======
+/*
+    loadDatabase function:
+    - Maps "books.db" into memory and builds one compact BookRecord per line that points into the mapped bytes.
+    - Large files are parsed in newline-aligned chunks on one thread per core, then merged in file order.
+    - No text is copied at load time; only books added later store their text in the string arena.
+    - Reads the copies and loans of the books that have them into the loan table.
+    - Builds the ISBN, token, title trigram, borrow, year, completion and facet indexes and the scan columns over the
+      loaded records, in parallel.
+    - If "books.db.image" was made from this exact file, takes the records and indexes from it instead of
+      parsing and indexing; otherwise writes that image once everything is built.
+    - Locks the catalog first (see journalLock); the lock is released by journalClose.
+    - Replays the journal of changes made since "books.db" was last written and opens it for appending.
+    - Returns 1 on success, 0 on failure (file or memory issues).
+*/
+int loadDatabase(Catalog *catalog)
+{
+   STATS_START(statStart);
+
+   // Only one process may work on the catalog at a time
+   int lock = journalLock("books.db");
+   if (lock < 0)
+   {
+      return 0;
+   }
+   catalog->journal.lockFd = lock;
+   catalog->journal.locked = 1;
+
+   // Open file for reading
+   int fd = open("books.db", O_RDONLY);
+   if (fd < 0)
+   {
+      fprintf(stderr, "Missing books.db. Creating a new one...\n");
+      fd = open("books.db", O_RDWR | O_CREAT, 0644);
+      if (fd < 0)
+      {
+         fprintf(stderr, "Error: Unable to create books.db.\n");
+         return 0;
+      }
+   }
+
+   struct stat text;
+   int loaded = fstat(fd, &text) == 0 && mapFile(fd, catalog);
+   close(fd);
+   if (!loaded)
+   {
+      return 0;
+   }
+
+   // Take the rows and indexes from the image of this exact file if there is one,
+   // otherwise parse the lines in place, index the records and leave an image for next time
+   if (imageEnabled() && catalog->dataSize > 0 && imageLoad(catalog, "books.db.image", &text))
+   {
+      // Both are one pass over the records, cheaper to rebuild than to store in the image
+      if (!borrowIndexBuild(&catalog->borrowIndex, catalog) || !yearIndexBuild(&catalog->yearIndex, catalog))
+      {
+         return 0;
+      }
+   }
+   else
+   {
+      if (!parseFile(catalog) || !buildLoans(catalog) || !buildIndexes(catalog))
+      {
+         return 0;
+      }
+      if (imageEnabled() && catalog->dataSize > 0)
+      {
+         imageWrite("books.db.image", catalog, catalog->books, &text);
+      }
+   }
+
+   // Apply changes recorded after the last snapshot
+   int opened = journalOpen(&catalog->journal, "books.db", catalog);
+   STATS_STOP(STAT_LOAD, statStart);
+   return opened;
+}
+
+//====== SAVED RECORD FUNCTION ======
+/*
+    savedRecord function:
+    - Works out the BookRecord that parsing a line written by saveDatabase at offset would give.
+    - Returns 1 on success, 0 if parsing would not give back the same row (an empty field, or one
+      containing '|' or a line break), in which case no image can be written for the file.
+*/
+static int savedRecord(const Catalog *catalog, int row, uint64_t offset, BookRecord *book)
+{
+   StringView fields[4] = {bookIsbn(catalog, row), bookTitle(catalog, row), bookAuthors(catalog, row), bookGenre(catalog, row)};
+   for (int i = 0; i < 4; i++)
+   {
+      if (fields[i].length == 0 || memchr(fields[i].data, '|', fields[i].length) ||
+          memchr(fields[i].data, '\n', fields[i].length))
+      {
+         return 0;
+      }
+   }
+   int year = bookYear(catalog, row);
+   if (year == INT_MIN)
+   {
+      return 0;
+   }
+
+   book->offset = offset;
+   book->isbnLength = (uint8_t)fields[0].length;
+   book->titleAt = (uint16_t)(fields[0].length + 1);
+   book->titleLength = (uint8_t)fields[1].length;
+   book->authorsAt = (uint16_t)(book->titleAt + fields[1].length + 1);
+   book->authorsLength = (uint8_t)fields[2].length;
+   book->genreAt = (uint16_t)(book->authorsAt + fields[2].length + 1 + snprintf(NULL, 0, "%d", year) + 1);
+   book->genreLength = (uint8_t)fields[3].length;
+   book->year = year;
+   book->flags = catalog->books[row].flags & BOOK_BORROWED;
+   book->borrowDay = bookBorrowDay(catalog, row);
+   book->loans = catalog->books[row].loans;
+   return 1;
+}
+
+//====== SYNC DIRECTORY FUNCTION ======
+/*
+    syncDirectory function:
+    - Flushes the directory holding path to disk, so a rename inside it survives a crash.
+    - Returns 1 on success, 0 on failure.
+*/
+int syncDirectory(const char *path)
+{
+   char directory[300];
+   const char *slash = strrchr(path, '/');
+   if (slash)
+   {
+      snprintf(directory, sizeof(directory), "%.*s", (int)(slash - path) + (slash == path), path);
+   }
+   else
+   {
+      snprintf(directory, sizeof(directory), ".");
+   }
+
+   int fd = open(directory, O_RDONLY | O_DIRECTORY);
+   if (fd < 0)
+   {
+      return 0;
+   }
+   int synced = fsync(fd) == 0;
+   close(fd);
+   return synced;
+}
+
+//====== SAVE DATABASE FUNCTION ======
+/*
+    saveDatabase function:
+    - Saves all books in the catalog, tombstones left out, to the specified file, atomically: the rows are written to
+      "<filename>.tmp", which is fsynced and then renamed over the file, and the directory is fsynced.
+      A crash at any point leaves either the old or the new file, never a partial one.
+    - Stores how long each step took in timing, if it is not NULL.
+    - Unless images are disabled, also writes "<filename>.image" so the next start can skip parsing the file;
+      only for a compacted catalog that has its indexes (not a frozen copy), as the image keeps the in-memory
+      indexes and their row numbers.
+    - Returns 1 on success, 0 if the file could not be written (the old file is then left as it was).
+*/
+int saveDatabase(const char *filename, const Catalog *catalog, PersistTiming *timing)
+{
+   char temp[300];
+   snprintf(temp, sizeof(temp), "%s.tmp", filename);
+   STATS_START(statStart);
+   double start = clockMs();
+   FILE *file = fopen(temp, "w");
+   if (!file)
+   {
+      fprintf(stderr, "Error! Unable to open file for writing.\n");
+      return 0;
+   }
+
+   // Rows as they will be found in the new file, for its image
+   BookRecord *records = imageEnabled() && catalog->deleted == 0 && !catalog->frozen ? malloc((catalog->count ? catalog->count : 1) * sizeof(BookRecord)) : NULL;
+   uint64_t offset = 0;
+   for (int i = 0; i < catalog->count; i++)
+   {
+      if (catalog->books[i].flags & BOOK_DELETED)
+      {
+         continue;
+      }
+      StringView isbn = bookIsbn(catalog, i);
+      StringView title = bookTitle(catalog, i);
+      StringView authors = bookAuthors(catalog, i);
+      StringView genre = bookGenre(catalog, i);
+      char date[11];
+      formatDate(bookBorrowDay(catalog, i), date, sizeof(date));
+      int written = fprintf(file, "%.*s|%.*s|%.*s|%d|%.*s|%s|%s",
+                            isbn.length, isbn.data, title.length, title.data, authors.length, authors.data,
+                            bookYear(catalog, i), genre.length, genre.data,
+                            isBookBorrowed(catalog, i) ? "true" : "false", date);
+      if (written >= 0 && catalog->books[i].loans > 0)
+      {
+         // Copies and loans follow, so older readers still see the borrow status of the book as a whole
+         int loans = loanTableWriteFields(&catalog->loans, catalog->books[i].loans - 1, file);
+         written = loans < 0 ? -1 : written + loans;
+      }
+      if (written >= 0)
+      {
+         written = putc('\n', file) == EOF ? -1 : written + 1;
+      }
+      if (records && (written < 0 || !savedRecord(catalog, i, offset, &records[i])))
+      {
+         free(records);
+         records = NULL;
+      }
+      offset += written > 0 ? (uint64_t)written : 0;
+   }
+
+   // Make the new contents durable before they replace the old ones
+   int flushed = fflush(file) == 0;
+   double writtenAt = clockMs();
+   int synced = flushed && fsync(fileno(file)) == 0;
+   double syncedAt = clockMs();
+   if (fclose(file) != 0 || !synced)
+   {
+      fprintf(stderr, "Error! Unable to finish writing %s.\n", temp);
+      unlink(temp);
+      free(records);
+      return 0;
+   }
+   if (rename(temp, filename) != 0)
+   {
+      fprintf(stderr, "Error: Unable to replace %s.\n", filename);
+      unlink(temp);
+      free(records);
+      return 0;
+   }
+   if (!syncDirectory(filename))
+   {
+      fprintf(stderr, "Error: Unable to flush the directory of %s.\n", filename);
+      free(records);
+      return 0;
+   }
+   if (timing)
+   {
+      timing->writeMs = writtenAt - start;
+      timing->syncMs = syncedAt - writtenAt;
+      timing->renameMs = clockMs() - syncedAt;
+   }
+   STATS_STOP(STAT_SAVE, statStart);
+   STATS_ADD(STAT_BYTES_WRITTEN, offset);
+
+   // The image is only a shortcut; the text file is already complete without it.
+   // One left from the old file no longer matches, so it goes if no new one is written
+   struct stat st;
+   char image[300];
+   snprintf(image, sizeof(image), "%s.image", filename);
+   if (records && stat(filename, &st) == 0)
+   {
+      imageWrite(image, catalog, records, &st);
+   }
+   else
+   {
+      unlink(image);
+   }
+   free(records);
+   return 1;
+}
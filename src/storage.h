@@ -0,0 +1,25 @@
+#ifndef STORAGE_H
+#define STORAGE_H
+
+#include "catalog.h"
+
+//====== PERSIST TIMING STRUCTURE DEFINITION ======
+/*
+    PersistTiming structure:
+    - How long each step of saveDatabase took, in milliseconds.
+*/
+typedef struct
+{
+   double writeMs;  // Writing the rows to the temporary file
+   double syncMs;   // fsync of the temporary file
+   double renameMs; // Rename over the target and fsync of its directory
+} PersistTiming;
+
+int loadDatabase(Catalog *catalog);
+int saveDatabase(const char *filename, const Catalog *catalog, PersistTiming *timing);
+int compactCatalog(Catalog *catalog);
+int freezeCatalog(const Catalog *catalog, Catalog *frozen);
+void freeFrozenCatalog(Catalog *frozen);
+int syncDirectory(const char *path);
+
+#endif
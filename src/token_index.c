@@ -0,0 +1,892 @@
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "catalog.h"
+#include "image.h"
+#include "stats.h"
+#include "token_index.h"
+
+//====== HASH TOKEN FUNCTION ======
+/*
+    hashToken function:
+    - Computes a 32-bit FNV-1a hash of a token.
+*/
+static unsigned int hashToken(const char *token, int length)
+{
+   unsigned int hash = 2166136261u;
+   for (int i = 0; i < length; i++)
+   {
+      hash ^= (unsigned char)token[i];
+      hash *= 16777619u;
+   }
+   return hash;
+}
+
+//====== NEXT TOKEN FUNCTION ======
+/*
+    nextToken function:
+    - Reads the next word of a text starting at pos: a run of letters and digits (bytes above 127
+      count as letters, so UTF-8 words stay whole), lowercased into token.
+    - Words longer than TOKEN_MAX_LENGTH are cut.
+    - Returns the token length, or 0 when there are no more words.
+*/
+static int nextToken(const char *text, int length, int *pos, char *token)
+{
+   while (*pos < length && !isalnum((unsigned char)text[*pos]) && (unsigned char)text[*pos] < 128)
+   {
+      (*pos)++;
+   }
+
+   int tokenLength = 0;
+   while (*pos < length && (isalnum((unsigned char)text[*pos]) || (unsigned char)text[*pos] >= 128))
+   {
+      if (tokenLength < TOKEN_MAX_LENGTH)
+      {
+         token[tokenLength++] = (char)tolower((unsigned char)text[*pos]);
+      }
+      (*pos)++;
+   }
+   return tokenLength;
+}
+
+//====== FIND TOKEN FUNCTION ======
+/*
+    findToken function:
+    - Looks up a token in the hash table.
+    - Returns its slot, or NULL if the token is not indexed.
+*/
+static TokenSlot *findToken(const TokenIndex *index, const char *token, int length, unsigned int hash)
+{
+   if (index->capacity == 0)
+   {
+      return NULL;
+   }
+
+   unsigned int mask = index->capacity - 1;
+   for (unsigned int pos = hash & mask; index->slots[pos].length != 0; pos = (pos + 1) & mask)
+   {
+      TokenSlot *slot = &index->slots[pos];
+      if (slot->hash == hash && slot->length == length && memcmp(index->pool + slot->text, token, length) == 0)
+      {
+         return slot;
+      }
+   }
+   return NULL;
+}
+
+//====== RESIZE TOKEN TABLE FUNCTION ======
+/*
+    resizeTable function:
+    - Moves all tokens to a new slot table with the given capacity (a power of two).
+    - Returns 1 on success, 0 on memory allocation failure.
+*/
+static int resizeTable(TokenIndex *index, unsigned int capacity)
+{
+   TokenSlot *slots = calloc(capacity, sizeof(TokenSlot));
+   if (!slots)
+   {
+      fprintf(stderr, "Error: Memory allocation for token index failed.\n");
+      return 0;
+   }
+
+   unsigned int mask = capacity - 1;
+   for (unsigned int i = 0; i < index->capacity; i++)
+   {
+      if (index->slots[i].length != 0)
+      {
+         unsigned int pos = index->slots[i].hash & mask;
+         while (slots[pos].length != 0)
+         {
+            pos = (pos + 1) & mask;
+         }
+         slots[pos] = index->slots[i];
+      }
+   }
+
+   free(index->slots);
+   index->slots = slots;
+   index->capacity = capacity;
+   STATS_ADD(STAT_REALLOCS, 1);
+   return 1;
+}
+
+//====== INTERN TOKEN FUNCTION ======
+/*
+    internToken function:
+    - Returns the slot of a token, adding the token (with an empty posting list, and to the BK tree) if it is new.
+    - Returns NULL on memory allocation failure.
+*/
+static TokenSlot *internToken(TokenIndex *index, const char *token, int length)
+{
+   unsigned int hash = hashToken(token, length);
+   TokenSlot *slot = findToken(index, token, length, hash);
+   if (slot)
+   {
+      return slot;
+   }
+
+   // Keep the load factor under 1/2
+   if ((index->count + 1) * 2 > index->capacity && !resizeTable(index, index->capacity ? index->capacity * 2 : 1024))
+   {
+      return NULL;
+   }
+
+   // Store the token text
+   if (index->poolSize + length > index->poolCapacity)
+   {
+      size_t capacity = index->poolCapacity ? index->poolCapacity * 2 : 16384;
+      char *pool = realloc(index->pool, capacity);
+      if (!pool)
+      {
+         fprintf(stderr, "Error: Memory allocation for token index failed.\n");
+         return NULL;
+      }
+      index->pool = pool;
+      index->poolCapacity = capacity;
+      STATS_ADD(STAT_REALLOCS, 1);
+   }
+   memcpy(index->pool + index->poolSize, token, length);
+
+   unsigned int mask = index->capacity - 1;
+   unsigned int pos = hash & mask;
+   while (index->slots[pos].length != 0)
+   {
+      pos = (pos + 1) & mask;
+   }
+   slot = &index->slots[pos];
+   slot->hash = hash;
+   slot->text = (uint32_t)index->poolSize;
+   slot->length = (uint8_t)length;
+   memset(&slot->postings, 0, sizeof(slot->postings));
+   index->poolSize += length;
+   index->count++;
+   return bkTreeAdd(&index->words, token, length) ? slot : NULL;
+}
+
+//====== ADD POSTING FUNCTION ======
+/*
+    addPosting function:
+    - Records that a row contains the token in the given field.
+    - Rows are normally added in ascending order; a repeated row only gains the field bit.
+    - Returns 1 on success, 0 on memory allocation failure.
+*/
+static int addPosting(PostingList *list, int row, uint8_t field)
+{
+   // Find where the row belongs (almost always at the end)
+   int at = list->count;
+   while (at > 0 && list->rows[at - 1] > row)
+   {
+      at--;
+   }
+   if (at > 0 && list->rows[at - 1] == row)
+   {
+      list->fields[at - 1] |= field;
+      return 1;
+   }
+
+   if (list->count >= list->capacity)
+   {
+      int capacity = list->capacity ? list->capacity * 2 : 4;
+      int *rows = realloc(list->rows, capacity * sizeof(int));
+      if (!rows)
+      {
+         fprintf(stderr, "Error: Memory allocation for token index failed.\n");
+         return 0;
+      }
+      list->rows = rows;
+      uint8_t *fields = realloc(list->fields, capacity);
+      if (!fields)
+      {
+         fprintf(stderr, "Error: Memory allocation for token index failed.\n");
+         return 0;
+      }
+      list->fields = fields;
+      list->capacity = capacity;
+      STATS_ADD(STAT_REALLOCS, 1);
+   }
+
+   memmove(list->rows + at + 1, list->rows + at, (list->count - at) * sizeof(int));
+   memmove(list->fields + at + 1, list->fields + at, list->count - at);
+   list->rows[at] = row;
+   list->fields[at] = field;
+   list->count++;
+   return 1;
+}
+
+//====== INDEX FIELD FUNCTION ======
+/*
+    indexField function:
+    - Adds every word of one field of a row to the index.
+    - Returns 1 on success, 0 on memory allocation failure.
+*/
+static int indexField(TokenIndex *index, StringView text, int row, uint8_t field)
+{
+   char token[TOKEN_MAX_LENGTH];
+   int pos = 0;
+   int length;
+   while ((length = nextToken(text.data, text.length, &pos, token)) > 0)
+   {
+      TokenSlot *slot = internToken(index, token, length);
+      if (!slot || !addPosting(&slot->postings, row, field))
+      {
+         return 0;
+      }
+   }
+   return 1;
+}
+
+//====== ADD TO TOKEN INDEX FUNCTION ======
+/*
+    tokenIndexAdd function:
+    - Indexes the title, authors and genre of the book at the given row.
+    - Returns 1 on success, 0 on memory allocation failure.
+*/
+int tokenIndexAdd(TokenIndex *index, const Catalog *catalog, int row)
+{
+   return indexField(index, bookTitle(catalog, row), row, TOKEN_TITLE) &&
+          indexField(index, bookAuthors(catalog, row), row, TOKEN_AUTHORS) &&
+          indexField(index, bookGenre(catalog, row), row, TOKEN_GENRE);
+}
+
+//====== BUILD TOKEN INDEX FUNCTION ======
+/*
+    tokenIndexBuild function:
+    - Builds the index over all rows of the catalog, then lays out the BK tree of the whole vocabulary.
+    - Returns 1 on success, 0 on memory allocation failure.
+*/
+int tokenIndexBuild(TokenIndex *index, const Catalog *catalog)
+{
+   memset(index, 0, sizeof(*index));
+   for (int i = 0; i < catalog->count; i++)
+   {
+      if (!tokenIndexAdd(index, catalog, i))
+      {
+         return 0;
+      }
+   }
+   return bkTreeLayout(&index->words);
+}
+
+//====== SEEK POSTING FUNCTION ======
+/*
+    seekPosting function:
+    - Advances a cursor in a posting list to the first entry not below row (galloping, then binary search).
+    - Returns 1 if the list contains the row, 0 otherwise.
+*/
+static int seekPosting(const PostingList *list, int *cursor, int row)
+{
+   int lo = *cursor;
+   if (lo >= list->count || list->rows[lo] >= row)
+   {
+      return lo < list->count && list->rows[lo] == row;
+   }
+
+   // rows[lo] < row: gallop until passing it
+   int step = 1;
+   while (lo + step < list->count && list->rows[lo + step] < row)
+   {
+      lo += step;
+      step *= 2;
+   }
+   int hi = lo + step < list->count ? lo + step : list->count;
+   lo++;
+   while (lo < hi)
+   {
+      int mid = lo + (hi - lo) / 2;
+      if (list->rows[mid] < row)
+      {
+         lo = mid + 1;
+      }
+      else
+      {
+         hi = mid;
+      }
+   }
+   *cursor = lo;
+   return lo < list->count && list->rows[lo] == row;
+}
+
+//====== SEARCH WORDS FUNCTION ======
+/*
+    searchWords function:
+    - The search of tokenIndexSearch, without the timing.
+*/
+static int searchWords(const TokenIndex *index, const Catalog *catalog, const char *query, int *rows, int maxRows)
+{
+   const PostingList *lists[TOKEN_MAX_TERMS];
+   uint8_t masks[TOKEN_MAX_TERMS];
+   int terms = 0;
+   int missing = 0;
+
+   // Split the query into words, keeping the field each one is limited to
+   const char *term = query;
+   while (*term && terms < TOKEN_MAX_TERMS)
+   {
+      while (*term == ' ' || *term == '\t')
+      {
+         term++;
+      }
+      int length = (int)strcspn(term, " \t");
+      if (length == 0)
+      {
+         break;
+      }
+
+      uint8_t mask = TOKEN_ANY;
+      const char *colon = memchr(term, ':', length);
+      if (colon)
+      {
+         int prefix = (int)(colon - term);
+         if (prefix == 5 && strncasecmp(term, "title", 5) == 0)
+         {
+            mask = TOKEN_TITLE;
+         }
+         else if ((prefix == 6 && strncasecmp(term, "author", 6) == 0) || (prefix == 7 && strncasecmp(term, "authors", 7) == 0))
+         {
+            mask = TOKEN_AUTHORS;
+         }
+         else if (prefix == 5 && strncasecmp(term, "genre", 5) == 0)
+         {
+            mask = TOKEN_GENRE;
+         }
+      }
+      const char *words = mask == TOKEN_ANY ? term : colon + 1;
+      int wordsLength = length - (int)(words - term);
+
+      char token[TOKEN_MAX_LENGTH];
+      int pos = 0;
+      int tokenLength;
+      while (terms < TOKEN_MAX_TERMS && (tokenLength = nextToken(words, wordsLength, &pos, token)) > 0)
+      {
+         TokenSlot *slot = findToken(index, token, tokenLength, hashToken(token, tokenLength));
+         if (!slot || slot->postings.count == 0)
+         {
+            missing = 1;
+         }
+         else
+         {
+            lists[terms] = &slot->postings;
+            masks[terms] = mask;
+         }
+         terms++;
+      }
+      term += length;
+   }
+
+   if (terms == 0)
+   {
+      return -1;
+   }
+   if (missing)
+   {
+      return 0;
+   }
+
+   // Shortest posting list first
+   for (int i = 1; i < terms; i++)
+   {
+      for (int j = i; j > 0 && lists[j]->count < lists[j - 1]->count; j--)
+      {
+         const PostingList *list = lists[j];
+         lists[j] = lists[j - 1];
+         lists[j - 1] = list;
+         uint8_t mask = masks[j];
+         masks[j] = masks[j - 1];
+         masks[j - 1] = mask;
+      }
+   }
+
+   // Walk the shortest list and look each row up in the others
+   int cursors[TOKEN_MAX_TERMS] = {0};
+   int found = 0;
+   STATS_ADD(STAT_ROWS_SCANNED, lists[0]->count);
+   for (int i = 0; i < lists[0]->count; i++)
+   {
+      int row = lists[0]->rows[i];
+      if (!(lists[0]->fields[i] & masks[0]) || isBookDeleted(catalog, row))
+      {
+         continue;
+      }
+
+      int matches = 1;
+      for (int t = 1; t < terms && matches; t++)
+      {
+         matches = seekPosting(lists[t], &cursors[t], row) && (lists[t]->fields[cursors[t]] & masks[t]);
+      }
+      if (matches)
+      {
+         if (found < maxRows)
+         {
+            rows[found] = row;
+         }
+         found++;
+      }
+   }
+   return found;
+}
+
+//====== SEARCH TOKEN INDEX FUNCTION ======
+/*
+    tokenIndexSearch function:
+    - Finds the books that contain every word of the query (AND).
+    - A word can be limited to one field with a prefix: "title:", "author:" or "genre:".
+    - Intersects the posting lists starting from the shortest, so the work depends on the
+      rarest word and not on the catalog size.
+    - Rows of deleted books are still in the posting lists until the catalog is compacted and are skipped here.
+    - Stores up to maxRows matching rows (ascending) in rows.
+    - Returns the total number of matches, or -1 if the query has no words.
+*/
+int tokenIndexSearch(const TokenIndex *index, const Catalog *catalog, const char *query, int *rows, int maxRows)
+{
+   STATS_START(statStart);
+   int found = searchWords(index, catalog, query, rows, maxRows);
+   STATS_STOP(STAT_FIND_KEYWORDS, statStart);
+   return found;
+}
+
+//====== FUZZY WORD STRUCTURE DEFINITION ======
+/*
+    FuzzyWord structure:
+    - One vocabulary word a term of a fuzzy search stands for.
+*/
+typedef struct
+{
+   const PostingList *list; // Rows containing the word
+   int distance;            // Edit distance from the term
+   int cursor;              // Position in list, only moves forward
+} FuzzyWord;
+
+//====== FUZZY ALLOWANCE FUNCTION ======
+/*
+    fuzzyAllowance function:
+    - Returns the edit distance a term of the given length may be off by: none up to 2 letters, one up to 5,
+      two beyond, and never more than maxDistance; short words would otherwise match most of the vocabulary.
+*/
+static int fuzzyAllowance(int length, int maxDistance)
+{
+   int allowed = length <= 2 ? 0 : length <= 5 ? 1 : 2;
+   return allowed < maxDistance ? allowed : maxDistance;
+}
+
+//====== COMPARE FUZZY WORDS FUNCTION ======
+/*
+    compareFuzzyWords function:
+    - qsort comparator putting the closest words first.
+*/
+static int compareFuzzyWords(const void *a, const void *b)
+{
+   return ((const FuzzyWord *)a)->distance - ((const FuzzyWord *)b)->distance;
+}
+
+//====== COMPARE KEYS FUNCTION ======
+/*
+    compareKeys function:
+    - qsort comparator for ascending 64-bit keys.
+*/
+static int compareKeys(const void *a, const void *b)
+{
+   uint64_t x = *(const uint64_t *)a;
+   uint64_t y = *(const uint64_t *)b;
+   return (x > y) - (x < y);
+}
+
+//====== SIFT DOWN KEY FUNCTION ======
+/*
+    siftDownKey function:
+    - Restores a min-heap of 64-bit keys below position i.
+*/
+static void siftDownKey(uint64_t *heap, int count, int i)
+{
+   while (1)
+   {
+      int smallest = i;
+      int left = 2 * i + 1;
+      int right = left + 1;
+      if (left < count && heap[left] < heap[smallest])
+      {
+         smallest = left;
+      }
+      if (right < count && heap[right] < heap[smallest])
+      {
+         smallest = right;
+      }
+      if (smallest == i)
+      {
+         return;
+      }
+      uint64_t swap = heap[i];
+      heap[i] = heap[smallest];
+      heap[smallest] = swap;
+      i = smallest;
+   }
+}
+
+//====== PUSH KEY FUNCTION ======
+/*
+    pushKey function:
+    - Adds a key to a min-heap of count keys that has room for it.
+*/
+static void pushKey(uint64_t *heap, int count, uint64_t key)
+{
+   int i = count;
+   while (i > 0 && key < heap[(i - 1) / 2])
+   {
+      heap[i] = heap[(i - 1) / 2];
+      i = (i - 1) / 2;
+   }
+   heap[i] = key;
+}
+
+//====== FIND FUZZY WORDS FUNCTION ======
+/*
+    findFuzzyWords function:
+    - Fills words with the vocabulary words within the allowance of a term, closest first.
+    - Returns the number of words (0 if none is close enough), or -1 on memory allocation failure.
+*/
+static int findFuzzyWords(const TokenIndex *index, const char *term, int length, int maxDistance, FuzzyWord *words)
+{
+   BkMatch matches[TOKEN_FUZZY_MAX_WORDS];
+   int count = bkTreeFind(&index->words, term, length, fuzzyAllowance(length, maxDistance), matches, TOKEN_FUZZY_MAX_WORDS);
+   int kept = 0;
+   for (int i = 0; i < count; i++)
+   {
+      const TokenSlot *slot = findToken(index, matches[i].text, matches[i].length,
+                                        hashToken(matches[i].text, matches[i].length));
+      if (slot && slot->postings.count > 0)
+      {
+         words[kept++] = (FuzzyWord){&slot->postings, matches[i].distance, 0};
+      }
+   }
+   qsort(words, kept, sizeof(FuzzyWord), compareFuzzyWords);
+   return count < 0 ? -1 : kept;
+}
+
+//====== SEARCH FUZZY FUNCTION ======
+/*
+    searchFuzzy function:
+    - The search of tokenIndexFuzzySearch, without the timing.
+*/
+static int searchFuzzy(const TokenIndex *index, const Catalog *catalog, const char *query, int maxDistance, int *rows,
+                       int maxRows)
+{
+   FuzzyWord *words = malloc(TOKEN_MAX_TERMS * TOKEN_FUZZY_MAX_WORDS * sizeof(FuzzyWord));
+   if (!words)
+   {
+      fprintf(stderr, "Error: Memory allocation for fuzzy search failed.\n");
+      return 0;
+   }
+
+   // The words each term stands for, and the term with the fewest postings over all of them
+   int counts[TOKEN_MAX_TERMS];
+   int terms = 0;
+   int driver = 0;
+   size_t driverPostings = SIZE_MAX;
+   char token[TOKEN_MAX_LENGTH];
+   int pos = 0;
+   int length;
+   int queryLength = (int)strlen(query);
+   while (terms < TOKEN_MAX_TERMS && (length = nextToken(query, queryLength, &pos, token)) > 0)
+   {
+      FuzzyWord *termWords = words + terms * TOKEN_FUZZY_MAX_WORDS;
+      counts[terms] = findFuzzyWords(index, token, length, maxDistance, termWords);
+      if (counts[terms] <= 0)
+      {
+         free(words);
+         return 0;
+      }
+      size_t postings = 0;
+      for (int w = 0; w < counts[terms]; w++)
+      {
+         postings += termWords[w].list->count;
+      }
+      if (postings < driverPostings)
+      {
+         driverPostings = postings;
+         driver = terms;
+      }
+      terms++;
+   }
+   if (terms == 0)
+   {
+      free(words);
+      return -1;
+   }
+
+   // The best maxRows matches so far, as the complement of distance << 32 | row so the worst is on top
+   uint64_t *best = malloc((maxRows > 0 ? maxRows : 1) * sizeof(uint64_t));
+   if (!best)
+   {
+      fprintf(stderr, "Error: Memory allocation for fuzzy search failed.\n");
+      free(words);
+      return 0;
+   }
+   int kept = 0;
+
+   // Merge the driver's posting lists, as row << 8 | word; words are sorted closest first, so the first
+   // entry of a row carries its smallest distance
+   const uint8_t mask = TOKEN_TITLE | TOKEN_AUTHORS;
+   FuzzyWord *driverWords = words + driver * TOKEN_FUZZY_MAX_WORDS;
+   uint64_t merge[TOKEN_FUZZY_MAX_WORDS];
+   int heads = 0;
+   for (int w = 0; w < counts[driver]; w++)
+   {
+      pushKey(merge, heads++, (uint64_t)driverWords[w].list->rows[0] << 8 | (uint64_t)w);
+   }
+   STATS_ADD(STAT_ROWS_SCANNED, driverPostings);
+
+   int found = 0;
+   int previousRow = -1;
+   while (heads > 0)
+   {
+      int row = (int)(merge[0] >> 8);
+      FuzzyWord *word = &driverWords[merge[0] & 0xff];
+      int inField = word->list->fields[word->cursor] & mask;
+      if (++word->cursor < word->list->count)
+      {
+         merge[0] = (uint64_t)word->list->rows[word->cursor] << 8 | (merge[0] & 0xff);
+      }
+      else
+      {
+         merge[0] = merge[--heads];
+      }
+      siftDownKey(merge, heads, 0);
+      if (!inField || row == previousRow || isBookDeleted(catalog, row))
+      {
+         continue;
+      }
+      previousRow = row;
+
+      // Look the row up in the words of the other terms, closest first
+      int distance = word->distance;
+      for (int t = 0; t < terms && distance >= 0; t++)
+      {
+         if (t == driver)
+         {
+            continue;
+         }
+         FuzzyWord *termWords = words + t * TOKEN_FUZZY_MAX_WORDS;
+         int closest = -1;
+         for (int w = 0; w < counts[t] && closest < 0; w++)
+         {
+            if (seekPosting(termWords[w].list, &termWords[w].cursor, row) &&
+                (termWords[w].list->fields[termWords[w].cursor] & mask))
+            {
+               closest = termWords[w].distance;
+            }
+         }
+         distance = closest < 0 ? -1 : distance + closest;
+      }
+      if (distance < 0)
+      {
+         continue;
+      }
+
+      found++;
+      uint64_t key = ~((uint64_t)distance << 32 | (uint64_t)row);
+      if (kept < maxRows)
+      {
+         pushKey(best, kept++, key);
+      }
+      else if (kept > 0 && key > best[0])
+      {
+         best[0] = key;
+         siftDownKey(best, kept, 0);
+      }
+   }
+
+   // Closest books first, then in file order
+   for (int i = 0; i < kept; i++)
+   {
+      best[i] = ~best[i];
+   }
+   qsort(best, kept, sizeof(uint64_t), compareKeys);
+   for (int i = 0; i < kept; i++)
+   {
+      rows[i] = (int)(best[i] & 0xffffffffu);
+   }
+   free(best);
+   free(words);
+   return found;
+}
+
+//====== FUZZY SEARCH TOKEN INDEX FUNCTION ======
+/*
+    tokenIndexFuzzySearch function:
+    - Finds the books whose title or authors contain, for every word of the query, a word within a few
+      edits of it (AND), so misspelled queries still find their books.
+    - A word may be off by up to maxDistance edits (insertions, deletions, substitutions), but by one at
+      most up to 5 letters and not at all up to 2.
+    - The BK tree finds the close vocabulary words of each term; the rows of the term whose words have
+      the fewest postings are then checked against the posting lists of the other terms.
+    - Stores up to maxRows matching rows in rows, fewest edits in total first, then ascending.
+    - Returns the total number of matches, or -1 if the query has no words.
+*/
+int tokenIndexFuzzySearch(const TokenIndex *index, const Catalog *catalog, const char *query, int maxDistance, int *rows,
+                          int maxRows)
+{
+   STATS_START(statStart);
+   int found = searchFuzzy(index, catalog, query, maxDistance, rows, maxRows);
+   STATS_STOP(STAT_FIND_FUZZY, statStart);
+   return found;
+}
+
+//====== FREE TOKEN INDEX FUNCTION ======
+/*
+    tokenIndexFree function:
+    - Releases the posting lists, the slot table, the character pool and the BK tree.
+*/
+void tokenIndexFree(TokenIndex *index)
+{
+   for (unsigned int i = 0; i < index->capacity; i++)
+   {
+      free(index->slots[i].postings.rows);
+      free(index->slots[i].postings.fields);
+   }
+   free(index->slots);
+   free(index->pool);
+   bkTreeFree(&index->words);
+   memset(index, 0, sizeof(*index));
+}
+
+//====== TOKEN ENTRY STRUCTURE DEFINITION ======
+/*
+    TokenEntry structure:
+    - How one slot is stored in a binary image; the posting lists follow all entries back to back.
+*/
+typedef struct
+{
+   uint32_t hash;   // Hash of the token
+   uint32_t text;   // Offset of the token in the character pool
+   uint32_t length; // Token length, 0 if the slot is empty
+   int32_t count;   // Number of rows in the posting list
+} TokenEntry;
+
+//====== WRITE TOKEN INDEX FUNCTION ======
+/*
+    tokenIndexWrite function:
+    - Writes the slot table, the character pool, all posting lists and the BK tree to a binary image section.
+    - Returns 1 on success, 0 on memory allocation or write failure.
+*/
+int tokenIndexWrite(const TokenIndex *index, FILE *file)
+{
+   uint64_t sizes[3] = {index->capacity, index->count, index->poolSize};
+   TokenEntry *entries = malloc((index->capacity ? index->capacity : 1) * sizeof(TokenEntry));
+   if (!entries)
+   {
+      fprintf(stderr, "Error: Memory allocation for token index failed.\n");
+      return 0;
+   }
+   size_t total = 0;
+   for (unsigned int i = 0; i < index->capacity; i++)
+   {
+      const TokenSlot *slot = &index->slots[i];
+      entries[i] = (TokenEntry){slot->hash, slot->text, slot->length, slot->postings.count};
+      total += slot->postings.count;
+   }
+   int ok = imagePut(file, sizes, sizeof(sizes)) && imagePut(file, index->pool, index->poolSize) &&
+            imagePut(file, entries, index->capacity * sizeof(TokenEntry));
+   free(entries);
+
+   // Rows of every list, then the field masks of every list, each padded as one value
+   for (unsigned int i = 0; ok && i < index->capacity; i++)
+   {
+      const PostingList *list = &index->slots[i].postings;
+      ok = list->count == 0 || fwrite(list->rows, sizeof(int), list->count, file) == (size_t)list->count;
+   }
+   ok = ok && imagePad(file, total * sizeof(int));
+   for (unsigned int i = 0; ok && i < index->capacity; i++)
+   {
+      const PostingList *list = &index->slots[i].postings;
+      ok = list->count == 0 || fwrite(list->fields, 1, list->count, file) == (size_t)list->count;
+   }
+   return ok && imagePad(file, total) && bkTreeWrite(&index->words, file);
+}
+
+//====== READ TOKEN INDEX FUNCTION ======
+/*
+    tokenIndexRead function:
+    - Restores an index written by tokenIndexWrite into fresh allocations.
+    - Returns 1 on success, 0 if the section is malformed or allocation fails (the index is then empty).
+*/
+int tokenIndexRead(TokenIndex *index, ImageReader *reader)
+{
+   memset(index, 0, sizeof(*index));
+   const uint64_t *sizes = imageTake(reader, 3 * sizeof(uint64_t));
+   if (!sizes || sizes[0] > UINT32_MAX || (sizes[0] & (sizes[0] - 1)) != 0 || sizes[1] > sizes[0])
+   {
+      return 0;
+   }
+   unsigned int capacity = (unsigned int)sizes[0];
+   size_t poolSize = (size_t)sizes[2];
+   const char *pool = imageTake(reader, poolSize);
+   const TokenEntry *entries = imageTake(reader, capacity * sizeof(TokenEntry));
+   if (!pool || !entries)
+   {
+      return 0;
+   }
+   size_t total = 0;
+   for (unsigned int i = 0; i < capacity; i++)
+   {
+      if (entries[i].count < 0 || entries[i].length > TOKEN_MAX_LENGTH || entries[i].text + entries[i].length > poolSize)
+      {
+         return 0;
+      }
+      total += entries[i].count;
+   }
+   const int *rows = imageTake(reader, total * sizeof(int));
+   const uint8_t *fields = imageTake(reader, total);
+   if (!rows || !fields)
+   {
+      return 0;
+   }
+
+   index->slots = calloc(capacity ? capacity : 1, sizeof(TokenSlot));
+   index->pool = malloc(poolSize ? poolSize : 1);
+   if (!index->slots || !index->pool)
+   {
+      fprintf(stderr, "Error: Memory allocation for token index failed.\n");
+      tokenIndexFree(index);
+      return 0;
+   }
+   memcpy(index->pool, pool, poolSize);
+   index->poolSize = poolSize;
+   index->poolCapacity = poolSize ? poolSize : 1;
+   index->capacity = capacity;
+   index->count = (unsigned int)sizes[1];
+
+   for (unsigned int i = 0; i < capacity; i++)
+   {
+      TokenSlot *slot = &index->slots[i];
+      slot->hash = entries[i].hash;
+      slot->text = entries[i].text;
+      slot->length = (uint8_t)entries[i].length;
+      int count = entries[i].count;
+      if (count == 0)
+      {
+         continue;
+      }
+      slot->postings.rows = malloc(count * sizeof(int));
+      slot->postings.fields = malloc(count);
+      if (!slot->postings.rows || !slot->postings.fields)
+      {
+         fprintf(stderr, "Error: Memory allocation for token index failed.\n");
+         tokenIndexFree(index);
+         return 0;
+      }
+      memcpy(slot->postings.rows, rows, count * sizeof(int));
+      memcpy(slot->postings.fields, fields, count);
+      slot->postings.count = count;
+      slot->postings.capacity = count;
+      rows += count;
+      fields += count;
+   }
+   if (!bkTreeRead(&index->words, reader))
+   {
+      tokenIndexFree(index);
+      return 0;
+   }
+   return 1;
+}
@@ -0,0 +1,78 @@
+#ifndef TOKEN_INDEX_H
+#define TOKEN_INDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "bk_tree.h"
+
+struct Catalog;
+struct ImageReader;
+
+// Fields a token was found in
+#define TOKEN_TITLE 0x01
+#define TOKEN_AUTHORS 0x02
+#define TOKEN_GENRE 0x04
+#define TOKEN_ANY (TOKEN_TITLE | TOKEN_AUTHORS | TOKEN_GENRE)
+
+// Longest token kept, longer words are cut
+#define TOKEN_MAX_LENGTH 32
+
+// Most terms a query may have
+#define TOKEN_MAX_TERMS 16
+
+// Largest edit distance a fuzzy search allows per word
+#define TOKEN_FUZZY_MAX_DISTANCE 2
+
+// Most vocabulary words one term of a fuzzy search may stand for; further ones are ignored
+#ifndef TOKEN_FUZZY_MAX_WORDS
+#define TOKEN_FUZZY_MAX_WORDS 256
+#endif
+
+//====== TOKEN INDEX STRUCTURE DEFINITION ======
+/*
+    TokenIndex structure:
+    - Inverted index from normalized (lowercased) words of the title, authors and genre to the rows containing them.
+    - Every token has a posting list of rows in ascending order, with a mask of the fields the word appeared in.
+    - Tokens live in a hash table (linear probing); their text is packed into one character pool.
+    - A BK tree holds every token once more, for searches that tolerate typos.
+    - Deleting a book leaves its rows in the posting lists; searches skip them until the catalog is compacted.
+*/
+typedef struct
+{
+   int *rows;         // Rows containing the token, ascending
+   uint8_t *fields;   // TOKEN_* mask per row
+   int count;         // Number of rows
+   int capacity;      // Allocated rows
+} PostingList;
+
+typedef struct
+{
+   unsigned int hash;    // Hash of the token
+   uint32_t text;        // Offset of the token in the character pool
+   uint8_t length;       // Token length, 0 if the slot is empty
+   PostingList postings; // Rows containing the token
+} TokenSlot;
+
+typedef struct
+{
+   TokenSlot *slots;       // Slot table, capacity is always a power of two
+   unsigned int capacity;  // Number of slots
+   unsigned int count;     // Number of distinct tokens
+   char *pool;             // Text of all tokens, back to back
+   size_t poolSize;        // Bytes used in the pool
+   size_t poolCapacity;    // Bytes allocated for the pool
+   BkTree words;           // Every token, by edit distance
+} TokenIndex;
+
+int tokenIndexBuild(TokenIndex *index, const struct Catalog *catalog);
+int tokenIndexAdd(TokenIndex *index, const struct Catalog *catalog, int row);
+int tokenIndexSearch(const TokenIndex *index, const struct Catalog *catalog, const char *query, int *rows, int maxRows);
+int tokenIndexFuzzySearch(const TokenIndex *index, const struct Catalog *catalog, const char *query, int maxDistance,
+                          int *rows, int maxRows);
+void tokenIndexFree(TokenIndex *index);
+int tokenIndexWrite(const TokenIndex *index, FILE *file);
+int tokenIndexRead(TokenIndex *index, struct ImageReader *reader);
+
+#endif
@@ -0,0 +1,1003 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "batch.h"
+#include "catalog.h"
+#include "storage.h"
+#include "transfer.h"
+
+// Fields of a record, in books.db order
+#define TRANSFER_FIELDS 9
+
+// Fields every record must have; a missing borrow status and date mean "false" and "-"
+#define TRANSFER_REQUIRED_FIELDS 5
+
+// Fields of a record without copies and loans, which mean one copy and no loans
+#define TRANSFER_BOOK_FIELDS 7
+
+// The loans field, the last one, is the only one that may be longer than TRANSFER_FIELD_LENGTH
+#define LOANS_FIELD 8
+
+// Field names of the CSV header and the JSON objects, in books.db order
+static const char *fieldNames[TRANSFER_FIELDS] = {"isbn", "title", "authors", "year", "genre", "borrowed", "date", "copies", "loans"};
+
+//====== TRANSFER RECORD STRUCTURE DEFINITION ======
+/*
+    TransferRecord structure:
+    - One book as read from the input, every field still text; only checked once it is complete.
+    - Fields point into text, set up by initRecord; see fieldSize for how much each may hold.
+*/
+typedef struct
+{
+   char *fields[TRANSFER_FIELDS]; // ISBN, title, authors, year, genre, borrowed, date, copies, loans
+   char text[LOANS_FIELD * TRANSFER_FIELD_LENGTH + TRANSFER_LINE_LENGTH];
+   int count;                     // Fields read
+   long line;                     // Input line the record starts on
+} TransferRecord;
+
+//====== FIELD SIZE FUNCTION ======
+/*
+    fieldSize function:
+    - Returns the bytes a field of a record holds, its terminating NUL included.
+*/
+static int fieldSize(int field)
+{
+   return field == LOANS_FIELD ? TRANSFER_LINE_LENGTH : TRANSFER_FIELD_LENGTH;
+}
+
+//====== INIT RECORD FUNCTION ======
+/*
+    initRecord function:
+    - Points the fields of a record at their part of its text.
+*/
+static void initRecord(TransferRecord *record)
+{
+   for (int field = 0; field < TRANSFER_FIELDS; field++)
+   {
+      record->fields[field] = record->text + field * TRANSFER_FIELD_LENGTH;
+   }
+}
+
+//====== TRANSFER INPUT STRUCTURE DEFINITION ======
+/*
+    TransferInput structure:
+    - Reading position in an input; the only buffer is one line, whatever the size of the input.
+*/
+typedef struct
+{
+   FILE *file;                        // Input being read
+   BookFormat format;                 // Its format
+   long line;                         // Lines read so far
+   char buffer[TRANSFER_LINE_LENGTH]; // Current line of books.db or JSON Lines input
+} TransferInput;
+
+//====== PARSE FORMAT FUNCTION ======
+/*
+    parseFormat function:
+    - Converts a format name given on the command line ("db", "csv" or "jsonl").
+    - Returns 1 on success, 0 if the name is unknown.
+*/
+int parseFormat(const char *name, BookFormat *format)
+{
+   if (strcmp(name, "db") == 0)
+   {
+      *format = FORMAT_DB;
+   }
+   else if (strcmp(name, "csv") == 0)
+   {
+      *format = FORMAT_CSV;
+   }
+   else if (strcmp(name, "jsonl") == 0)
+   {
+      *format = FORMAT_JSONL;
+   }
+   else
+   {
+      fprintf(stderr, "Error: Unknown format %s, use db, csv or jsonl.\n", name);
+      return 0;
+   }
+   return 1;
+}
+
+//====== COPY FIELD FUNCTION ======
+/*
+    copyField function:
+    - Copies length bytes of text into a field of size bytes, clamped to size - 1 bytes.
+*/
+static void copyField(char *field, int size, const char *text, size_t length)
+{
+   if (length > (size_t)size - 1)
+   {
+      length = (size_t)size - 1;
+   }
+   memcpy(field, text, length);
+   field[length] = '\0';
+}
+
+//====== READ LINE FUNCTION ======
+/*
+    readLine function:
+    - Reads the next non-empty line into the input buffer, without its line break.
+    - Returns 1 if a line was read, 0 at the end of the input, -1 if the line did not fit the buffer
+      (the rest of it is skipped).
+*/
+static int readLine(TransferInput *input)
+{
+   while (fgets(input->buffer, sizeof(input->buffer), input->file))
+   {
+      input->line++;
+      size_t length = strlen(input->buffer);
+      if (length > 0 && input->buffer[length - 1] == '\n')
+      {
+         length--;
+      }
+      else if (!feof(input->file))
+      {
+         int ch;
+         while ((ch = getc(input->file)) != '\n' && ch != EOF)
+            ;
+         return -1;
+      }
+      if (length > 0 && input->buffer[length - 1] == '\r')
+      {
+         length--;
+      }
+      input->buffer[length] = '\0';
+      if (length > 0)
+      {
+         return 1;
+      }
+   }
+   return 0;
+}
+
+//====== SPLIT DB LINE FUNCTION ======
+/*
+    splitDbLine function:
+    - Splits a books.db line on '|' into the record, keeping empty fields so they are reported instead
+      of shifting the others.
+*/
+static void splitDbLine(const char *line, TransferRecord *record)
+{
+   record->count = 0;
+   while (1)
+   {
+      const char *bar = strchr(line, '|');
+      size_t length = bar ? (size_t)(bar - line) : strlen(line);
+      if (record->count < TRANSFER_FIELDS)
+      {
+         copyField(record->fields[record->count], fieldSize(record->count), line, length);
+      }
+      record->count++;
+      if (!bar)
+      {
+         return;
+      }
+      line = bar + 1;
+   }
+}
+
+//====== SKIP SPACES FUNCTION ======
+/*
+    skipSpaces function:
+    - Returns the first character of text that is not JSON whitespace.
+*/
+static const char *skipSpaces(const char *text)
+{
+   while (*text == ' ' || *text == '\t')
+   {
+      text++;
+   }
+   return text;
+}
+
+//====== HEX VALUE FUNCTION ======
+/*
+    hexValue function:
+    - Reads the four hexadecimal digits of a \u escape.
+    - Returns 1 on success, 0 if they are not four hexadecimal digits.
+*/
+static int hexValue(const char *text, unsigned int *value)
+{
+   *value = 0;
+   for (int i = 0; i < 4; i++)
+   {
+      char ch = text[i];
+      int digit = ch >= '0' && ch <= '9' ? ch - '0'
+                  : ch >= 'a' && ch <= 'f' ? ch - 'a' + 10
+                  : ch >= 'A' && ch <= 'F' ? ch - 'A' + 10
+                                           : -1;
+      if (digit < 0)
+      {
+         return 0;
+      }
+      *value = *value * 16 + (unsigned int)digit;
+   }
+   return 1;
+}
+
+//====== PARSE JSON STRING FUNCTION ======
+/*
+    parseJsonString function:
+    - Reads the JSON string starting at text (on its opening quote) into value, clamped to size - 1 bytes.
+    - Escapes are decoded, \u escapes (surrogate pairs included) to UTF-8.
+    - Returns the position after the closing quote, or NULL if the string is malformed.
+*/
+static const char *parseJsonString(const char *text, char *value, int size)
+{
+   if (*text != '"')
+   {
+      return NULL;
+   }
+   text++;
+
+   int length = 0;
+   unsigned char bytes[4];
+   while (*text != '"')
+   {
+      int count = 1;
+      bytes[0] = (unsigned char)*text++;
+      if (bytes[0] < 0x20)
+      {
+         return NULL;
+      }
+      if (bytes[0] == '\\')
+      {
+         char escape = *text++;
+         unsigned int code;
+         switch (escape)
+         {
+         case '"':
+         case '\\':
+         case '/':
+            bytes[0] = (unsigned char)escape;
+            break;
+         case 'b':
+            bytes[0] = '\b';
+            break;
+         case 'f':
+            bytes[0] = '\f';
+            break;
+         case 'n':
+            bytes[0] = '\n';
+            break;
+         case 'r':
+            bytes[0] = '\r';
+            break;
+         case 't':
+            bytes[0] = '\t';
+            break;
+         case 'u':
+            if (!hexValue(text, &code))
+            {
+               return NULL;
+            }
+            text += 4;
+            unsigned int low;
+            if (code >= 0xD800 && code < 0xDC00 && text[0] == '\\' && text[1] == 'u' && hexValue(text + 2, &low) &&
+                low >= 0xDC00 && low < 0xE000)
+            {
+               code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+               text += 6;
+            }
+            if (code < 0x80)
+            {
+               bytes[0] = (unsigned char)code;
+            }
+            else if (code < 0x800)
+            {
+               bytes[0] = (unsigned char)(0xC0 | code >> 6);
+               bytes[1] = (unsigned char)(0x80 | (code & 0x3F));
+               count = 2;
+            }
+            else if (code < 0x10000)
+            {
+               bytes[0] = (unsigned char)(0xE0 | code >> 12);
+               bytes[1] = (unsigned char)(0x80 | (code >> 6 & 0x3F));
+               bytes[2] = (unsigned char)(0x80 | (code & 0x3F));
+               count = 3;
+            }
+            else
+            {
+               bytes[0] = (unsigned char)(0xF0 | code >> 18);
+               bytes[1] = (unsigned char)(0x80 | (code >> 12 & 0x3F));
+               bytes[2] = (unsigned char)(0x80 | (code >> 6 & 0x3F));
+               bytes[3] = (unsigned char)(0x80 | (code & 0x3F));
+               count = 4;
+            }
+            break;
+         default:
+            return NULL;
+         }
+      }
+      for (int i = 0; i < count && length < size - 1; i++)
+      {
+         value[length++] = (char)bytes[i];
+      }
+   }
+   value[length] = '\0';
+   return text + 1;
+}
+
+//====== PARSE JSON RECORD FUNCTION ======
+/*
+    parseJsonRecord function:
+    - Reads one flat JSON object, as writeBook writes them, into the record.
+    - Strings, numbers, true and false are all taken as text; unknown keys and null values are ignored.
+    - A missing borrow status is "false", a missing date "-", missing copies 1 and missing loans "-".
+    - Returns NULL on success, otherwise the reason the line is not a record.
+*/
+static const char *parseJsonRecord(const char *line, TransferRecord *record)
+{
+   int seen = 0;
+   const char *pos = skipSpaces(line);
+   if (*pos != '{')
+   {
+      return "expected a JSON object";
+   }
+   pos = skipSpaces(pos + 1);
+
+   while (*pos != '}')
+   {
+      char key[16];
+      if (!(pos = parseJsonString(pos, key, sizeof(key))))
+      {
+         return "malformed JSON key";
+      }
+      pos = skipSpaces(pos);
+      if (*pos != ':')
+      {
+         return "expected ':' after a key";
+      }
+      pos = skipSpaces(pos + 1);
+
+      int field = TRANSFER_FIELDS - 1;
+      while (field >= 0 && strcmp(key, fieldNames[field]) != 0)
+      {
+         field--;
+      }
+      char ignored[TRANSFER_FIELD_LENGTH];
+      char *value = field >= 0 ? record->fields[field] : ignored;
+      int size = field >= 0 ? fieldSize(field) : TRANSFER_FIELD_LENGTH;
+      if (*pos == '"')
+      {
+         if (!(pos = parseJsonString(pos, value, size)))
+         {
+            return "malformed JSON string";
+         }
+      }
+      else
+      {
+         size_t length = strcspn(pos, ",} \t");
+         if (length == 0)
+         {
+            return "expected a value";
+         }
+         copyField(value, size, pos, length);
+         pos += length;
+         if (strcmp(value, "null") == 0)
+         {
+            field = -1;
+         }
+      }
+      if (field >= 0)
+      {
+         seen |= 1 << field;
+      }
+
+      pos = skipSpaces(pos);
+      if (*pos == ',')
+      {
+         pos = skipSpaces(pos + 1);
+      }
+      else if (*pos != '}')
+      {
+         return "expected ',' or '}'";
+      }
+   }
+   if (*skipSpaces(pos + 1) != '\0')
+   {
+      return "text after the JSON object";
+   }
+
+   for (int field = 0; field < TRANSFER_REQUIRED_FIELDS; field++)
+   {
+      if (!(seen & 1 << field))
+      {
+         return "isbn, title, authors, year and genre are required";
+      }
+   }
+   if (!(seen & 1 << 5))
+   {
+      strcpy(record->fields[5], "false");
+   }
+   if (!(seen & 1 << 6))
+   {
+      strcpy(record->fields[6], "-");
+   }
+   if (!(seen & 1 << 7))
+   {
+      strcpy(record->fields[7], "1");
+   }
+   if (!(seen & 1 << 8))
+   {
+      strcpy(record->fields[8], "-");
+   }
+   record->count = TRANSFER_FIELDS;
+   return NULL;
+}
+
+//====== READ CSV RECORD FUNCTION ======
+/*
+    readCsvRecord function:
+    - Reads the next CSV record, character by character: fields are separated by commas and may be quoted,
+      with "" for a quote; quoted fields may hold commas and line breaks. Empty lines are skipped.
+    - Returns 1 if a record was read, 0 at the end of the input, -1 if it is malformed (problem says why).
+*/
+static int readCsvRecord(TransferInput *input, TransferRecord *record, const char **problem)
+{
+   int ch = getc(input->file);
+   while (ch == '\n' || ch == '\r')
+   {
+      input->line += ch == '\n';
+      ch = getc(input->file);
+   }
+   if (ch == EOF)
+   {
+      return 0;
+   }
+
+   record->line = input->line + 1;
+   record->count = 0;
+   int length = 0;
+   int quoted = 0;
+   int wasQuoted = 0;
+   while (1)
+   {
+      int store = 0;
+      if (quoted)
+      {
+         if (ch == EOF)
+         {
+            *problem = "quoted field not closed";
+            return -1;
+         }
+         if (ch == '"')
+         {
+            ch = getc(input->file);
+            if (ch != '"')
+            {
+               quoted = 0;
+               continue;
+            }
+         }
+         input->line += ch == '\n';
+         store = 1;
+      }
+      else if (ch == '"' && length == 0 && !wasQuoted)
+      {
+         quoted = 1;
+         wasQuoted = 1;
+      }
+      else if (ch == ',' || ch == '\n' || ch == EOF)
+      {
+         if (record->count < TRANSFER_FIELDS)
+         {
+            record->fields[record->count][length] = '\0';
+         }
+         record->count++;
+         if (ch != ',')
+         {
+            input->line += ch == '\n';
+            return 1;
+         }
+         length = 0;
+         wasQuoted = 0;
+      }
+      else if (ch != '\r')
+      {
+         store = 1;
+      }
+
+      if (store && record->count < TRANSFER_FIELDS && length < fieldSize(record->count) - 1)
+      {
+         record->fields[record->count][length++] = (char)ch;
+      }
+      ch = getc(input->file);
+   }
+}
+
+//====== READ RECORD FUNCTION ======
+/*
+    readRecord function:
+    - Reads the next record of the input in its format.
+    - Returns 1 if a record was read, 0 at the end of the input, -1 if it is malformed (problem says why).
+*/
+static int readRecord(TransferInput *input, TransferRecord *record, const char **problem)
+{
+   *problem = NULL;
+   if (input->format == FORMAT_CSV)
+   {
+      return readCsvRecord(input, record, problem);
+   }
+
+   int status = readLine(input);
+   record->line = input->line;
+   if (status < 0)
+   {
+      *problem = "line too long";
+      return -1;
+   }
+   if (status == 0)
+   {
+      return 0;
+   }
+   if (input->format == FORMAT_DB)
+   {
+      splitDbLine(input->buffer, record);
+      return 1;
+   }
+   *problem = parseJsonRecord(input->buffer, record);
+   return *problem ? -1 : 1;
+}
+
+//====== CHECK LOANS FUNCTION ======
+/*
+    checkLoans function:
+    - Checks the copies and loans fields of a record: 1 to LOAN_MAX_COPIES copies, and loans of distinct copies
+      among them, which the borrow status and date must sum up (borrowed if any copy is lent, since the oldest loan).
+    - A single copy without loans ("1" and "-") is the copy its borrow status and date describe, as when the
+      record has no copies and loans fields, so it may be borrowed.
+    - Rewrites both fields in canonical form, the loans in copy order.
+    - Returns NULL if they are valid, otherwise the reason they are not.
+*/
+static const char *checkLoans(TransferRecord *record, int borrowed, int32_t day)
+{
+   char *end;
+   long copies = strtol(record->fields[7], &end, 10);
+   if (record->fields[7][0] == '\0' || *end != '\0' || copies < 1 || copies > LOAN_MAX_COPIES)
+   {
+      static char message[64];
+      snprintf(message, sizeof(message), "copies must be a number from 1 to %d", LOAN_MAX_COPIES);
+      return message;
+   }
+
+   static int32_t patrons[LOAN_MAX_COPIES + 1];
+   static int32_t days[LOAN_MAX_COPIES + 1];
+   for (int copy = 1; copy <= copies; copy++)
+   {
+      patrons[copy] = LOAN_SHELF;
+   }
+   const char *loans = record->fields[LOANS_FIELD];
+   int length = (int)strlen(loans);
+   int pos = 0, copy, read, lent = 0;
+   int32_t patron, since, earliest = INT32_MAX;
+   while ((read = nextLoan(loans, length, &pos, &copy, &patron, &since)) > 0)
+   {
+      if (copy > copies)
+      {
+         return "a loan names a copy the book does not have";
+      }
+      if (patrons[copy] != LOAN_SHELF)
+      {
+         return "a copy is lent twice";
+      }
+      patrons[copy] = patron;
+      days[copy] = since;
+      earliest = since < earliest ? since : earliest;
+      lent++;
+   }
+   if (read < 0 || length >= TRANSFER_LINE_LENGTH - 1)
+   {
+      return "loans must be copy:patron:DD-MM-YYYY items separated by ';', or -";
+   }
+   int singleCopy = copies == 1 && lent == 0;
+   if (!singleCopy && (borrowed != (lent > 0) || (lent > 0 && day != earliest)))
+   {
+      return "borrowed and date must match the oldest loan";
+   }
+
+   snprintf(record->fields[7], TRANSFER_FIELD_LENGTH, "%ld", copies);
+   char *text = record->fields[LOANS_FIELD];
+   int written = 0;
+   strcpy(text, "-");
+   for (copy = 1; copy <= copies; copy++)
+   {
+      if (patrons[copy] != LOAN_SHELF)
+      {
+         char date[11];
+         formatDate(days[copy], date, sizeof(date));
+         written += snprintf(text + written, TRANSFER_LINE_LENGTH - written, "%s%d:%d:%s", written ? ";" : "", copy,
+                             patrons[copy], date);
+      }
+   }
+   return NULL;
+}
+
+//====== CHECK RECORD FUNCTION ======
+/*
+    checkRecord function:
+    - Checks a complete record: the book itself with checkBook, then its borrow status and date, which must
+      agree (a borrowed book has a DD-MM-YYYY date, any other book "-"), then its copies and loans (see checkLoans).
+    - Outside books.db, a record of five fields is a book that is not borrowed; a record without copies and
+      loans is a single copy, described by its borrow status.
+    - Returns NULL and stores the year and borrow day if the record is valid, otherwise the reason it is not.
+*/
+static const char *checkRecord(TransferRecord *record, BookFormat format, int *year, int32_t *day)
+{
+   if (record->count == TRANSFER_REQUIRED_FIELDS && format != FORMAT_DB)
+   {
+      strcpy(record->fields[5], "false");
+      strcpy(record->fields[6], "-");
+      record->count = TRANSFER_BOOK_FIELDS;
+   }
+   int withLoans = record->count == TRANSFER_FIELDS;
+   if (record->count == TRANSFER_BOOK_FIELDS)
+   {
+      strcpy(record->fields[7], "1");
+      strcpy(record->fields[LOANS_FIELD], "-");
+      record->count = TRANSFER_FIELDS;
+   }
+   if (record->count != TRANSFER_FIELDS)
+   {
+      return format == FORMAT_DB ? "expected 7 or 9 '|'-separated fields" : "expected 5, 7 or 9 fields";
+   }
+
+   char **fields = record->fields;
+   const char *problem = checkBook(fields[0], fields[1], fields[2], fields[3], fields[4], year);
+   if (problem)
+   {
+      return problem;
+   }
+   int borrowed = strcmp(fields[5], "true") == 0;
+   if (!borrowed && strcmp(fields[5], "false") != 0)
+   {
+      return "borrowed must be true or false";
+   }
+   if (!parseDate(fields[6], (int)strlen(fields[6]), day))
+   {
+      return "date must be DD-MM-YYYY or -";
+   }
+   if (borrowed != (*day != NO_DATE))
+   {
+      return borrowed ? "a borrowed book needs its borrow date" : "a book that is not borrowed has no date";
+   }
+   return withLoans ? checkLoans(record, borrowed, *day) : NULL;
+}
+
+//====== WRITE CSV FIELD FUNCTION ======
+/*
+    writeCsvField function:
+    - Writes a text field, in quotes (with "" for a quote) if it holds a comma, a quote or surrounding spaces.
+*/
+static void writeCsvField(FILE *output, const char *text)
+{
+   size_t length = strlen(text);
+   if (!strpbrk(text, ",\"") && (length == 0 || (text[0] != ' ' && text[length - 1] != ' ')))
+   {
+      fputs(text, output);
+      return;
+   }
+   fputc('"', output);
+   for (const char *ch = text; *ch; ch++)
+   {
+      if (*ch == '"')
+      {
+         fputc('"', output);
+      }
+      fputc(*ch, output);
+   }
+   fputc('"', output);
+}
+
+//====== WRITE RECORD FUNCTION ======
+/*
+    writeRecord function:
+    - Writes a checked record in the given format; the date is written in its canonical DD-MM-YYYY form.
+    - books.db lines only get copies and loans fields if the book has more than one copy or a loan.
+*/
+static void writeRecord(FILE *output, BookFormat format, const TransferRecord *record, int year, int32_t day)
+{
+   char date[11];
+   formatDate(day, date, sizeof(date));
+
+   if (format == FORMAT_DB)
+   {
+      fprintf(output, "%s|%s|%s|%d|%s|%s|%s", record->fields[0], record->fields[1], record->fields[2], year, record->fields[4], record->fields[5], date);
+      if (strcmp(record->fields[7], "1") != 0 || strcmp(record->fields[LOANS_FIELD], "-") != 0)
+      {
+         fprintf(output, "|%s|%s", record->fields[7], record->fields[LOANS_FIELD]);
+      }
+      fputc('\n', output);
+   }
+   else if (format == FORMAT_CSV)
+   {
+      for (int field = 0; field < 3; field++)
+      {
+         writeCsvField(output, record->fields[field]);
+         fputc(',', output);
+      }
+      fprintf(output, "%d,", year);
+      writeCsvField(output, record->fields[4]);
+      fprintf(output, ",%s,%s,%s,%s\n", record->fields[5], date, record->fields[7], record->fields[LOANS_FIELD]);
+   }
+   else
+   {
+      fprintf(output, "{\"isbn\":");
+      writeJsonString(output, record->fields[0], (int)strlen(record->fields[0]));
+      fprintf(output, ",\"title\":");
+      writeJsonString(output, record->fields[1], (int)strlen(record->fields[1]));
+      fprintf(output, ",\"authors\":");
+      writeJsonString(output, record->fields[2], (int)strlen(record->fields[2]));
+      fprintf(output, ",\"year\":%d,\"genre\":", year);
+      writeJsonString(output, record->fields[4], (int)strlen(record->fields[4]));
+      fprintf(output, ",\"borrowed\":%s,\"date\":\"%s\",\"copies\":%s,\"loans\":\"%s\"}\n", record->fields[5], date,
+              record->fields[7], record->fields[LOANS_FIELD]);
+   }
+}
+
+//====== TRANSFER BOOKS FUNCTION ======
+/*
+    transferBooks function:
+    - Reads the books of input one record at a time, checks each like addBook would and writes the valid ones to
+      output in format to (output may be NULL to only check). Memory use does not depend on the input size.
+    - Invalid records are reported on stderr with their line (the first TRANSFER_MAX_ERRORS of them) and skipped.
+    - A CSV output starts with a header line; a CSV input may start with one.
+    - Duplicate ISBNs are not detected, as that would take memory for every ISBN.
+    - Returns 1 if every record was valid and the output was written, 0 otherwise.
+*/
+int transferBooks(FILE *input, BookFormat from, FILE *output, BookFormat to, TransferCounts *counts)
+{
+   TransferInput reader = {input, from, 0, ""};
+   static TransferRecord record;
+   const char *problem;
+   int status;
+   int first = 1;
+
+   initRecord(&record);
+   memset(counts, 0, sizeof(*counts));
+   if (output && to == FORMAT_CSV)
+   {
+      fprintf(output, "isbn,title,authors,year,genre,borrowed,date,copies,loans\n");
+   }
+
+   while ((status = readRecord(&reader, &record, &problem)) != 0)
+   {
+      if (first && from == FORMAT_CSV && status > 0 && strcmp(record.fields[0], "isbn") == 0)
+      {
+         first = 0;
+         continue;
+      }
+      first = 0;
+      counts->records++;
+
+      int year;
+      int32_t day;
+      if (status > 0)
+      {
+         problem = checkRecord(&record, from, &year, &day);
+      }
+      if (problem)
+      {
+         if (++counts->invalid <= TRANSFER_MAX_ERRORS)
+         {
+            fprintf(stderr, "Error: Line %ld: %s.\n", record.line, problem);
+         }
+         continue;
+      }
+      counts->written++;
+      if (output)
+      {
+         writeRecord(output, to, &record, year, day);
+      }
+   }
+
+   if (counts->invalid > TRANSFER_MAX_ERRORS)
+   {
+      fprintf(stderr, "Error: %ld more invalid records not shown.\n", counts->invalid - TRANSFER_MAX_ERRORS);
+   }
+   if (ferror(input))
+   {
+      fprintf(stderr, "Error: Unable to read the input.\n");
+      return 0;
+   }
+   if (output && (fflush(output) != 0 || ferror(output)))
+   {
+      fprintf(stderr, "Error: Unable to write the output.\n");
+      return 0;
+   }
+   return counts->invalid == 0;
+}
+
+//====== HAS PENDING CHANGES FUNCTION ======
+/*
+    hasPendingChanges function:
+    - Tells whether the journal holds changes that are not in books.db yet (anything after its header line,
+      or a journal left over from a compaction).
+*/
+static int hasPendingChanges(void)
+{
+   if (access("books.db.journal.old", F_OK) == 0)
+   {
+      return 1;
+   }
+   FILE *journal = fopen("books.db.journal", "r");
+   if (!journal)
+   {
+      return 0;
+   }
+   int ch;
+   while ((ch = getc(journal)) != '\n' && ch != EOF)
+      ;
+   int pending = ch != EOF && getc(journal) != EOF;
+   fclose(journal);
+   return pending;
+}
+
+//====== OPEN INPUT FUNCTION ======
+/*
+    openInput function:
+    - Opens path for reading, or returns stdin if it is NULL or "-", with a TRANSFER_BUFFER_SIZE buffer.
+    - Returns NULL if the file cannot be opened.
+*/
+static FILE *openInput(const char *path)
+{
+   static char buffer[TRANSFER_BUFFER_SIZE];
+   FILE *input = stdin;
+   if (path && strcmp(path, "-") != 0 && !(input = fopen(path, "r")))
+   {
+      fprintf(stderr, "Error: Unable to open %s.\n", path);
+      return NULL;
+   }
+   setvbuf(input, buffer, _IOFBF, sizeof(buffer));
+   return input;
+}
+
+//====== EXPORT CATALOG FUNCTION ======
+/*
+    exportCatalog function:
+    - Writes the books of books.db to path (stdout if it is NULL or "-") in the given format, streaming,
+      so catalogs of any size are exported without loading them.
+    - Invalid lines of books.db are reported and left out.
+    - Changes still in the journal are not exported; a warning says so.
+    - Returns 1 if every book was exported, 0 otherwise.
+*/
+int exportCatalog(BookFormat format, const char *path)
+{
+   static char buffer[TRANSFER_BUFFER_SIZE];
+   FILE *input = openInput("books.db");
+   if (!input)
+   {
+      return 0;
+   }
+   FILE *output = stdout;
+   if (path && strcmp(path, "-") != 0 && !(output = fopen(path, "w")))
+   {
+      fprintf(stderr, "Error: Unable to create %s.\n", path);
+      fclose(input);
+      return 0;
+   }
+   setvbuf(output, buffer, _IOFBF, sizeof(buffer));
+   if (hasPendingChanges())
+   {
+      fprintf(stderr, "Warning: books.db.journal holds changes not yet written to books.db; they are not exported.\n");
+   }
+
+   TransferCounts counts;
+   int exported = transferBooks(input, FORMAT_DB, output, format, &counts);
+   fclose(input);
+   if (output != stdout && fclose(output) != 0)
+   {
+      fprintf(stderr, "Error: Unable to write %s.\n", path);
+      exported = 0;
+   }
+   fprintf(stderr, "Exported %ld of %ld books.\n", counts.written, counts.records);
+   return exported;
+}
+
+//====== REPLACE CATALOG FUNCTION ======
+/*
+    replaceCatalog function:
+    - Replaces books.db with the books read from path (stdin if it is NULL or "-") in the given format,
+      streaming them into "books.db.tmp", which is fsynced and renamed over books.db like saveDatabase does.
+    - All or nothing: if any record is invalid, every problem is reported and books.db is left as it was.
+    - The old journal belongs to the old books.db; the next start sets it aside as "books.db.journal.stale".
+    - Returns 1 if books.db was replaced, 0 otherwise.
+*/
+static int replaceCatalog(BookFormat format, const char *path)
+{
+   static char buffer[TRANSFER_BUFFER_SIZE];
+   FILE *input = openInput(path);
+   if (!input)
+   {
+      return 0;
+   }
+   FILE *output = fopen("books.db.tmp", "w");
+   if (!output)
+   {
+      fprintf(stderr, "Error: Unable to create books.db.tmp.\n");
+      if (input != stdin)
+      {
+         fclose(input);
+      }
+      return 0;
+   }
+   setvbuf(output, buffer, _IOFBF, sizeof(buffer));
+
+   TransferCounts counts;
+   int imported = transferBooks(input, format, output, FORMAT_DB, &counts);
+   if (input != stdin)
+   {
+      fclose(input);
+   }
+   int synced = imported && fsync(fileno(output)) == 0;
+   if (fclose(output) != 0 || !synced)
+   {
+      if (imported)
+      {
+         fprintf(stderr, "Error: Unable to finish writing books.db.tmp.\n");
+      }
+      fprintf(stderr, "Error: %ld invalid of %ld records, books.db was left unchanged.\n", counts.invalid,
+              counts.records);
+      unlink("books.db.tmp");
+      return 0;
+   }
+   if (rename("books.db.tmp", "books.db") != 0)
+   {
+      fprintf(stderr, "Error: Unable to replace books.db.\n");
+      unlink("books.db.tmp");
+      return 0;
+   }
+   if (!syncDirectory("books.db"))
+   {
+      fprintf(stderr, "Error: Unable to flush the directory of books.db.\n");
+      return 0;
+   }
+   fprintf(stderr, "Imported %ld books into books.db.\n", counts.written);
+   return 1;
+}
+
+//====== IMPORT CATALOG FUNCTION ======
+/*
+    importCatalog function:
+    - Replaces books.db with replaceCatalog while holding the catalog lock, so it never swaps the file
+      under a running program that is journaling changes to it.
+    - Returns 1 if books.db was replaced, 0 otherwise.
+*/
+int importCatalog(BookFormat format, const char *path)
+{
+   int lock = journalLock("books.db");
+   if (lock < 0)
+   {
+      return 0;
+   }
+   int ok = replaceCatalog(format, path);
+   close(lock);
+   return ok;
+}
+
+//====== CHECK CATALOG FUNCTION ======
+/*
+    checkCatalog function:
+    - Checks the books of path (stdin if it is NULL or "-") in the given format without writing anything,
+      reporting every invalid record.
+    - Returns 1 if all of them are valid, 0 otherwise.
+*/
+int checkCatalog(BookFormat format, const char *path)
+{
+   FILE *input = openInput(path);
+   if (!input)
+   {
+      return 0;
+   }
+   TransferCounts counts;
+   int valid = transferBooks(input, format, NULL, format, &counts);
+   if (input != stdin)
+   {
+      fclose(input);
+   }
+   fprintf(stderr, "Checked %ld records, %ld invalid.\n", counts.records, counts.invalid);
+   return valid;
+}
@@ -0,0 +1,45 @@
+#ifndef TRANSFER_H
+#define TRANSFER_H
+
+#include <stdio.h>
+
+// Longest line of books.db or JSON Lines input, including its line break (loadDatabase takes lines below 64 KB)
+#define TRANSFER_LINE_LENGTH (1 << 16)
+
+// Longest field kept of an input record, but for the loans which may take a whole line; every field limit is
+// below it, so a clamped field still fails checkBook
+#define TRANSFER_FIELD_LENGTH 256
+
+// Bytes of the stdio buffers of the input and the output
+#define TRANSFER_BUFFER_SIZE (1 << 20)
+
+// Most invalid records reported one by one, the rest are only counted
+#define TRANSFER_MAX_ERRORS 100
+
+// File formats of a catalog
+typedef enum
+{
+   FORMAT_DB,   // books.db lines: ISBN|Title|Authors|Year|Genre|true/false|DD-MM-YYYY or -[|copies|loans]
+   FORMAT_CSV,  // Comma-separated values with a header line, fields quoted as needed
+   FORMAT_JSONL // One JSON object per line, as books appear in batch mode results
+} BookFormat;
+
+//====== TRANSFER COUNTS STRUCTURE DEFINITION ======
+/*
+    TransferCounts structure:
+    - What one pass over an input found.
+*/
+typedef struct
+{
+   long records; // Records read, valid or not
+   long written; // Valid records (written to the output, if there is one)
+   long invalid; // Records rejected, with their line reported on stderr
+} TransferCounts;
+
+int parseFormat(const char *name, BookFormat *format);
+int transferBooks(FILE *input, BookFormat from, FILE *output, BookFormat to, TransferCounts *counts);
+int exportCatalog(BookFormat format, const char *path);
+int importCatalog(BookFormat format, const char *path);
+int checkCatalog(BookFormat format, const char *path);
+
+#endif
@@ -0,0 +1,606 @@
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "catalog.h"
+#include "image.h"
+#include "stats.h"
+#include "trigram_index.h"
+
+//====== LOWER TITLE FUNCTION ======
+/*
+    lowerTitle function:
+    - Copies the title of a row into buffer as a lowercased NUL-terminated string.
+    - Returns its length.
+*/
+static int lowerTitle(const Catalog *catalog, int row, char *buffer, int size)
+{
+   StringView title = bookTitle(catalog, row);
+   snprintf(buffer, size, "%.*s", title.length, title.data);
+   int length = 0;
+   for (; buffer[length]; length++)
+   {
+      buffer[length] = (char)tolower((unsigned char)buffer[length]);
+   }
+   return length;
+}
+
+// Top byte of the keys: plus the number of bytes (1 to 3) for the starts, fixed for the others
+#define KEY_TITLE_START 0
+#define KEY_WORD_START 3
+#define KEY_INSIDE_WORD 7
+#define KEY_WHOLE_TITLE 8
+
+//====== TRIGRAM KEY FUNCTION ======
+/*
+    trigramKey function:
+    - Packs the key stored in a slot (never 0) for text found where anchor says:
+        TRIGRAM_TITLE_START, TRIGRAM_WORD_START: its first one to three bytes (length at least 1)
+        TRIGRAM_INSIDE_WORD: its first three bytes (length at least 3)
+        TRIGRAM_WHOLE_TITLE: a 16-bit hash of all length bytes, so a key gathers a few titles and a
+                             slot per title is not needed
+*/
+static uint32_t trigramKey(int anchor, const char *text, int length)
+{
+   if (anchor == TRIGRAM_WHOLE_TITLE)
+   {
+      uint32_t hash = 2166136261u;
+      for (int i = 0; i < length; i++)
+      {
+         hash = (hash ^ (unsigned char)text[i]) * 16777619u;
+      }
+      return ((uint32_t)KEY_WHOLE_TITLE << 24) | ((hash ^ (hash >> 16)) & 0xffffu);
+   }
+
+   int bytes = length < 3 ? length : 3;
+   int kind = anchor == TRIGRAM_INSIDE_WORD ? KEY_INSIDE_WORD
+              : anchor == TRIGRAM_TITLE_START ? KEY_TITLE_START + bytes
+                                               : KEY_WORD_START + bytes;
+   uint32_t key = (uint32_t)kind << 24;
+   for (int i = 0; i < bytes; i++)
+   {
+      key |= (uint32_t)(unsigned char)text[i] << (16 - 8 * i);
+   }
+   return key;
+}
+
+//====== HASH TRIGRAM FUNCTION ======
+/*
+    hashTrigram function:
+    - Mixes the bits of a trigram key so neighbouring keys spread over the table.
+*/
+static unsigned int hashTrigram(uint32_t key)
+{
+   key ^= key >> 16;
+   key *= 0x45d9f3bu;
+   key ^= key >> 16;
+   return key;
+}
+
+//====== FIND TRIGRAM FUNCTION ======
+/*
+    findTrigram function:
+    - Looks up a trigram key in the hash table.
+    - Returns its slot, or NULL if no title contains it.
+*/
+static TrigramSlot *findTrigram(const TrigramIndex *index, uint32_t key)
+{
+   if (index->capacity == 0)
+   {
+      return NULL;
+   }
+
+   unsigned int mask = index->capacity - 1;
+   for (unsigned int pos = hashTrigram(key) & mask; index->slots[pos].trigram != 0; pos = (pos + 1) & mask)
+   {
+      if (index->slots[pos].trigram == key)
+      {
+         return &index->slots[pos];
+      }
+   }
+   return NULL;
+}
+
+//====== RESIZE TRIGRAM TABLE FUNCTION ======
+/*
+    resizeTable function:
+    - Moves all trigrams to a new slot table with the given capacity (a power of two).
+    - Returns 1 on success, 0 on memory allocation failure.
+*/
+static int resizeTable(TrigramIndex *index, unsigned int capacity)
+{
+   TrigramSlot *slots = calloc(capacity, sizeof(TrigramSlot));
+   if (!slots)
+   {
+      fprintf(stderr, "Error: Memory allocation for trigram index failed.\n");
+      return 0;
+   }
+
+   unsigned int mask = capacity - 1;
+   for (unsigned int i = 0; i < index->capacity; i++)
+   {
+      if (index->slots[i].trigram != 0)
+      {
+         unsigned int pos = hashTrigram(index->slots[i].trigram) & mask;
+         while (slots[pos].trigram != 0)
+         {
+            pos = (pos + 1) & mask;
+         }
+         slots[pos] = index->slots[i];
+      }
+   }
+
+   free(index->slots);
+   index->slots = slots;
+   index->capacity = capacity;
+   STATS_ADD(STAT_REALLOCS, 1);
+   return 1;
+}
+
+//====== ADD TRIGRAM FUNCTION ======
+/*
+    addTrigram function:
+    - Records that the title of a row contains a trigram, adding the trigram if it is new.
+    - Rows are added in ascending order, so a repeated trigram of the same title is the last entry.
+    - Returns 1 on success, 0 on memory allocation failure.
+*/
+static int addTrigram(TrigramIndex *index, uint32_t key, int row)
+{
+   TrigramSlot *slot = findTrigram(index, key);
+   if (!slot)
+   {
+      // Keep the load factor under 1/2
+      if ((index->count + 1) * 2 > index->capacity && !resizeTable(index, index->capacity ? index->capacity * 2 : 4096))
+      {
+         return 0;
+      }
+      unsigned int mask = index->capacity - 1;
+      unsigned int pos = hashTrigram(key) & mask;
+      while (index->slots[pos].trigram != 0)
+      {
+         pos = (pos + 1) & mask;
+      }
+      slot = &index->slots[pos];
+      slot->trigram = key;
+      index->count++;
+   }
+
+   if (slot->count > 0 && slot->rows[slot->count - 1] == row)
+   {
+      return 1;
+   }
+   if (slot->count >= slot->capacity)
+   {
+      int capacity = slot->capacity ? slot->capacity * 2 : 4;
+      int *rows = realloc(slot->rows, capacity * sizeof(int));
+      if (!rows)
+      {
+         fprintf(stderr, "Error: Memory allocation for trigram index failed.\n");
+         return 0;
+      }
+      slot->rows = rows;
+      slot->capacity = capacity;
+      STATS_ADD(STAT_REALLOCS, 1);
+   }
+   slot->rows[slot->count++] = row;
+   return 1;
+}
+
+//====== ADD TO TRIGRAM INDEX FUNCTION ======
+/*
+    trigramIndexAdd function:
+    - Indexes the title of the book at the given row, which must be the last row of the catalog: the
+      whole title, the first one to three bytes of the title and of every later word, and every other
+      trigram as one inside a word.
+    - Returns 1 on success, 0 on memory allocation failure.
+*/
+int trigramIndexAdd(TrigramIndex *index, const Catalog *catalog, int row)
+{
+   char title[FIELD_LIMIT(nameBook) + 1];
+   int length = lowerTitle(catalog, row, title, sizeof(title));
+   if (!addTrigram(index, trigramKey(TRIGRAM_WHOLE_TITLE, title, length), row))
+   {
+      return 0;
+   }
+
+   for (int i = 0; i < length; i++)
+   {
+      if (i > 0 && isalnum((unsigned char)title[i - 1]))
+      {
+         if (i + 3 <= length && !addTrigram(index, trigramKey(TRIGRAM_INSIDE_WORD, title + i, 3), row))
+         {
+            return 0;
+         }
+         continue;
+      }
+      int anchor = i == 0 ? TRIGRAM_TITLE_START : TRIGRAM_WORD_START;
+      for (int bytes = 1; bytes <= 3 && i + bytes <= length; bytes++)
+      {
+         if (!addTrigram(index, trigramKey(anchor, title + i, bytes), row))
+         {
+            return 0;
+         }
+      }
+   }
+   return 1;
+}
+
+//====== BUILD TRIGRAM INDEX FUNCTION ======
+/*
+    trigramIndexBuild function:
+    - Builds the index over the titles of all rows of the catalog.
+    - Returns 1 on success, 0 on memory allocation failure.
+*/
+int trigramIndexBuild(TrigramIndex *index, const Catalog *catalog)
+{
+   memset(index, 0, sizeof(*index));
+   for (int i = 0; i < catalog->count; i++)
+   {
+      if (!trigramIndexAdd(index, catalog, i))
+      {
+         return 0;
+      }
+   }
+   return 1;
+}
+
+//====== FIND ROW FUNCTION ======
+/*
+    findRow function:
+    - Finds the first entry of an ascending row list that is not below row, starting at from.
+    - Gallops ahead from from before the binary search, so a walk that asks for close rows one after
+      the other only searches the short stretch it moved.
+*/
+static int findRow(const int *rows, int from, int count, int row)
+{
+   int lo = from, step = 1;
+   while (lo + step < count && rows[lo + step] < row)
+   {
+      lo += step;
+      step *= 2;
+   }
+   int hi = lo + step < count ? lo + step : count;
+   while (lo < hi)
+   {
+      int mid = lo + (hi - lo) / 2;
+      if (rows[mid] < row)
+      {
+         lo = mid + 1;
+      }
+      else
+      {
+         hi = mid;
+      }
+   }
+   return lo;
+}
+
+//====== TITLE MATCHES FUNCTION ======
+/*
+    titleMatches function:
+    - The exact check: returns 1 if the lowercased title of a row (kept in the scan columns) contains the lowercased query.
+    - Deleted books have a blank title there, so their rows left in the trigram lists never match.
+*/
+static int titleMatches(const Catalog *catalog, int row, const char *query)
+{
+   return strstr(catalog->columns.titles + catalog->columns.titleAt[row], query) != NULL;
+}
+
+//====== QUERY TERM STRUCTURE DEFINITION ======
+/*
+    QueryTerm structure:
+    - The rows having one key of a query: the list of an anchored key, or the up to three lists a trigram
+      is kept in (at the title start, at a later word start, inside a word), which can share rows.
+*/
+typedef struct
+{
+   const TrigramSlot *lists[3];
+   int at[3];     // Position reached in each list
+   int listCount; // Number of lists
+   int total;     // Rows in all lists together
+} QueryTerm;
+
+//====== ADD TERM LIST FUNCTION ======
+/*
+    addTermList function:
+    - Adds the row list of a key to a term if some title has the key.
+*/
+static void addTermList(const TrigramIndex *index, uint32_t key, QueryTerm *term)
+{
+   const TrigramSlot *slot = findTrigram(index, key);
+   if (slot && slot->count > 0)
+   {
+      term->at[term->listCount] = 0;
+      term->lists[term->listCount++] = slot;
+      term->total += slot->count;
+   }
+}
+
+//====== ADD TERM FUNCTION ======
+/*
+    addTerm function:
+    - Inserts the term of a key of the query into terms, which is kept smallest first.
+    - A plain trigram (anchor TRIGRAM_ANYWHERE) gathers the lists of the three places it can be in.
+    - Returns 0 if no title has the key, in which case nothing can match.
+*/
+static int addTerm(const TrigramIndex *index, int anchor, const char *text, int length, QueryTerm *terms, int *count)
+{
+   QueryTerm term = {0};
+   if (anchor == TRIGRAM_ANYWHERE)
+   {
+      addTermList(index, trigramKey(TRIGRAM_TITLE_START, text, 3), &term);
+      addTermList(index, trigramKey(TRIGRAM_WORD_START, text, 3), &term);
+      addTermList(index, trigramKey(TRIGRAM_INSIDE_WORD, text, 3), &term);
+   }
+   else
+   {
+      addTermList(index, trigramKey(anchor, text, length), &term);
+   }
+   if (term.total == 0)
+   {
+      return 0;
+   }
+
+   int j = (*count)++;
+   for (; j > 0 && terms[j - 1].total > term.total; j--)
+   {
+      terms[j] = terms[j - 1];
+   }
+   terms[j] = term;
+   return 1;
+}
+
+//====== TERM HAS ROW FUNCTION ======
+/*
+    termHasRow function:
+    - Returns 1 if one of the lists of a term holds row; rows must be asked for in ascending order.
+*/
+static int termHasRow(QueryTerm *term, int row)
+{
+   for (int k = 0; k < term->listCount; k++)
+   {
+      const TrigramSlot *list = term->lists[k];
+      term->at[k] = findRow(list->rows, term->at[k], list->count, row);
+      if (term->at[k] < list->count && list->rows[term->at[k]] == row)
+      {
+         return 1;
+      }
+   }
+   return 0;
+}
+
+//====== NEXT TERM ROW FUNCTION ======
+/*
+    nextTermRow function:
+    - Returns the next row of a term in ascending order, merging its lists, or -1 after the last one.
+*/
+static int nextTermRow(QueryTerm *term)
+{
+   int row = -1;
+   for (int k = 0; k < term->listCount; k++)
+   {
+      const TrigramSlot *list = term->lists[k];
+      if (term->at[k] < list->count && (row < 0 || list->rows[term->at[k]] < row))
+      {
+         row = list->rows[term->at[k]];
+      }
+   }
+   for (int k = 0; k < term->listCount && row >= 0; k++)
+   {
+      const TrigramSlot *list = term->lists[k];
+      term->at[k] += term->at[k] < list->count && list->rows[term->at[k]] == row;
+   }
+   return row;
+}
+
+//====== MATCH TITLES FUNCTION ======
+/*
+    trigramIndexMatches function:
+    - The search of trigramIndexSearch, starting at row from and without the timing, for searches that
+      read the matches in chunks and time themselves as a whole (see titleSearchPage).
+    - With an anchor other than TRIGRAM_ANYWHERE, only the rows whose title has the query at that place
+      are candidates: the title is its hash, starts with its first one to three bytes, has a later word
+      starting with them, or has its first trigram inside a word. They still need the substring check,
+      and the caller checks where the query really is (see rankTitle).
+    - A query shorter than three characters has no trigram inside a word; TRIGRAM_INSIDE_WORD then scans like TRIGRAM_ANYWHERE.
+    - Stores up to maxRows matching rows, from row from on, in rows; call again from the row after the last one for more.
+    - Returns the number of rows stored.
+*/
+int trigramIndexMatches(const TrigramIndex *index, const Catalog *catalog, const char *title, int anchor, int from,
+                        int *rows, int maxRows)
+{
+   char query[FIELD_LIMIT(nameBook) + 1];
+   snprintf(query, sizeof(query), "%s", title);
+   int length = 0;
+   for (; query[length]; length++)
+   {
+      query[length] = (char)tolower((unsigned char)query[length]);
+   }
+
+   // A longer query than any title cannot match
+   if ((size_t)length < strlen(title))
+   {
+      return 0;
+   }
+
+   // Rows of the anchored key and of the query's other trigrams, smallest term first
+   if (anchor == TRIGRAM_INSIDE_WORD && length < 3)
+   {
+      anchor = TRIGRAM_ANYWHERE;
+   }
+   QueryTerm terms[TRIGRAM_MAX_QUERY + 1];
+   int count = 0;
+   if (anchor != TRIGRAM_ANYWHERE && length > 0 && !addTerm(index, anchor, query, length, terms, &count))
+   {
+      return 0;
+   }
+   // An anchored key already holds the first trigram
+   for (int i = anchor == TRIGRAM_ANYWHERE ? 0 : 1; anchor != TRIGRAM_WHOLE_TITLE && i + 3 <= length && i < TRIGRAM_MAX_QUERY; i++)
+   {
+      if (!addTerm(index, TRIGRAM_ANYWHERE, query + i, 3, terms, &count))
+      {
+         return 0;
+      }
+   }
+
+   if (count == 0)
+   {
+      return scanTitles(&catalog->columns, from, query, rows, maxRows);
+   }
+
+   // Walk the smallest term, keep rows found in every other term, then check the title itself
+   for (int k = 0; k < terms[0].listCount; k++)
+   {
+      terms[0].at[k] = findRow(terms[0].lists[k]->rows, 0, terms[0].lists[k]->count, from);
+   }
+   int found = 0;
+   int walked = 0;
+   for (int row; found < maxRows && (row = nextTermRow(&terms[0])) >= 0; walked++)
+   {
+      int candidate = 1;
+      for (int t = 1; t < count && candidate; t++)
+      {
+         candidate = termHasRow(&terms[t], row);
+      }
+      if (candidate && titleMatches(catalog, row, query))
+      {
+         rows[found++] = row;
+      }
+   }
+   STATS_ADD(STAT_ROWS_SCANNED, walked);
+   return found;
+}
+
+//====== SEARCH TRIGRAM INDEX FUNCTION ======
+/*
+    trigramIndexSearch function:
+    - Finds the books whose title contains the given text (case-insensitive), in row order.
+    - Queries of three or more characters only check the rows that contain all of the query's
+      trigrams; shorter queries scan every title with the vector kernels.
+    - Stores up to maxRows matching rows in rows and stops there.
+    - Returns the number of rows stored.
+*/
+int trigramIndexSearch(const TrigramIndex *index, const Catalog *catalog, const char *title, int *rows, int maxRows)
+{
+   STATS_START(statStart);
+   int found = trigramIndexMatches(index, catalog, title, TRIGRAM_ANYWHERE, 0, rows, maxRows);
+   STATS_STOP(STAT_FIND_TITLE, statStart);
+   return found;
+}
+
+//====== FREE TRIGRAM INDEX FUNCTION ======
+/*
+    trigramIndexFree function:
+    - Releases the row lists and the slot table.
+*/
+void trigramIndexFree(TrigramIndex *index)
+{
+   for (unsigned int i = 0; i < index->capacity; i++)
+   {
+      free(index->slots[i].rows);
+   }
+   free(index->slots);
+   memset(index, 0, sizeof(*index));
+}
+
+//====== WRITE TRIGRAM INDEX FUNCTION ======
+/*
+    trigramIndexWrite function:
+    - Writes the trigram keys with their list lengths, then all row lists back to back, to a binary image section.
+    - Returns 1 on success, 0 on memory allocation or write failure.
+*/
+int trigramIndexWrite(const TrigramIndex *index, FILE *file)
+{
+   uint32_t sizes[2] = {index->capacity, index->count};
+   uint32_t *entries = malloc((index->capacity ? index->capacity : 1) * 2 * sizeof(uint32_t));
+   if (!entries)
+   {
+      fprintf(stderr, "Error: Memory allocation for trigram index failed.\n");
+      return 0;
+   }
+   size_t total = 0;
+   for (unsigned int i = 0; i < index->capacity; i++)
+   {
+      entries[2 * i] = index->slots[i].trigram;
+      entries[2 * i + 1] = (uint32_t)index->slots[i].count;
+      total += index->slots[i].count;
+   }
+   int ok = imagePut(file, sizes, sizeof(sizes)) && imagePut(file, entries, index->capacity * 2 * sizeof(uint32_t));
+   free(entries);
+
+   for (unsigned int i = 0; ok && i < index->capacity; i++)
+   {
+      const TrigramSlot *slot = &index->slots[i];
+      ok = slot->count == 0 || fwrite(slot->rows, sizeof(int), slot->count, file) == (size_t)slot->count;
+   }
+   return ok && imagePad(file, total * sizeof(int));
+}
+
+//====== READ TRIGRAM INDEX FUNCTION ======
+/*
+    trigramIndexRead function:
+    - Restores an index written by trigramIndexWrite into fresh allocations.
+    - Returns 1 on success, 0 if the section is malformed or allocation fails (the index is then empty).
+*/
+int trigramIndexRead(TrigramIndex *index, ImageReader *reader)
+{
+   memset(index, 0, sizeof(*index));
+   const uint32_t *sizes = imageTake(reader, 2 * sizeof(uint32_t));
+   if (!sizes || (sizes[0] & (sizes[0] - 1)) != 0 || sizes[1] > sizes[0])
+   {
+      return 0;
+   }
+   unsigned int capacity = sizes[0];
+   const uint32_t *entries = imageTake(reader, capacity * 2 * sizeof(uint32_t));
+   if (!entries)
+   {
+      return 0;
+   }
+   size_t total = 0;
+   for (unsigned int i = 0; i < capacity; i++)
+   {
+      if (entries[2 * i + 1] > INT32_MAX)
+      {
+         return 0;
+      }
+      total += entries[2 * i + 1];
+   }
+   const int *rows = imageTake(reader, total * sizeof(int));
+   if (!rows)
+   {
+      return 0;
+   }
+
+   index->slots = calloc(capacity ? capacity : 1, sizeof(TrigramSlot));
+   if (!index->slots)
+   {
+      fprintf(stderr, "Error: Memory allocation for trigram index failed.\n");
+      return 0;
+   }
+   index->capacity = capacity;
+   index->count = sizes[1];
+
+   for (unsigned int i = 0; i < capacity; i++)
+   {
+      TrigramSlot *slot = &index->slots[i];
+      slot->trigram = entries[2 * i];
+      int count = (int)entries[2 * i + 1];
+      if (count == 0)
+      {
+         continue;
+      }
+      slot->rows = malloc(count * sizeof(int));
+      if (!slot->rows)
+      {
+         fprintf(stderr, "Error: Memory allocation for trigram index failed.\n");
+         trigramIndexFree(index);
+         return 0;
+      }
+      memcpy(slot->rows, rows, count * sizeof(int));
+      slot->count = count;
+      slot->capacity = count;
+      rows += count;
+   }
+   return 1;
+}
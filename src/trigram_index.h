@@ -0,0 +1,59 @@
+#ifndef TRIGRAM_INDEX_H
+#define TRIGRAM_INDEX_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+struct Catalog;
+struct ImageReader;
+
+// Most trigrams of a query that are intersected, the rest are left to the substring check
+#define TRIGRAM_MAX_QUERY 64
+
+// Where in a title trigramIndexMatches looks for the query
+#define TRIGRAM_ANYWHERE 0    // Anywhere
+#define TRIGRAM_TITLE_START 1 // At the start of the title
+#define TRIGRAM_WORD_START 2  // At the start of a later word (after a byte that is not a letter or digit)
+#define TRIGRAM_WHOLE_TITLE 3 // The query is the whole title
+#define TRIGRAM_INSIDE_WORD 4 // Inside a word (after a letter or digit)
+
+//====== TRIGRAM INDEX STRUCTURE DEFINITION ======
+/*
+    TrigramIndex structure:
+    - Maps every run of three bytes of a lowercased title to the rows whose title contains it.
+    - A title containing a query also contains all of the query's trigrams, so intersecting their
+      row lists gives a short candidate list that the exact substring check is run on.
+    - Keys live in a hash table (linear probing) with one ascending row list each. A trigram has up to
+      three keys, by where it is: at the start of the title, at the start of a later word, or inside a
+      word (after a letter or digit); a search for it reads the three lists together.
+    - Titles and later words also have keys for their first one and two bytes, and every title one for
+      a hash of itself. With the start and inside keys they find the titles that equal a query, start
+      with it, have a word starting with it or only contain it inside words without reading the titles
+      that match it another way (see TRIGRAM_TITLE_START and the others).
+    - Deleting a book leaves its rows in the lists; the substring check rejects them until the catalog is compacted.
+*/
+typedef struct
+{
+   uint32_t trigram; // Kind of key in the top byte, lowercased bytes or a hash below, 0 if the slot is empty
+   int *rows;        // Rows whose title has the key, ascending
+   int count;        // Number of rows
+   int capacity;     // Allocated rows
+} TrigramSlot;
+
+typedef struct
+{
+   TrigramSlot *slots;    // Slot table, capacity is always a power of two
+   unsigned int capacity; // Number of slots
+   unsigned int count;    // Number of distinct keys
+} TrigramIndex;
+
+int trigramIndexBuild(TrigramIndex *index, const struct Catalog *catalog);
+int trigramIndexAdd(TrigramIndex *index, const struct Catalog *catalog, int row);
+int trigramIndexSearch(const TrigramIndex *index, const struct Catalog *catalog, const char *title, int *rows, int maxRows);
+int trigramIndexMatches(const TrigramIndex *index, const struct Catalog *catalog, const char *title, int anchor, int from,
+                        int *rows, int maxRows);
+void trigramIndexFree(TrigramIndex *index);
+int trigramIndexWrite(const TrigramIndex *index, FILE *file);
+int trigramIndexRead(TrigramIndex *index, struct ImageReader *reader);
+
+#endif
@@ -0,0 +1,145 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "catalog.h"
+#include "stats.h"
+#include "year_index.h"
+
+//====== FIND YEAR FUNCTION ======
+/*
+    findYear function:
+    - Binary search for the first list whose year is not below year.
+*/
+static int findYear(const YearIndex *index, int32_t year)
+{
+   int lo = 0, hi = index->count;
+   while (lo < hi)
+   {
+      int mid = lo + (hi - lo) / 2;
+      if (index->years[mid].year < year)
+      {
+         lo = mid + 1;
+      }
+      else
+      {
+         hi = mid;
+      }
+   }
+   return lo;
+}
+
+//====== ADD TO YEAR INDEX FUNCTION ======
+/*
+    yearIndexAdd function:
+    - Adds a row published in the given year; rows must be added in ascending order.
+    - Returns 1 on success, 0 on memory allocation failure.
+*/
+int yearIndexAdd(YearIndex *index, int row, int32_t year)
+{
+   int at = findYear(index, year);
+   if (at == index->count || index->years[at].year != year)
+   {
+      // First book of this year
+      if (index->count == index->capacity)
+      {
+         int capacity = index->capacity ? index->capacity * 2 : 256;
+         YearList *years = realloc(index->years, capacity * sizeof(YearList));
+         if (!years)
+         {
+            fprintf(stderr, "Error: Memory allocation for the year index failed.\n");
+            return 0;
+         }
+         index->years = years;
+         index->capacity = capacity;
+         STATS_ADD(STAT_REALLOCS, 1);
+      }
+      memmove(index->years + at + 1, index->years + at, (index->count - at) * sizeof(YearList));
+      memset(&index->years[at], 0, sizeof(YearList));
+      index->years[at].year = year;
+      index->count++;
+   }
+
+   YearList *list = &index->years[at];
+   if (list->count == list->capacity)
+   {
+      int capacity = list->capacity ? list->capacity * 2 : 16;
+      int *rows = realloc(list->rows, capacity * sizeof(int));
+      if (!rows)
+      {
+         fprintf(stderr, "Error: Memory allocation for the year index failed.\n");
+         return 0;
+      }
+      list->rows = rows;
+      list->capacity = capacity;
+      STATS_ADD(STAT_REALLOCS, 1);
+   }
+   list->rows[list->count++] = row;
+   return 1;
+}
+
+//====== BUILD YEAR INDEX FUNCTION ======
+/*
+    yearIndexBuild function:
+    - Builds the index over all rows of the catalog.
+    - Returns 1 on success, 0 on memory allocation failure.
+*/
+int yearIndexBuild(YearIndex *index, const Catalog *catalog)
+{
+   memset(index, 0, sizeof(*index));
+   for (int i = 0; i < catalog->count; i++)
+   {
+      if (!isBookDeleted(catalog, i) && !yearIndexAdd(index, i, bookYear(catalog, i)))
+      {
+         return 0;
+      }
+   }
+   return 1;
+}
+
+//====== YEAR RANGE FUNCTION ======
+/*
+    yearIndexRange function:
+    - Finds the books published between firstYear and lastYear (inclusive), by year and then in file order.
+    - Stores up to maxRows of them in rows and stops there.
+    - Returns the number of rows stored.
+*/
+int yearIndexRange(const YearIndex *index, const Catalog *catalog, int firstYear, int lastYear, int *rows, int maxRows)
+{
+   STATS_START(statStart);
+   int found = 0;
+   int examined = 0;
+   for (int at = findYear(index, firstYear); at < index->count && index->years[at].year <= lastYear; at++)
+   {
+      const YearList *list = &index->years[at];
+      for (int i = 0; i < list->count && found < maxRows; i++, examined++)
+      {
+         if (!isBookDeleted(catalog, list->rows[i]))
+         {
+            rows[found++] = list->rows[i];
+         }
+      }
+      if (found == maxRows)
+      {
+         break;
+      }
+   }
+   STATS_ADD(STAT_ROWS_SCANNED, examined);
+   STATS_STOP(STAT_FIND_YEAR, statStart);
+   return found;
+}
+
+//====== FREE YEAR INDEX FUNCTION ======
+/*
+    yearIndexFree function:
+    - Releases every list and the year array.
+*/
+void yearIndexFree(YearIndex *index)
+{
+   for (int i = 0; i < index->count; i++)
+   {
+      free(index->years[i].rows);
+   }
+   free(index->years);
+   memset(index, 0, sizeof(*index));
+}
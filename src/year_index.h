@@ -0,0 +1,38 @@
+#ifndef YEAR_INDEX_H
+#define YEAR_INDEX_H
+
+#include <stdint.h>
+
+struct Catalog;
+
+//====== YEAR INDEX STRUCTURE DEFINITION ======
+/*
+    YearIndex structure:
+    - Publication years in ascending order, each with the ascending list of rows published that year.
+    - A year range is found by binary search over the years and read list by list, so a range query
+      costs time in the number of books returned, sorted by year and then by file order.
+    - New books take the highest row, so adding one appends to its year's list; only a year not seen
+      before moves the year array.
+    - Deleting a book leaves its row in the list; queries skip it until the catalog is compacted.
+*/
+typedef struct
+{
+   int32_t year;  // Publication year
+   int *rows;     // Rows published that year, ascending
+   int count;     // Number of rows
+   int capacity;  // Allocated rows
+} YearList;
+
+typedef struct
+{
+   YearList *years; // One list per year, ascending by year
+   int count;       // Number of distinct years
+   int capacity;    // Allocated lists
+} YearIndex;
+
+int yearIndexBuild(YearIndex *index, const struct Catalog *catalog);
+int yearIndexAdd(YearIndex *index, int row, int32_t year);
+int yearIndexRange(const YearIndex *index, const struct Catalog *catalog, int firstYear, int lastYear, int *rows, int maxRows);
+void yearIndexFree(YearIndex *index);
+
+#endif
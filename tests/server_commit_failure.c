@@ -0,0 +1,179 @@
+#define _GNU_SOURCE
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "server.h"
+#include "storage.h"
+
+//====== TEST SETTINGS ======
+#define SOCKET_NAME "test.sock"
+#define WAIT_SECONDS 10
+
+static const char *books = "9780000000001|Book One|Ann Lee|1999|Fiction|false|-\n";
+
+//====== RUN SERVER FUNCTION ======
+/*
+    runServer function:
+    - Child process: loads the catalog, then caps the size of any file it writes at the journal's current
+      size, so the first journal commit fails, and serves until the server stops.
+    - Exits with 0 if the server stopped cleanly.
+*/
+static void runServer(void)
+{
+   Catalog catalog = {0};
+   if (!loadDatabase(&catalog))
+   {
+      _exit(2);
+   }
+   struct stat st;
+   struct rlimit limit;
+   if (stat("books.db.journal", &st) != 0)
+   {
+      _exit(2);
+   }
+
+   // The limit applies to every file, stdout included when it is redirected to one
+   if (!freopen("/dev/null", "w", stdout))
+   {
+      _exit(2);
+   }
+   limit.rlim_cur = limit.rlim_max = (rlim_t)st.st_size;
+   signal(SIGXFSZ, SIG_IGN);
+   setrlimit(RLIMIT_FSIZE, &limit);
+   int ok = serveLibrary(&catalog, SOCKET_NAME);
+   journalClose(&catalog.journal);
+   freeCatalog(&catalog);
+   _exit(ok ? 0 : 1);
+}
+
+//====== CONNECT SERVER FUNCTION ======
+/*
+    connectServer function:
+    - Connects to the test socket, retrying until the server listens.
+    - Returns the socket, or -1 if the server never came up.
+*/
+static int connectServer(void)
+{
+   struct sockaddr_un address;
+   memset(&address, 0, sizeof(address));
+   address.sun_family = AF_UNIX;
+   strcpy(address.sun_path, SOCKET_NAME);
+   for (int attempt = 0; attempt < WAIT_SECONDS * 100; attempt++)
+   {
+      int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+      if (fd >= 0 && connect(fd, (struct sockaddr *)&address, sizeof(address)) == 0)
+      {
+         return fd;
+      }
+      if (fd >= 0)
+      {
+         close(fd);
+      }
+      usleep(10000);
+   }
+   return -1;
+}
+
+//====== WAIT SERVER FUNCTION ======
+/*
+    waitServer function:
+    - Waits up to WAIT_SECONDS for the server process to end on its own.
+    - Returns 1 if it did, 0 if it had to be killed.
+*/
+static int waitServer(pid_t pid)
+{
+   for (int attempt = 0; attempt < WAIT_SECONDS * 100; attempt++)
+   {
+      if (waitpid(pid, NULL, WNOHANG) == pid)
+      {
+         return 1;
+      }
+      usleep(10000);
+   }
+   kill(pid, SIGKILL);
+   waitpid(pid, NULL, 0);
+   return 0;
+}
+
+//====== CHECK FUNCTION ======
+static int check(int ok, const char *what)
+{
+   printf("%-50s %s\n", what, ok ? "ok" : "FAILED");
+   return ok;
+}
+
+//====== MAIN FUNCTION ======
+/*
+    main function:
+    - Usage: server_commit_failure
+    - Serves a one-book catalog from a temporary directory with the journal unable to grow, sends an add,
+      and checks that the client is told the change was not saved, that the server stops by itself, and
+      that a restart neither has the book nor loses the catalog.
+    - Returns 0 if every check passed, 1 otherwise.
+*/
+int main(void)
+{
+   char directory[] = "/tmp/library-test-XXXXXX";
+   if (!mkdtemp(directory) || chdir(directory) != 0)
+   {
+      fprintf(stderr, "Error: Unable to create a temporary directory.\n");
+      return 1;
+   }
+   FILE *file = fopen("books.db", "w");
+   if (!file || fputs(books, file) == EOF || fclose(file) != 0)
+   {
+      fprintf(stderr, "Error: Unable to write books.db.\n");
+      return 1;
+   }
+
+   pid_t pid = fork();
+   if (pid == 0)
+   {
+      runServer();
+   }
+   int fd = connectServer();
+   int ok = check(fd >= 0, "server is listening");
+
+   char answer[512] = "";
+   if (fd >= 0)
+   {
+      static const char command[] = "add|9780000000002|Book Two|Bob Roe|2001|Mystery\n";
+      FILE *stream = fdopen(fd, "r+");
+      if (stream && fputs(command, stream) != EOF && fflush(stream) == 0 && !fgets(answer, sizeof(answer), stream))
+      {
+         answer[0] = '\0';
+      }
+      if (stream)
+      {
+         fclose(stream);
+      }
+   }
+   ok = check(strstr(answer, "\"status\":\"error\"") && strstr(answer, "could not be saved"),
+              "add is reported as not saved") && ok;
+   ok = check(waitServer(pid), "server stops after the failed commit") && ok;
+
+   // A fresh start replays only what reached the journal
+   Catalog catalog = {0};
+   int loaded = loadDatabase(&catalog);
+   ok = check(loaded && catalog.count == 1 && isbnIndexFind(&catalog.isbnIndex, &catalog, "9780000000001") == 0,
+              "restart keeps the catalog without the change") && ok;
+   journalClose(&catalog.journal);
+   freeCatalog(&catalog);
+
+   char cleanup[300];
+   snprintf(cleanup, sizeof(cleanup), "rm -rf %s", directory);
+   if (system(cleanup) != 0)
+   {
+      fprintf(stderr, "Warning: Unable to remove %s.\n", directory);
+   }
+   return ok ? 0 : 1;
+}
@@ -0,0 +1,85 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "transfer.h"
+
+//====== TEST SETTINGS ======
+#define OUTPUT_SIZE 4096
+
+// books.db lines covering every borrow shape: a borrowed single copy without and with its copies and loans
+// fields, a single copy on the shelf, and several copies lent to patrons
+static const char *books =
+    "9780000000001|Book One|Ann Lee|1999|Fiction|true|01-02-2024\n"
+    "9780000000002|Book Two|Bob Roe, Cy Doe|2001|Mystery, Thriller|true|03-04-2024|1|-\n"
+    "9780000000003|Book Three|Cy Doe|1850|History|false|-\n"
+    "9780000000004|Book \"Four\"|Dee Poe|-20|Poetry|true|05-06-2024|3|3:42:07-06-2024;1:17:05-06-2024\n";
+
+// The same books as an import writes them back: single copies without loans lose their copies and loans fields
+static const char *expected =
+    "9780000000001|Book One|Ann Lee|1999|Fiction|true|01-02-2024\n"
+    "9780000000002|Book Two|Bob Roe, Cy Doe|2001|Mystery, Thriller|true|03-04-2024\n"
+    "9780000000003|Book Three|Cy Doe|1850|History|false|-\n"
+    "9780000000004|Book \"Four\"|Dee Poe|-20|Poetry|true|05-06-2024|3|1:17:05-06-2024;3:42:07-06-2024\n";
+
+//====== CONVERT FUNCTION ======
+/*
+    convert function:
+    - Runs transferBooks from text in one format to another, through temporary files.
+    - Stores the output in result and returns 1 if every record was valid, 0 otherwise.
+*/
+static int convert(const char *text, BookFormat from, BookFormat to, char *result, size_t size)
+{
+   FILE *input = tmpfile();
+   FILE *output = tmpfile();
+   if (!input || !output)
+   {
+      fprintf(stderr, "Error: Unable to create temporary files.\n");
+      return 0;
+   }
+   fputs(text, input);
+   rewind(input);
+
+   TransferCounts counts;
+   int ok = transferBooks(input, from, output, to, &counts) && counts.invalid == 0 && counts.records == 4;
+   rewind(output);
+   size_t length = fread(result, 1, size - 1, output);
+   result[length] = '\0';
+   fclose(input);
+   fclose(output);
+   return ok;
+}
+
+//====== ROUND TRIP FUNCTION ======
+/*
+    roundTrip function:
+    - Exports the books to a format and imports them back, and checks that no record was rejected and that
+      the books.db lines are the expected ones.
+    - Returns 1 if so, 0 otherwise.
+*/
+static int roundTrip(BookFormat format, const char *name)
+{
+   static char exported[OUTPUT_SIZE], imported[OUTPUT_SIZE];
+   int ok = convert(books, FORMAT_DB, format, exported, sizeof(exported)) &&
+            convert(exported, format, FORMAT_DB, imported, sizeof(imported)) && strcmp(imported, expected) == 0;
+   printf("%-6s %s\n", name, ok ? "ok" : "FAILED");
+   if (!ok)
+   {
+      printf("Exported:\n%sImported:\n%s", exported, imported);
+   }
+   return ok;
+}
+
+//====== MAIN FUNCTION ======
+/*
+    main function:
+    - Usage: transfer_roundtrip
+    - Round-trips borrowed and lent books through CSV and JSON Lines.
+    - Returns 0 if every round trip kept the books, 1 otherwise.
+*/
+int main(void)
+{
+   int ok = roundTrip(FORMAT_CSV, "csv");
+   ok = roundTrip(FORMAT_JSONL, "jsonl") && ok;
+   return ok ? 0 : 1;
+}